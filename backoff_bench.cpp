@@ -1,12 +1,14 @@
 /*
  * backoff_bench.cpp
  *
- * Measure the real-time cost of software back-off schedules.
+ * Measure the real-time cost of software back-off schedules, and the
+ * wake-up latency of each consumer WaitPolicy (spin / tpause / umwait /
+ * ladder) from cxl_mpsc_queue_exp.hpp.
  *   – Works on x86-64 / clang++ or g++ (Linux, macOS).
  *   – No external dependencies.
  *
  * Compile:
- *   g++ -O3 -std=c++20 -march=native backoff_bench.cpp -o backoff_bench
+ *   make backoff_bench      # needs the ISAFLAGS (incl. -mwaitpkg) and -lnuma
  *
  * Run:
  *   ./backoff_bench          # prints one table per configuration
@@ -14,6 +16,13 @@
  * The program prints:  pause-slot,   programmed cycles,   median real cycles,
  *                      and the same converted to nanoseconds (ns)
  *                      assuming the invariant-TSC frequency detected at start-up.
+ *                      Then, per wait policy: median / p99 cycles from a
+ *                      signalling store to the waiter noticing it, after the
+ *                      waiter has been idle for a given time.
+ *                      Finally, fixed vs adaptive schedules (set_adaptive)
+ *                      against items arriving at a steady gap: probes per
+ *                      item, detection lag, and the schedule adaptive mode
+ *                      settles on.
  */
 
 #include <array>
@@ -23,9 +32,13 @@
 #include <cstring>
 #include <vector>
 #include <algorithm>
+#include <atomic>
+#include <thread>
 #include <cpuid.h>
 #include <x86intrin.h>   // rdtsc, _mm_pause
 
+#include "cxl_mpsc_queue_exp.hpp"   // ExponentialBackoff, WaitPolicy
+
 // -----------------------------------------------------------------------------
 // low-level helpers  -----------------------------------------------------------
 // -----------------------------------------------------------------------------
@@ -106,6 +119,111 @@ void run_config(uint32_t min_wait,
     }
 }
 
+// -----------------------------------------------------------------------------
+// wake-up latency  -------------------------------------------------------------
+// -----------------------------------------------------------------------------
+
+/// TSC ticks per ns, measured against steady_clock over ~50 ms
+static double measure_tsc_per_ns()
+{
+    const auto     t0 = std::chrono::steady_clock::now();
+    const uint64_t c0 = __rdtsc();
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    const uint64_t c1 = __rdtsc();
+    const auto     t1 = std::chrono::steady_clock::now();
+    return static_cast<double>(c1 - c0) /
+           std::chrono::duration<double, std::nano>(t1 - t0).count();
+}
+
+/// A waiter polls `flag` with the given policy; the main thread stores the
+/// TSC into it after `idle_us` of silence.  Latency = waiter's TSC when it
+/// saw the value − the stored TSC.
+void run_wakeup(WaitPolicy policy, uint32_t idle_us, double tsc_per_ns,
+                int rounds = 101)
+{
+    struct alignas(64) Line { std::atomic<uint64_t> v{0}; };
+    Line flag, ack;
+    std::vector<uint64_t> lat;
+    lat.reserve(rounds);
+
+    std::thread waiter([&] {
+        ExponentialBackoff b{128, 16'384, policy};
+        size_t ev = 0, cyc = 0;
+        for (int r = 0; r < rounds; ++r) {
+            uint64_t sent;
+            while ((sent = flag.v.load(std::memory_order_acquire)) == 0)
+                b.pause(ev, cyc, &flag);
+            lat.push_back(__rdtsc() - sent);
+            b.reset();
+            flag.v.store(0, std::memory_order_relaxed);
+            ack.v.store(r + 1, std::memory_order_release);
+        }
+    });
+
+    for (int r = 0; r < rounds; ++r) {
+        std::this_thread::sleep_for(std::chrono::microseconds(idle_us));
+        flag.v.store(__rdtsc(), std::memory_order_release);
+        while (ack.v.load(std::memory_order_acquire) != uint64_t(r + 1))
+            std::this_thread::yield();
+    }
+    waiter.join();
+
+    std::sort(lat.begin(), lat.end());
+    const uint64_t med = lat[lat.size() / 2];
+    const uint64_t p99 = lat[lat.size() * 99 / 100];
+    printf("%-7s  %7u   %12llu  %9.1f  %12llu  %9.1f\n",
+           std::string(to_string(policy)).c_str(), idle_us,
+           static_cast<unsigned long long>(med), med / tsc_per_ns,
+           static_cast<unsigned long long>(p99), p99 / tsc_per_ns);
+}
+
+// -----------------------------------------------------------------------------
+// adaptive vs fixed schedule  --------------------------------------------------
+// -----------------------------------------------------------------------------
+
+/// One thread: an item "arrives" `gap` TSC cycles after the previous one was
+/// taken; the poller checks the clock, pauses on a miss and resets on a hit,
+/// like dequeue().  Lag = TSC at detection − arrival time.  Cost is what
+/// adaptive mode minimises: lag in wait units + probe_cost per failed poll.
+void run_adaptive(bool adaptive, uint32_t gap, double tsc_per_ns,
+                  double tsc_per_unit, int items = 4'000)
+{
+    ExponentialBackoff b{128, 16'384};
+    b.set_adaptive(adaptive);
+    size_t ev = 0, cyc = 0;
+    std::vector<uint64_t> lag;
+    lag.reserve(items);
+
+    size_t probes = 0, late_probes = 0;
+    for (int i = 0; i < items; ++i) {
+        if (i == items / 2) late_probes = probes;
+        const uint64_t due = __rdtsc() + gap;
+        uint64_t now;
+        while ((now = __rdtsc()) < due) {
+            ++probes;
+            b.pause(ev, cyc);
+        }
+        ++probes;
+        lag.push_back(now - due);
+        b.reset();
+    }
+
+    // only the second half: adaptive mode has settled by then
+    std::sort(lag.begin() + items / 2, lag.end());
+    const uint64_t med = lag[items / 2 + items / 4];
+    const uint64_t p99 = lag[items / 2 + (items / 2) * 99 / 100];
+    double mean_lag = 0;
+    for (int i = items / 2; i < items; ++i) mean_lag += double(lag[i]);
+    mean_lag /= items - items / 2;
+    const double per_item = double(probes - late_probes) / (items - items / 2);
+    const double cost     = mean_lag / tsc_per_unit + b.probe_cost() * (per_item - 1);
+    printf("%-8s  %7u   %7.2f   %11llu  %9.1f   %10llu  %8.0f   %5u / %-5u x%.2f\n",
+           adaptive ? "adaptive" : "fixed", gap, per_item,
+           static_cast<unsigned long long>(med), med / tsc_per_ns,
+           static_cast<unsigned long long>(p99), cost,
+           b.min_wait(), b.max_wait(), b.growth());
+}
+
 // -----------------------------------------------------------------------------
 // main ------------------------------------------------------------------------
 // -----------------------------------------------------------------------------
@@ -120,5 +238,27 @@ int main()
     for (double g : {1.5, 1.7})
         run_config(32u, 16'384u, g);
 
+    // ❸ Wake-up latency per wait policy, short and long idle periods
+    const double tsc_per_ns = measure_tsc_per_ns();
+    printf("\n----  wake-up latency  (TSC %.2f GHz, WAITPKG %s)  ----\n",
+           tsc_per_ns, has_waitpkg() ? "yes" : "no → pause fallback");
+    printf("policy   idle-us   median-cycles  median-ns    p99-cycles    p99-ns\n");
+    printf("-------  -------   -------------  ---------  ------------  --------\n");
+    for (uint32_t idle : {10u, 2'000u})
+        for (WaitPolicy p : {WaitPolicy::spin, WaitPolicy::tpause,
+                             WaitPolicy::umwait, WaitPolicy::ladder})
+            run_wakeup(p, idle, tsc_per_ns);
+
+    // ❹ Fixed 128 / 16384 ×2 vs adaptive, items at a steady inter-arrival gap
+    //    (wait units are pause iterations; cost is in units, see run_adaptive)
+    const double tsc_per_unit = double(median_pause_cost(10'000)) / 10'000;
+    printf("\n----  fixed vs adaptive schedule (items at a steady gap, %.1f TSC/unit)  ----\n",
+           tsc_per_unit);
+    printf("schedule  gap-cyc   probes/item  median-lag  median-ns   p99-lag      cost      min / max   grow\n");
+    printf("--------  -------   -----------  ----------  ---------   ----------  --------   ------------------\n");
+    for (uint32_t gap : {2'000u, 20'000u, 200'000u})
+        for (bool adaptive : {false, true})
+            run_adaptive(adaptive, gap, tsc_per_ns, tsc_per_unit);
+
     return 0;
 }
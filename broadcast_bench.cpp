@@ -0,0 +1,234 @@
+// broadcast_bench.cpp — fan-out: N × CxlMpscQueue vs. one broadcast ring
+//
+// CLI:
+//   ./broadcast_bench numa <node_id> [key=value …]
+//   ./broadcast_bench dax            [key=value …]
+//     subs=1,2,4,8     subscriber counts to sweep       (default 1,2,4,8)
+//     items=200000     entries the producer sends per point
+//     order=12         ring order (every queue and the broadcast ring)
+//     overflow=block   block | lap  (broadcast ring only)
+//
+// Per fan-out N, two runs with one producer and N subscriber threads:
+//   queues    : one CxlMpscQueue per subscriber, the producer enqueues
+//               every entry N times (today's fan-out)
+//   broadcast : one BroadcastRing, every entry written once, each
+//               subscriber publishes its own cursor line
+// Output: producer Mentries/s, ring lines written per entry and CXL
+// reads per entry on the producer side (tail / cursor lines), plus the
+// entries each subscriber missed (lap mode only).
+//
+// Build:
+//   make broadcast_bench
+// ---------------------------------------------------------------------------
+
+#include "cxl_allocator.hpp"
+#include "cxl_broadcast.hpp"
+#include "cxl_mpsc_queue_exp.hpp"
+
+#include <pthread.h>
+#include <sched.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using Steady = std::chrono::steady_clock;
+
+static void pin_to_cpu(unsigned cpu)
+{
+    cpu_set_t set; CPU_ZERO(&set); CPU_SET(cpu, &set);
+    if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0)
+        perror("pthread_setaffinity_np");
+}
+
+[[noreturn]] static void print_usage(const char* prog)
+{
+    std::cerr << "Usage:\n"
+              << "  " << prog << " numa <node_id> [subs=1,2,4,8] [items=200000] [order=12] [overflow=block|lap]\n"
+              << "  " << prog << " dax            [subs=…] [items=…] [order=…] [overflow=…]\n";
+    std::exit(EXIT_FAILURE);
+}
+
+static std::vector<std::size_t> parse_list(const std::string& s)
+{
+    std::vector<std::size_t> out;
+    std::stringstream ss(s);
+    for (std::string tok; std::getline(ss, tok, ','); )
+        if (!tok.empty()) out.push_back(std::max<std::size_t>(1, std::stoull(tok)));
+    return out;
+}
+
+struct Result {
+    double mops          {0};   // producer entries / µs
+    double lines_per_op  {0};   // ring lines written per entry
+    double reads_per_op  {0};   // producer CXL control reads per entry
+    size_t missed        {0};   // entries not delivered (lap mode)
+};
+
+static double mops(std::size_t n, Steady::duration dt)
+{
+    const double us = std::chrono::duration<double, std::micro>(dt).count();
+    return us > 0 ? double(n) / us : 0.0;
+}
+
+// ─── N queues, every entry enqueued N times ─────────────────────────────────
+static Result run_queues(const std::vector<Entry*>& rings, const std::vector<uint64_t*>& tails,
+                         uint32_t order, std::size_t subs, std::size_t items, unsigned n_cpus)
+{
+    std::vector<std::unique_ptr<CxlMpscQueue>> qs;
+    for (std::size_t s = 0; s < subs; ++s)
+        qs.push_back(std::make_unique<CxlMpscQueue>(rings[s], order, tails[s], true));
+
+    std::atomic<bool> go{false};
+    std::vector<std::thread> th;
+    for (std::size_t s = 0; s < subs; ++s)
+        th.emplace_back([&, s] {
+            pin_to_cpu(static_cast<unsigned>((s + 1) % n_cpus));
+            while (!go.load(std::memory_order_acquire)) std::this_thread::yield();
+            Entry buf[16];
+            for (std::size_t got = 0; got < items; )
+                got += qs[s]->dequeue_batch(std::span<Entry>(buf, 16));
+        });
+
+    pin_to_cpu(0);
+    go.store(true, std::memory_order_release);
+    Entry e{};
+    const auto t0 = Steady::now();
+    for (std::size_t i = 0; i < items; ++i) {
+        e.args[0] = i;
+        for (auto& q : qs) while (!q->enqueue(e)) { /* slowest subscriber */ }
+    }
+    const auto dt = Steady::now() - t0;
+    for (auto& t : th) t.join();
+
+    std::size_t reads = 0;
+    for (auto& q : qs) reads += q->get_metrics().read_cxl_tail;
+    return {mops(items, dt), double(subs), double(reads) / double(items), 0};
+}
+
+// ─── one broadcast ring ─────────────────────────────────────────────────────
+static Result run_broadcast(const BroadcastRegion& r, BroadcastProducer::Overflow ov,
+                            std::size_t subs, std::size_t items, unsigned n_cpus)
+{
+    BroadcastProducer pub(r, /*do_initialize=*/true, ov);
+    std::atomic<bool>   go{false}, done{false};
+    std::atomic<size_t> missed{0};
+    std::vector<std::thread> th;
+    for (std::size_t s = 0; s < subs; ++s)
+        th.emplace_back([&, s] {
+            pin_to_cpu(static_cast<unsigned>((s + 1) % n_cpus));
+            BroadcastSubscriber sub(r, static_cast<uint32_t>(s));
+            while (!go.load(std::memory_order_acquire)) std::this_thread::yield();
+            Entry buf[16];
+            // lap mode: the producer may finish first, stop at its last entry
+            for (std::size_t last = 0; last + 1 < items; ) {
+                const std::size_t n = sub.poll_batch(buf);
+                if (n) last = buf[n - 1].args[0];
+                else if (done.load(std::memory_order_relaxed) && sub.cursor() >= items) break;
+            }
+            missed += sub.get_metrics().skipped;
+        });
+
+    // all cursor lines attached before the first entry
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    pin_to_cpu(0);
+    go.store(true, std::memory_order_release);
+    Entry e{};
+    const auto t0 = Steady::now();
+    for (std::size_t i = 0; i < items; ++i) {
+        e.args[0] = i;
+        while (!pub.publish(e)) { /* block mode: slowest subscriber */ }
+    }
+    const auto dt = Steady::now() - t0;
+    done.store(true, std::memory_order_relaxed);
+    for (auto& t : th) t.join();
+
+    return {mops(items, dt), 1.0, double(pub.get_metrics().cursor_reads) / double(items),
+            missed.load()};
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc < 2) print_usage(argv[0]);
+    const std::string mode = argv[1];
+    int mem_node = 0, next = 2;
+    std::unique_ptr<cxl::CxlAllocator> alloc;
+    try {
+        if (mode == "numa" && argc >= 3) {
+            mem_node = std::stoi(argv[2]);
+            next     = 3;
+            alloc    = std::make_unique<cxl::NumaAllocator>(mem_node, cxl::DaxAllocator::default_length,
+                                                           cxl::DebugLevel::off);
+        } else if (mode == "dax") {
+            alloc = std::make_unique<cxl::DaxAllocator>(cxl::DaxAllocator::default_path,
+                                                       cxl::DaxAllocator::default_offset,
+                                                       cxl::DaxAllocator::default_length,
+                                                       cxl::DebugLevel::off);
+        } else {
+            print_usage(argv[0]);
+        }
+    } catch (const std::exception& ex) {
+        std::cerr << "Allocator init failed: " << ex.what() << '\n';
+        return EXIT_FAILURE;
+    }
+
+    std::vector<std::size_t> subs{1, 2, 4, 8};
+    std::size_t items = 200'000;
+    uint32_t    order = 12;
+    auto        ov    = BroadcastProducer::Overflow::block;
+    for (int i = next; i < argc; ++i) {
+        const std::string a = argv[i];
+        const auto eq = a.find('=');
+        if (eq == std::string::npos) print_usage(argv[0]);
+        const std::string k = a.substr(0, eq), v = a.substr(eq + 1);
+        if      (k == "subs")  subs  = parse_list(v);
+        else if (k == "items") items = std::stoull(v);
+        else if (k == "order") order = std::stoul(v);
+        else if (k == "overflow") {
+            if      (v == "block") ov = BroadcastProducer::Overflow::block;
+            else if (v == "lap")   ov = BroadcastProducer::Overflow::lap;
+            else print_usage(argv[0]);
+        } else print_usage(argv[0]);
+    }
+    if (subs.empty() || items == 0 || order < 1 || order >= 24) print_usage(argv[0]);
+
+    // N rings + tail lines for the largest N, and one broadcast region
+    const std::size_t max_subs = *std::max_element(subs.begin(), subs.end());
+    std::vector<Entry*>    rings;
+    std::vector<uint64_t*> tails;
+    for (std::size_t s = 0; s < max_subs; ++s) {
+        rings.push_back(static_cast<Entry*>(alloc->allocate_aligned(sizeof(Entry) << order, 64)));
+        tails.push_back(static_cast<uint64_t*>(alloc->allocate_aligned(64, 64)));
+    }
+    const BroadcastRegion region =
+        BroadcastRegion::allocate(*alloc, order, static_cast<uint32_t>(max_subs));
+
+    const unsigned n_cpus = std::max(1u, std::thread::hardware_concurrency());
+    std::cout << "Memory node " << mem_node << (mode == "dax" ? " (dax)" : "")
+              << "  ring 2^" << order << "  items " << items
+              << "  overflow " << (ov == BroadcastProducer::Overflow::lap ? "lap" : "block")
+              << "  CPUs " << n_cpus << (max_subs + 1 > n_cpus ? " (oversubscribed)" : "") << "\n\n"
+              << " subs  kind        P Mops/s  lines/op  reads/op    missed\n"
+              << " ----  ----------  --------  --------  --------  --------\n"
+              << std::fixed;
+
+    for (std::size_t n : subs) {
+        const Result q = run_queues(rings, tails, order, n, items, n_cpus);
+        const Result b = run_broadcast(region, ov, n, items, n_cpus);
+        for (const auto& [name, r] : {std::pair{"queues", q}, std::pair{"broadcast", b}})
+            std::cout << std::setw(5) << n << "  " << std::left << std::setw(10) << name << std::right
+                      << "  " << std::setw(8) << std::setprecision(2) << r.mops
+                      << "  " << std::setw(8) << std::setprecision(1) << r.lines_per_op
+                      << "  " << std::setw(8) << std::setprecision(4) << r.reads_per_op
+                      << "  " << std::setw(8) << r.missed << '\n';
+    }
+    return EXIT_SUCCESS;
+}
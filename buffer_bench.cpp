@@ -0,0 +1,167 @@
+// buffer_bench.cpp — bulk payloads: multi-line messages vs. out-of-line buffers
+//
+// CLI:
+//   ./buffer_bench pin <cpu_id> numa <node_id> [msgs_per_size]
+//   ./buffer_bench pin <cpu_id> dax            [msgs_per_size]
+//
+// For payloads of 1, 4, 16 and 64 KiB (the json_bench document range):
+//   inline : producer pack_message() + enqueue_message(),
+//            consumer dequeue_message() + unpack_message() into a local buffer
+//   buffer : producer BufferPool::write() + enqueue(handle),
+//            consumer open() + read in place + release()
+// Both consumers fold the payload into a checksum so the reads happen.
+// Producer runs on cpu_id+1, consumer on cpu_id.
+//
+// Build:
+//   make buffer_bench
+// ---------------------------------------------------------------------------
+
+#include "cxl_allocator.hpp"
+#include "cxl_buffer_pool.hpp"
+#include "cxl_mpsc_queue_exp.hpp"
+
+#include <pthread.h>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+using Steady = std::chrono::steady_clock;
+
+constexpr uint32_t    ORDER      = 12;            // 4096 slots ≥ 64 KiB / 56 B
+constexpr std::size_t MAX_BYTES  = 64 * 1024;
+constexpr uint32_t    N_BUFFERS  = 64;
+
+static void pin_to_cpu(unsigned cpu)
+{
+    cpu_set_t set; CPU_ZERO(&set); CPU_SET(cpu, &set);
+    if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0)
+        perror("pthread_setaffinity_np");
+}
+
+static void print_usage(const char* prog)
+{
+    std::cerr << "Usage:\n"
+              << "  " << prog << " pin <cpu_id> numa <node_id> [msgs_per_size]\n"
+              << "  " << prog << " pin <cpu_id> dax            [msgs_per_size]\n";
+    std::exit(EXIT_FAILURE);
+}
+
+static uint64_t fold(const void* p, std::size_t bytes)
+{
+    const auto* w = static_cast<const uint64_t*>(p);
+    uint64_t acc = 0;
+    for (std::size_t i = 0; i < bytes / 8; ++i) acc ^= w[i];
+    return acc;
+}
+
+struct Run { double ns; uint64_t sum; };
+
+static Run run_inline(CxlMpscQueue& q, unsigned cpu, std::size_t bytes, std::size_t msgs)
+{
+    const std::size_t m = message_lines(bytes);
+    std::vector<uint8_t> src(bytes, 0x5a);
+    uint64_t sum = 0;
+
+    const auto t0 = Steady::now();
+    std::thread prod([&] {
+        pin_to_cpu(cpu + 1);
+        std::vector<Entry> lines(m);
+        for (std::size_t i = 0; i < msgs; ++i) {
+            src[0] = static_cast<uint8_t>(i);
+            pack_message(src.data(), bytes, lines);
+            while (!q.enqueue_message(lines)) {}
+        }
+    });
+    std::vector<Entry>   lines(m);
+    std::vector<uint8_t> dst(bytes);
+    for (std::size_t i = 0; i < msgs; ) {
+        if (q.dequeue_message(lines) == 0) continue;
+        unpack_message(lines, dst.data(), bytes);
+        sum += fold(dst.data(), bytes);
+        ++i;
+    }
+    prod.join();
+    return {std::chrono::duration<double, std::nano>(Steady::now() - t0).count(), sum};
+}
+
+static Run run_buffer(CxlMpscQueue& q, BufferPool& pool, unsigned cpu,
+                      std::size_t bytes, std::size_t msgs)
+{
+    std::vector<uint8_t> src(bytes, 0x5a);
+    uint64_t sum = 0;
+
+    const auto t0 = Steady::now();
+    std::thread prod([&] {
+        pin_to_cpu(cpu + 1);
+        for (std::size_t i = 0; i < msgs; ++i) {
+            BufferHandle h;
+            while (!(h = pool.acquire(bytes))) {}
+            src[0] = static_cast<uint8_t>(i);
+            pool.write(h, src.data());
+            Entry e{};
+            put_handle(e, h);
+            while (!q.enqueue(e)) {}
+        }
+    });
+    Entry e{};
+    for (std::size_t i = 0; i < msgs; ) {
+        if (!q.dequeue(e)) { pool.flush_releases(); continue; }
+        const BufferHandle h = get_handle(e);
+        sum += fold(pool.open(h), h.length);
+        pool.release(h);
+        ++i;
+    }
+    pool.flush_releases();
+    prod.join();
+    return {std::chrono::duration<double, std::nano>(Steady::now() - t0).count(), sum};
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc < 4 || std::string(argv[1]) != "pin") print_usage(argv[0]);
+    const unsigned    cpu  = std::stoul(argv[2]);
+    const std::string mode = argv[3];
+
+    std::unique_ptr<cxl::CxlAllocator> alloc;
+    int extra = 0;
+    if (mode == "numa" && argc >= 5) {
+        alloc = std::make_unique<cxl::NumaAllocator>(std::stoi(argv[4]));
+        extra = 5;
+    } else if (mode == "dax") {
+        alloc = std::make_unique<cxl::DaxAllocator>();
+        extra = 4;
+    } else {
+        print_usage(argv[0]);
+    }
+    const std::size_t msgs = argc > extra ? std::stoull(argv[extra]) : 20'000;
+    pin_to_cpu(cpu);
+
+    auto* ring = static_cast<Entry*>(alloc->allocate_aligned(sizeof(Entry) << ORDER, 64));
+    auto* tail = static_cast<uint64_t*>(alloc->allocate_aligned(64, 64));
+    CxlMpscQueue q(ring, ORDER, tail, true);
+    BufferPool   pool(*alloc, N_BUFFERS, MAX_BYTES, 6);   // a return slot per buffer
+
+    std::cout << std::fixed << std::setprecision(2)
+              << "msgs/size=" << msgs << "  ring=" << (1u << ORDER) << " slots  buffers="
+              << N_BUFFERS << " × " << MAX_BYTES << " B\n\n"
+              << "  payload   inline GB/s   buffer GB/s   speed-up\n"
+              << "  -------   -----------   -----------   --------\n";
+    for (std::size_t bytes : {1024ul, 4096ul, 16384ul, 65536ul}) {
+        const Run a = run_inline(q, cpu, bytes, msgs);
+        const Run b = run_buffer(q, pool, cpu, bytes, msgs);
+        if (a.sum != b.sum) std::cerr << "checksum mismatch at " << bytes << " B\n";
+        const double gb = double(bytes) * msgs;
+        std::cout << std::setw(9) << bytes << "   "
+                  << std::setw(11) << gb / a.ns << "   "
+                  << std::setw(11) << gb / b.ns << "   "
+                  << std::setw(8)  << a.ns / b.ns << '\n';
+    }
+    pool.print_metrics("buffer path");
+    return 0;
+}
@@ -9,12 +9,18 @@
 //  Key features
 //   • bump-pointer allocator with           allocate()          // no alignment
 //                                           allocate_aligned()  // 64-B aligned
+//     (deallocate() is a no-op here; cxl_pool_allocator.hpp reuses memory)
 //   • run-time debug level  { Off | Low | High }
 //   • simple 64-B flush + verify test
+//   • MapOptions: prefault at construction, 2 MiB / 1 GiB pages or
+//     alignment, NUMA interleave; map_info() reports what was obtained
 //
 //  Build notes
 //   ▸ DaxAllocator uses   mmap/MAP_SYNC (Linux ≥ 4.15).
 //   ▸ NumaAllocator needs libnuma → link with -lnuma.
+//   ▸ NumaAllocator huge pages use MAP_HUGETLB (reserve them in
+//     /sys/kernel/mm/hugepages first); without a reservation it falls back
+//     to base pages + MADV_HUGEPAGE and map_info() says so.
 //
 //  Example
 //   #include "cxl_allocator.hpp"
@@ -23,10 +29,16 @@
 //   void* p = dax.allocate_aligned(256);        // 64-B aligned
 //   uint8_t* tiny = static_cast<uint8_t*>(dax.allocate(8));   // tightly packed
 //   dax.test_memory();                          // sanity-check cache flush
+//
+//   cxl::MapOptions opt{.prefault = true, .page = cxl::PageSize::huge_2m};
+//   cxl::NumaAllocator ram(1, 1ull << 30, cxl::DebugLevel::low, opt);
+//   const std::uint64_t f0 = cxl::page_faults();
+//   /* … hot loop … */                          // cxl::page_faults() - f0 == 0
 // ─────────────────────────────────────────────────────────────────────────────
 #ifndef CXL_ALLOCATOR_HPP_
 #define CXL_ALLOCATOR_HPP_
 
+#include <algorithm>
 #include <cstddef>
 #include <cstdint>
 #include <cstring>
@@ -41,8 +53,15 @@
 #include <string_view>
 #include <system_error>
 #include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/sysmacros.h>
+#include <chrono>
+#include <fstream>
+#include <vector>
 #include <unistd.h>
 #include <numa.h>
+#include <linux/mman.h>          // MAP_HUGE_2MB / MAP_HUGE_1GB
 
 namespace cxl {
 
@@ -60,6 +79,85 @@ inline void log(DebugLevel lvl,
         std::clog << "[cxl] " << msg << '\n';
 }
 
+// ─────────────────────────────────────────────────────────────────────────────
+//  mapping options / report
+// ─────────────────────────────────────────────────────────────────────────────
+enum class PageSize : uint8_t { base, huge_2m, huge_1g };
+
+constexpr std::size_t page_bytes(PageSize p) noexcept
+{
+    switch (p) {
+    case PageSize::huge_2m: return std::size_t{2} << 20;
+    case PageSize::huge_1g: return std::size_t{1} << 30;
+    default:                return 4096;
+    }
+}
+
+struct MapOptions {
+    bool             prefault {false};           // fault every page in the constructor
+    PageSize         page     {PageSize::base};  // NUMA: page size; DAX: mapping alignment
+    std::vector<int> interleave;                 // NUMA only: nodes to interleave (overrides node)
+};
+
+struct MapInfo {
+    std::size_t   page_size       {4096};  // page size actually backing the mapping
+    bool          huge_fallback   {false}; // huge pages requested but not obtained
+    std::uint64_t prefault_faults {0};     // faults taken while prefaulting
+    double        prefault_ms     {0.0};
+};
+
+/// minor + major page faults of this process so far (getrusage)
+inline std::uint64_t page_faults() noexcept
+{
+    rusage ru{};
+    ::getrusage(RUSAGE_SELF, &ru);
+    return static_cast<std::uint64_t>(ru.ru_minflt) + static_cast<std::uint64_t>(ru.ru_majflt);
+}
+
+inline std::ostream& operator<<(std::ostream& os, const MapInfo& m)
+{
+    os << "page=" << (m.page_size >= (1u << 30) ? m.page_size >> 30 : m.page_size >> 10)
+       << (m.page_size >= (1u << 30) ? " GiB" : " KiB")
+       << (m.huge_fallback ? " (huge pages unavailable)" : "")
+       << "  prefault faults=" << m.prefault_faults
+       << " in " << m.prefault_ms << " ms";
+    return os;
+}
+
+namespace detail {
+
+// Write-fault one byte per page (a read would map the zero page first and
+// fault again on the first store).  The RMW with 0 preserves contents.
+// Private memory only: on a shared CXL region the RMW leaves a modified
+// line per page in this host's cache, and its eventual write-back can
+// overwrite lines another host stored in the meantime.
+inline void touch_pages(void* base, std::size_t length, std::size_t page, MapInfo& info)
+{
+    const std::uint64_t f0 = page_faults();
+    const auto          t0 = std::chrono::steady_clock::now();
+    auto* p = static_cast<std::uint8_t*>(base);
+    for (std::size_t off = 0; off < length; off += page)
+        __atomic_fetch_or(p + off, std::uint8_t{0}, __ATOMIC_RELAXED);
+    info.prefault_faults = page_faults() - f0;
+    info.prefault_ms     = std::chrono::duration<double, std::milli>(
+                               std::chrono::steady_clock::now() - t0).count();
+}
+
+// Read-fault one byte per page of a shared mapping, then drop the line
+// again: nothing is left dirty, and no stale copy is left for later reads.
+// devdax has no zero page, so the read maps the real page.
+inline void read_touch_pages(void* base, std::size_t length, std::size_t page)
+{
+    auto* p = static_cast<volatile std::uint8_t*>(base);
+    for (std::size_t off = 0; off < length; off += page) {
+        (void)p[off];
+        _mm_clflushopt(const_cast<std::uint8_t*>(p + off));
+    }
+    _mm_sfence();
+}
+
+} // namespace detail
+
 // ─────────────────────────────────────────────────────────────────────────────
 //  Interface
 // ─────────────────────────────────────────────────────────────────────────────
@@ -71,6 +169,11 @@ public:
     virtual void* allocate_aligned(std::size_t bytes,
                                    std::size_t alignment = 64) = 0;
 
+    /// return a block (same bytes/alignment as allocated); the bump
+    /// allocators cannot reuse memory and ignore it – see PoolAllocator
+    virtual void deallocate(void* /*p*/, std::size_t /*bytes*/,
+                            std::size_t /*alignment*/ = 64) {}
+
     [[nodiscard]] virtual std::size_t used() const noexcept      = 0;
     [[nodiscard]] virtual std::size_t remaining() const noexcept = 0;
     [[nodiscard]] virtual std::size_t capacity() const noexcept  = 0;
@@ -80,6 +183,9 @@ public:
 
     /// change debug level at run-time
     virtual void set_debug(DebugLevel lvl) noexcept = 0;
+
+    /// page size obtained and prefault cost (see MapOptions)
+    [[nodiscard]] virtual MapInfo map_info() const noexcept { return {}; }
 };
 
 // ─────────────────────────────────────────────────────────────────────────────
@@ -126,10 +232,11 @@ public:
     static constexpr std::size_t      default_offset = 81ULL * 1024 * 1024 * 1024; // 81 GiB
     static constexpr std::size_t      default_length =  1ULL * 1024 * 1024 * 1024; // 1 GiB
 
-    explicit DaxAllocator(std::string_view path   = default_path,
-                          std::size_t      offset = default_offset,
-                          std::size_t      length = default_length,
-                          DebugLevel       dbg    = DebugLevel::low)
+    explicit DaxAllocator(std::string_view  path   = default_path,
+                          std::size_t       offset = default_offset,
+                          std::size_t       length = default_length,
+                          DebugLevel        dbg    = DebugLevel::low,
+                          const MapOptions& opts   = {})
         : path_{path}, offset_{offset}, length_{length}, debug_level_{dbg}
     {
         fd_ = ::open(path.data(), O_RDWR | O_SYNC);
@@ -137,17 +244,38 @@ public:
             throw std::system_error(errno, std::generic_category(),
                                     "open(" + std::string(path) + ")");
 
-        const long page_sz = ::getpagesize();
-        if (offset % page_sz)
-            throw std::invalid_argument("offset must be page-aligned");
+        const std::size_t align = std::max<std::size_t>(::getpagesize(), page_bytes(opts.page));
+        if (offset % align) {
+            ::close(fd_);
+            throw std::invalid_argument("offset must be aligned to " + std::to_string(align));
+        }
 
-        base_addr_ = ::mmap(nullptr,
+        // devdax faults in units of its own alignment; the mapping address
+        // must be aligned to at least that, or every fault falls back to 4 KiB.
+        // Reserve length + align of address space, then map inside it.
+        void* hint = nullptr;
+        if (align > static_cast<std::size_t>(::getpagesize())) {
+            void* r = ::mmap(nullptr, length + align, PROT_NONE,
+                             MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+            if (r != MAP_FAILED) {
+                const auto a = (reinterpret_cast<std::uintptr_t>(r) + align - 1) & ~(align - 1);
+                ::munmap(r, length + align);
+                hint = reinterpret_cast<void*>(a);
+            }
+        }
+
+        const int populate = opts.prefault ? MAP_POPULATE : 0;
+        const std::uint64_t f0 = page_faults();
+        const auto          t0 = std::chrono::steady_clock::now();
+        base_addr_ = ::mmap(hint,
                             length,
                             PROT_READ | PROT_WRITE,
-                            MAP_SHARED_VALIDATE | MAP_SYNC,
+                            MAP_SHARED_VALIDATE | MAP_SYNC | populate |
+                                (hint ? MAP_FIXED_NOREPLACE : 0),
                             fd_,
                             static_cast<off_t>(offset));
         if (base_addr_ == MAP_FAILED) {
+            base_addr_ = nullptr;
             ::close(fd_);
             throw std::system_error(errno, std::generic_category(),
                "mmap(" + std::string(path) +
@@ -155,13 +283,26 @@ public:
                ", length=" + std::to_string(length) + ")");
         }
 
+        info_.page_size = device_align(path_, align);
+        info_.huge_fallback = page_bytes(opts.page) > info_.page_size;
+        if (opts.prefault) {
+            // MAP_POPULATE did the work inside mmap(); the read-only touch
+            // pass only catches what it left behind.  Report both together.
+            // Never a write touch here: the region is shared with other hosts.
+            detail::read_touch_pages(base_addr_, length_, info_.page_size);
+            info_.prefault_faults = page_faults() - f0;
+            info_.prefault_ms     = std::chrono::duration<double, std::milli>(
+                                        std::chrono::steady_clock::now() - t0).count();
+        }
+
         bump_ptr_ = std::make_unique<BumpPtr>(base_addr_, length);
 
         std::ostringstream msg;
         msg << "DAX mmap ok: path=" << path_ << std::hex
             << " offset=" << offset_
             << " length=" << length_
-            << " addr=0x" << reinterpret_cast<std::uintptr_t>(base_addr_);
+            << " addr=0x" << reinterpret_cast<std::uintptr_t>(base_addr_)
+            << std::dec << ' ' << info_;
         log(debug_level_, DebugLevel::low, msg.str());
 
     }
@@ -216,7 +357,21 @@ public:
 
     void set_debug(DebugLevel lvl) noexcept override { debug_level_ = lvl; }
 
+    [[nodiscard]] MapInfo map_info() const noexcept override { return info_; }
+
 private:
+    // Fault granularity of a devdax device: /sys/dev/char/M:m/align
+    // (dax0.0/align on the dax bus); `fallback` when it cannot be read.
+    static std::size_t device_align(const std::string& path, std::size_t fallback)
+    {
+        struct stat st{};
+        if (::stat(path.c_str(), &st) != 0 || !S_ISCHR(st.st_mode)) return fallback;
+        std::ifstream f("/sys/dev/char/" + std::to_string(major(st.st_rdev)) + ':' +
+                        std::to_string(minor(st.st_rdev)) + "/align");
+        std::size_t a = 0;
+        return (f >> a) && a != 0 ? a : fallback;
+    }
+
     std::string           path_;
     std::size_t           offset_;
     std::size_t           length_;
@@ -224,6 +379,7 @@ private:
     int                   fd_{-1};
     void*                 base_addr_{nullptr};
     std::unique_ptr<BumpPtr> bump_ptr_;
+    MapInfo               info_;
 };
 
 // ─────────────────────────────────────────────────────────────────────────────
@@ -232,30 +388,69 @@ private:
 
 class NumaAllocator : public CxlAllocator {
 public:
-    explicit NumaAllocator(int          node,
-                           std::size_t  length = DaxAllocator::default_length,
-                           DebugLevel   dbg    = DebugLevel::low)
+    explicit NumaAllocator(int               node,
+                           std::size_t       length = DaxAllocator::default_length,
+                           DebugLevel        dbg    = DebugLevel::low,
+                           const MapOptions& opts   = {})
         : node_{node}, length_{length}, debug_level_{dbg}
     {
         if (numa_available() == -1)
             throw std::runtime_error("NUMA unavailable");
 
-        base_addr_ = numa_alloc_onnode(length, node);
-        if (!base_addr_)
-            throw std::runtime_error("numa_alloc_onnode failed");
+        // Same as numa_alloc_onnode() (anonymous mmap + mbind), but huge
+        // pages and interleave need the mapping in hand.
+        const std::size_t page = page_bytes(opts.page);
+        map_len_ = (length + page - 1) & ~(page - 1);
+        if (opts.page != PageSize::base) {
+            const int huge = opts.page == PageSize::huge_1g ? MAP_HUGE_1GB : MAP_HUGE_2MB;
+            base_addr_ = ::mmap(nullptr, map_len_, PROT_READ | PROT_WRITE,
+                                MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | huge, -1, 0);
+            if (base_addr_ != MAP_FAILED) {
+                info_.page_size = page;
+            } else {                           // no reservation: THP, best effort
+                base_addr_ = nullptr;
+                info_.huge_fallback = true;
+            }
+        }
+        if (!base_addr_) {
+            base_addr_ = ::mmap(nullptr, map_len_, PROT_READ | PROT_WRITE,
+                                MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (base_addr_ == MAP_FAILED) {
+                base_addr_ = nullptr;
+                throw std::system_error(errno, std::generic_category(), "mmap(anonymous)");
+            }
+            if (info_.huge_fallback) ::madvise(base_addr_, map_len_, MADV_HUGEPAGE);
+        }
+
+        if (opts.interleave.empty()) {
+            numa_tonode_memory(base_addr_, map_len_, node);
+        } else {
+            bitmask* nodes = numa_allocate_nodemask();
+            for (int n : opts.interleave) numa_bitmask_setbit(nodes, n);
+            numa_interleave_memory(base_addr_, map_len_, nodes);
+            numa_free_nodemask(nodes);
+        }
+
+        // After the policy is set: MAP_POPULATE would fault before mbind().
+        if (opts.prefault)
+            detail::touch_pages(base_addr_, map_len_, info_.page_size, info_);
 
         bump_ptr_ = std::make_unique<BumpPtr>(base_addr_, length);
 
         std::ostringstream msg;
-        msg << "NUMA alloc ok: node=" << node
-            << " length=" << length
+        msg << "NUMA alloc ok: node=";
+        if (opts.interleave.empty()) msg << node;
+        else for (std::size_t i = 0; i < opts.interleave.size(); ++i)
+            msg << (i ? "," : "") << opts.interleave[i];
+        msg << (opts.interleave.empty() ? "" : " (interleaved)")
+            << " length=" << length << ' ' << info_
             << " addr=0x" << std::hex << reinterpret_cast<std::uintptr_t>(base_addr_);
         log(debug_level_, DebugLevel::low, msg.str());
     }
 
     ~NumaAllocator() override
     {
-        if (base_addr_) numa_free(base_addr_, length_);
+        if (base_addr_) ::munmap(base_addr_, map_len_);
     }
 
     // ─── allocator API ────────────────────────────────────────────────────
@@ -302,12 +497,16 @@ public:
 
     void set_debug(DebugLevel lvl) noexcept override { debug_level_ = lvl; }
 
+    [[nodiscard]] MapInfo map_info() const noexcept override { return info_; }
+
 private:
     int                  node_;
     std::size_t          length_;
+    std::size_t          map_len_{0};     // length rounded up to the page size
     DebugLevel           debug_level_;
     void*                base_addr_{nullptr};
     std::unique_ptr<BumpPtr> bump_ptr_;
+    MapInfo              info_;
 };
 
 } // namespace cxl
@@ -0,0 +1,383 @@
+// cxl_broadcast.hpp
+// ─────────────────────────────────────────────────────────────────────────────
+//  Broadcast ring – one producer, N subscribers, every entry written once
+//
+//   • the ring holds the queue's 64-B Entry lines (epoch = lap + 1, line
+//     check); every subscriber reads the same lines with its own cursor
+//   • each subscriber owns one cursor line (word 0 = cursor, word 1 =
+//     attached) and publishes it every `interval` entries and whenever a
+//     poll finds nothing new; the producer never writes it
+//   • the producer keeps the minimum of the cursors it last read and reads
+//     the cursor lines fresh only when the ring looks full against that
+//     minimum – like shadow_tail on CxlMpscQueue, one pass over N lines
+//     per (at most) capacity entries, so producer bandwidth does not
+//     depend on the number of subscribers
+//   • Overflow::block : the slowest subscriber in the window holds the
+//                       producer back (publish() returns false)
+//     Overflow::lap   : the producer never waits; a subscriber a whole
+//                       ring behind is lapped – it finds a newer epoch in
+//                       its next slot, skips ahead to it and counts the
+//                       entries it missed
+//   • the producer also publishes its head in a head line every
+//     capacity / 4 entries; a subscriber starts from it when it attaches,
+//     and resyncs to it when its next slot is 128 or more laps ahead
+//     (epoch lag 0x80…0xfe – the 8-bit epoch alone cannot say how far)
+//   • a subscriber whose cursor is more than a ring behind the producer
+//     (lapped) takes no part in the minimum until it has caught up
+//
+//  Epochs are 8 bits: a subscriber lapped a multiple of 256 times, or
+//  255 more, in one go cannot tell and waits for the next lap.  Lap mode
+//  is for consumers that want the latest data (market data, config), not
+//  for lossless delivery.
+//
+//  Layout (allocation order, same on every host): ring, then one cursor
+//  line per subscriber, then the head line (word 0 = head, word 1 =
+//  ~head).
+//
+//  Example
+//   const BroadcastRegion r = BroadcastRegion::allocate(alloc, 12, 4);
+//   BroadcastProducer  pub(r, /*do_initialize=*/true, BroadcastProducer::Overflow::lap);
+//   while (!pub.publish(e)) { /* block mode only: slowest subscriber */ }
+//   BroadcastSubscriber sub(r, /*index=*/2);           // on host 2
+//   Entry out;
+//   if (sub.poll(out)) use(out);
+// ─────────────────────────────────────────────────────────────────────────────
+#ifndef CXL_BROADCAST_HPP_
+#define CXL_BROADCAST_HPP_
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <span>
+#include <string_view>
+#include <vector>
+#include <immintrin.h>
+
+#include "cxl_allocator.hpp"
+#include "cxl_mpsc_queue_exp.hpp"
+
+// The shared memory of one broadcast ring; allocate() fixes the layout.
+struct BroadcastRegion {
+    Entry*    ring        {nullptr};
+    uint64_t* cursors     {nullptr};   // 8 words (one line) per subscriber
+    uint64_t* head        {nullptr};   // producer's head line
+    uint32_t  order       {0};
+    uint32_t  subscribers {0};
+
+    static BroadcastRegion allocate(cxl::CxlAllocator& alloc, uint32_t order, uint32_t subscribers)
+    {
+        assert(order >= 1 && order < 24 && subscribers >= 1);
+        BroadcastRegion r;
+        r.order       = order;
+        r.subscribers = subscribers;
+        r.ring        = static_cast<Entry*>(
+            alloc.allocate_aligned((std::size_t{1} << order) * sizeof(Entry), 64));
+        r.cursors     = static_cast<uint64_t*>(
+            alloc.allocate_aligned(std::size_t{subscribers} * 64, 64));
+        r.head        = static_cast<uint64_t*>(alloc.allocate_aligned(64, 64));
+        return r;
+    }
+
+    [[nodiscard]] uint64_t* cursor_line(uint32_t i) const noexcept { return cursors + 8 * i; }
+
+    // Last head the producer published (0 if none yet, or the line is torn).
+    [[nodiscard]] uint32_t read_head() const noexcept
+    {
+        alignas(64) uint64_t line[8];
+        load_fresh_64B(line, head);
+        return line[1] == ~line[0] ? static_cast<uint32_t>(line[0]) : 0;
+    }
+};
+
+struct BroadcastMetrics {
+    size_t published         {0};   // P: entries written
+    size_t ring_full         {0};   // P: publish() refused (block mode)
+    size_t cursor_scans      {0};   // P: passes over the cursor lines
+    size_t cursor_reads      {0};   // P: fresh cursor-line reads
+    size_t head_publishes    {0};   // P: head-line stores
+    size_t subscribers_lapped{0};   // P: subscribers left behind (lap mode)
+    size_t backoff_events    {0};   // P: pauses after a refused publish
+    size_t backoff_cycles    {0};
+    size_t received          {0};   // S: entries returned
+    size_t empty_polls       {0};   // S: nothing new
+    size_t checksum_failed   {0};   // S: torn line, retried on the next poll
+    size_t laps              {0};   // S: times this subscriber was lapped
+    size_t head_resyncs      {0};   // S: laps resolved from the head line
+    size_t skipped           {0};   // S: entries lost to laps
+    size_t cursor_publishes  {0};   // S: cursor-line stores
+};
+
+// ─────────────────────────────────────────────────────────────────────────────
+//  Producer
+// ─────────────────────────────────────────────────────────────────────────────
+class BroadcastProducer {
+public:
+    enum class Overflow : uint8_t { block, lap };
+
+    BroadcastProducer(const BroadcastRegion& r, bool do_initialize, Overflow overflow = Overflow::block)
+        : ring_(r.ring), region_(r), order_(r.order), mask_((1u << r.order) - 1),
+          overflow_(overflow), lapped_(r.subscribers, false)
+    {
+        if (do_initialize) {
+            std::memset(ring_, 0, sizeof(Entry) * capacity());
+            alignas(64) uint64_t zero[8] = {};
+            for (uint32_t i = 0; i < r.subscribers; ++i) store_nt_64B(r.cursor_line(i), zero);
+            publish_head();
+            _mm_sfence();
+        }
+    }
+
+    [[nodiscard]] std::size_t capacity() const noexcept { return std::size_t{1} << order_; }
+    [[nodiscard]] uint32_t    head()     const noexcept { return head_; }
+    [[nodiscard]] Overflow    overflow() const noexcept { return overflow_; }
+
+    // ────────────────────────────────────────────────────────────────
+    //  publish — write one entry for all subscribers (args and the
+    //  rpc / seal fields are the caller's; epoch and checksum are set
+    //  here).  False only in block mode with the slowest subscriber a
+    //  whole ring behind.
+    // ────────────────────────────────────────────────────────────────
+    bool publish(const Entry& e) noexcept { return publish_batch(std::span<const Entry>(&e, 1)) == 1; }
+
+    // As many of `in` as fit, one fence; returns how many were written.
+    // Every line is checked on its own, so the fence only drains the WC
+    // buffers – there is no publish point to order against.
+    std::size_t publish_batch(std::span<const Entry> in) noexcept
+    {
+        std::size_t n = 0;
+        while (n < in.size()) {
+            const uint32_t room = free_slots(static_cast<uint32_t>(
+                std::min<std::size_t>(in.size() - n, capacity())));
+            if (room == 0) break;
+            for (uint32_t k = 0; k < room && n < in.size(); ++k, ++n) put(in[n], head_++);
+        }
+        if (n == 0) {
+            ++metrics_.ring_full;
+            // give the subscribers time to move before the next scan
+            backoff_full_.pause(metrics_.backoff_events, metrics_.backoff_cycles);
+            return 0;
+        }
+        backoff_full_.reset();
+        if (head_ - head_published_ >= head_interval()) publish_head();
+        _mm_sfence();
+        metrics_.published += n;
+        return n;
+    }
+
+    // Read every cursor line now; returns the minimum over the window.
+    uint32_t scan_cursors() noexcept
+    {
+        ++metrics_.cursor_scans;
+        uint32_t min = head_;
+        const uint32_t cap = static_cast<uint32_t>(capacity());
+        for (uint32_t i = 0; i < region_.subscribers; ++i) {
+            alignas(64) uint64_t line[8];
+            load_fresh_64B(line, region_.cursor_line(i));
+            ++metrics_.cursor_reads;
+            const uint32_t c = static_cast<uint32_t>(line[0]);
+            const bool in_window = line[1] != 0 && head_ - c <= cap;
+            if (!in_window) continue;
+            if (overflow_ == Overflow::lap && head_ - c == cap) {
+                // would block: leave it behind, it resyncs on its own
+                if (!lapped_[i]) { lapped_[i] = true; ++metrics_.subscribers_lapped; }
+                continue;
+            }
+            lapped_[i] = false;
+            if (static_cast<int32_t>(c - min) < 0) min = c;
+        }
+        min_cursor_ = min;
+        return min;
+    }
+
+    // Back-off after a refused publish (block mode), as on CxlMpscQueue.
+    [[nodiscard]] ExponentialBackoff& producer_backoff() noexcept { return backoff_full_; }
+
+    [[nodiscard]] const BroadcastMetrics& get_metrics() const noexcept { return metrics_; }
+
+    void print_metrics(std::string_view label = {}, std::ostream& os = std::cout) const
+    {
+        const auto& m = metrics_;
+        os << "── Broadcast producer [" << label << "] ──────────\n"
+           << "Overflow                : " << (overflow_ == Overflow::lap ? "lap" : "block") << '\n'
+           << "Subscribers             : " << region_.subscribers << '\n'
+           << "Entries published       : " << m.published << '\n'
+           << "Ring full (block)       : " << m.ring_full << '\n'
+           << "Cursor scans / reads    : " << m.cursor_scans << " / " << m.cursor_reads << '\n'
+           << "Head publishes          : " << m.head_publishes << '\n'
+           << "Subscribers lapped      : " << m.subscribers_lapped << '\n'
+           << "Back-off events / cycles: " << m.backoff_events << " / " << m.backoff_cycles << '\n';
+    }
+
+private:
+    // Free slots against the cached minimum; rescans the cursor lines if
+    // fewer than `want` (lap mode: never 0 after a scan).
+    uint32_t free_slots(uint32_t want) noexcept
+    {
+        const uint32_t cap = static_cast<uint32_t>(capacity());
+        if (cap - (head_ - min_cursor_) >= want) return cap - (head_ - min_cursor_);
+        scan_cursors();
+        return cap - (head_ - min_cursor_);
+    }
+
+    uint32_t head_interval() const noexcept { return std::max<uint32_t>((mask_ + 1) / 4, 1); }
+
+    // Head line for subscribers that attach late or were lapped too far.
+    void publish_head() noexcept
+    {
+        alignas(64) uint64_t line[8] = {head_, ~uint64_t{head_}};
+        store_nt_64B(region_.head, line);
+        head_published_ = head_;
+        ++metrics_.head_publishes;
+    }
+
+    void put(const Entry& src, uint32_t pos) noexcept
+    {
+        alignas(64) Entry e = src;
+        e.meta.f.epoch = static_cast<uint8_t>(pos >> order_) + 1;
+        XorCheck::stamp(e);
+        NtStore::store(&ring_[pos & mask_], &e);
+    }
+
+    Entry* const          ring_;
+    const BroadcastRegion region_;
+    const uint32_t        order_;
+    const uint32_t        mask_;
+    const Overflow        overflow_;
+    uint32_t              head_        {0};
+    uint32_t              min_cursor_  {0};   // cached minimum cursor
+    uint32_t              head_published_ {0};
+    std::vector<bool>     lapped_;            // per subscriber, lap mode
+    ExponentialBackoff    backoff_full_ {128};
+    BroadcastMetrics      metrics_;
+};
+
+// ─────────────────────────────────────────────────────────────────────────────
+//  Subscriber – one per cursor line (index < region.subscribers)
+// ─────────────────────────────────────────────────────────────────────────────
+class BroadcastSubscriber {
+public:
+    // interval: entries between cursor publishes (0 → capacity / 4)
+    BroadcastSubscriber(const BroadcastRegion& r, uint32_t index, uint32_t interval = 0)
+        : ring_(r.ring), region_(r), line_(r.cursor_line(index)), order_(r.order),
+          mask_((1u << r.order) - 1),
+          interval_(std::clamp<uint32_t>(interval ? interval : (1u << r.order) / 4, 1, 1u << r.order))
+    {
+        assert(index < r.subscribers && "no cursor line for this subscriber");
+        cursor_ = published_ = r.read_head();   // attach at the live lap
+        publish_cursor();
+    }
+
+    ~BroadcastSubscriber() { detach(); }
+
+    BroadcastSubscriber(const BroadcastSubscriber&)            = delete;
+    BroadcastSubscriber& operator=(const BroadcastSubscriber&) = delete;
+
+    // ────────────────────────────────────────────────────────────────
+    //  poll — the next entry, false if none has been published
+    // ────────────────────────────────────────────────────────────────
+    bool poll(Entry& out) noexcept { return poll_batch(std::span<Entry>(&out, 1)) == 1; }
+
+    // Up to out.size() consecutive entries, one fence for the batch.
+    std::size_t poll_batch(std::span<Entry> out) noexcept
+    {
+        const std::size_t want = std::min(out.size(), std::size_t{k_batch});
+        for (std::size_t k = 0; k < want; ++k)
+            FlushLoad::invalidate(&ring_[(cursor_ + k) & mask_]);
+        _mm_sfence();
+
+        std::size_t n = 0;
+        while (n < want) {
+            Entry& e = out[n];
+            FlushLoad::load(&e, &ring_[cursor_ & mask_]);
+            const uint8_t lag = static_cast<uint8_t>(e.meta.f.epoch - expected_epoch());
+            if (lag != 0) {
+                if (lag == 0xff) break;          // not written yet (previous lap)
+                if (lag >= 0x80) {               // 128+ laps behind: ask the producer
+                    if (!resync_to_head(want - n)) break;
+                    continue;
+                }
+                // lapped: the slot holds lap + lag – skip ahead to it
+                cursor_           += uint32_t{lag} << order_;
+                metrics_.skipped  += std::size_t{lag} << order_;
+                ++metrics_.laps;
+            }
+            if (!XorCheck::verify(e)) { ++metrics_.checksum_failed; break; }
+            ++cursor_;
+            ++n;
+        }
+        if (n == 0) {
+            ++metrics_.empty_polls;
+            if (cursor_ != published_) publish_cursor();   // idle: hand the slots back
+            return 0;
+        }
+        metrics_.received += n;
+        if (cursor_ - published_ >= interval_) publish_cursor();
+        return n;
+    }
+
+    // Store the cursor now (e.g. before going idle for long).
+    void publish_cursor() noexcept
+    {
+        alignas(64) uint64_t line[8] = {cursor_, 1};
+        store_nt_64B(line_, line);
+        published_ = cursor_;
+        ++metrics_.cursor_publishes;
+    }
+
+    // Leave the producer's minimum; the line reads as unattached.
+    void detach() noexcept
+    {
+        alignas(64) uint64_t line[8] = {cursor_, 0};
+        store_nt_64B(line_, line);
+    }
+
+    [[nodiscard]] uint32_t cursor() const noexcept { return cursor_; }
+    [[nodiscard]] const BroadcastMetrics& get_metrics() const noexcept { return metrics_; }
+
+    void print_metrics(std::string_view label = {}, std::ostream& os = std::cout) const
+    {
+        const auto& m = metrics_;
+        os << "── Broadcast subscriber [" << label << "] ────────\n"
+           << "Entries received        : " << m.received << '\n'
+           << "Empty polls             : " << m.empty_polls << '\n'
+           << "Checksum failures       : " << m.checksum_failed << '\n'
+           << "Laps / entries skipped  : " << m.laps << " / " << m.skipped << '\n'
+           << "Head-line resyncs       : " << m.head_resyncs << '\n'
+           << "Cursor publishes        : " << m.cursor_publishes << '\n';
+    }
+
+private:
+    static constexpr uint32_t k_batch = 16;
+
+    uint8_t expected_epoch() const noexcept { return static_cast<uint8_t>(cursor_ >> order_) + 1; }
+
+    // Jump to the producer's published head and invalidate the next
+    // `window` slots from there; false if the head is not ahead.
+    bool resync_to_head(std::size_t window) noexcept
+    {
+        const uint32_t h = region_.read_head();
+        if (static_cast<int32_t>(h - cursor_) <= 0) return false;
+        metrics_.skipped += h - cursor_;
+        ++metrics_.laps;
+        ++metrics_.head_resyncs;
+        cursor_ = h;
+        for (std::size_t k = 0; k < window; ++k) FlushLoad::invalidate(&ring_[(cursor_ + k) & mask_]);
+        _mm_sfence();
+        return true;
+    }
+
+    Entry* const     ring_;
+    const BroadcastRegion region_;
+    uint64_t* const  line_;
+    const uint32_t   order_;
+    const uint32_t   mask_;
+    const uint32_t   interval_;
+    uint32_t         cursor_    {0};
+    uint32_t         published_ {0};
+    BroadcastMetrics metrics_;
+};
+
+#endif // CXL_BROADCAST_HPP_
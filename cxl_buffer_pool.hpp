@@ -0,0 +1,245 @@
+// cxl_buffer_pool.hpp
+// ─────────────────────────────────────────────────────────────────────────────
+//  Out-of-line payload buffers for CxlMpscQueue
+//
+//   • N fixed-size, 64-B aligned buffers in one CXL region; a ring Entry
+//     carries only a BufferHandle {offset, length} in args[0..1] – offsets
+//     are relative to the region, so they mean the same on every host
+//   • producer writes the payload once into the buffer (NT stores), then
+//     enqueues the handle; the consumer reads it in place
+//   • buffers come back on a return ring (consumer → producer, a second
+//     CxlMpscQueue) carrying up to 7 buffer indices per Entry; the free
+//     list itself is host-local to the producer → no cross-host locks
+//
+//  Sizing: (1 << return_order) ≥ n_buffers – one return slot per buffer,
+//  so even Entries carrying a single id (flush_releases() on every idle
+//  poll) cannot fill the ring while the producer owns no buffer.  Releases
+//  never wait on it anyway: ids the ring cannot take yet stay pending on
+//  the consumer and go out with the next release() / flush_releases().
+//
+//  Ownership: a buffer belongs to the producer until its handle is
+//  enqueued, then to the consumer until release().  Each side touches it
+//  only while it owns it.
+//
+//  Example
+//   BufferPool pool(alloc, 256, 64 * 1024, 8);
+//   // producer                                 // consumer
+//   auto h = pool.acquire(len);                 q.dequeue(e);
+//   pool.write(h, src);                         auto h = get_handle(e);
+//   Entry e{}; put_handle(e, h);                const void* p = pool.open(h);
+//   q.enqueue(e);                               ...; pool.release(h);
+// ─────────────────────────────────────────────────────────────────────────────
+#ifndef CXL_BUFFER_POOL_HPP_
+#define CXL_BUFFER_POOL_HPP_
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <span>
+#include <string_view>
+#include <vector>
+#include <immintrin.h>
+
+#include "cxl_allocator.hpp"
+#include "cxl_mpsc_queue_exp.hpp"
+
+struct BufferHandle {
+    uint64_t offset {~0ull};          // bytes from the pool base
+    uint32_t length {0};              // payload bytes
+
+    explicit operator bool() const noexcept { return offset != ~0ull; }
+};
+
+// Handle travels in args[0] (offset) and args[1] (length); args[2..6]
+// stay free for the caller.
+inline void put_handle(Entry& e, const BufferHandle& h) noexcept
+{
+    e.args[0] = h.offset;
+    e.args[1] = h.length;
+}
+
+inline BufferHandle get_handle(const Entry& e) noexcept
+{
+    return BufferHandle{e.args[0], static_cast<uint32_t>(e.args[1])};
+}
+
+struct BufferPoolMetrics {
+    size_t acquired       {0};   // P
+    size_t exhausted      {0};   // P: acquire() found no buffer
+    size_t reclaimed      {0};   // P: buffers back from the return ring
+    size_t bytes_written  {0};   // P
+    size_t opened         {0};   // C
+    size_t bytes_opened   {0};   // C
+    size_t released       {0};   // C
+    size_t return_entries {0};   // C: Entries sent on the return ring
+    size_t return_full    {0};   // C: flushes deferred, return ring full
+};
+
+class BufferPool {
+public:
+    static constexpr std::size_t k_ids_per_entry = std::size(Entry{}.args);   // 7
+
+    // ────────────────────────────────────────────────────────────────
+    //  Allocates the buffer region, then the return ring and its tail
+    //  line, from `alloc` (same order on every host).
+    // ────────────────────────────────────────────────────────────────
+    BufferPool(cxl::CxlAllocator& alloc,
+               uint32_t           n_buffers,
+               std::size_t        buffer_bytes,
+               uint32_t           return_order,
+               bool               do_initialize = true)
+        : n_buffers_(n_buffers),
+          buffer_bytes_((buffer_bytes + 63) & ~std::size_t{63})
+    {
+        assert(n_buffers >= 1);
+        assert((std::size_t{1} << return_order) >= n_buffers &&
+               "return ring needs a slot per buffer (partly filled Entries)");
+        base_ = static_cast<uint8_t*>(
+            alloc.allocate_aligned(std::size_t{n_buffers} * buffer_bytes_, 4096));
+        auto* tail = static_cast<uint64_t*>(alloc.allocate_aligned(64, 64));
+        auto* ring = static_cast<Entry*>(
+            alloc.allocate_aligned((std::size_t{1} << return_order) * sizeof(Entry), 64));
+        returns_ = std::make_unique<CxlMpscQueue>(ring, return_order, tail, do_initialize);
+        returns_->set_wait_policy(WaitPolicy::none);   // acquire() never sleeps
+
+        free_.reserve(n_buffers);
+        for (uint32_t i = n_buffers; i-- > 0; ) free_.push_back(i);
+        pending_.reserve(n_buffers);
+    }
+
+    [[nodiscard]] std::size_t buffer_bytes() const noexcept { return buffer_bytes_; }
+    [[nodiscard]] uint32_t    buffers()      const noexcept { return n_buffers_; }
+    [[nodiscard]] std::size_t free_buffers() const noexcept { return free_.size(); }
+
+    // ── producer side ───────────────────────────────────────────────
+
+    // A buffer for `length` bytes, or an empty handle if all are out.
+    BufferHandle acquire(std::size_t length)
+    {
+        assert(length <= buffer_bytes_ && "payload larger than a buffer");
+        if (free_.empty()) reclaim();
+        if (free_.empty()) { ++metrics_.exhausted; return {}; }
+
+        const uint32_t id = free_.back();
+        free_.pop_back();
+        ++metrics_.acquired;
+        return BufferHandle{std::size_t{id} * buffer_bytes_, static_cast<uint32_t>(length)};
+    }
+
+    // Writable view for in-place construction; finish with publish().
+    [[nodiscard]] void* data(const BufferHandle& h) const noexcept { return base_ + h.offset; }
+
+    // Write back the lines of an in-place payload (before enqueueing h).
+    void publish(const BufferHandle& h) noexcept
+    {
+        uint8_t* p = base_ + h.offset;
+        for (std::size_t off = 0; off < h.length; off += 64) _mm_clwb(p + off);
+        _mm_sfence();
+        metrics_.bytes_written += h.length;
+    }
+
+    // Stream `h.length` bytes from src into the buffer (one pass, NT
+    // stores) and fence, so the handle can be enqueued right after.
+    void write(const BufferHandle& h, const void* src) noexcept
+    {
+        uint8_t*       dst  = base_ + h.offset;
+        const auto*    s    = static_cast<const uint8_t*>(src);
+        const std::size_t full = h.length & ~std::size_t{63};
+        for (std::size_t off = 0; off < full; off += 64)
+            _mm512_stream_si512(reinterpret_cast<__m512i*>(dst + off),
+                                _mm512_loadu_si512(s + off));
+        if (const std::size_t rest = h.length - full) {
+            alignas(64) uint8_t line[64] = {};
+            std::memcpy(line, s + full, rest);
+            stream_64B(dst + full, line);
+        }
+        _mm_sfence();
+        metrics_.bytes_written += h.length;
+    }
+
+    // Pull returned buffer ids back into the free list.
+    std::size_t reclaim()
+    {
+        alignas(64) Entry buf[16];
+        std::size_t got = 0;
+        for (std::size_t n; (n = returns_->dequeue_batch(buf)) != 0; )
+            for (std::size_t k = 0; k < n; ++k)
+                for (uint64_t v : buf[k].args)
+                    if (v != 0) { free_.push_back(static_cast<uint32_t>(v - 1)); ++got; }
+        metrics_.reclaimed += got;
+        return got;
+    }
+
+    // ── consumer side ───────────────────────────────────────────────
+
+    // Invalidate the payload lines, then read in place.
+    [[nodiscard]] const void* open(const BufferHandle& h) noexcept
+    {
+        uint8_t* p = base_ + h.offset;
+        for (std::size_t off = 0; off < h.length; off += 64) _mm_clflushopt(p + off);
+        _mm_sfence();
+        ++metrics_.opened;
+        metrics_.bytes_opened += h.length;
+        return p;
+    }
+
+    // Give the buffer back; ids are sent 7 per Entry (see flush_releases).
+    void release(const BufferHandle& h)
+    {
+        pending_.push_back(h.offset / buffer_bytes_ + 1);   // 0 = empty
+        ++metrics_.released;
+        if (pending_.size() >= k_ids_per_entry) flush_releases();
+    }
+
+    // Send the pending ids now, a partly filled Entry included (call when
+    // going idle).  Never waits for the producer: if the return ring is
+    // full the rest stay pending and false is returned.
+    bool flush_releases()
+    {
+        while (!pending_.empty()) {
+            const std::size_t k = std::min(pending_.size(), k_ids_per_entry);
+            Entry e{};
+            std::copy_n(pending_.end() - k, k, e.args);
+            if (!returns_->enqueue(e)) { ++metrics_.return_full; return false; }
+            pending_.resize(pending_.size() - k);
+            ++metrics_.return_entries;
+        }
+        return true;
+    }
+
+    [[nodiscard]] std::size_t pending_releases() const noexcept { return pending_.size(); }
+
+    [[nodiscard]] const BufferPoolMetrics& get_metrics() const noexcept { return metrics_; }
+    [[nodiscard]] CxlMpscQueue& return_queue() noexcept { return *returns_; }
+
+    void print_metrics(std::string_view label = {}, std::ostream& os = std::cout) const
+    {
+        const auto& m = metrics_;
+        os << "\n════════ BufferPool " << label << " ════════\n"
+           << "Buffers × bytes         : " << n_buffers_ << " × " << buffer_bytes_ << '\n'
+           << "Acquired (exhausted)    : " << m.acquired << " (" << m.exhausted << ")\n"
+           << "Bytes written (P)       : " << m.bytes_written << '\n'
+           << "Opened / bytes (C)      : " << m.opened << " / " << m.bytes_opened << '\n'
+           << "Released / return Ents  : " << m.released << " / " << m.return_entries << '\n'
+           << "Return ring full (C)    : " << m.return_full << '\n'
+           << "Reclaimed (P)           : " << m.reclaimed << '\n';
+    }
+
+private:
+    const uint32_t    n_buffers_;
+    const std::size_t buffer_bytes_;
+    uint8_t*          base_ {nullptr};
+
+    std::unique_ptr<CxlMpscQueue> returns_;   // C enqueues, P dequeues
+    std::vector<uint32_t>         free_;      // P: host-local free list
+
+    std::vector<uint64_t>         pending_;   // C: ids (+1) not yet sent
+
+    BufferPoolMetrics metrics_;
+};
+
+#endif // CXL_BUFFER_POOL_HPP_
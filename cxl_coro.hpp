@@ -0,0 +1,278 @@
+// cxl_coro.hpp
+// ─────────────────────────────────────────────────────────────────────────────
+//  C++20 coroutine front-end for CxlMpscQueue
+//
+//   • CoTask         : fire-and-forget coroutine, owned by a CoroScheduler
+//   • CoroScheduler  : single-threaded; resumes ready coroutines, then makes
+//                      one batched probe per queue that has waiters
+//                        – dequeue waiters : one dequeue_batch() for all of them
+//                        – enqueue waiters : one enqueue_batch() for all of them
+//                      and backs off only if a whole round made no progress
+//   • awaitables     : co_await sched.async_dequeue(q)     → Entry
+//                      co_await sched.async_enqueue(q, e)  (resumes once published)
+//                      co_await sched.yield()
+//
+//  Waiters of one queue are served FIFO.  The scheduler sets the consumer
+//  wait policy of every queue it dequeues from to WaitPolicy::none – it does
+//  the waiting itself, once per idle round.  Not thread-safe: one scheduler
+//  per pinned core, and a queue's consumer side belongs to one scheduler.
+//
+//  Example
+//   CoroScheduler sched;
+//   sched.spawn([](CoroScheduler& s, CxlMpscQueue& q) -> CoTask {
+//       for (;;) { Entry e = co_await s.async_dequeue(q); ... }
+//   }(sched, q));
+//   sched.run();
+// ─────────────────────────────────────────────────────────────────────────────
+#ifndef CXL_CORO_HPP_
+#define CXL_CORO_HPP_
+
+#include <algorithm>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <iostream>
+#include <new>
+#include <span>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "cxl_mpsc_queue_exp.hpp"
+
+class CoroScheduler;
+
+// ─────────────────────────────────────────────────────────────────────────────
+//  CoTask – starts suspended; spawn() hands it to a scheduler
+// ─────────────────────────────────────────────────────────────────────────────
+struct CoTask {
+    struct promise_type {
+        // Frames hold awaiters with alignas(64) Entry members; the default
+        // frame allocation only guarantees 16 B.
+        static void* operator new(std::size_t n)
+        {
+            return ::operator new(n, std::align_val_t{alignof(Entry)});
+        }
+        static void operator delete(void* p) noexcept
+        {
+            ::operator delete(p, std::align_val_t{alignof(Entry)});
+        }
+
+        CoTask get_return_object() noexcept
+        {
+            return CoTask{std::coroutine_handle<promise_type>::from_promise(*this)};
+        }
+        std::suspend_always initial_suspend() noexcept { return {}; }
+        std::suspend_always final_suspend()   noexcept { return {}; }
+        void return_void() noexcept {}
+        void unhandled_exception() noexcept { std::terminate(); }
+    };
+
+    explicit CoTask(std::coroutine_handle<promise_type> h) noexcept : h_(h) {}
+    CoTask(CoTask&& o) noexcept : h_(std::exchange(o.h_, {})) {}
+    CoTask(const CoTask&)            = delete;
+    CoTask& operator=(const CoTask&) = delete;
+    CoTask& operator=(CoTask&&)      = delete;
+    ~CoTask() { if (h_) h_.destroy(); }
+
+private:
+    friend class CoroScheduler;
+    std::coroutine_handle<promise_type> h_;
+};
+
+struct CoroMetrics {
+    size_t resumes        {0};
+    size_t rounds         {0};
+    size_t idle_rounds    {0};   // no coroutine became ready
+    size_t dequeue_probes {0};   // dequeue_batch() calls
+    size_t enqueue_probes {0};   // enqueue_batch() calls
+    size_t items_dequeued {0};
+    size_t items_enqueued {0};
+    size_t backoff_events {0};
+    size_t backoff_cycles {0};
+};
+
+// ─────────────────────────────────────────────────────────────────────────────
+//  CoroScheduler
+// ─────────────────────────────────────────────────────────────────────────────
+class CoroScheduler {
+public:
+    explicit CoroScheduler(uint32_t min_backoff = 128,
+                           uint32_t max_backoff = 16'384,
+                           WaitPolicy idle_policy = WaitPolicy::spin)
+        : backoff_idle_(min_backoff, max_backoff, idle_policy) {}
+
+    CoroScheduler(const CoroScheduler&)            = delete;
+    CoroScheduler& operator=(const CoroScheduler&) = delete;
+
+    ~CoroScheduler()
+    {
+        for (auto h : ready_) h.destroy();
+        for (auto& qw : queues_) {
+            for (auto& w : qw.deq) w.h.destroy();
+            for (auto& w : qw.enq) w.h.destroy();
+        }
+    }
+
+    // Take ownership of a task; it starts on the next round.
+    void spawn(CoTask&& t)
+    {
+        ready_.push_back(std::exchange(t.h_, {}));
+        ++live_;
+    }
+
+    [[nodiscard]] std::size_t live() const noexcept { return live_; }
+
+    void set_wait_policy(WaitPolicy p) noexcept { backoff_idle_.set_policy(p); }
+
+    // ── awaitables ──────────────────────────────────────────────────
+    struct DequeueAwaiter {
+        CoroScheduler& s;
+        CxlMpscQueue&  q;
+        Entry          out {};
+
+        bool  await_ready() const noexcept { return false; }
+        void  await_suspend(std::coroutine_handle<> h) { s.waiters_for(q, true).deq.push_back({h, &out}); }
+        Entry await_resume() const noexcept { return out; }
+    };
+
+    struct EnqueueAwaiter {
+        CoroScheduler& s;
+        CxlMpscQueue&  q;
+        Entry          in;
+
+        bool await_ready() const noexcept { return false; }
+        void await_suspend(std::coroutine_handle<> h) { s.waiters_for(q, false).enq.push_back({h, &in}); }
+        void await_resume() const noexcept {}
+    };
+
+    struct YieldAwaiter {
+        CoroScheduler& s;
+
+        bool await_ready() const noexcept { return false; }
+        void await_suspend(std::coroutine_handle<> h) { s.ready_.push_back(h); }
+        void await_resume() const noexcept {}
+    };
+
+    [[nodiscard]] DequeueAwaiter async_dequeue(CxlMpscQueue& q) noexcept { return {*this, q}; }
+    [[nodiscard]] EnqueueAwaiter async_enqueue(CxlMpscQueue& q, const Entry& e) noexcept { return {*this, q, e}; }
+    [[nodiscard]] YieldAwaiter   yield() noexcept { return {*this}; }
+
+    // ────────────────────────────────────────────────────────────────
+    //  run_once — resume everything ready, then probe every queue with
+    //  waiters once.  Returns the number of coroutines made ready.
+    // ────────────────────────────────────────────────────────────────
+    std::size_t run_once()
+    {
+        ++metrics_.rounds;
+
+        /* resuming may make more coroutines ready (yield) – only run the
+         * ones that were ready at the start of the round */
+        for (std::size_t n = ready_.size(); n != 0; --n) {
+            auto h = ready_.front();
+            ready_.pop_front();
+            ++metrics_.resumes;
+            h.resume();
+            if (h.done()) { h.destroy(); --live_; }
+        }
+
+        const std::size_t before = ready_.size();
+        for (auto& qw : queues_) {
+            if (!qw.deq.empty()) probe_dequeue(qw);
+            if (!qw.enq.empty()) probe_enqueue(qw);
+        }
+        return ready_.size() - before;
+    }
+
+    // Run until every spawned task has finished.
+    void run()
+    {
+        while (live_ != 0) {
+            if (run_once() == 0 && ready_.empty()) {
+                ++metrics_.idle_rounds;
+                backoff_idle_.pause(metrics_.backoff_events, metrics_.backoff_cycles);
+            } else {
+                backoff_idle_.reset();
+            }
+        }
+    }
+
+    [[nodiscard]] const CoroMetrics& get_metrics() const noexcept { return metrics_; }
+
+    void print_metrics(std::string_view label = {}, std::ostream& os = std::cout) const
+    {
+        const auto& m = metrics_;
+        os << "\n════════ CoroScheduler " << label << " ════════\n"
+           << "Rounds (idle)           : " << m.rounds << " (" << m.idle_rounds << ")\n"
+           << "Resumes                 : " << m.resumes << '\n'
+           << "Dequeue probes / items  : " << m.dequeue_probes << " / " << m.items_dequeued << '\n'
+           << "Enqueue probes / items  : " << m.enqueue_probes << " / " << m.items_enqueued << '\n'
+           << "Back-off events/cycles  : " << m.backoff_events << " / " << m.backoff_cycles << '\n';
+    }
+
+private:
+    static constexpr std::size_t k_batch = 16;
+
+    struct Waiter {
+        std::coroutine_handle<> h;
+        Entry*                  e;
+    };
+    struct QueueWaiters {
+        CxlMpscQueue*      q;
+        std::deque<Waiter> deq;
+        std::deque<Waiter> enq;
+        bool               consumer;    // wait policy already switched
+    };
+
+    // Few queues per scheduler: a linear scan beats a map here.
+    QueueWaiters& waiters_for(CxlMpscQueue& q, bool consumer)
+    {
+        QueueWaiters* qw = nullptr;
+        for (auto& w : queues_)
+            if (w.q == &q) { qw = &w; break; }
+        if (!qw) qw = &queues_.emplace_back(QueueWaiters{&q, {}, {}, false});
+        if (consumer && !qw->consumer) {
+            q.set_wait_policy(WaitPolicy::none);   // we wait, not dequeue
+            qw->consumer = true;
+        }
+        return *qw;
+    }
+
+    void probe_dequeue(QueueWaiters& qw)
+    {
+        alignas(64) Entry buf[k_batch];
+        const std::size_t want = std::min(qw.deq.size(), k_batch);
+        const std::size_t n    = qw.q->dequeue_batch(std::span<Entry>(buf, want));
+        ++metrics_.dequeue_probes;
+        for (std::size_t k = 0; k < n; ++k) {
+            *qw.deq.front().e = buf[k];
+            ready_.push_back(qw.deq.front().h);
+            qw.deq.pop_front();
+        }
+        metrics_.items_dequeued += n;
+    }
+
+    void probe_enqueue(QueueWaiters& qw)
+    {
+        alignas(64) Entry buf[k_batch];
+        const std::size_t want = std::min(qw.enq.size(), k_batch);
+        for (std::size_t k = 0; k < want; ++k) buf[k] = *qw.enq[k].e;
+        const std::size_t n = qw.q->enqueue_batch(std::span<Entry>(buf, want));
+        ++metrics_.enqueue_probes;
+        for (std::size_t k = 0; k < n; ++k) {
+            ready_.push_back(qw.enq.front().h);
+            qw.enq.pop_front();
+        }
+        metrics_.items_enqueued += n;
+    }
+
+    std::deque<std::coroutine_handle<>> ready_;
+    std::vector<QueueWaiters>           queues_;
+    std::size_t                         live_ {0};
+    CoroMetrics                         metrics_;
+    ExponentialBackoff                  backoff_idle_;
+};
+
+#endif // CXL_CORO_HPP_
@@ -0,0 +1,306 @@
+// cxl_flat.hpp
+// ─────────────────────────────────────────────────────────────────────────────
+//  Flat binary layout for CXL messages
+//
+//   • a message is one contiguous, 8-B aligned run of bytes: a FlatHeader,
+//     then fixed-size tables (plain structs chosen by the schema) that point
+//     at strings, blobs and arrays with FlatRef {offset, count}; offsets are
+//     from the message start, so they mean the same on every host
+//   • nothing is parsed on read: FlatReader checks a ref against the
+//     message length and hands out a string_view / span into the buffer –
+//     a BufferPool buffer, a dequeued message, any bytes
+//   • FlatWriter builds in one forward pass into caller memory (e.g.
+//     pool.data(h), then pool.publish(h)); the schema's encoded_size()
+//     sizes the buffer up front, so there is no growing or copying
+//   • FlatArena: bump allocator for decoding into pointer-linked structs
+//     with no per-node heap allocation; reset() keeps its memory
+//
+//  Tables are memcpy'd structs: little-endian, same-ABI hosts only.
+//  Ring messages: lines interleave payload with meta words, so encode into
+//  a local buffer and pack_message() it; the consumer reads in place from
+//  the buffer it unpacks into.
+//
+//  Example
+//   FlatWriter w(pool.data(h), size);
+//   auto* t = w.table<MyTable>(w.reserve<MyTable>());
+//   t->name = w.bytes(name.data(), name.size());
+//   w.finish(k_my_schema, root);  pool.publish(h);
+//   // consumer
+//   FlatReader r(pool.open(h), h.length);
+//   const MyTable* t = r.root<MyTable>(k_my_schema);
+//   std::string_view name = r.string(t->name);
+// ─────────────────────────────────────────────────────────────────────────────
+#ifndef CXL_FLAT_HPP_
+#define CXL_FLAT_HPP_
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <span>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+struct FlatRef {
+    uint32_t offset {0};       // bytes from the message start
+    uint32_t count  {0};       // elements (bytes for strings / blobs)
+};
+
+struct FlatHeader {
+    uint32_t magic;            // k_flat_magic
+    uint16_t schema;           // caller's schema id
+    uint16_t version;
+    uint32_t bytes;            // whole message, header included
+    uint32_t root;             // offset of the root table
+};
+static_assert(sizeof(FlatHeader) == 16);
+
+constexpr uint32_t k_flat_magic   = 0x5441'4c46;   // "FLAT"
+constexpr uint16_t k_flat_version = 1;
+
+constexpr std::size_t flat_align(std::size_t n) noexcept { return (n + 7) & ~std::size_t{7}; }
+
+// Bytes a run of `n` T's takes in a message.
+template <class T>
+constexpr std::size_t flat_bytes(std::size_t n) noexcept { return flat_align(n * sizeof(T)); }
+
+// ─────────────────────────────────────────────────────────────────────────────
+//  FlatWriter – bump writer over caller memory
+//  Every block starts 8-B aligned.  Running past `capacity` sets failed()
+//  and makes finish() return 0; nothing is written out of bounds.
+// ─────────────────────────────────────────────────────────────────────────────
+class FlatWriter {
+public:
+    FlatWriter(void* buf, std::size_t capacity) noexcept
+        : base_(static_cast<uint8_t*>(buf)), cap_(capacity), pos_(sizeof(FlatHeader))
+    {
+        if (cap_ < sizeof(FlatHeader)) failed_ = true;
+    }
+
+    // Room for one table (zeroed); returns its offset.
+    template <class T>
+    uint32_t reserve() noexcept { return reserve_array<T>(1).offset; }
+
+    // Room for `n` tables (zeroed), e.g. a node's children.
+    template <class T>
+    FlatRef reserve_array(std::size_t n) noexcept
+    {
+        static_assert(std::is_trivially_copyable_v<T> && alignof(T) <= 8);
+        const std::size_t len = n * sizeof(T);
+        const uint32_t    off = claim(len);
+        if (!failed_) std::memset(base_ + off, 0, flat_align(len));
+        return {off, static_cast<uint32_t>(n)};
+    }
+
+    // Writable table at `off` (from reserve / reserve_array).
+    template <class T>
+    [[nodiscard]] T* table(uint32_t off) noexcept
+    {
+        return failed_ ? &scratch<T>() : reinterpret_cast<T*>(base_ + off);
+    }
+
+    FlatRef bytes(const void* src, std::size_t n) noexcept
+    {
+        const uint32_t off = claim(n);
+        if (!failed_ && n) {
+            std::memcpy(base_ + off, src, n);
+            std::memset(base_ + off + n, 0, flat_align(n) - n);
+        }
+        return {off, static_cast<uint32_t>(n)};
+    }
+
+    FlatRef string(std::string_view s) noexcept { return bytes(s.data(), s.size()); }
+
+    template <class T>
+    FlatRef array(std::span<const T> v) noexcept
+    {
+        static_assert(std::is_trivially_copyable_v<T> && alignof(T) <= 8);
+        FlatRef r = bytes(v.data(), v.size_bytes());
+        r.count   = static_cast<uint32_t>(v.size());
+        return r;
+    }
+
+    // Write the header; returns the message length, 0 if it did not fit.
+    std::size_t finish(uint16_t schema, uint32_t root) noexcept
+    {
+        if (failed_) return 0;
+        const FlatHeader h{k_flat_magic, schema, k_flat_version,
+                           static_cast<uint32_t>(pos_), root};
+        std::memcpy(base_, &h, sizeof h);
+        return pos_;
+    }
+
+    [[nodiscard]] bool        failed() const noexcept { return failed_; }
+    [[nodiscard]] std::size_t size()   const noexcept { return pos_; }
+
+private:
+    uint32_t claim(std::size_t n) noexcept
+    {
+        const std::size_t off = pos_;
+        if (failed_ || off + flat_align(n) > cap_ || off + flat_align(n) > UINT32_MAX) {
+            failed_ = true;
+            return 0;
+        }
+        pos_ += flat_align(n);
+        return static_cast<uint32_t>(off);
+    }
+
+    // Sink for tables written after an overflow.
+    template <class T>
+    static T& scratch() noexcept
+    {
+        static thread_local T t;
+        return t;
+    }
+
+    uint8_t*    base_;
+    std::size_t cap_;
+    std::size_t pos_;
+    bool        failed_ {false};
+};
+
+// ─────────────────────────────────────────────────────────────────────────────
+//  FlatReader – bounds-checked, zero-copy views into a message
+//  A ref that points outside the message yields an empty view / nullptr
+//  table and sets failed(); a truncated or corrupt message therefore reads
+//  as empty fields, never out of bounds.
+// ─────────────────────────────────────────────────────────────────────────────
+class FlatReader {
+public:
+    FlatReader(const void* buf, std::size_t len) noexcept
+        : base_(static_cast<const uint8_t*>(buf)), len_(len)
+    {
+        FlatHeader h{};
+        if (len_ >= sizeof h) std::memcpy(&h, base_, sizeof h);
+        if (h.magic != k_flat_magic || h.version != k_flat_version || h.bytes > len_) {
+            failed_ = true;
+            return;
+        }
+        len_    = h.bytes;
+        schema_ = h.schema;
+        root_   = h.root;
+    }
+
+    // The root table, or nullptr for a foreign / broken message.
+    template <class T>
+    [[nodiscard]] const T* root(uint16_t schema) const noexcept
+    {
+        if (failed_ || schema_ != schema) return nullptr;
+        return table<T>(root_);
+    }
+
+    template <class T>
+    [[nodiscard]] const T* table(uint32_t off) const noexcept
+    {
+        return in_bounds(off, sizeof(T)) ? reinterpret_cast<const T*>(base_ + off) : nullptr;
+    }
+
+    template <class T>
+    [[nodiscard]] std::span<const T> array(FlatRef r) const noexcept
+    {
+        if (!in_bounds(r.offset, std::size_t{r.count} * sizeof(T))) return {};
+        return {reinterpret_cast<const T*>(base_ + r.offset), r.count};
+    }
+
+    [[nodiscard]] std::string_view string(FlatRef r) const noexcept
+    {
+        const auto s = array<char>(r);
+        return {s.data(), s.size()};
+    }
+
+    [[nodiscard]] std::span<const uint8_t> blob(FlatRef r) const noexcept { return array<uint8_t>(r); }
+
+    [[nodiscard]] bool        failed() const noexcept { return failed_; }
+    [[nodiscard]] std::size_t size()   const noexcept { return len_; }
+
+private:
+    bool in_bounds(std::size_t off, std::size_t n) const noexcept
+    {
+        const bool ok = !failed_ && off >= sizeof(FlatHeader) && (off & 7) == 0 &&
+                        off <= len_ && n <= len_ - off;
+        if (!ok && n != 0) failed_ = true;
+        return ok || n == 0;
+    }
+
+    const uint8_t* base_;
+    std::size_t    len_;
+    uint16_t       schema_ {0};
+    uint32_t       root_   {0};
+    mutable bool   failed_ {false};
+};
+
+// ─────────────────────────────────────────────────────────────────────────────
+//  FlatArena – monotonic allocator for decoded structures
+//  Blocks double from `block_bytes`; reset() keeps the largest one, so a
+//  steady-state decode loop does no heap allocation at all.  Objects are
+//  never destroyed: only trivially destructible types.
+// ─────────────────────────────────────────────────────────────────────────────
+class FlatArena {
+public:
+    explicit FlatArena(std::size_t block_bytes = 64 * 1024) : next_block_(block_bytes) {}
+
+    template <class T>
+    [[nodiscard]] T* make_array(std::size_t n)
+    {
+        static_assert(std::is_trivially_destructible_v<T>);
+        T* p = static_cast<T*>(allocate(n * sizeof(T), alignof(T)));
+        std::uninitialized_value_construct_n(p, n);
+        return p;
+    }
+
+    // Copy `s` into the arena.
+    std::string_view copy(std::string_view s)
+    {
+        if (s.empty()) return {};
+        char* p = static_cast<char*>(allocate(s.size(), 1));
+        std::memcpy(p, s.data(), s.size());
+        return {p, s.size()};
+    }
+
+    std::span<const uint8_t> copy(std::span<const uint8_t> b)
+    {
+        if (b.empty()) return {};
+        auto* p = static_cast<uint8_t*>(allocate(b.size(), 1));
+        std::memcpy(p, b.data(), b.size());
+        return {p, b.size()};
+    }
+
+    void* allocate(std::size_t n, std::size_t align)
+    {
+        std::size_t at = (used_ + align - 1) & ~(align - 1);
+        if (blocks_.empty() || at + n > cap_) {
+            next_block_ = std::max(next_block_, n + align);
+            blocks_.push_back(std::make_unique<std::byte[]>(next_block_));
+            cap_        = next_block_;
+            next_block_ *= 2;
+            at          = 0;
+            ++blocks_allocated_;
+        }
+        used_ = at + n;
+        return blocks_.back().get() + at;
+    }
+
+    // Drop everything allocated; keep the newest (largest) block.
+    void reset() noexcept
+    {
+        if (blocks_.size() > 1) {
+            std::swap(blocks_.front(), blocks_.back());
+            blocks_.resize(1);
+        }
+        used_ = 0;
+    }
+
+    [[nodiscard]] std::size_t bytes_used()       const noexcept { return used_; }
+    [[nodiscard]] std::size_t blocks_allocated() const noexcept { return blocks_allocated_; }
+
+private:
+    std::vector<std::unique_ptr<std::byte[]>> blocks_;
+    std::size_t next_block_;
+    std::size_t cap_  {0};
+    std::size_t used_ {0};
+    std::size_t blocks_allocated_ {0};   // heap allocations, ever
+};
+
+#endif // CXL_FLAT_HPP_
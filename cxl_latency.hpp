@@ -0,0 +1,222 @@
+// cxl_latency.hpp
+// ─────────────────────────────────────────────────────────────────────────────
+//  Latency recording for the queue benchmarks
+//
+//   • LatencyHistogram : log-linear buckets over TSC cycles – 16 linear
+//                        sub-buckets per power of two (≤ 6.25 % bucket
+//                        width), fixed 8 KiB array, record() is a handful
+//                        of ALU ops and one increment, no allocation
+//   • timestamp-in-entry: stamp_tx() writes the sender's TSC into
+//                        args[k_ts_arg]; the receiver turns it into a
+//                        one-way latency with a TscOffset
+//   • TSC offset calibration between two hosts over a pair of queues
+//     (NTP style): the initiator sends its TSC t1, the responder answers
+//     with its TSC t2 at once, the initiator reads t3 on receipt.  For the
+//     round with the smallest t3 − t1,
+//         offset = t2 − (t1 + t3) / 2          (responder − initiator)
+//     and the true offset lies within ± rtt / 2 of it.
+//     Assumes an invariant TSC ticking at the same rate on both hosts
+//     (same SKU / same base clock) – only the offset is estimated.
+//
+//  Example (consumer host computes one-way producer → consumer latency)
+//   const TscOffset off = calibrate_tsc_offset(q_to_prod, q_from_prod);   // prod − cons
+//   LatencyHistogram h;
+//   while (q.dequeue(e)) h.record(one_way_cycles(e, off));
+//   h.print("one-way", std::cout, measure_tsc_per_ns());
+// ─────────────────────────────────────────────────────────────────────────────
+#ifndef CXL_LATENCY_HPP_
+#define CXL_LATENCY_HPP_
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <string_view>
+#include <thread>
+#include <x86intrin.h>   // __rdtsc
+
+#include "cxl_mpsc_queue_exp.hpp"
+
+// TSC ticks per nanosecond, measured against steady_clock over `ms`
+inline double measure_tsc_per_ns(unsigned ms = 50)
+{
+    const auto     t0 = std::chrono::steady_clock::now();
+    const uint64_t c0 = __rdtsc();
+    std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+    const uint64_t c1 = __rdtsc();
+    const auto     t1 = std::chrono::steady_clock::now();
+    return static_cast<double>(c1 - c0) /
+           std::chrono::duration<double, std::nano>(t1 - t0).count();
+}
+
+// ─────────────────────────────────────────────────────────────────────────────
+//  LatencyHistogram
+//  Bucket of v: v < 16 → v itself; otherwise exponent e = bit_width(v) − 5
+//  and the 4 bits below the leading one pick one of 16 sub-buckets, so a
+//  bucket spans 2^e values.  percentile() reports the bucket's upper edge.
+// ─────────────────────────────────────────────────────────────────────────────
+class LatencyHistogram {
+public:
+    static constexpr unsigned    k_sub_bits = 4;
+    static constexpr unsigned    k_sub      = 1u << k_sub_bits;
+    static constexpr std::size_t k_buckets  = (64 - k_sub_bits + 1) * k_sub;
+
+    void record(uint64_t v) noexcept
+    {
+        ++counts_[index(v)];
+        ++count_;
+        sum_ += v;
+        min_ = std::min(min_, v);
+        max_ = std::max(max_, v);
+    }
+
+    void merge(const LatencyHistogram& o) noexcept
+    {
+        for (std::size_t i = 0; i < k_buckets; ++i) counts_[i] += o.counts_[i];
+        count_ += o.count_;
+        sum_   += o.sum_;
+        min_    = std::min(min_, o.min_);
+        max_    = std::max(max_, o.max_);
+    }
+
+    void reset() noexcept { *this = LatencyHistogram{}; }
+
+    [[nodiscard]] uint64_t count() const noexcept { return count_; }
+    [[nodiscard]] uint64_t min()   const noexcept { return count_ ? min_ : 0; }
+    [[nodiscard]] uint64_t max()   const noexcept { return max_; }
+    [[nodiscard]] double   mean()  const noexcept { return count_ ? double(sum_) / count_ : 0.0; }
+
+    // Smallest bucket edge with at least p (0‥1) of the samples at or
+    // below it, clamped to the observed max.
+    [[nodiscard]] uint64_t percentile(double p) const noexcept
+    {
+        if (count_ == 0) return 0;
+        const uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(p * count_ + 0.5));
+        uint64_t seen = 0;
+        for (std::size_t i = 0; i < k_buckets; ++i) {
+            seen += counts_[i];
+            if (seen >= rank) return std::min(upper_edge(i), max_);
+        }
+        return max_;
+    }
+
+    // "<label>  n=…  min / p50 / p90 / p99 / p99.9 / max", in ns if
+    // tsc_per_ns > 0, else in cycles
+    void print(std::string_view label, std::ostream& os = std::cout,
+               double tsc_per_ns = 0.0) const
+    {
+        const double  div  = tsc_per_ns > 0 ? tsc_per_ns : 1.0;
+        const char*   unit = tsc_per_ns > 0 ? "ns" : "cycles";
+        const auto    f    = [&](uint64_t c) { return static_cast<double>(c) / div; };
+        const auto    flags = os.flags();
+        os << std::fixed << std::setprecision(1)
+           << label << "  n=" << count_ << "  (" << unit << ")\n"
+           << "    min " << f(min()) << "  p50 " << f(percentile(0.50))
+           << "  p90 " << f(percentile(0.90)) << "  p99 " << f(percentile(0.99))
+           << "  p99.9 " << f(percentile(0.999)) << "  max " << f(max_)
+           << "  mean " << mean() / div << '\n';
+        os.flags(flags);
+    }
+
+    static constexpr std::size_t index(uint64_t v) noexcept
+    {
+        if (v < k_sub) return static_cast<std::size_t>(v);
+        const unsigned e = static_cast<unsigned>(std::bit_width(v)) - (k_sub_bits + 1);
+        return (e + 1) * k_sub + static_cast<std::size_t>((v >> e) & (k_sub - 1));
+    }
+
+    static constexpr uint64_t upper_edge(std::size_t i) noexcept
+    {
+        if (i < k_sub) return i;
+        const unsigned e   = static_cast<unsigned>(i / k_sub) - 1;
+        const uint64_t sub = i % k_sub;
+        return ((k_sub + sub + 1) << e) - 1;
+    }
+
+private:
+    std::array<uint64_t, k_buckets> counts_ {};
+    uint64_t count_ {0};
+    uint64_t sum_   {0};
+    uint64_t min_   {std::numeric_limits<uint64_t>::max()};
+    uint64_t max_   {0};
+};
+
+// ─────────────────────────────────────────────────────────────────────────────
+//  Timestamp-in-entry
+//  The send TSC travels in the last payload word; senders that use it
+//  must leave args[k_ts_arg] alone.
+// ─────────────────────────────────────────────────────────────────────────────
+constexpr std::size_t k_ts_arg = 6;
+
+struct TscOffset {
+    int64_t  offset  {0};   // sender TSC − receiver TSC
+    uint64_t rtt_min {0};   // best calibration round trip (error ≤ rtt_min / 2)
+    uint32_t rounds  {0};
+};
+
+inline void stamp_tx(Entry& e) noexcept { e.args[k_ts_arg] = __rdtsc(); }
+
+// Receiver-clock cycles since the sender stamped e; negative results
+// (offset error larger than the latency) clamp to 0.
+inline uint64_t one_way_cycles(const Entry& e, const TscOffset& off,
+                               uint64_t now = __rdtsc()) noexcept
+{
+    const int64_t d = static_cast<int64_t>(now - e.args[k_ts_arg]) + off.offset;
+    return d > 0 ? static_cast<uint64_t>(d) : 0;
+}
+
+// ─────────────────────────────────────────────────────────────────────────────
+//  TSC offset calibration (see header).  Both sides run the same number of
+//  rounds on an otherwise idle pair of queues.  `now` is the clock to read
+//  (tests substitute a skewed one).
+// ─────────────────────────────────────────────────────────────────────────────
+constexpr uint8_t k_tsc_cal_method = 0xFE;
+
+struct RdtscClock {
+    uint64_t operator()() const noexcept { return __rdtsc(); }
+};
+
+template <class Queue, class Clock = RdtscClock>
+TscOffset calibrate_tsc_offset(Queue& to_peer, Queue& from_peer,
+                               uint32_t rounds = 1'000, Clock now = {})
+{
+    TscOffset best{0, std::numeric_limits<uint64_t>::max(), rounds};
+    Entry req{}, rsp{};
+    req.meta.f.rpc_method = k_tsc_cal_method;
+    req.meta.f.seal_index = -1;
+    for (uint32_t r = 0; r < rounds; ++r) {
+        req.meta.f.rpc_id = static_cast<uint16_t>(r);
+        const uint64_t t1 = now();
+        req.args[0] = t1;
+        while (!to_peer.enqueue(req)) {}
+        while (!from_peer.dequeue(rsp)) {}
+        const uint64_t t3 = now();
+
+        const uint64_t rtt = t3 - t1;
+        if (rsp.meta.f.rpc_id == req.meta.f.rpc_id && rtt < best.rtt_min) {
+            best.rtt_min = rtt;
+            best.offset  = static_cast<int64_t>(rsp.args[1] - (t1 + rtt / 2));
+        }
+    }
+    return best;
+}
+
+// The other side of calibrate_tsc_offset(): answer `rounds` requests.
+template <class Queue, class Clock = RdtscClock>
+void serve_tsc_calibration(Queue& from_peer, Queue& to_peer,
+                           uint32_t rounds = 1'000, Clock now = {})
+{
+    Entry e{};
+    for (uint32_t r = 0; r < rounds; ++r) {
+        while (!from_peer.dequeue(e)) {}
+        e.args[1] = now();
+        while (!to_peer.enqueue(e)) {}
+    }
+}
+
+#endif // CXL_LATENCY_HPP_
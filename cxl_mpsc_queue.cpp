@@ -3,16 +3,33 @@
 //  Sanity / micro-benchmark using CXL-backed allocators
 //
 //  CLI (choose **one** form) ––––––––––––––––––––––––––––––––––––––––––––––
-//    pin <cpu_id> numa <node_id> [iter_count]
-//    pin <cpu_id> dax            [iter_count]
+//    pin <cpu_id|auto> numa <node_id> [iter_count [max_producers]] [variant <store>+<load>[+<check>]] [stats <shm>] [small <words>]
+//    pin <cpu_id|auto> dax            [iter_count [max_producers]] [variant <store>+<load>[+<check>]] [stats <shm>] [small <words>]
 //
-//    • cpu_id      : logical CPU to pin the main thread to
-//    • node_id     : NUMA node for DRAM allocation            (numa form)
-//    • iter_count  : #iterations (default = 10’000’000 = 10 M)
+//    • cpu_id        : logical CPU for the consumer; producer i runs on
+//                      cpu_id + 1 + i (mod #CPUs); auto: consumer and
+//                      producers on the cores nearest the ring's memory,
+//                      one per physical core first (cxl_topology.hpp)
+//    • node_id       : NUMA node for DRAM allocation          (numa form)
+//    • iter_count    : #iterations (default = 10’000’000 = 10 M)
+//    • max_producers : sweep 1, 2, 4 … max_producers producer threads
+//                      sharing one ProducerGroup (default = 1)
+//    • variant       : queue line store / load / check policy, e.g.
+//                      nt+clflushopt, clwb+clflush+crc32c,
+//                      movdir64b+clflushopt+none (default: CPUID, xor16)
+//    • stats         : export live producer / consumer snapshots into the
+//                      POSIX shm object <shm> (watch with ./stats_monitor)
+//    • small         : timed items become <words>-word (1…7) messages sent
+//                      with enqueue_small / dequeue_small, several per line
 //
 //  Examples
 //    sudo ./cxl_mpsc_queue pin 15 numa 0               # 10 M iters on node 0
 //    sudo ./cxl_mpsc_queue pin 3  dax  20_000_000      # 20 M iters on /dev/dax
+//    sudo ./cxl_mpsc_queue pin 0  numa 1 10000000 8    # 1→8 producer scaling
+//    sudo ./cxl_mpsc_queue pin auto numa 2 10000000 4  # placed near node 2
+//    sudo ./cxl_mpsc_queue pin 0  numa 1 variant clwb+clflushopt
+//    sudo ./cxl_mpsc_queue pin 0  numa 1 100000000 2 stats /cxlq
+//    sudo ./cxl_mpsc_queue pin 0  numa 1 10000000 2 small 1   # 7 msgs / line
 //
 //  Build (GCC ≥ 12 or Clang ≥ 15)
 //    g++ -O3 -std=c++20 -march=native -mavx512f -mavx512bw \
@@ -23,6 +40,8 @@
 
 #include "cxl_mpsc_queue_exp.hpp"
 #include "cxl_allocator.hpp"
+#include "cxl_stats.hpp"
+#include "cxl_topology.hpp"
 
 #include <atomic>
 #include <cassert>
@@ -32,7 +51,9 @@
 #include <iostream>
 #include <memory>
 #include <numa.h>
+#include <optional>
 #include <sched.h>
+#include <algorithm>
 #include <sstream>
 #include <string>
 #include <thread>
@@ -51,11 +72,146 @@ static void pin_to_cpu(int cpu_id) {
 
 [[noreturn]] static void print_usage(const char* prog) {
     std::cerr <<
-        "usage  : " << prog << " pin <cpu_id> numa <node_id> [iter_count]\n"
-        "       | " << prog << " pin <cpu_id> dax [iter_count]\n"
-        "notes  : iter_count defaults to 10M when omitted\n";
+        "usage  : " << prog << " pin <cpu_id|auto> numa <node_id> [iter_count [max_producers]] [variant <s>+<l>[+<c>]]\n"
+        "       | " << prog << " pin <cpu_id|auto> dax [iter_count [max_producers]] [variant <s>+<l>[+<c>]]\n"
+        "notes  : iter_count defaults to 10M, max_producers to 1 when omitted\n"
+        "         variant <s>+<l>[+<c>]: <s> = nt|movdir64b|clwb|clflushopt,\n"
+        "         <l> = clflushopt|clflush, <c> = xor16|crc32c|none (none: movdir64b only)\n"
+        "         stats <shm>: live snapshots into POSIX shm <shm> (see stats_monitor)\n"
+        "         small <words>: packed <words>-word messages (1..7) instead of one per line\n";
     std::exit(EXIT_FAILURE);
 }
+
+//-------------------------------------------------------------------
+//  One benchmark round: `n_prod` producers → one consumer
+//-------------------------------------------------------------------
+struct RoundResult {
+    std::size_t              producers;
+    std::size_t              produced;       // timed items (excl. warm-up)
+    std::chrono::nanoseconds t_prod;         // wall time, slowest producer
+    std::chrono::nanoseconds t_cons;
+    std::size_t              enqueue_calls;  // timed phase, all producers
+    std::size_t              dequeue_calls;  // timed phase
+    std::size_t              lines;          // timed lines written (small mode)
+};
+
+template <class Queue>
+static RoundResult run_round(Entry* ring, uint32_t order, uint64_t* tail_cxl,
+                             const std::vector<unsigned>& cpus, std::size_t n_prod, std::size_t ITER,
+                             bool print_queue_metrics, StatsSegment* stats,
+                             std::size_t small_words)
+{
+    // One handle per producer thread, all claiming slots through `group`.
+    ProducerGroup group;
+    std::vector<std::unique_ptr<Queue>> q_producers;
+    for (std::size_t p = 0; p < n_prod; ++p)
+        q_producers.push_back(std::make_unique<Queue>(
+            ring, order, tail_cxl, group, /*do_initialize=*/p == 0));
+    Queue q_consumer(ring, order, tail_cxl, /*do_initialize=*/false);
+
+    // Live export: producer p → slot p, consumer → the last slot
+    if (stats) {
+        for (std::size_t p = 0; p < n_prod; ++p)
+            q_producers[p]->set_stats_export(StatsRole::producer,
+                stats->attach(static_cast<uint32_t>(p), "ring", StatsRole::producer, q_consumer.capacity()));
+        q_consumer.set_stats_export(StatsRole::consumer,
+            stats->attach(stats->slots() - 1, "ring", StatsRole::consumer, q_consumer.capacity()));
+    }
+
+    //-----------------------------------------------------------------------
+    //  Producer / Consumer micro-benchmark with warm-up
+    //-----------------------------------------------------------------------
+    const std::size_t WARMUP = q_consumer.capacity() / 4;   // pre-produce ¼ of queue
+    assert(WARMUP < ITER && "warm-up must be < total iterations");
+
+    {   // warm-up phase uses the first producer's queue instance
+        Entry e{};
+        e.meta.f.rpc_method = 1;
+        e.meta.f.seal_index = -1;
+        for (std::size_t i = 0; i < WARMUP; ++i) {
+            e.meta.f.rpc_id = static_cast<uint16_t>(i);
+            while (!q_producers[0]->enqueue(e)) { /* should not happen */ }
+        }
+    }
+
+    // ── Record baseline metrics AFTER warm-up from both sides ─────────────
+    const std::size_t enqueue_warmup_calls = q_producers[0]->get_metrics().enqueue_calls;
+    const std::size_t dequeue_warmup_calls = q_consumer.get_metrics().dequeue_calls;
+
+    // ── Timed phase ────────────────────────────────────────────────────────
+    const std::size_t produced = ITER - WARMUP;
+    std::chrono::nanoseconds t_cons{0};
+    std::vector<std::chrono::nanoseconds> t_prod(n_prod);
+
+    std::vector<std::thread> producer_threads;
+    for (std::size_t p = 0; p < n_prod; ++p) {
+        // split the timed items as evenly as possible
+        const std::size_t first = WARMUP + produced * p / n_prod;
+        const std::size_t last  = WARMUP + produced * (p + 1) / n_prod;
+
+        producer_threads.emplace_back([&, p, first, last] {
+            pin_to_cpu(static_cast<int>(cpus[1 + p]));
+            Queue& q = *q_producers[p];
+            Entry e{};
+            e.meta.f.rpc_method = 1;
+            e.meta.f.seal_index = -1;
+
+            const auto t0 = std::chrono::steady_clock::now();
+            if (small_words) {
+                // one item = one message; the partial last line goes on flush
+                const std::span<const uint64_t> msg(e.args, small_words);
+                for (std::size_t i = first; i < last; ++i) {
+                    e.args[0] = i;
+                    while (!q.enqueue_small(msg)) { /* spin */ }
+                }
+                while (!q.flush_small()) { /* spin */ }
+            } else {
+                for (std::size_t i = first; i < last; ++i) {
+                    e.meta.f.rpc_id = static_cast<uint16_t>(i);
+                    while (!q.enqueue(e)) { /* spin */ }
+                }
+            }
+            t_prod[p] = std::chrono::steady_clock::now() - t0;
+        });
+    }
+
+    std::thread consumer_thread([&] {
+        pin_to_cpu(static_cast<int>(cpus[0]));
+        Entry e{};
+        std::size_t consumed = 0;
+        const auto t0 = std::chrono::steady_clock::now();
+
+        // small mode: warm-up lines arrive unpacked and count as one message
+        const auto count = [](std::span<const uint64_t>) {};
+        while (consumed < ITER) {
+            if (small_words)                consumed += q_consumer.dequeue_small(count);
+            else if (q_consumer.dequeue(e)) ++consumed;
+        }
+        t_cons = std::chrono::steady_clock::now() - t0;
+    });
+
+    for (auto& t : producer_threads) t.join();
+    consumer_thread.join();
+
+    RoundResult r{n_prod, produced,
+                  *std::max_element(t_prod.begin(), t_prod.end()), t_cons,
+                  0, q_consumer.get_metrics().dequeue_calls - dequeue_warmup_calls, 0};
+    for (const auto& q : q_producers) {
+        r.enqueue_calls += q->get_metrics().enqueue_calls;
+        r.lines         += q->get_metrics().small_lines;
+    }
+    r.enqueue_calls -= enqueue_warmup_calls;
+
+    if (print_queue_metrics) {
+        // Print metrics from each queue instance separately
+        for (std::size_t p = 0; p < n_prod; ++p) {
+            q_producers[p]->print_metrics("Producer Queue " + std::to_string(p));
+            std::cout << '\n';
+        }
+        q_consumer.print_metrics("Consumer Queue");
+    }
+    return r;
+}
 //-------------------------------------------------------------------
 //  Main
 //-------------------------------------------------------------------
@@ -65,32 +221,81 @@ int main(int argc, char* argv[]) {
     //-----------------------------------------------------------------------
     //  Parse CLI
     //-----------------------------------------------------------------------
+    // Optional trailing “variant <store>+<load>” / “stats <shm>” / “small <words>” – strip
+    // them before the rest.
+    QueueVariant variant = detect_queue_variant();
+    std::string  stats_name;
+    std::size_t  small_words = 0;
+    while (argc >= 6) {
+        const std::string opt = argv[argc - 2];
+        if (opt == "variant") {
+            const auto v = parse_queue_variant(argv[argc - 1]);
+            if (!v) print_usage(argv[0]);
+            variant = *v;
+        } else if (opt == "stats") {
+            stats_name = argv[argc - 1];
+        } else if (opt == "small") {
+            small_words = std::stoull(argv[argc - 1]);
+            if (small_words < 1 || small_words > k_small_max_words) print_usage(argv[0]);
+        } else {
+            break;
+        }
+        argc -= 2;
+    }
+
     if (argc < 4) print_usage(argv[0]);
 
     if (std::string{argv[1]} != "pin") print_usage(argv[0]);
-    const int         cpu_id = std::stoi(argv[2]);
+    const bool        auto_pin = std::string{argv[2]} == "auto";
+    int               cpu_id   = auto_pin ? 0 : std::stoi(argv[2]);
     const std::string mode   = argv[3];
 
     bool        use_dax   = false;
     int         numa_node = -1;
     std::size_t ITER      = DEFAULT_ITERS;
+    std::size_t MAX_PROD  = 1;
 
+    int extra = 0;                  // index of the first optional argument
     if (mode == "numa") {
         if (argc < 5) print_usage(argv[0]);
         numa_node = std::stoi(argv[4]);
-        if (argc >= 6) ITER = std::stoull(argv[5]);
+        extra     = 5;
     } else if (mode == "dax") {
         use_dax = true;
-        if (argc >= 5) ITER = std::stoull(argv[4]);
+        extra   = 4;
     } else {
         print_usage(argv[0]);
     }
+    if (argc > extra)     ITER     = std::stoull(argv[extra]);
+    if (argc > extra + 1) MAX_PROD = std::stoull(argv[extra + 1]);
+    if (MAX_PROD == 0) print_usage(argv[0]);
 
     if (!use_dax && (numa_node < 0 || numa_node > numa_max_node())) {
         std::cerr << "Invalid NUMA node id " << numa_node << '\n';
         return EXIT_FAILURE;
     }
 
+    //-----------------------------------------------------------------------
+    //  Placement: cpus[0] = consumer, cpus[1 + p] = producer p
+    //-----------------------------------------------------------------------
+    std::vector<unsigned> cpus;
+    if (auto_pin) {
+        const cxl::Topology  topo = cxl::Topology::discover();
+        const cxl::Placement plan = topo.place(
+            use_dax ? cxl::dax_numa_node(cxl::DaxAllocator::default_path) : numa_node, MAX_PROD + 1);
+        topo.print(std::cout);
+        std::vector<std::string> roles{"consumer"};
+        for (std::size_t p = 0; p < MAX_PROD; ++p) roles.push_back("producer " + std::to_string(p));
+        plan.print(std::cout, roles);
+        for (std::size_t i = 0; i < plan.size(); ++i) cpus.push_back(plan[i]);
+        cpu_id = static_cast<int>(cpus[0]);
+    } else {
+        const unsigned n_cpus = std::max(1u, std::thread::hardware_concurrency());
+        cpus.push_back(static_cast<unsigned>(cpu_id));
+        for (std::size_t p = 0; p < MAX_PROD; ++p)
+            cpus.push_back(static_cast<unsigned>((cpu_id + 1 + p) % n_cpus));
+    }
+
     //-----------------------------------------------------------------------
     //  Pin main thread and create allocator
     //-----------------------------------------------------------------------
@@ -111,10 +316,16 @@ int main(int argc, char* argv[]) {
     }
 
     std::cout << "Pinned to CPU " << cpu_id << '\n'
-              << "Iterations      : " << ITER << "\n\n";
+              << "Iterations      : " << ITER << '\n'
+              << "Max producers   : " << MAX_PROD << '\n'
+              << "Queue variant   : " << variant << '\n';
+    if (small_words)
+        std::cout << "Small messages  : " << small_words << " word(s), up to "
+                  << k_small_max_words / small_words << " per line\n";
+    std::cout << '\n';
 
     //-----------------------------------------------------------------------
-    //  Queue setup – allocate from CXL allocator
+    //  Queue setup – allocate from CXL allocator (re-initialized per round)
     //-----------------------------------------------------------------------
     constexpr uint32_t ORDER       = 14; // 16,384 entries
     const std::size_t  RING_BYTES  = (1u << ORDER) * sizeof(Entry);
@@ -122,60 +333,33 @@ int main(int argc, char* argv[]) {
     Entry* ring      = static_cast<Entry*>   (alloc->allocate_aligned(RING_BYTES, 64));
     uint64_t* tail_cxl  = static_cast<uint64_t*>(alloc->allocate_aligned(64,          64));
 
-    // Instantiate two separate queue objects pointing to the same shared memory.
-    CxlMpscQueue q_producer(ring, ORDER, tail_cxl);
-    CxlMpscQueue q_consumer(ring, ORDER, tail_cxl);
+    // 1, 2, 4, … and finally MAX_PROD itself
+    std::vector<std::size_t> sweep;
+    for (std::size_t p = 1; p < MAX_PROD; p *= 2) sweep.push_back(p);
+    sweep.push_back(MAX_PROD);
 
-    //-----------------------------------------------------------------------
-    //  Producer / Consumer micro-benchmark with warm-up
-    //-----------------------------------------------------------------------
-    const std::size_t WARMUP = q_producer.capacity() / 4;   // pre-produce ¼ of queue
-    assert(WARMUP < ITER && "warm-up must be < total iterations");
-
-    {   // warm-up phase uses the producer's queue instance
-        Entry e{};
-        e.meta.f.rpc_method = 1;
-        e.meta.f.seal_index = -1;
-        for (std::size_t i = 0; i < WARMUP; ++i) {
-            e.meta.f.rpc_id = static_cast<uint16_t>(i);
-            while (!q_producer.enqueue(e)) { /* should not happen */ }
+    // Slots 0 … MAX_PROD-1 for producers, MAX_PROD for the consumer.
+    std::optional<StatsSegment> stats;
+    if (!stats_name.empty()) {
+        try {
+            stats.emplace(StatsSegment::open_shm(stats_name, static_cast<uint32_t>(MAX_PROD + 1),
+                                                 /*create=*/true));
+        } catch (const std::exception& ex) {
+            std::cerr << ex.what() << '\n';
+            return EXIT_FAILURE;
         }
+        std::cout << "Stats export    : " << stats_name << " (" << stats->slots() << " slots)\n\n";
     }
 
-    // ── Record baseline metrics AFTER warm-up from both queues ─────────────
-    const std::size_t enqueue_warmup_calls = q_producer.get_metrics().enqueue_calls;
-    const std::size_t dequeue_warmup_calls = q_consumer.get_metrics().dequeue_calls;
-
-    // ── Timed phase ────────────────────────────────────────────────────────
-    std::chrono::nanoseconds t_prod{0}, t_cons{0};
-
-    std::thread producer_thread([&] {
-        Entry e{};
-        e.meta.f.rpc_method = 1;
-        e.meta.f.seal_index = -1;
-
-        const auto t0 = std::chrono::steady_clock::now();
-        for (std::size_t i = WARMUP; i < ITER; ++i) {
-            e.meta.f.rpc_id = static_cast<uint16_t>(i);
-            while (!q_producer.enqueue(e)) { /* spin */ }
-        }
-        t_prod = std::chrono::steady_clock::now() - t0;
+    std::vector<RoundResult> results;
+    with_queue_variant(variant, [&](auto tag) {
+        using Queue = typename decltype(tag)::type;
+        for (std::size_t p : sweep)
+            results.push_back(run_round<Queue>(ring, ORDER, tail_cxl, cpus, p, ITER,
+                                               /*print_queue_metrics=*/p == MAX_PROD,
+                                               stats ? &*stats : nullptr, small_words));
     });
 
-    std::thread consumer_thread([&] {
-        Entry e{};
-        std::size_t consumed = 0;
-        const auto t0 = std::chrono::steady_clock::now();
-
-        while (consumed < ITER) {
-            if (q_consumer.dequeue(e)) ++consumed;
-        }
-        t_cons = std::chrono::steady_clock::now() - t0;
-    });
-
-    producer_thread.join();
-    consumer_thread.join();
-
     //-----------------------------------------------------------------------
     //  Results
     //-----------------------------------------------------------------------
@@ -184,28 +368,26 @@ int main(int argc, char* argv[]) {
         return static_cast<double>(ns.count()) / calls;
     };
 
-    const std::size_t produced_items = ITER - WARMUP;
-    const std::size_t enqueue_total_calls = q_producer.get_metrics().enqueue_calls - enqueue_warmup_calls;
-    const std::size_t dequeue_total_calls = q_consumer.get_metrics().dequeue_calls - dequeue_warmup_calls;
+    std::cout << "\nProduced / Consumed : " << ITER << " items per round\n\n";
 
-    std::cout << "\nProduced / Consumed : " << ITER << " items\n";
-
-    // Throughput per *successful* item
-    std::cout << "Producer time       : " << std::fixed << std::setprecision(2)
-              << ns_per(produced_items, t_prod) << " ns/op\n";
-    std::cout << "Consumer time       : "
-              << ns_per(ITER, t_cons) << " ns/op\n";
-
-    // Average cost per enqueue / dequeue *call* (includes retries / polls)
-    std::cout << "Enqueue time        : "
-              << ns_per(enqueue_total_calls, t_prod) << " ns/enq\n";
-    std::cout << "Dequeue time        : "
-              << ns_per(dequeue_total_calls, t_cons) << " ns/deq\n\n";
-
-    // Print metrics from each queue instance separately
-    q_producer.print_metrics("Producer Queue");
-    std::cout << '\n';
-    q_consumer.print_metrics("Consumer Queue");
+    // Throughput per *successful* item; per-call cost includes retries / polls
+    std::cout << "producers  prod ns/op  cons ns/op  ns/enq  ns/deq  Mops/s (cons)"
+              << (small_words ? "  msgs/line" : "") << '\n'
+              << "---------  ----------  ----------  ------  ------  -------------"
+              << (small_words ? "  ---------" : "") << '\n';
+    for (const auto& r : results) {
+        const double cons_ns = ns_per(ITER, r.t_cons);
+        std::cout << std::setw(9) << r.producers << "  "
+                  << std::fixed << std::setprecision(2)
+                  << std::setw(10) << ns_per(r.produced, r.t_prod) << "  "
+                  << std::setw(10) << cons_ns << "  "
+                  << std::setw(6) << ns_per(r.enqueue_calls, r.t_prod) << "  "
+                  << std::setw(6) << ns_per(r.dequeue_calls, r.t_cons) << "  "
+                  << std::setw(13) << (cons_ns > 0 ? 1e3 / cons_ns : 0.0);
+        if (small_words)
+            std::cout << "  " << std::setw(9) << (r.lines ? double(r.produced) / double(r.lines) : 0.0);
+        std::cout << '\n';
+    }
 
     return 0;
 }
@@ -2,39 +2,81 @@
 //  CxlMpscQueue — NT-store / NT-load AVX-512 queue for CXL-resident buffers
 //  * One 64-byte non-temporal **store** (+ sfence) per enqueue()
 //  * One 64-byte non-temporal **load** per dequeue()
-//  * Optional adaptive back-off on the consumer side (spin→yield→sleep)
+//  * Batched enqueue_batch()/dequeue_batch(): one sfence per batch
+//  * Zero-copy reserve()/commit() and peek()/release() on the ring slot
+//  * Multi-line messages (M consecutive slots, all-or-nothing visibility)
+//  * Packed small messages: up to 7 messages of 1–7 words per line,
+//       sent when full, on a TSC deadline or on flush_small()
+//  * Optional consumer lookahead for dequeue(): K future slots kept
+//       flushed + prefetched
+//  * Tail publication policy: fixed cap/4 interval, or adaptive
+//       (idle flush, producer stall requests, self-adjusting interval),
+//       or piggyback (tail credits ride on a paired response queue)
+//  * Many producers per ring: slots are claimed through a host-local
+//       ProducerGroup (CAS on a shared head), the consumer stays single
+//  * Optional per-ring doorbell word, rung after every publish (QueueSet)
+//  * Pluggable consumer wait policy: spin, TPAUSE, UMONITOR/UMWAIT on the
+//       slot line, or an idle ladder (spin→tpause→yield→sleep)
+//  * Compile-time line store / load policies: BasicCxlMpscQueue<Store, Load>
+//       (NT stream, MOVDIR64B, store+clwb, store+clflushopt × clflushopt or
+//       clflush before the load); CxlMpscQueue is <NtStore, FlushLoad>, and
+//       with_queue_variant() instantiates the one CPUID picks at start-up
+//  * Line check policy: XOR fold (default), CRC32C, or none – the latter
+//       only with MOVDIR64B stores, and it hands the checksum field to the
+//       payload
 //  * Extensive run-time metrics (enqueue/dequeue calls, CXL probes,
-//       back-off activity, etc.)
+//       back-off activity, etc.); -DCXL_QUEUE_METRICS=0 compiles them out
+//  * Live stats export: periodic 64-B snapshots of rate / position /
+//       stalls / back-off into a line an external monitor can read
+//  * Restart: resume_consumer() / resume_producer() pick up a live ring
+//       from its tail line and slot epochs (no memset, no drain)
 //  Build (Sapphire-Rapids or newer):
 //       g++ -std=c++20 -O3 -march=native -pthread cxl_mpsc_queue.cpp -lnuma -o cxl_mpsc_queue
 // ─────────────────────────────────────────────────────────────────────────────
+#ifndef CXL_MPSC_QUEUE_EXP_HPP_
+#define CXL_MPSC_QUEUE_EXP_HPP_
 
 #ifndef __AVX512F__
 #error "This queue implementation requires AVX-512F for 64-byte stream ops"
 #endif
 
-// #include <atomic>
+#include <atomic>
 #include <cassert>
+#include <cmath>
 #include <cstdint>
 #include <cstring>
+#include <cpuid.h>
 #include <immintrin.h>
+#include <x86intrin.h>   // __rdtsc
 #include <iostream>
 #include <syncstream>
+#include <sstream>
 #include <numa.h>
 #include <thread>
 #include <chrono>
 #include <algorithm>      // std::min, std::max
 #include <string_view>
+#include <span>
+#include <bit>          // std::bit_floor
+#include <optional>
+#include <type_traits>  // std::type_identity
 
 // ─────────────────────────────────────────────────────────────────────────────
 //  Low-level helpers (AVX-512 only)
 // ─────────────────────────────────────────────────────────────────────────────
 
-// src and dst **must** be 64-B aligned.
-static inline void store_nt_64B(void* dst, const void* src) noexcept
+// src and dst **must** be 64-B aligned.  No fence – callers batch several
+// lines and order them with a single _mm_sfence().
+static inline void stream_64B(void* dst, const void* src) noexcept
 {
     const __m512i v = _mm512_load_si512(src);              // src in L1
     _mm512_stream_si512(reinterpret_cast<__m512i*>(dst), v); // NT-store
+}
+
+// src and dst **must** be 64-B aligned.
+static inline void store_nt_64B(void* dst, const void* src) noexcept
+{
+    stream_64B(dst, src);
     _mm_sfence();
 }
 
@@ -72,6 +114,51 @@ static inline void cpu_relax_for_cycles(uint32_t cycles) noexcept
     }
 }
 
+// ─────────────────────────────────────────────────────────────────────────────
+//  WAITPKG helpers (TPAUSE / UMONITOR / UMWAIT)
+//  * The instructions are compiled in (-mwaitpkg) but only executed when
+//    CPUID.(EAX=7,ECX=0):ECX[5] says so; otherwise callers fall back to a
+//    pause loop of the same length.
+//  * The OS caps every wait (IA32_UMWAIT_CONTROL, ~100 µs on Linux); the
+//    TSC deadline here is the upper bound, not a guarantee.
+//  * UMWAIT wakes early on a store to the monitored line only when that
+//    store is snooped.  A write from another CXL host to non-coherent
+//    memory is not, so there it degrades to a TPAUSE of the same length.
+// ─────────────────────────────────────────────────────────────────────────────
+
+static inline bool has_waitpkg() noexcept
+{
+    static const bool yes = [] {
+        unsigned a, b, c, d;
+        return __get_cpuid_count(7, 0, &a, &b, &c, &d) && (c & (1u << 5));
+    }();
+    return yes;
+}
+
+// ctrl 0 = C0.2 (deeper, slower wake-up), 1 = C0.1 (light)
+constexpr uint32_t k_wait_c02 = 0;
+constexpr uint32_t k_wait_c01 = 1;
+
+static inline void tpause_for_cycles(uint64_t cycles, uint32_t ctrl) noexcept
+{
+    if (!has_waitpkg()) {
+        cpu_relax_for_cycles(static_cast<uint32_t>(cycles));
+        return;
+    }
+    _tpause(ctrl, __rdtsc() + cycles);
+}
+
+static inline void umwait_for_cycles(const void* line, uint64_t cycles,
+                                     uint32_t ctrl) noexcept
+{
+    if (!has_waitpkg()) {
+        cpu_relax_for_cycles(static_cast<uint32_t>(cycles));
+        return;
+    }
+    _umonitor(const_cast<void*>(line));
+    _umwait(ctrl, __rdtsc() + cycles);
+}
+
 using u64_may_alias = uint64_t __attribute__((may_alias));
 
 // static inline uint16_t xor_checksum64(const void* p) noexcept
@@ -141,81 +228,661 @@ struct alignas(64) Entry {
             int16_t  seal_index;
             uint16_t checksum;
         } f;
+        uint64_t raw;      // whole meta word – published with one store
     } meta;
 };
 static_assert(sizeof(Entry) == 64, "Entry must be 64 B");
 
 // ─────────────────────────────────────────────────────────────────────────────
-//  Metrics – all counters are 64-bit atomics (relaxed updates)
+//  Multi-line messages
+//  A message spans M consecutive slots.  On every line seal_index holds the
+//  number of lines that follow it (M-1 … 0), so the first line carries the
+//  length and the last line is the seal.  A line with seal_index < 0 is a
+//  plain single-line entry.  On queues used with enqueue_message() the
+//  seal_index field therefore belongs to the framing, not to the caller.
 // ─────────────────────────────────────────────────────────────────────────────
 
+constexpr std::size_t k_payload_bytes     = sizeof(Entry::args);   // 56 B
+constexpr std::size_t k_max_message_lines = 32'768;                // int16 seal_index
+
+constexpr std::size_t message_lines(std::size_t bytes) noexcept
+{
+    return bytes == 0 ? 1 : (bytes + k_payload_bytes - 1) / k_payload_bytes;
+}
+
+// Copy `bytes` into the args of consecutive lines (zero-padding the last).
+// Returns the number of lines used, 0 if `lines` is too short.
+inline std::size_t pack_message(const void* data, std::size_t bytes,
+                                std::span<Entry> lines) noexcept
+{
+    const std::size_t m = message_lines(bytes);
+    if (m > lines.size()) return 0;
+
+    const auto* src = static_cast<const uint8_t*>(data);
+    for (std::size_t i = 0; i < m; ++i) {
+        const std::size_t off = i * k_payload_bytes;
+        const std::size_t len = std::min(k_payload_bytes, bytes - std::min(bytes, off));
+        std::memset(lines[i].args, 0, k_payload_bytes);
+        if (len) std::memcpy(lines[i].args, src + off, len);
+    }
+    return m;
+}
+
+// Inverse of pack_message(): copy up to `bytes` of payload out of `lines`.
+inline void unpack_message(std::span<const Entry> lines,
+                           void* dst, std::size_t bytes) noexcept
+{
+    auto* out = static_cast<uint8_t*>(dst);
+    for (std::size_t i = 0; i < lines.size() && bytes; ++i) {
+        const std::size_t len = std::min(k_payload_bytes, bytes);
+        std::memcpy(out, lines[i].args, len);
+        out   += len;
+        bytes -= len;
+    }
+}
+
+// ─────────────────────────────────────────────────────────────────────────────
+//  Packed small messages (enqueue_small / dequeue_small)
+//  One line carries up to 7 messages of 1 … 7 words each, back to back in
+//  args[].  seal_index = −1 − count (−2 … −8) marks a packed line and
+//  rpc_method is the end bitmap: bit i set ⇔ a message ends with args[i].
+//  rpc_id is 0.  Plain single-line entries keep seal_index −1 (or ≥ 0 on
+//  message queues), so the two never look alike.
+// ─────────────────────────────────────────────────────────────────────────────
+
+constexpr std::size_t k_small_max_words = std::size(Entry{}.args);   // 7
+
+constexpr bool is_packed_line(const Entry& e) noexcept
+{
+    return e.meta.f.seal_index <= -2 &&
+           e.meta.f.seal_index >= -1 - static_cast<int>(k_small_max_words);
+}
+
+// fn(std::span<const uint64_t>) for every message of a packed line; any
+// other line is handed over whole (7 words).  Returns the message count.
+template <class Fn>
+inline std::size_t unpack_small(const Entry& e, Fn&& fn)
+{
+    if (!is_packed_line(e)) {
+        fn(std::span<const uint64_t>(e.args, k_small_max_words));
+        return 1;
+    }
+    std::size_t first = 0, n = 0;
+    for (uint32_t ends = e.meta.f.rpc_method; ends != 0; ends &= ends - 1, ++n) {
+        const std::size_t last = static_cast<std::size_t>(std::countr_zero(ends));
+        fn(std::span<const uint64_t>(e.args + first, last + 1 - first));
+        first = last + 1;
+    }
+    return n;
+}
+
+// ─────────────────────────────────────────────────────────────────────────────
+//  Metrics – plain 64-bit counters, each owned by one side (P or C)
+//  Build with -DCXL_QUEUE_METRICS=0 (make METRICS=0) to compile them out:
+//  every field becomes a NullCounter, updates vanish and reads return 0.
+//  The stats export (set_stats_export) keeps working – it has its own
+//  call counter.
+// ─────────────────────────────────────────────────────────────────────────────
+
+#ifndef CXL_QUEUE_METRICS
+#define CXL_QUEUE_METRICS 1
+#endif
+
+struct NullCounter {
+    constexpr NullCounter& operator++() noexcept { return *this; }
+    constexpr NullCounter& operator+=(uint64_t) noexcept { return *this; }
+    constexpr operator size_t() const noexcept { return 0; }
+};
+
+#if CXL_QUEUE_METRICS
+using metric_t = size_t;
+#else
+using metric_t = NullCounter;
+#endif
+
 struct Metrics {
     /* call counters ------------------------------------------------- */
-    size_t enqueue_calls   {0};
-    size_t dequeue_calls   {0};
+    metric_t enqueue_calls   {};
+    metric_t dequeue_calls   {};
+
+    /* items moved by the batched calls (included in the calls above) */
+    metric_t enqueue_batch_items {};
+    metric_t dequeue_batch_items {};
 
     /* queue-state probes ------------------------------------------- */
-    size_t read_cxl_tail   {0};
-    size_t queue_full      {0};
-    size_t no_new_items    {0};
-    size_t checksum_failed {0};
-    size_t flush_tail      {0};
+    metric_t read_cxl_tail   {};
+    metric_t queue_full      {};
+    metric_t no_new_items    {};
+    metric_t checksum_failed {};
+    metric_t flush_tail      {};
+
+    /* Tail publication (adaptive policy) ---------------------------- */
+    metric_t flush_tail_interval {};   // C: interval reached
+    metric_t flush_tail_idle     {};   // C: queue empty, items pending
+    metric_t flush_tail_demand   {};   // C: a producer asked for the tail
+    metric_t tail_demand_probes  {};   // C: CXL reads of the request word
+    metric_t tail_requests       {};   // P: stall requests posted
+    metric_t tail_credits        {};   // P: shadow tail advanced in-band
+    metric_t doorbells_rung      {};   // P: QueueSet doorbell stores
 
     /* Consumer (dequeue) back-off activity ------------------------- */
-    size_t consumer_backoff_events        {0};
-    size_t consumer_backoff_cycles_waited {0};
+    metric_t consumer_backoff_events        {};
+    metric_t consumer_backoff_cycles_waited {};
 
     /* Producer (enqueue) back-off activity ------------------------- */
-    size_t producer_backoff_events        {0};
-    size_t producer_backoff_cycles_waited {0};
+    metric_t producer_backoff_events        {};
+    metric_t producer_backoff_cycles_waited {};
+
+    /* Producer slot claims (multi-producer contention) -------------- */
+    metric_t claim_retries                  {};
+
+    /* Multi-line messages ------------------------------------------ */
+    metric_t messages_enqueued              {};
+    metric_t messages_dequeued              {};
+    metric_t message_incomplete             {};   // head seen, rest not yet
+
+    /* Packed small messages ---------------------------------------- */
+    metric_t small_enqueued                 {};   // P: messages staged
+    metric_t small_lines                    {};   // P: packed lines sent
+    metric_t small_dequeued                 {};   // C: messages unpacked
+
+    /* Consumer lookahead (dequeue) ---------------------------------- */
+    metric_t lookahead_hits                 {};   // prefetched line was valid
+    metric_t lookahead_misses               {};   // stale, needed a fresh load
 };
 
 // ─────────────────────────────────────────────────────────────────────────────
 //  Exponential back-off helper (per consumer/producer thread)
+//  WaitPolicy picks how each step is spent:
+//  * none   : no wait, only counted – for callers that poll many queues
+//             or run their own scheduler
+//  * spin   : _mm_pause loop (the original behaviour, default)
+//  * tpause : TPAUSE to a TSC deadline (C0.1) – no pipeline activity
+//  * umwait : UMONITOR the line passed to pause(), UMWAIT to the deadline;
+//             falls back to tpause when no line is given
+//  * ladder : for fully idle queues – spin while the step grows, then
+//             `tpause_rounds` TPAUSE steps (C0.2) at the max, then
+//             `yield_rounds` sched_yield(), then sleeps doubling from
+//             min_sleep_us to max_sleep_us.  reset() drops back to spin.
+//  Each step multiplies the wait by `growth` (default 2.0), up to max.
+//
+//  Adaptive mode (set_adaptive) retunes min, max and growth from what the
+//  waits achieved.  Per waited success it keeps EWMAs of the gap G (the
+//  residual inter-arrival time in wait units: the waits spent before the
+//  success minus half the last one, since the item landed somewhere in it)
+//  and of its spread D = |gap − G|, and counts polls vs successes.  Every
+//  k_retune_every waited successes:
+//  * min    : polling every T costs T/2 of lag plus probe_cost per G/T
+//             failed polls; T = √(2 · probe_cost · G) minimises the sum
+//  * growth : 1 + D/G within [1.0625, 3] – steady arrivals keep it near
+//             T, bursty ones escalate faster through the long idle gaps
+//  * max    : 4 × (G + D), at least 4 × min, never above the constructed max
+//  probe_cost (default 128 wait units) prices one wasted poll against
+//  wake-up latency: a CXL load is a few hundred ns plus link traffic.
+//  min stays within [k_adaptive_floor, max].
 // ─────────────────────────────────────────────────────────────────────────────
 
+enum class WaitPolicy : uint8_t { none, spin, tpause, umwait, ladder };
+
+constexpr std::string_view to_string(WaitPolicy p) noexcept
+{
+    switch (p) {
+    case WaitPolicy::none:   return "none";
+    case WaitPolicy::spin:   return "spin";
+    case WaitPolicy::tpause: return "tpause";
+    case WaitPolicy::umwait: return "umwait";
+    case WaitPolicy::ladder: return "ladder";
+    }
+    return "?";
+}
+
 struct ExponentialBackoff {
-  // Per-instance limits (default max = 16 384 cycles).
-  const uint32_t min_wait_cycles_;
-  const uint32_t max_wait_cycles_;
+  // Per-instance limits (default max = 16 384 cycles); adaptive mode
+  // moves min / max / growth, max_limit_ stays the ceiling.
+  uint32_t min_wait_cycles_;
+  uint32_t max_wait_cycles_;
+  uint32_t max_limit_;
+  uint32_t growth_q8_ = 512;                 // growth × 256 (2.0)
 
   uint32_t current_wait_;
 
+  WaitPolicy policy_ = WaitPolicy::spin;
+
+  // Ladder shape (only used by WaitPolicy::ladder)
+  uint32_t tpause_rounds = 64;
+  uint32_t yield_rounds  = 16;
+  uint32_t min_sleep_us  = 1;
+  uint32_t max_sleep_us  = 1'000;
+
+  // Steps taken per rung since the last reset() / ever
+  enum Rung : uint8_t { rung_spin, rung_tpause, rung_umwait, rung_yield, rung_sleep, rung_count };
+  uint32_t idle_rounds_ = 0;                 // ladder steps at max wait
+  size_t   rung_steps[rung_count] {};
+
   explicit ExponentialBackoff(uint32_t min_wait,
-                              uint32_t max_wait = 16'384)
+                              uint32_t max_wait = 16'384,
+                              WaitPolicy policy = WaitPolicy::spin)
       : min_wait_cycles_(min_wait),
         max_wait_cycles_(max_wait),
-        current_wait_(min_wait) {}
+        max_limit_(max_wait),
+        current_wait_(min_wait),
+        policy_(policy) {}
+
+  void set_policy(WaitPolicy p) noexcept { policy_ = p; reset(); }
+  [[nodiscard]] WaitPolicy policy() const noexcept { return policy_; }
+
+  // Fixed schedule; growth ≥ 1 (fractions allowed, in 1/256 steps).
+  void set_limits(uint32_t min_wait, uint32_t max_wait, double growth = 2.0) noexcept {
+    max_limit_       = std::max(1u, max_wait);
+    max_wait_cycles_ = max_limit_;
+    min_wait_cycles_ = std::clamp(min_wait, 1u, max_limit_);
+    growth_q8_       = std::max(256u, static_cast<uint32_t>(growth * 256.0 + 0.5));
+    reset();
+  }
+
+  void set_adaptive(bool on) noexcept { adaptive_ = on; tune_ = {}; reset(); }
+  [[nodiscard]] bool     adaptive()  const noexcept { return adaptive_; }
+  [[nodiscard]] uint32_t min_wait()  const noexcept { return min_wait_cycles_; }
+  [[nodiscard]] uint32_t max_wait()  const noexcept { return max_wait_cycles_; }
+  [[nodiscard]] double   growth()    const noexcept { return growth_q8_ / 256.0; }
+  [[nodiscard]] uint64_t gap_estimate() const noexcept { return tune_.gap_ewma; }
+  [[nodiscard]] uint32_t retunes()   const noexcept { return tune_.retunes; }
+  [[nodiscard]] uint32_t poll_success_pct() const noexcept { return tune_.success_pct; }
+  void set_probe_cost(uint32_t units) noexcept { probe_cost_ = units; }
+  [[nodiscard]] uint32_t probe_cost() const noexcept { return probe_cost_; }
+
+  static constexpr uint32_t k_retune_every   = 32;
+  static constexpr uint32_t k_adaptive_floor = 16;
 
   // Pause locally, then increase wait time for the next attempt.
-  inline void pause(size_t& events_counter,
-                    size_t& cycles_counter) noexcept {
-    cpu_relax_for_cycles(current_wait_);
+  // `line` is the cache line the caller is waiting on (umwait only).
+  // Counters are size_t or NullCounter (see CXL_QUEUE_METRICS).
+  template <class Counter>
+  inline void pause(Counter& events_counter,
+                    Counter& cycles_counter,
+                    const void* line = nullptr) noexcept {
     ++events_counter;
-    cycles_counter += current_wait_;
-    current_wait_ = std::min(current_wait_ * 2, max_wait_cycles_);
+    switch (policy_) {
+    case WaitPolicy::none:
+      return;
+    case WaitPolicy::spin:
+      cpu_relax_for_cycles(current_wait_);
+      ++rung_steps[rung_spin];
+      cycles_counter += current_wait_;
+      break;
+    case WaitPolicy::tpause:
+      tpause_for_cycles(current_wait_, k_wait_c01);
+      ++rung_steps[rung_tpause];
+      cycles_counter += current_wait_;
+      break;
+    case WaitPolicy::umwait:
+      if (line) {
+        umwait_for_cycles(line, current_wait_, k_wait_c01);
+        ++rung_steps[rung_umwait];
+      } else {
+        tpause_for_cycles(current_wait_, k_wait_c01);
+        ++rung_steps[rung_tpause];
+      }
+      cycles_counter += current_wait_;
+      break;
+    case WaitPolicy::ladder:
+      cycles_counter += ladder_step();
+      break;
+    }
+    if (adaptive_) {
+      ++tune_.pauses;
+      tune_.spent += current_wait_;
+      tune_.last   = current_wait_;
+    }
+    const uint64_t next = (uint64_t{current_wait_} * growth_q8_) >> 8;
+    current_wait_ = static_cast<uint32_t>(
+        std::min<uint64_t>(std::max<uint64_t>(next, current_wait_ + 1), max_wait_cycles_));
   }
 
   // Reset the wait time after a successful operation.
   inline void reset() noexcept {
+    if (adaptive_ && tune_.pauses != 0) [[unlikely]] observe();
     current_wait_ = min_wait_cycles_;
+    idle_rounds_  = 0;
+  }
+
+private:
+  bool     adaptive_   = false;
+  uint32_t probe_cost_ = 128;
+  struct Tuning {
+    uint64_t spent       = 0;   // wait units paused since reset()
+    uint32_t last        = 0;   // the last of them
+    uint32_t pauses      = 0;   // pauses since reset()
+    uint64_t gap_ewma    = 0;   // G, wait units
+    uint64_t dev_ewma    = 0;   // D, wait units
+    uint64_t polls       = 0;   // polls this window (pauses + successes)
+    uint32_t success_pct = 0;   // successful polls, % of the last window
+    uint32_t waited      = 0;   // waited successes since the last retune
+    uint32_t retunes     = 0;
+  } tune_;
+
+  // A success after `tune_.pauses` pauses: fold it in, retune now and then.
+  inline void observe() noexcept {
+    const int64_t gap = static_cast<int64_t>(tune_.spent - tune_.last / 2);
+    if (tune_.gap_ewma == 0) {
+      tune_.gap_ewma = static_cast<uint64_t>(gap);
+    } else {                                               // α = 1/8
+      const int64_t d = gap - static_cast<int64_t>(tune_.gap_ewma);
+      tune_.gap_ewma += d / 8;
+      tune_.dev_ewma += ((d < 0 ? -d : d) - static_cast<int64_t>(tune_.dev_ewma)) / 8;
+    }
+    tune_.polls += tune_.pauses + 1;
+    tune_.pauses = 0;
+    tune_.spent  = 0;
+    if (++tune_.waited < k_retune_every) return;
+
+    tune_.success_pct = static_cast<uint32_t>(100 * k_retune_every / tune_.polls);
+    tune_.polls  = 0;
+    tune_.waited = 0;
+    ++tune_.retunes;
+
+    const double G = double(std::max<uint64_t>(tune_.gap_ewma, 1));
+    const double D = double(tune_.dev_ewma);
+    growth_q8_       = static_cast<uint32_t>(256.0 * std::clamp(1.0 + D / G, 1.0625, 3.0));
+    min_wait_cycles_ = std::clamp<uint32_t>(static_cast<uint32_t>(std::sqrt(2.0 * probe_cost_ * G)),
+                                            k_adaptive_floor, max_limit_);
+    max_wait_cycles_ = static_cast<uint32_t>(std::clamp<uint64_t>(
+        4 * (tune_.gap_ewma + tune_.dev_ewma), 4ull * min_wait_cycles_, max_limit_));
+    max_wait_cycles_ = std::max(max_wait_cycles_, min_wait_cycles_);
   }
+
+  // One ladder step; returns the TSC cycles actually spent.
+  inline uint64_t ladder_step() noexcept {
+    if (current_wait_ < max_wait_cycles_) {
+      cpu_relax_for_cycles(current_wait_);
+      ++rung_steps[rung_spin];
+      return current_wait_;
+    }
+    const uint64_t t0 = __rdtsc();
+    const uint32_t r  = idle_rounds_++;
+    if (r < tpause_rounds) {
+      tpause_for_cycles(current_wait_, k_wait_c02);
+      ++rung_steps[rung_tpause];
+    } else if (r < tpause_rounds + yield_rounds) {
+      std::this_thread::yield();
+      ++rung_steps[rung_yield];
+    } else {
+      const uint32_t shift = std::min(r - tpause_rounds - yield_rounds, 31u);
+      const uint64_t us = std::min<uint64_t>(uint64_t{min_sleep_us} << shift, max_sleep_us);
+      std::this_thread::sleep_for(std::chrono::microseconds(us));
+      ++rung_steps[rung_sleep];
+    }
+    return __rdtsc() - t0;
+  }
+};
+
+
+// ─────────────────────────────────────────────────────────────────────────────
+//  ProducerGroup – slot-claim state shared by all producers of one ring
+//  * Lives in ordinary host memory (coherent), never in the CXL region
+//  * head        : next free slot, claimed with a CAS by each producer
+//  * shadow_tail : newest consumer tail seen by *any* producer (monotonic)
+//  A slot that is claimed but not yet written still carries the previous
+//  lap's epoch, so the consumer simply waits on it like on an empty slot.
+//  Producers on other hosts cannot share this block – give them their own
+//  ring instead.
+// ─────────────────────────────────────────────────────────────────────────────
+
+struct ProducerGroup {
+    alignas(64) std::atomic<uint32_t> head        {0};
+    alignas(64) std::atomic<uint32_t> shadow_tail {0};
+    std::atomic<uint64_t>             stall_seq   {0};   // tail requests posted
 };
 
+// ─────────────────────────────────────────────────────────────────────────────
+//  TailPolicy – when the consumer publishes tail_ to the CXL tail line
+//  * fixed    : every `interval` items (default cap/4) – the original scheme
+//  * adaptive : as fixed, plus
+//      – idle flush   : a poll finds the queue empty while items are still
+//                       unpublished and `idle_cycles` TSC ticks have passed
+//      – demand flush : a producer found the ring full after reading the
+//                       CXL tail and posted a request (word 1 of the tail
+//                       line); the consumer probes it every interval/4 items
+//      – the interval halves after a demand flush (down to min_interval)
+//        and doubles back after a quiet interval (up to `interval`)
+//  * piggyback: the tail travels in-band instead – a paired response queue
+//               carries consumed_tail() back to the producer, which feeds it
+//               to note_consumer_tail() (see RpcServer::set_tail_piggyback).
+//               No interval flushes; only demand flushes remain, and the
+//               request word is probed on empty polls at most once per
+//               `idle_cycles`, so a producer that gets no credits (another
+//               host, a full ring) still makes progress
+//  The tail line is 64 B and owned by the queue: word 0 = tail (written by
+//  the consumer), word 1 = stall-request sequence (written by producers).
+// ─────────────────────────────────────────────────────────────────────────────
+
+struct TailPolicy {
+    enum class Mode : uint8_t { fixed, adaptive, piggyback };
+
+    Mode     mode         = Mode::fixed;
+    uint32_t interval     = 0;        // 0 → cap/4 (min 1)
+    uint32_t min_interval = 0;        // 0 → interval/16 (min 1)
+    uint64_t idle_cycles  = 10'000;   // TSC ticks before an idle flush
+};
+
+// ─────────────────────────────────────────────────────────────────────────────
+//  SlotReservation – producer handle to a claimed ring slot (reserve/commit)
+//  `entry` points straight into the CXL ring; it still holds the previous
+//  lap's content, so the caller must write every field it cares about.
+// ─────────────────────────────────────────────────────────────────────────────
+
+struct SlotReservation {
+    Entry*   entry {nullptr};
+    uint32_t slot  {0};
+
+    explicit operator bool() const noexcept { return entry != nullptr; }
+};
+
+// ─────────────────────────────────────────────────────────────────────────────
+//  Line store / load policies (template parameters of BasicCxlMpscQueue)
+//  Store::store(dst, src) – write one 64-B ring line so that it leaves this
+//                           core's cache; no fence, the queue fences once
+//                           per enqueue / batch / message
+//  Load::invalidate(line) – drop our (possibly stale) copy; the queue fences
+//                           once after all lines of a batch are invalidated
+//  Load::load(dst, src)   – the 64-B read that then misses to CXL
+//  doorbell_benchmark.cpp measures the store side on a given platform.
+// ─────────────────────────────────────────────────────────────────────────────
+
+//  Store::atomic_64B – the line reaches memory in one piece (the no-check
+//  policy is only allowed then).
+struct NtStore {                        // MOVNTDQ zmm via the WC buffers
+    static constexpr std::string_view name = "nt";
+    static constexpr bool atomic_64B = false;
+    static void store(void* dst, const void* src) noexcept { stream_64B(dst, src); }
+};
+
+#ifdef __MOVDIR64B__
+struct MovDir64BStore {                 // one 64-B direct store, never torn
+    static constexpr std::string_view name = "movdir64b";
+    static constexpr bool atomic_64B = true;
+    static void store(void* dst, const void* src) noexcept { _movdir64b(dst, src); }
+};
+#endif
+
+struct ClwbStore {                      // cached store, line written back and kept
+    static constexpr std::string_view name = "clwb";
+    static constexpr bool atomic_64B = false;
+    static void store(void* dst, const void* src) noexcept
+    {
+        _mm512_store_si512(dst, _mm512_load_si512(src));
+        _mm_clwb(dst);
+    }
+};
+
+struct ClflushoptStore {                // cached store, line written back and dropped
+    static constexpr std::string_view name = "clflushopt";
+    static constexpr bool atomic_64B = false;
+    static void store(void* dst, const void* src) noexcept
+    {
+        _mm512_store_si512(dst, _mm512_load_si512(src));
+        _mm_clflushopt(dst);
+    }
+};
+
+struct FlushLoad {                      // CLFLUSHOPT, weakly ordered → fence
+    static constexpr std::string_view name = "clflushopt";
+    static void invalidate(const void* line) noexcept { _mm_clflushopt(const_cast<void*>(line)); }
+    static void load(void* dst, const void* src) noexcept
+    {
+        _mm512_store_si512(dst, _mm512_load_si512(src));
+    }
+};
+
+struct ClflushLoad {                    // legacy CLFLUSH: serialised per line
+    static constexpr std::string_view name = "clflush";
+    static void invalidate(const void* line) noexcept { _mm_clflush(line); }
+    static void load(void* dst, const void* src) noexcept
+    {
+        _mm512_store_si512(dst, _mm512_load_si512(src));
+    }
+};
+
+// ─────────────────────────────────────────────────────────────────────────────
+//  Line check policies – detect a line the consumer saw half-written
+//  Check::sum(e, meta)  – 16-bit check over args[0..6] and `meta` (the meta
+//                         word as it will be published, checksum field 0)
+//  Check::stamp(e)      – fill e.meta.f.checksum for the meta already in e
+//  Check::verify(e)     – true if the line is whole
+//
+//  XorCheck    : the 64-bit XOR of all words folded to 16 bits (one AVX-512
+//                reduction).  Misses any even number of flips of the same
+//                bit position – e.g. the same byte torn in two words.
+//  Crc32cCheck : hardware CRC32C over the 8 words, folded to 16 bits
+//                (~8 × 3 cycles dependent chain).  Catches multi-bit and
+//                burst errors the XOR fold misses.
+//  NoCheck     : nothing computed or verified; e.meta.f.checksum is left to
+//                the caller as 2 extra payload bytes.  Needs a store policy
+//                with atomic_64B (MOVDIR64B) – the consumer's 64-B aligned
+//                zmm load then never splits a line it reads.
+// ─────────────────────────────────────────────────────────────────────────────
+
+struct XorCheck {
+    static constexpr std::string_view name = "xor16";
+    static constexpr bool enabled = true;
+
+    static uint16_t sum(const Entry& e, uint64_t meta) noexcept
+    {
+        const u64_may_alias* w = reinterpret_cast<const u64_may_alias*>(&e);
+        uint64_t acc = meta;
+        for (int i = 0; i < 7; ++i) acc ^= w[i];
+        acc ^= acc >> 32;
+        acc ^= acc >> 16;
+        return static_cast<uint16_t>(acc);
+    }
+    static void stamp(Entry& e) noexcept
+    {
+        e.meta.f.checksum = 0;
+        e.meta.f.checksum = xor_checksum64(&e);
+    }
+    static bool verify(const Entry& e) noexcept { return verify_checksum(&e); }
+};
+
+struct Crc32cCheck {
+    static constexpr std::string_view name = "crc32c";
+    static constexpr bool enabled = true;
+
+    static uint16_t sum(const Entry& e, uint64_t meta) noexcept
+    {
+        const u64_may_alias* w = reinterpret_cast<const u64_may_alias*>(&e);
+        uint64_t crc = ~0u;
+        for (int i = 0; i < 7; ++i) crc = _mm_crc32_u64(crc, w[i]);
+        crc = ~_mm_crc32_u64(crc, meta) & 0xFFFF'FFFFu;
+        return static_cast<uint16_t>(crc ^ (crc >> 16));
+    }
+    static void stamp(Entry& e) noexcept
+    {
+        Entry::Meta m = e.meta;
+        m.f.checksum = 0;
+        e.meta.f.checksum = sum(e, m.raw);
+    }
+    static bool verify(const Entry& e) noexcept
+    {
+        Entry::Meta m = e.meta;
+        m.f.checksum = 0;
+        return sum(e, m.raw) == e.meta.f.checksum;
+    }
+};
+
+struct NoCheck {
+    static constexpr std::string_view name = "none";
+    static constexpr bool enabled = false;
+
+    static uint16_t sum(const Entry&, uint64_t) noexcept { return 0; }
+    static void stamp(Entry&) noexcept {}
+    static bool verify(const Entry&) noexcept { return true; }
+};
+
+// ─────────────────────────────────────────────────────────────────────────────
+//  Live stats export
+//  A queue handle can publish a snapshot of one side (producer or consumer)
+//  into a 64-B QueueStatsLine every 2^k calls of that side: one NT line
+//  store + sfence from the thread that already owns the counters, nothing
+//  on the ring, tail or group lines.  A monitor on any host reads the
+//  line fresh (read_stats_line) and diffs two snapshots for rates; depth
+//  is producer.position − consumer.position.  `calls` and `position` are
+//  always live; stalls / probes / back-off come from Metrics and stay 0
+//  with CXL_QUEUE_METRICS=0.  seq is written at both ends of the line so
+//  a torn read (plain NT stores are not 64-B atomic) is rejected.
+// ─────────────────────────────────────────────────────────────────────────────
+
+enum class StatsRole : uint8_t { producer, consumer };
+
+struct alignas(64) QueueStatsLine {
+    uint64_t seq;              // snapshots published, 0 = none yet
+    uint64_t tsc;              // publisher's TSC at the snapshot
+    uint64_t position;         // P: claimed head, C: tail (free-running)
+    uint64_t calls;            // enqueue*/reserve or dequeue*/peek calls
+    uint64_t stalls;           // P: queue_full,     C: no_new_items
+    uint64_t backoff_cycles;   // P/C back-off cycles waited
+    uint64_t probes;           // P: read_cxl_tail,  C: flush_tail
+    uint64_t seq_check;        // == seq when the line is whole
+};
+static_assert(sizeof(QueueStatsLine) == 64);
+
+// Fresh read of a stats line written by another host; false if it was
+// never written or the read caught it half-way.
+inline bool read_stats_line(const QueueStatsLine* line, QueueStatsLine& out) noexcept
+{
+    load_fresh_64B(&out, const_cast<QueueStatsLine*>(line));
+    return out.seq != 0 && out.seq == out.seq_check;
+}
 
 // ─────────────────────────────────────────────────────────────────────────────
 //  Queue class
 // ─────────────────────────────────────────────────────────────────────────────
 
-class CxlMpscQueue {
+template <class Store = NtStore, class Load = FlushLoad, class Check = XorCheck>
+class BasicCxlMpscQueue {
+    static_assert(Check::enabled || Store::atomic_64B,
+                  "NoCheck needs a store policy with 64-B atomic stores (MovDir64BStore)");
+
 public:
-     CxlMpscQueue(Entry* ring, uint32_t order_log2, uint64_t* cxl_tail, 
+    using store_policy = Store;
+    using load_policy  = Load;
+    using check_policy = Check;
+
+     BasicCxlMpscQueue(Entry* ring, uint32_t order_log2, uint64_t* cxl_tail, 
                  bool do_initialize = true, uint32_t min_backoff = 128, uint32_t max_backoff = 16'384)
+        : BasicCxlMpscQueue(ring, order_log2, cxl_tail, own_group_,
+                            do_initialize, min_backoff, max_backoff)
+    {}
+
+    // Producer handle that shares slot claims with every other handle built
+    // on the same `group` (one handle per producer thread).  Exactly one
+    // process/handle must pass do_initialize = true.
+    BasicCxlMpscQueue(Entry* ring, uint32_t order_log2, uint64_t* cxl_tail,
+                      ProducerGroup& group, bool do_initialize,
+                      uint32_t min_backoff = 128, uint32_t max_backoff = 16'384)
         : ring_(ring),
           order_(order_log2),
           mask_((1u << order_log2) - 1),
-          head_(0),
-          shadow_tail_(0),
+          group_(&group),
           tail_(0),
           cxl_tail_(cxl_tail),
           expected_epoch_consumer(1),
@@ -232,10 +899,95 @@ public:
         // The consumer process attaches to the already-initialized memory.
         if (do_initialize) {
             std::memset(ring_, 0, sizeof(Entry) * (1u << order_));
+            store_nt_u64(cxl_tail_ + 1, 0);     // stall-request word
             store_nt_u64(cxl_tail_, tail_);
         }
+        set_tail_policy(TailPolicy{});
+    }
+
+    // ────────────────────────────────────────────────────────────────
+    //  set_tail_policy — choose how the consumer publishes its tail
+    //  Consumer-side setting; producers only post stall requests.
+    // ────────────────────────────────────────────────────────────────
+    void set_tail_policy(const TailPolicy& p) noexcept
+    {
+        tail_policy_ = p;
+        const uint32_t def = std::max(1u, (1u << order_) / 4);
+        max_interval_ = std::bit_floor(std::clamp(p.interval ? p.interval : def,
+                                                  1u, 1u << order_));
+        min_interval_ = std::bit_floor(std::clamp(p.min_interval ? p.min_interval
+                                                                 : max_interval_ / 16,
+                                                  1u, max_interval_));
+        flush_interval_ = max_interval_;
+        last_publish_tsc_ = __rdtsc();
+    }
+
+    [[nodiscard]] const TailPolicy& tail_policy() const noexcept { return tail_policy_; }
+
+    // ────────────────────────────────────────────────────────────────
+    //  In-band tail credits (TailPolicy::Mode::piggyback)
+    //  consumed_tail()      – consumer: slots consumed so far; send it
+    //                         back on the paired queue
+    //  note_consumer_tail() – producer: a tail value received that way;
+    //                         raises the shadow tail like a CXL tail read
+    //                         would (older values are ignored).  Returns
+    //                         true if it freed slots.
+    // ────────────────────────────────────────────────────────────────
+    [[nodiscard]] uint32_t consumed_tail() const noexcept { return tail_; }
+
+    bool note_consumer_tail(uint32_t t) noexcept
+    {
+        if (!advance_shadow_tail(t)) return false;
+        ++metrics.tail_credits;
+        return true;
+    }
+    [[nodiscard]] uint32_t tail_flush_interval() const noexcept { return flush_interval_; }
+
+    // ────────────────────────────────────────────────────────────────
+    //  Restart without re-initialization (handles built with
+    //  do_initialize = false; cxl_region.hpp keeps the ring by name)
+    //  resume_consumer – continue from the CXL tail line.  Items taken
+    //                    after the last publication are delivered again;
+    //                    publish_tail() before a planned stop avoids it.
+    //                    A lookahead depth set earlier is kept.
+    //  resume_producer – find the head by reading forward from the CXL
+    //                    tail while each slot carries its lap's epoch, and
+    //                    claim from there.  Call on one handle of a group
+    //                    before any of them enqueues; returns the head.
+    //                    A producer that died between claim and store
+    //                    leaves a hole – the head resumes there, where the
+    //                    consumer is waiting anyway.
+    //  publish_tail    – consumer: write the tail to CXL now
+    // ────────────────────────────────────────────────────────────────
+    void resume_consumer() noexcept
+    {
+        tail_ = published_tail_ = last_probe_tail_ =
+            static_cast<uint32_t>(load_fresh_u64(cxl_tail_));
+        expected_epoch_consumer = static_cast<uint8_t>(tail_ >> order_) + 1;
+        arm_lookahead();                          // same depth, from the new tail
+    }
+
+    uint32_t resume_producer() noexcept
+    {
+        const uint32_t tail = static_cast<uint32_t>(load_fresh_u64(cxl_tail_));
+        const uint32_t cap  = 1u << order_;
+        uint32_t head = tail;
+        Entry    line;
+        /* head ≤ tail + cap, plus up to one ring of consumer lag when
+         * credits travel in-band (a slot already holds the next lap) */
+        while (head - tail < 2 * cap) {
+            load_fresh(&line, &ring_[head & mask_]);
+            if      (line.meta.f.epoch == epoch_of(head))       ++head;
+            else if (line.meta.f.epoch == epoch_of(head + cap)) head += cap;
+            else break;
+        }
+        group_->head.store(head, std::memory_order_relaxed);
+        group_->shadow_tail.store(tail, std::memory_order_relaxed);
+        return head;
     }
 
+    void publish_tail() noexcept { flush_tail(); }
+
     [[nodiscard]] std::size_t capacity() const noexcept
     {
         return static_cast<std::size_t>(1u) << order_;  // 2^order_
@@ -246,54 +998,100 @@ public:
     // ────────────────────────────────────────────────────────────────
     bool enqueue(Entry& in, bool debug = false)
     {
-        static thread_local ExponentialBackoff backoff_full{128};
 
-        // uint32_t slot = head_.load(std::memory_order_relaxed);
-        // uint32_t slot = head_;
-        static const uint32_t cap = 1u << order_;
         ++metrics.enqueue_calls;
+        tick_stats(StatsRole::producer);
 
-        /* fast check: ring looks full? */
-        if (static_cast<int32_t>(head_ - shadow_tail_) >=
-            static_cast<int32_t>(cap))
-        {
-            ++metrics.read_cxl_tail;
+        /* claim one slot (refreshes the CXL tail if the ring looks full) */
+        uint32_t slot;
+        if (claim(1, slot) == 0) {
+            backoff_full_.pause(metrics.producer_backoff_events,
+                                metrics.producer_backoff_cycles_waited);
             // if (debug)
             //     std::osyncstream(std::cout)
-            //         << "[enqueue] ring-full slot=" << slot
-            //         << " shadow_tail=" << shadow_tail_
-            //         << " cap=" << cap << '\n';
-
-            /* refresh tail from CXL */
-            shadow_tail_ = static_cast<uint32_t>(load_fresh_u64(cxl_tail_));
-
-            /* still full after refresh → backoff and give up */
-            if (static_cast<int32_t>(head_ - shadow_tail_) >=
-                static_cast<int32_t>(cap))
-            {
-                ++metrics.queue_full;
-                backoff_full.pause(metrics.producer_backoff_events,
-                                   metrics.producer_backoff_cycles_waited);
-                // if (debug)
-                //     std::osyncstream(std::cout)
-                //         << "[enqueue] queue_full (after CXL tail read)\n";
-                return false;
-            }
+            //         << "[enqueue] queue_full (after CXL tail read)\n";
+            return false;
         }
         
         // If we got here, the queue is not full, so reset producer backoff
-        backoff_full.reset();
+        backoff_full_.reset();
 
         /* prepare entry (checksum over 64 B) */
-        in.meta.f.epoch    = static_cast<uint8_t>(head_ >> order_) + 1;
-        in.meta.f.checksum = 0;
-        in.meta.f.checksum = xor_checksum64(&in);
+        seal(in, slot);
+        Store::store(&ring_[slot & mask_], &in);
+        _mm_sfence();
+        ring_doorbell(slot);
+
+        return true;
+    }
+
+    // ────────────────────────────────────────────────────────────────
+    //  enqueue_batch — stream as many of `in` as fit, fence once
+    //  Returns the number of entries enqueued (a prefix of `in`); 0 means
+    //  the ring is full and the producer backed off.  Entries are stamped
+    //  (epoch + checksum) in place, like enqueue().
+    // ────────────────────────────────────────────────────────────────
+    std::size_t enqueue_batch(std::span<Entry> in)
+    {
+
+        ++metrics.enqueue_calls;
+        tick_stats(StatsRole::producer);
+        if (in.empty()) return 0;
+
+        const uint32_t want = static_cast<uint32_t>(
+            std::min<std::size_t>(in.size(), capacity()));
+        uint32_t first;
+        const uint32_t n = claim(want, first);
+        if (n == 0) {
+            backoff_full_.pause(metrics.producer_backoff_events,
+                                metrics.producer_backoff_cycles_waited);
+            return 0;
+        }
+        backoff_full_.reset();
+
+        for (uint32_t i = 0; i < n; ++i) {
+            seal(in[i], first + i);
+            Store::store(&ring_[(first + i) & mask_], &in[i]);
+        }
+        _mm_sfence();                       // one fence for the whole batch
+        ring_doorbell(first + n - 1);
+
+        metrics.enqueue_batch_items += n;
+        return n;
+    }
+
+    // ────────────────────────────────────────────────────────────────
+    //  enqueue_message — one logical message over M = lines.size() slots
+    //  All-or-nothing: claims M consecutive slots or fails (queue_full).
+    //  seal_index of every line is overwritten with the framing; the
+    //  single sfence after the last line publishes the whole message.
+    // ────────────────────────────────────────────────────────────────
+    bool enqueue_message(std::span<Entry> lines)
+    {
 
-        store_nt_64B(&ring_[head_ & mask_], &in);
-        _mm_sfence();                       // order NT-store
+        ++metrics.enqueue_calls;
+        tick_stats(StatsRole::producer);
+        const std::size_t m = lines.size();
+        assert(m >= 1 && m <= std::min(capacity(), k_max_message_lines) &&
+               "message must fit the ring");
+
+        uint32_t first;
+        if (claim(static_cast<uint32_t>(m), first, static_cast<uint32_t>(m)) == 0) {
+            backoff_full_.pause(metrics.producer_backoff_events,
+                                metrics.producer_backoff_cycles_waited);
+            return false;
+        }
+        backoff_full_.reset();
 
-        // head_.store(slot + 1, std::memory_order_release);
-        head_++;
+        for (std::size_t i = 0; i < m; ++i) {
+            lines[i].meta.f.seal_index = static_cast<int16_t>(m - 1 - i);
+            seal(lines[i], first + static_cast<uint32_t>(i));
+            Store::store(&ring_[(first + i) & mask_], &lines[i]);
+        }
+        _mm_sfence();                       // one fence for the whole message
+        ring_doorbell(first + static_cast<uint32_t>(m) - 1);
+
+        ++metrics.messages_enqueued;
         return true;
     }
 
@@ -302,20 +1100,30 @@ public:
     // ────────────────────────────────────────────────────────────────
     bool dequeue(Entry& out, bool debug = false)
     {
-        // static ExponentialBackoff backoff_empty{128};
-        static ExponentialBackoff backoff_checksum{100};
         ++metrics.dequeue_calls;
+        tick_stats(StatsRole::consumer);
 
-        load_fresh_64B(&out, &ring_[tail_ & mask_]);
-
+        Entry* const line = &ring_[tail_ & mask_];
         const uint8_t expected_epoch = expected_epoch_consumer;
-            
+
+        /* lookahead: the line was invalidated + prefetched when it entered
+         * the window.  Use the cached copy only if it is already valid. */
+        bool prefetched_hit = false;
+        if (lookahead_ != 0) {
+            _mm512_store_si512(&out, _mm512_load_si512(line));
+            prefetched_hit = out.meta.f.epoch == expected_epoch &&
+                             Check::verify(out);
+        }
+        if (!prefetched_hit)
+            load_fresh(&out, line);
 
         /* epoch mismatch → nothing new yet */
         if (out.meta.f.epoch != expected_epoch) {
             ++metrics.no_new_items;
+            on_empty_poll(debug);
             backoff_empty.pause(metrics.consumer_backoff_events,
-                                metrics.consumer_backoff_cycles_waited);
+                                metrics.consumer_backoff_cycles_waited,
+                                &ring_[tail_ & mask_]);
             // if (debug)
             //     std::osyncstream(std::cout)
             //         << "[dequeue] epoch mismatch tail=" << tail_
@@ -324,11 +1132,11 @@ public:
             return false;
         }
 
-        /* checksum mismatch */
-        if (!verify_checksum(&out)) {
+        /* checksum mismatch (a lookahead hit was verified already) */
+        if (!prefetched_hit && !Check::verify(out)) {
             ++metrics.checksum_failed;
-            backoff_checksum.pause(metrics.consumer_backoff_events,
-                                   metrics.consumer_backoff_cycles_waited);
+            backoff_checksum_.pause(metrics.consumer_backoff_events,
+                                    metrics.consumer_backoff_cycles_waited);
             // if (debug)
             //     std::osyncstream(std::cout)
             //         << "[dequeue] checksum failed at tail=" << tail_ << '\n';
@@ -336,21 +1144,389 @@ public:
         }
 
         /* success */
-        ++tail_;
         backoff_empty.reset();
-        backoff_checksum.reset();
+        backoff_checksum_.reset();
+        advance_tail(1, debug);
 
-        /* flush tail back every (cap/4) dequeues, minimum 1 */
-        
-        const uint32_t flush_interval = std::max(1u, (1u << order_) / 4);
-        if ((tail_ & (flush_interval - 1)) == 0) {
-            flush_tail(debug);
-            expected_epoch_consumer = static_cast<uint8_t>(tail_ >> order_) + 1;
+        if (lookahead_ != 0) {
+            ++(prefetched_hit ? metrics.lookahead_hits : metrics.lookahead_misses);
+            prefetch_slot(tail_ + lookahead_ - 1);   // slide the window by one
+        }
+
+        return true;
+    }
+
+    // ────────────────────────────────────────────────────────────────
+    //  set_lookahead — keep `slots` upcoming slots in flight for dequeue()
+    //  Each slot entering the window is invalidated and soft-prefetched,
+    //  so by the time dequeue() reaches it the CXL load has (ideally)
+    //  completed.  A prefetched line is re-validated before use and
+    //  re-read fresh if stale.  0 disables lookahead (default).
+    //
+    //  Only dequeue() uses and slides the window.  dequeue_batch(),
+    //  peek() and dequeue_message() invalidate and load their own lines
+    //  (one fence per call already overlaps them) and leave the window
+    //  where it was, so a dequeue() after them misses until the window
+    //  has refilled; call set_lookahead() again to re-arm it at once.
+    //  resume_consumer() keeps the depth and re-arms from the new tail.
+    // ────────────────────────────────────────────────────────────────
+    void set_lookahead(uint32_t slots) noexcept
+    {
+        lookahead_ = std::min<uint32_t>(slots, static_cast<uint32_t>(capacity()) - 1);
+        arm_lookahead();
+    }
+
+    [[nodiscard]] uint32_t lookahead() const noexcept { return lookahead_; }
+
+    // ────────────────────────────────────────────────────────────────
+    //  set_wait_policy — how the consumer waits on an empty ring
+    //  (umwait monitors the slot it is waiting on)
+    // ────────────────────────────────────────────────────────────────
+    void set_wait_policy(WaitPolicy p) noexcept { backoff_empty.set_policy(p); }
+    [[nodiscard]] WaitPolicy wait_policy() const noexcept { return backoff_empty.policy(); }
+    [[nodiscard]] ExponentialBackoff& consumer_backoff() noexcept { return backoff_empty; }
+    [[nodiscard]] ExponentialBackoff& producer_backoff() noexcept { return backoff_full_; }
+
+    // ────────────────────────────────────────────────────────────────
+    //  set_backoff_adaptive — let the ring-full (P) and empty-ring (C)
+    //  back-offs tune min / max / growth from the gaps they observe
+    //  (see ExponentialBackoff).  Back-off state is per handle and side,
+    //  so producers of one ring sharing a thread no longer share it.
+    // ────────────────────────────────────────────────────────────────
+    void set_backoff_adaptive(bool on) noexcept
+    {
+        backoff_full_.set_adaptive(on);
+        backoff_empty.set_adaptive(on);
+    }
+
+    // ────────────────────────────────────────────────────────────────
+    //  set_stats_export — publish a `role` snapshot into `line` every
+    //  2^every_log2 calls of that side (nullptr stops it).  Producer and
+    //  consumer of one handle may export to two different lines.
+    //  publish_stats() writes one now (e.g. when the thread goes idle).
+    // ────────────────────────────────────────────────────────────────
+    void set_stats_export(StatsRole role, QueueStatsLine* line,
+                          uint32_t every_log2 = 10) noexcept
+    {
+        assert((reinterpret_cast<std::uintptr_t>(line) & 63u) == 0 &&
+               "stats line is not 64-byte aligned");
+        StatsExport& x = stats_[static_cast<int>(role)];
+        x.line  = line;
+        x.mask  = (uint64_t{1} << std::min(every_log2, 63u)) - 1;
+        if (line) publish_stats(role);
+    }
+
+    void publish_stats(StatsRole role) noexcept
+    {
+        StatsExport& x = stats_[static_cast<int>(role)];
+        if (!x.line) return;
+        const bool p = role == StatsRole::producer;
+        alignas(64) QueueStatsLine s;
+        s.seq            = ++x.seq;
+        s.tsc            = __rdtsc();
+        s.position       = p ? group_->head.load(std::memory_order_relaxed) : tail_;
+        s.calls          = x.calls;
+        s.stalls         = p ? metrics.queue_full : metrics.no_new_items;
+        s.backoff_cycles = p ? metrics.producer_backoff_cycles_waited
+                             : metrics.consumer_backoff_cycles_waited;
+        s.probes         = p ? metrics.read_cxl_tail : metrics.flush_tail;
+        s.seq_check      = s.seq;
+        store_nt_64B(x.line, &s);
+    }
+
+    // ────────────────────────────────────────────────────────────────
+    //  set_doorbell — 4-byte CXL word stamped with (last slot + 1)
+    //  after every publish; nullptr disables it.  Producer-side setting.
+    // ────────────────────────────────────────────────────────────────
+    void set_doorbell(uint32_t* word) noexcept { doorbell_ = word; }
+
+    // ────────────────────────────────────────────────────────────────
+    //  dequeue_batch — flush the next K slots, fence once, then validate
+    //  them in order and stop at the first slot that is not ready.
+    //  K = min(out.size(), max, capacity).  Returns #entries copied to `out`.
+    //  last_batch_torn() then says whether it stopped at a line that
+    //  failed the check (in every build – Metrics may be compiled out).
+    // ────────────────────────────────────────────────────────────────
+    std::size_t dequeue_batch(std::span<Entry> out,
+                              std::size_t max = static_cast<std::size_t>(-1),
+                              bool debug = false)
+    {
+        ++metrics.dequeue_calls;
+        tick_stats(StatsRole::consumer);
+
+        const uint32_t k = static_cast<uint32_t>(
+            std::min({out.size(), max, capacity()}));
+        if (k == 0) return 0;
+
+        /* invalidate all K lines, then one fence for the lot */
+        for (uint32_t i = 0; i < k; ++i)
+            Load::invalidate(&ring_[(tail_ + i) & mask_]);
+        _mm_sfence();
+
+        uint32_t n = 0;
+        bool     torn = false;
+        for (; n < k; ++n) {
+            const uint32_t t = tail_ + n;
+            Load::load(&out[n], &ring_[t & mask_]);
+
+            if (out[n].meta.f.epoch != static_cast<uint8_t>((t >> order_) + 1))
+                break;
+            if (!Check::verify(out[n])) { torn = true; break; }
         }
+        batch_torn_ = torn;
 
+        if (n == 0) {
+            if (torn) {
+                ++metrics.checksum_failed;
+                backoff_checksum_.pause(metrics.consumer_backoff_events,
+                                        metrics.consumer_backoff_cycles_waited);
+            } else {
+                ++metrics.no_new_items;
+                on_empty_poll(debug);
+                backoff_empty.pause(metrics.consumer_backoff_events,
+                                    metrics.consumer_backoff_cycles_waited,
+                                    &ring_[tail_ & mask_]);
+            }
+            return 0;
+        }
+        backoff_empty.reset();
+        backoff_checksum_.reset();
+
+        /* publish tail once if the batch crossed a flush boundary */
+        advance_tail(n, debug);
+
+        metrics.dequeue_batch_items += n;
+        return n;
+    }
+
+    [[nodiscard]] bool last_batch_torn() const noexcept { return batch_torn_; }
+
+    // ────────────────────────────────────────────────────────────────
+    //  enqueue_small — stage a 1…7-word message in this handle's pack
+    //  line.  The line is sent (one enqueue: one store, one fence) once
+    //  it is full, when the next message does not fit, on flush_small(),
+    //  or on the first enqueue_small() / poll_small() `pack_deadline`
+    //  TSC ticks after its first message.  False (nothing staged) only
+    //  if a full pack could not be sent – the ring is full.
+    //  Staged messages are not ordered against enqueue() on the same
+    //  handle: flush_small() first when mixing the two.
+    // ────────────────────────────────────────────────────────────────
+    bool enqueue_small(std::span<const uint64_t> msg)
+    {
+        assert(!msg.empty() && msg.size() <= k_small_max_words);
+        if (pack_words_ + msg.size() > k_small_max_words && !flush_small()) return false;
+
+        if (pack_words_ == 0) pack_since_tsc_ = __rdtsc();
+        std::memcpy(pack_.args + pack_words_, msg.data(), msg.size_bytes());
+        pack_words_ += static_cast<uint32_t>(msg.size());
+        pack_ends_  |= 1u << (pack_words_ - 1);
+        ++pack_count_;
+        ++metrics.small_enqueued;
+
+        if (pack_words_ == k_small_max_words) flush_small();   // stays staged if full
+        else                                  poll_small();
         return true;
     }
 
+    // Send the pack line if its deadline has passed (call when idle).
+    bool poll_small()
+    {
+        if (pack_count_ == 0 || __rdtsc() - pack_since_tsc_ < pack_deadline_) return false;
+        return flush_small();
+    }
+
+    // ────────────────────────────────────────────────────────────────
+    //  flush_small — send the staged messages now; false if the ring
+    //  is full (they stay staged)
+    // ────────────────────────────────────────────────────────────────
+    bool flush_small()
+    {
+        if (pack_count_ == 0) return true;
+        pack_.meta.f.seal_index = static_cast<int16_t>(-1 - static_cast<int>(pack_count_));
+        pack_.meta.f.rpc_method = static_cast<uint8_t>(pack_ends_);
+        pack_.meta.f.rpc_id     = 0;
+        if (!enqueue(pack_)) return false;
+
+        ++metrics.small_lines;
+        pack_       = Entry{};
+        pack_words_ = pack_count_ = pack_ends_ = 0;
+        return true;
+    }
+
+    void set_pack_deadline(uint64_t tsc_ticks) noexcept { pack_deadline_ = tsc_ticks; }
+    [[nodiscard]] uint64_t pack_deadline() const noexcept { return pack_deadline_; }
+    [[nodiscard]] uint32_t small_staged()  const noexcept { return pack_count_; }
+
+    // ────────────────────────────────────────────────────────────────
+    //  dequeue_small — dequeue_batch up to `max_lines` lines and hand
+    //  out the messages packed in them, fn(std::span<const uint64_t>).
+    //  Unpacked lines count as one 7-word message.  Returns messages.
+    // ────────────────────────────────────────────────────────────────
+    template <class Fn>
+    std::size_t dequeue_small(Fn&& fn, std::size_t max_lines = k_small_batch)
+    {
+        alignas(64) Entry buf[k_small_batch];
+        const std::size_t n = dequeue_batch(std::span<Entry>(buf, std::min(max_lines, k_small_batch)));
+        std::size_t msgs = 0;
+        for (std::size_t i = 0; i < n; ++i) msgs += unpack_small(buf[i], fn);
+        metrics.small_dequeued += msgs;
+        return msgs;
+    }
+
+    // ────────────────────────────────────────────────────────────────
+    //  dequeue_message — copy the next message (all its lines) to `out`
+    //  Returns M, or 0 if nothing is ready.  The message is consumed only
+    //  once every line has the right epoch, checksum and seal_index, so a
+    //  partially visible message is never returned.  `out` must be able to
+    //  hold the longest message the producer sends.
+    // ────────────────────────────────────────────────────────────────
+    std::size_t dequeue_message(std::span<Entry> out, bool debug = false)
+    {
+        ++metrics.dequeue_calls;
+        tick_stats(StatsRole::consumer);
+        if (out.empty()) return 0;
+
+        /* head line first: it tells us the length */
+        load_fresh(&out[0], &ring_[tail_ & mask_]);
+        if (out[0].meta.f.epoch != expected_epoch_consumer) {
+            ++metrics.no_new_items;
+            on_empty_poll(debug);
+            backoff_empty.pause(metrics.consumer_backoff_events,
+                                metrics.consumer_backoff_cycles_waited,
+                                &ring_[tail_ & mask_]);
+            return 0;
+        }
+        if (!Check::verify(out[0])) {
+            ++metrics.checksum_failed;
+            backoff_checksum_.pause(metrics.consumer_backoff_events,
+                                    metrics.consumer_backoff_cycles_waited);
+            return 0;
+        }
+
+        const int16_t   seal = out[0].meta.f.seal_index;
+        const uint32_t  m    = seal < 0 ? 1u : static_cast<uint32_t>(seal) + 1;
+        assert(m <= out.size() && "dequeue_message: output span too short");
+        if (m > out.size()) return 0;
+
+        /* remaining lines: invalidate all, one fence, then validate */
+        if (m > 1) {
+            for (uint32_t i = 1; i < m; ++i)
+                Load::invalidate(&ring_[(tail_ + i) & mask_]);
+            _mm_sfence();
+
+            for (uint32_t i = 1; i < m; ++i) {
+                const uint32_t t = tail_ + i;
+                Load::load(&out[i], &ring_[t & mask_]);
+                if (out[i].meta.f.epoch != static_cast<uint8_t>((t >> order_) + 1) ||
+                    out[i].meta.f.seal_index != static_cast<int16_t>(m - 1 - i) ||
+                    !Check::verify(out[i]))
+                {
+                    ++metrics.message_incomplete;
+                    backoff_checksum_.pause(metrics.consumer_backoff_events,
+                                            metrics.consumer_backoff_cycles_waited);
+                    return 0;
+                }
+            }
+        }
+
+        backoff_empty.reset();
+        backoff_checksum_.reset();
+        advance_tail(m, debug);
+
+        ++metrics.messages_dequeued;
+        return m;
+    }
+
+    // ────────────────────────────────────────────────────────────────
+    //  reserve / commit — build the entry directly in its ring slot
+    //  reserve() claims a slot and returns a handle into the ring (empty
+    //  handle + producer back-off if full).  Fill args / rpc fields with
+    //  regular stores, then commit(): it writes epoch + checksum as one
+    //  8-B meta store and sends the line out through the queue's Store
+    //  policy (clwb, NT store, movdir64b, … – slot as its own source),
+    //  then sfence.  No staging Entry; the producer is the only writer
+    //  of ring slots.
+    // ────────────────────────────────────────────────────────────────
+    SlotReservation reserve()
+    {
+
+        ++metrics.enqueue_calls;
+        tick_stats(StatsRole::producer);
+
+        uint32_t slot;
+        if (claim(1, slot) == 0) {
+            backoff_full_.pause(metrics.producer_backoff_events,
+                                metrics.producer_backoff_cycles_waited);
+            return {};
+        }
+        backoff_full_.reset();
+        return {&ring_[slot & mask_], slot};
+    }
+
+    void commit(const SlotReservation& r) noexcept
+    {
+        assert(r && "commit() of an empty reservation");
+        Entry& e = *r.entry;
+
+        /* checksum over payload + final meta, computed before the meta is
+         * published so the new epoch never appears without its checksum */
+        Entry::Meta m = e.meta;
+        m.f.epoch    = static_cast<uint8_t>(r.slot >> order_) + 1;
+        if constexpr (Check::enabled) {
+            m.f.checksum = 0;
+            m.f.checksum = Check::sum(e, m.raw);
+        }
+
+        e.meta.raw = m.raw;
+        Store::store(&e, &e);
+        _mm_sfence();
+        ring_doorbell(r.slot);
+    }
+
+    // ────────────────────────────────────────────────────────────────
+    //  peek / release — read the head entry in place
+    //  peek() invalidates the slot, validates epoch + checksum and returns
+    //  a pointer into the ring (nullptr + consumer back-off if not ready).
+    //  The pointer stays valid until release(), which advances tail_ and
+    //  applies the usual flush_tail rate limiting.
+    // ────────────────────────────────────────────────────────────────
+    const Entry* peek(bool debug = false)
+    {
+        ++metrics.dequeue_calls;
+        tick_stats(StatsRole::consumer);
+
+        Entry* line = &ring_[tail_ & mask_];
+        Load::invalidate(line);
+        _mm_sfence(); // complete the eviction, next access reads CXL
+
+        /* epoch mismatch → nothing new yet */
+        if (line->meta.f.epoch != expected_epoch_consumer) {
+            ++metrics.no_new_items;
+            on_empty_poll(debug);
+            backoff_empty.pause(metrics.consumer_backoff_events,
+                                metrics.consumer_backoff_cycles_waited,
+                                &ring_[tail_ & mask_]);
+            return nullptr;
+        }
+
+        /* checksum mismatch */
+        if (!Check::verify(*line)) {
+            ++metrics.checksum_failed;
+            backoff_checksum_.pause(metrics.consumer_backoff_events,
+                                    metrics.consumer_backoff_cycles_waited);
+            return nullptr;
+        }
+
+        backoff_empty.reset();
+        backoff_checksum_.reset();
+        return line;
+    }
+
+    void release(bool debug = false)
+    {
+        advance_tail(1, debug);
+    }
+
     // ────────────────────────────────────────────────────────────────
     //  read-only access to metrics
     // ────────────────────────────────────────────────────────────────
@@ -365,21 +1541,300 @@ public:
                            std::ostream&      os = std::cout) const
     {
         os << "── Metrics [" << label << "] ─────────────────────\n"
+           << "Line store/load/check   : " << Store::name << " / " << Load::name
+                                           << " / " << Check::name << '\n'
            << "Enqueue calls           : " << metrics.enqueue_calls    << '\n'
            << "Dequeue calls           : " << metrics.dequeue_calls    << '\n'
+           << "Batched enqueued items  : " << metrics.enqueue_batch_items << '\n'
+           << "Batched dequeued items  : " << metrics.dequeue_batch_items << '\n'
            << "CXL-tail reads (P)      : " << metrics.read_cxl_tail    << '\n'
            << "Queue-full events (P)   : " << metrics.queue_full       << '\n'
+           << "Claim retries (P)       : " << metrics.claim_retries    << '\n'
+           << "Messages enqueued (P)   : " << metrics.messages_enqueued << '\n'
+           << "Messages dequeued (C)   : " << metrics.messages_dequeued << '\n'
+           << "Small msgs / lines (P)  : " << metrics.small_enqueued << " / "
+                                           << metrics.small_lines << '\n'
+           << "Small msgs (C)          : " << metrics.small_dequeued << '\n'
+           << "Incomplete messages (C) : " << metrics.message_incomplete << '\n'
+           << "Lookahead hits (C)      : " << metrics.lookahead_hits   << '\n'
+           << "Lookahead misses (C)    : " << metrics.lookahead_misses << '\n'
            << "No-new-item polls (C)   : " << metrics.no_new_items     << '\n'
            << "Checksum failures (C)   : " << metrics.checksum_failed  << '\n'
            << "Tail flushes (C)        : " << metrics.flush_tail       << '\n'
+           << "  interval / idle / dem : " << metrics.flush_tail_interval << " / "
+                                           << metrics.flush_tail_idle     << " / "
+                                           << metrics.flush_tail_demand   << '\n'
+           << "  demand probes (C)     : " << metrics.tail_demand_probes << '\n'
+           << "  flush interval (C)    : " << flush_interval_
+           << (tail_policy_.mode == TailPolicy::Mode::adaptive  ? " (adaptive)\n"  :
+               tail_policy_.mode == TailPolicy::Mode::piggyback ? " (piggyback)\n" : " (fixed)\n")
+           << "Tail requests (P)       : " << metrics.tail_requests    << '\n'
+           << "Tail credits in-band (P): " << metrics.tail_credits     << '\n'
+           << "Doorbells rung (P)      : " << metrics.doorbells_rung   << '\n'
            << "── Back-off ──────────────────────────\n"
            << "Producer Events         : " << metrics.producer_backoff_events << '\n'
            << "Producer Cycles Waited  : " << metrics.producer_backoff_cycles_waited << '\n'
            << "Consumer Events         : " << metrics.consumer_backoff_events << '\n'
-           << "Consumer Cycles Waited  : " << metrics.consumer_backoff_cycles_waited << '\n';
+           << "Consumer Cycles Waited  : " << metrics.consumer_backoff_cycles_waited << '\n'
+           << "Producer schedule       : " << backoff_schedule(backoff_full_) << '\n'
+           << "Consumer schedule       : " << backoff_schedule(backoff_empty) << '\n'
+           << "Consumer wait policy    : " << to_string(backoff_empty.policy())
+           << (has_waitpkg() ? "" : " (no WAITPKG → pause)") << '\n'
+           << "  spin/tpause/umwait    : "
+           << backoff_empty.rung_steps[ExponentialBackoff::rung_spin]   << " / "
+           << backoff_empty.rung_steps[ExponentialBackoff::rung_tpause] << " / "
+           << backoff_empty.rung_steps[ExponentialBackoff::rung_umwait] << '\n'
+           << "  yield/sleep           : "
+           << backoff_empty.rung_steps[ExponentialBackoff::rung_yield]  << " / "
+           << backoff_empty.rung_steps[ExponentialBackoff::rung_sleep]  << '\n';
     }
 
 private:
+    // "min / max ×growth", plus the tuning state when adaptive.
+    static std::string backoff_schedule(const ExponentialBackoff& b)
+    {
+        std::ostringstream s;
+        s << b.min_wait() << " / " << b.max_wait() << " x" << b.growth();
+        if (b.adaptive())
+            s << " (adaptive, gap " << b.gap_estimate() << ", "
+              << b.poll_success_pct() << "% polls hit, " << b.retunes() << " retunes)";
+        else
+            s << " (fixed)";
+        return s.str();
+    }
+
+    // One call of `role`'s side: count it, publish every mask+1 calls.
+    inline void tick_stats(StatsRole role) noexcept
+    {
+        StatsExport& x = stats_[static_cast<int>(role)];
+        if (x.line == nullptr) [[likely]] return;
+        if ((++x.calls & x.mask) == 0) publish_stats(role);
+    }
+
+    // ────────────────────────────────────────────────────────────────
+    //  claim – reserve up to `want` consecutive slots for this producer
+    //  Returns how many were claimed (starting at `first`); fewer than
+    //  `want` only if the ring is short on space even after a fresh read
+    //  of the CXL tail, 0 (queue_full) if fewer than `at_least` are free.
+    //  CAS losers retry with the updated head.
+    // ────────────────────────────────────────────────────────────────
+    inline uint32_t claim(uint32_t want, uint32_t& first,
+                          uint32_t at_least = 1) noexcept
+    {
+        const int32_t cap = static_cast<int32_t>(capacity());
+        bool refreshed = false;
+
+        first = group_->head.load(std::memory_order_relaxed);
+        for (;;) {
+            const uint32_t tail = group_->shadow_tail.load(std::memory_order_relaxed);
+            int32_t free_slots  = cap - static_cast<int32_t>(first - tail);
+
+            /* fast check: ring looks too full? refresh tail from CXL once */
+            if (free_slots < static_cast<int32_t>(want) && !refreshed) {
+                ++metrics.read_cxl_tail;
+                refresh_shadow_tail();
+                refreshed = true;
+                continue;
+            }
+
+            /* still full after refresh → ask for the tail, give up */
+            if (free_slots < static_cast<int32_t>(at_least)) {
+                ++metrics.queue_full;
+                if (!tail_requested_) request_tail();
+                return 0;
+            }
+            tail_requested_ = false;
+
+            const uint32_t n = std::min(want, static_cast<uint32_t>(free_slots));
+            if (group_->head.compare_exchange_weak(first, first + n,
+                                                   std::memory_order_relaxed))
+                return n;
+            ++metrics.claim_retries;
+        }
+    }
+
+    // ────────────────────────────────────────────────────────────────
+    //  load_fresh – invalidate one line, fence, read it from CXL
+    // ────────────────────────────────────────────────────────────────
+    static inline void load_fresh(Entry* dst, const Entry* line) noexcept
+    {
+        Load::invalidate(line);
+        _mm_sfence();
+        Load::load(dst, line);
+    }
+
+    // ────────────────────────────────────────────────────────────────
+    //  seal – stamp epoch of `slot` and the line check into `e`
+    // ────────────────────────────────────────────────────────────────
+    inline uint8_t epoch_of(uint32_t slot) const noexcept
+    {
+        return static_cast<uint8_t>(slot >> order_) + 1;
+    }
+
+    inline void seal(Entry& e, uint32_t slot) const noexcept
+    {
+        e.meta.f.epoch = epoch_of(slot);
+        Check::stamp(e);
+    }
+
+    // ────────────────────────────────────────────────────────────────
+    //  refresh_shadow_tail – read tail from CXL, keep the group's copy
+    //  monotonic (another producer may have seen a newer value)
+    // ────────────────────────────────────────────────────────────────
+    inline uint32_t refresh_shadow_tail() noexcept
+    {
+        const uint32_t fresh = static_cast<uint32_t>(load_fresh_u64(cxl_tail_));
+        uint32_t cur = fresh;
+        advance_shadow_tail(cur);
+        return cur;
+    }
+
+    // ────────────────────────────────────────────────────────────────
+    //  advance_shadow_tail – raise the group's copy to `t` unless it is
+    //  already newer; leaves the resulting value in `t`
+    // ────────────────────────────────────────────────────────────────
+    inline bool advance_shadow_tail(uint32_t& t) noexcept
+    {
+        const uint32_t fresh = t;
+        t = group_->shadow_tail.load(std::memory_order_relaxed);
+        while (static_cast<int32_t>(fresh - t) > 0) {
+            if (group_->shadow_tail.compare_exchange_weak(
+                    t, fresh, std::memory_order_relaxed)) {
+                t = fresh;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // ────────────────────────────────────────────────────────────────
+    //  ring_doorbell – after the publishing sfence: a 4-byte NT store
+    //  into the summary line, so it never becomes visible before the
+    //  entries it announces.  Every value is distinct (a slot number),
+    //  which lets the poller detect a change without any RMW on CXL.
+    // ────────────────────────────────────────────────────────────────
+    inline void ring_doorbell(uint32_t last_slot) noexcept
+    {
+        if (!doorbell_) return;
+        _mm_stream_si32(reinterpret_cast<int*>(doorbell_),
+                        static_cast<int>(last_slot + 1));
+        _mm_sfence();
+        ++metrics.doorbells_rung;
+    }
+
+    // ────────────────────────────────────────────────────────────────
+    //  request_tail – producer: the ring is full even after a fresh CXL
+    //  tail read; post one request per stall episode (word 1 of the line)
+    // ────────────────────────────────────────────────────────────────
+    inline void request_tail() noexcept
+    {
+        const uint64_t seq = group_->stall_seq.fetch_add(1, std::memory_order_relaxed) + 1;
+        store_nt_u64(cxl_tail_ + 1, seq);
+        tail_requested_ = true;
+        ++metrics.tail_requests;
+    }
+
+    // ────────────────────────────────────────────────────────────────
+    //  advance_tail – consume n slots; publish the tail to CXL once
+    //  `flush_interval_` items are unpublished (at most once per call)
+    // ────────────────────────────────────────────────────────────────
+    inline void advance_tail(uint32_t n, bool debug = false)
+    {
+        const uint32_t old_tail = tail_;
+        tail_ += n;
+        if ((old_tail >> order_) != (tail_ >> order_))
+            expected_epoch_consumer = static_cast<uint8_t>(tail_ >> order_) + 1;
+
+        /* piggyback: the response queue carries the tail, see on_empty_poll */
+        if (tail_policy_.mode == TailPolicy::Mode::piggyback) return;
+
+        const uint32_t pending = tail_ - published_tail_;
+        if (pending >= flush_interval_) {
+            ++metrics.flush_tail_interval;
+            flush_tail(debug);
+            /* a whole interval without demand → relax towards the max */
+            if (tail_policy_.mode == TailPolicy::Mode::adaptive && !demand_since_flush_)
+                flush_interval_ = std::min(flush_interval_ * 2, max_interval_);
+            demand_since_flush_ = false;
+            return;
+        }
+
+        /* adaptive: look at the producers' request word now and then */
+        if (tail_policy_.mode == TailPolicy::Mode::adaptive &&
+            tail_ - last_probe_tail_ >= std::max(1u, flush_interval_ / 4))
+        {
+            last_probe_tail_ = tail_;
+            ++metrics.tail_demand_probes;
+            const uint64_t seq = load_fresh_u64(cxl_tail_ + 1);
+            if (seq != seen_stall_seq_) {
+                seen_stall_seq_ = seq;
+                ++metrics.flush_tail_demand;
+                flush_tail(debug);
+                flush_interval_ = std::max(flush_interval_ / 2, min_interval_);
+                demand_since_flush_ = true;
+            }
+        }
+    }
+
+    // ────────────────────────────────────────────────────────────────
+    //  on_empty_poll – adaptive idle flush: nothing to consume, yet
+    //  items are unpublished and the last publish is `idle_cycles` old
+    // ────────────────────────────────────────────────────────────────
+    inline void on_empty_poll(bool debug = false)
+    {
+        if (tail_policy_.mode == TailPolicy::Mode::piggyback) {
+            probe_demand_idle(debug);
+            return;
+        }
+        if (tail_policy_.mode != TailPolicy::Mode::adaptive ||
+            tail_ == published_tail_)
+            return;
+        if (__rdtsc() - last_publish_tsc_ < tail_policy_.idle_cycles)
+            return;
+        ++metrics.flush_tail_idle;
+        flush_tail(debug);
+    }
+
+    // ────────────────────────────────────────────────────────────────
+    //  probe_demand_idle – piggyback: a producer that ran out of in-band
+    //  credits (or never gets any) posts a stall request; look for it
+    //  while idle, at most once per `idle_cycles`
+    // ────────────────────────────────────────────────────────────────
+    inline void probe_demand_idle(bool debug = false)
+    {
+        if (tail_ == published_tail_) return;
+        const uint64_t now = __rdtsc();
+        if (now - last_probe_tsc_ < tail_policy_.idle_cycles) return;
+        last_probe_tsc_ = now;
+
+        ++metrics.tail_demand_probes;
+        const uint64_t seq = load_fresh_u64(cxl_tail_ + 1);
+        if (seq == seen_stall_seq_) return;
+        seen_stall_seq_ = seq;
+        ++metrics.flush_tail_demand;
+        flush_tail(debug);
+    }
+
+    // ────────────────────────────────────────────────────────────────
+    //  prefetch_slot – drop our copy of a future slot, then start a
+    //  non-blocking load of it (the fence keeps the prefetch behind the
+    //  eviction, but unlike load_fresh() nothing waits for the data)
+    // ────────────────────────────────────────────────────────────────
+    inline void prefetch_slot(uint32_t t) noexcept
+    {
+        Entry* line = &ring_[t & mask_];
+        Load::invalidate(line);
+        _mm_sfence();
+        _mm_prefetch(reinterpret_cast<const char*>(line), _MM_HINT_T0);
+    }
+
+    // Put the whole lookahead window, from tail_, in flight.
+    inline void arm_lookahead() noexcept
+    {
+        for (uint32_t i = 0; i < lookahead_; ++i)
+            prefetch_slot(tail_ + i);
+    }
+
     // ────────────────────────────────────────────────────────────────
     //  flush_tail – write tail to CXL & count
     // ────────────────────────────────────────────────────────────────
@@ -387,6 +1842,9 @@ private:
     {
         store_nt_u64(cxl_tail_, tail_);
         ++metrics.flush_tail;
+        published_tail_ = tail_;
+        if (tail_policy_.mode == TailPolicy::Mode::adaptive)
+            last_publish_tsc_ = __rdtsc();
 
         // if (debug)
         //     std::osyncstream(std::cout)
@@ -397,14 +1855,191 @@ private:
     Entry* const              ring_;
     const uint32_t            order_;
     const uint32_t            mask_;
-    alignas(64) uint32_t     head_;
-    uint32_t                  shadow_tail_;
+
+    /* producer side: claim state (own_group_ unless a group is shared) */
+    ProducerGroup             own_group_;
+    ProducerGroup* const      group_;
+    bool                      tail_requested_ {false};
+    uint32_t*                 doorbell_       {nullptr};
+
+    /* producer side: pack line for enqueue_small() */
+    static constexpr std::size_t k_small_batch = 16;
+    alignas(64) Entry         pack_           {};
+    uint32_t                  pack_words_     {0};
+    uint32_t                  pack_count_     {0};
+    uint32_t                  pack_ends_      {0};
+    uint64_t                  pack_since_tsc_ {0};
+    uint64_t                  pack_deadline_  {2'000};   // TSC ticks
     
     alignas(64) uint32_t                  tail_;
     uint8_t                   expected_epoch_consumer;
+    uint32_t                  lookahead_ {0};
+    bool                      batch_torn_ {false};   // last dequeue_batch hit a torn line
+
+    /* consumer side: tail publication */
+    TailPolicy                tail_policy_;
+    uint32_t                  published_tail_     {0};
+    uint32_t                  flush_interval_     {1};
+    uint32_t                  min_interval_       {1};
+    uint32_t                  max_interval_       {1};
+    uint32_t                  last_probe_tail_    {0};
+    uint64_t                  seen_stall_seq_     {0};
+    uint64_t                  last_publish_tsc_   {0};
+    uint64_t                  last_probe_tsc_     {0};
+    bool                      demand_since_flush_ {false};
     alignas(64) uint64_t* const           cxl_tail_;
 
     /* metrics block ------------------------------------------------- */
     alignas(64) Metrics                   metrics;
     ExponentialBackoff backoff_empty;
-};
\ No newline at end of file
+    ExponentialBackoff backoff_full_     {128};   // producer: ring full
+    ExponentialBackoff backoff_checksum_ {100};   // consumer: torn slot, re-read
+
+    /* live stats export (per side, written only by that side) -------- */
+    struct StatsExport {
+        QueueStatsLine* line  {nullptr};
+        uint64_t        mask  {0};
+        uint64_t        calls {0};
+        uint64_t        seq   {0};
+    };
+    alignas(64) StatsExport               stats_[2] {};
+};
+
+using CxlMpscQueue = BasicCxlMpscQueue<>;
+
+// ─────────────────────────────────────────────────────────────────────────────
+//  Start-up variant selection
+//  detect_queue_variant() reads CPUID once: MOVDIR64B stores when the core
+//  has them (64-B atomic, no WC-buffer merging), NT stores otherwise;
+//  CLFLUSHOPT invalidation when available, CLFLUSH otherwise.  The line
+//  check stays XOR – dropping it (none) or strengthening it (crc32c) is a
+//  deployment choice, not a CPU feature.
+//  with_queue_variant(v, fn) calls fn(std::type_identity<Q>{}) with the
+//  matching BasicCxlMpscQueue, so everything below fn is compiled per
+//  variant and the hot path has no policy branches:
+//
+//   with_queue_variant(detect_queue_variant(), [&](auto tag) {
+//       using Queue = typename decltype(tag)::type;
+//       Queue q(ring, order, tail);
+//       run(q);
+//   });
+// ─────────────────────────────────────────────────────────────────────────────
+
+enum class StoreKind : uint8_t { nt, movdir64b, clwb, clflushopt };
+enum class LoadKind  : uint8_t { clflushopt, clflush };
+enum class CheckKind : uint8_t { xor16, crc32c, none };
+
+struct QueueVariant {
+    StoreKind store = StoreKind::nt;
+    LoadKind  load  = LoadKind::clflushopt;
+    CheckKind check = CheckKind::xor16;
+};
+
+inline std::string_view to_string(StoreKind k) noexcept
+{
+    switch (k) {
+    case StoreKind::nt:         return NtStore::name;
+    case StoreKind::movdir64b:  return "movdir64b";
+    case StoreKind::clwb:       return ClwbStore::name;
+    case StoreKind::clflushopt: return ClflushoptStore::name;
+    }
+    return "?";
+}
+
+inline std::string_view to_string(LoadKind k) noexcept
+{
+    return k == LoadKind::clflush ? ClflushLoad::name : FlushLoad::name;
+}
+
+inline std::string_view to_string(CheckKind k) noexcept
+{
+    switch (k) {
+    case CheckKind::xor16:  return XorCheck::name;
+    case CheckKind::crc32c: return Crc32cCheck::name;
+    case CheckKind::none:   return NoCheck::name;
+    }
+    return "?";
+}
+
+inline std::ostream& operator<<(std::ostream& os, const QueueVariant& v)
+{
+    return os << to_string(v.store) << '+' << to_string(v.load) << '+' << to_string(v.check);
+}
+
+// "<store>+<load>[+<check>]", e.g. "movdir64b+clflushopt+none"; nullopt if
+// unknown, or if the check is "none" without MOVDIR64B stores
+inline std::optional<QueueVariant> parse_queue_variant(std::string_view s) noexcept
+{
+    const auto p1 = s.find('+');
+    if (p1 == std::string_view::npos) return std::nullopt;
+    const auto p2 = s.find('+', p1 + 1);
+    const std::string_view st = s.substr(0, p1);
+    const std::string_view ld = s.substr(p1 + 1, p2 == std::string_view::npos ? p2 : p2 - p1 - 1);
+    const std::string_view ck = p2 == std::string_view::npos ? "xor16" : s.substr(p2 + 1);
+
+    QueueVariant v;
+    if      (st == "nt")         v.store = StoreKind::nt;
+    else if (st == "movdir64b")  v.store = StoreKind::movdir64b;
+    else if (st == "clwb")       v.store = StoreKind::clwb;
+    else if (st == "clflushopt") v.store = StoreKind::clflushopt;
+    else return std::nullopt;
+    if      (ld == "clflushopt") v.load = LoadKind::clflushopt;
+    else if (ld == "clflush")    v.load = LoadKind::clflush;
+    else return std::nullopt;
+    if      (ck == "xor16")      v.check = CheckKind::xor16;
+    else if (ck == "crc32c")     v.check = CheckKind::crc32c;
+    else if (ck == "none" && v.store == StoreKind::movdir64b) v.check = CheckKind::none;
+    else return std::nullopt;
+    return v;
+}
+
+inline QueueVariant detect_queue_variant() noexcept
+{
+    unsigned a = 0, b = 0, c = 0, d = 0;
+    const bool leaf7 = __get_cpuid_count(7, 0, &a, &b, &c, &d);
+    QueueVariant v;
+#ifdef __MOVDIR64B__
+    if (leaf7 && (c & (1u << 28))) v.store = StoreKind::movdir64b;
+#endif
+    if (!leaf7 || !(b & (1u << 23))) v.load = LoadKind::clflush;
+    return v;
+}
+
+namespace detail {
+template <class Store, class Load, class Fn>
+decltype(auto) with_check_policy(CheckKind k, Fn&& fn)
+{
+    if constexpr (Store::atomic_64B)
+        if (k == CheckKind::none)
+            return fn(std::type_identity<BasicCxlMpscQueue<Store, Load, NoCheck>>{});
+    if (k == CheckKind::crc32c)
+        return fn(std::type_identity<BasicCxlMpscQueue<Store, Load, Crc32cCheck>>{});
+    return fn(std::type_identity<BasicCxlMpscQueue<Store, Load, XorCheck>>{});
+}
+
+template <class Store, class Fn>
+decltype(auto) with_load_policy(const QueueVariant& v, Fn&& fn)
+{
+    if (v.load == LoadKind::clflush)
+        return with_check_policy<Store, ClflushLoad>(v.check, fn);
+    return with_check_policy<Store, FlushLoad>(v.check, fn);
+}
+} // namespace detail
+
+// All variants must return the same type from fn.  A MOVDIR64B variant on a
+// build without -mmovdir64b falls back to NT stores; check "none" with a
+// store that is not 64-B atomic falls back to XOR.
+template <class Fn>
+decltype(auto) with_queue_variant(QueueVariant v, Fn&& fn)
+{
+    switch (v.store) {
+#ifdef __MOVDIR64B__
+    case StoreKind::movdir64b:  return detail::with_load_policy<MovDir64BStore>(v, fn);
+#endif
+    case StoreKind::clwb:       return detail::with_load_policy<ClwbStore>(v, fn);
+    case StoreKind::clflushopt: return detail::with_load_policy<ClflushoptStore>(v, fn);
+    default:                    return detail::with_load_policy<NtStore>(v, fn);
+    }
+}
+
+#endif // CXL_MPSC_QUEUE_EXP_HPP_
@@ -4,22 +4,39 @@
 //  • Two-field payload (args[0], args[1])
 //  • rpc_id populated and echoed back
 //  • Verbose logs: client/server send-/receive events each iteration
+//  • Optional RPC window sweep (cxl_rpc.hpp): 1, 2, 4 … max_window calls
+//    in flight → throughput vs. latency per window depth
+//  • Optional prefault: all pages faulted (2 MiB pages if available) before
+//    the timed loop; the page faults taken inside the loop are reported
+//  • Optional latency: RTT and per-direction one-way percentiles from TSC
+//    stamps in the entries (client and server share one TSC, no offset)
+//  • Optional piggyback: the server sends the request queue's tail back in
+//    every response (args[k_rpc_credit_arg]) instead of flushing it to CXL;
+//    the client never reads the CXL tail (cxl_rpc.hpp, TailPolicy)
+//  • Placement: `pin auto` puts client and server on the two cores nearest
+//    the queue memory (cxl_topology.hpp); with `pin <cpu_id>` the server
+//    takes the nearest core that is not an SMT sibling of the client
 // ─────────────────────────────────────────────────────────────────────────────
 //  Build:
 //      g++ -std=c++20 -O3 -march=native -pthread -lnuma \
 //          cxl_ping_pong.cpp -o cxl_ping_pong
 //
 //  Usage:
-//      ./cxl_ping_pong pin <cpu_id> numa <node_id> [iter_count]
-//      ./cxl_ping_pong pin <cpu_id> dax            [iter_count]
+//      ./cxl_ping_pong pin <cpu_id|auto> numa <node_id> [iter_count] <min> <max> [rpc <max_window>] [prefault] [latency] [piggyback]
+//      ./cxl_ping_pong pin <cpu_id|auto> dax            [iter_count] <min> <max> [rpc <max_window>] [prefault] [latency] [piggyback]
 //
-//      cpu_id      – logical CPU the *client* thread is pinned to
+//      cpu_id      – logical CPU the *client* thread is pinned to, or auto
 //      node_id     – NUMA node from which DRAM is allocated
 //      iter_count  – ping-pong iterations (default 1'000'000)
+//      min, max    – back-off limits in cycles
+//      max_window  – run the RPC sweep up to this many calls in flight
 // ─────────────────────────────────────────────────────────────────────────────
 
 #include "cxl_mpsc_queue_exp.hpp"
 #include "cxl_allocator.hpp"
+#include "cxl_rpc.hpp"
+#include "cxl_latency.hpp"
+#include "cxl_topology.hpp"
 #include <iomanip>
 #include <pthread.h>
 #include <cstring>
@@ -30,32 +47,116 @@
 
 static void pin_to_cpu(unsigned cpu)
 {
-    cpu_set_t set; CPU_ZERO(&set); CPU_SET(cpu, &set);
-    if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0)
-        perror("pthread_setaffinity_np");
+    if (!cxl::pin_thread(cpu)) perror("pthread_setaffinity_np");
 }
 
 // ─── helper: CLI usage ──────────────────────────────────────────────────────
 static void print_usage(const char* prog)
 {
     std::cerr << "Usage:\n"
-              << "  " << prog << " pin <cpu_id> numa <node_id> [iter_count]\n"
-              << "  " << prog << " pin <cpu_id> dax            [iter_count]\n"
+              << "  " << prog << " pin <cpu_id|auto> numa <node_id> [iter_count] <min> <max> [rpc <max_window>] [prefault] [latency] [piggyback]\n"
+              << "  " << prog << " pin <cpu_id|auto> dax            [iter_count] <min> <max> [rpc <max_window>] [prefault] [latency] [piggyback]\n"
               << "    iter_count defaults to 1'000'000 (1M)\n";
 }
 
 constexpr uint32_t ORDER = 14;           // 16 Ki-entry ring (capacity = 16384)
 using Steady = std::chrono::steady_clock;
 
+// ─── RPC window sweep ───────────────────────────────────────────────────────
+//  One run per window depth: the client keeps up to `window` calls in
+//  flight, the server thread echoes args[0] + 1.  Reports throughput and
+//  mean / max call latency (TSC converted with the run's own clock ratio).
+struct RpcRun {
+    uint32_t window;
+    double   mops;
+    double   avg_ns;
+    double   max_ns;
+    size_t   errors;
+};
+
+static RpcRun run_rpc(CxlMpscQueue& q_req, CxlMpscQueue& q_rsp,
+                      unsigned client_cpu, unsigned server_cpu, uint32_t window,
+                      size_t iters, bool piggyback)
+{
+    constexpr uint8_t k_echo = 1;
+    std::atomic<bool> ready{false};
+
+    std::thread server([&]{
+        pin_to_cpu(server_cpu);
+        RpcServer srv(q_req, q_rsp);
+        srv.set_tail_piggyback(piggyback);
+        srv.register_handler(k_echo, [](const Entry& in, Entry& out) {
+            out.args[0] = in.args[0] + 1;
+        });
+        ready.store(true, std::memory_order_release);
+        for (size_t served = 0; served < iters; )
+            served += srv.poll();
+    });
+    while (!ready.load(std::memory_order_acquire)) std::this_thread::yield();
+    pin_to_cpu(client_cpu);
+
+    RpcClient cli(q_req, q_rsp, window);
+    cli.set_tail_piggyback(piggyback);
+    size_t errors = 0;
+    auto on_done = [&](const RpcCompletion& c) {
+        if (c.error || c.rsp.args[0] != c.cookie + 1) ++errors;
+    };
+
+    const auto     t0 = Steady::now();
+    const uint64_t c0 = __rdtsc();
+    for (size_t i = 0; i < iters; ) {
+        const uint64_t arg = i;
+        if (cli.call(k_echo, {&arg, 1}, arg)) ++i;
+        else                                  cli.poll(on_done);
+    }
+    cli.drain(on_done);
+    const uint64_t c1 = __rdtsc();
+    const auto     t1 = Steady::now();
+    server.join();
+
+    const double ns      = std::chrono::duration<double, std::nano>(t1 - t0).count();
+    const double cyc_ns  = static_cast<double>(c1 - c0) / ns;
+    const auto&  m       = cli.get_metrics();
+    return RpcRun{window,
+                  static_cast<double>(iters) / ns * 1e3,
+                  static_cast<double>(m.latency_cycles_sum) / m.responses / cyc_ns,
+                  static_cast<double>(m.latency_cycles_max) / cyc_ns,
+                  errors + m.unknown_responses};
+}
+
 int main(int argc, char* argv[])
 {
     // ───── parse arguments ────────────────────────────────────────────────
     //  Required layout (iters is optional, min/max are *always* last):
     //
-    //    pin <cpu> dax                     [iters] <min_backoff> <max_backoff>
-    //    pin <cpu> numa <node>             [iters] <min_backoff> <max_backoff>
+    //    pin <cpu|auto> dax                [iters] <min_backoff> <max_backoff>
+    //    pin <cpu|auto> numa <node>        [iters] <min_backoff> <max_backoff>
     //
 
+    // Optional trailing “prefault” / “latency” / “piggyback” flags, then “rpc
+    // <max_window>” – strip them before the rest.
+    cxl::MapOptions map_opts;
+    bool latency   = false;
+    bool piggyback = false;
+    for (; argc >= 7; --argc) {
+        const std::string_view flag = argv[argc - 1];
+        if (flag == "prefault") {
+            map_opts.prefault = true;
+            map_opts.page     = cxl::PageSize::huge_2m;
+        } else if (flag == "latency") {
+            latency = true;
+        } else if (flag == "piggyback") {
+            piggyback = true;
+        } else {
+            break;
+        }
+    }
+    uint32_t rpc_max_window = 0;
+    if (argc >= 8 && std::string_view(argv[argc - 2]) == "rpc") {
+        rpc_max_window = static_cast<uint32_t>(std::stoul(argv[argc - 1]));
+        argc -= 2;
+    }
+
     if (argc < 6) {         // smallest valid form is “pin cpu dax min max”
         print_usage(argv[0]);
         return 1;
@@ -65,7 +166,8 @@ int main(int argc, char* argv[])
         print_usage(argv[0]);
         return 1;
     }
-    const unsigned client_cpu = std::stoul(argv[2]);
+    const bool auto_pin = std::string_view(argv[2]) == "auto";
+    unsigned   client_cpu = auto_pin ? 0 : std::stoul(argv[2]);
 
     // Back-off parameters are *always* the final two arguments.
     const uint32_t min_backoff = static_cast<uint32_t>(std::stoul(argv[argc - 2]));
@@ -75,6 +177,7 @@ int main(int argc, char* argv[])
     size_t iters = 1'000'000;
 
     const std::string_view mem_kind = argv[3];
+    int mem_node = -1;
 
     if (mem_kind == "numa") {
         if (argc < 7) {         // need at least: pin cpu numa node min max
@@ -83,13 +186,15 @@ int main(int argc, char* argv[])
         }
 
         const int numa_node = std::stoi(argv[4]);
+        mem_node = numa_node;
 
         // iters, if present, is the argument immediately before min_backoff
         if (5 < argc - 2) {
             iters = std::stoull(argv[5]);
         }
 
-        alloc = std::make_unique<cxl::NumaAllocator>(numa_node);
+        alloc = std::make_unique<cxl::NumaAllocator>(numa_node, cxl::DaxAllocator::default_length,
+                                                     cxl::DebugLevel::low, map_opts);
         std::cout << "Allocator: NUMA node " << numa_node << '\n';
     } else if (mem_kind == "dax") {
         // iters is optional and precedes min_backoff if supplied.
@@ -97,16 +202,38 @@ int main(int argc, char* argv[])
             iters = std::stoull(argv[4]);
         }
 
-        alloc = std::make_unique<cxl::DaxAllocator>();  // default /dev/dax1.0
+        alloc = std::make_unique<cxl::DaxAllocator>(cxl::DaxAllocator::default_path,   // /dev/dax1.0
+                                                    cxl::DaxAllocator::default_offset,
+                                                    cxl::DaxAllocator::default_length,
+                                                    cxl::DebugLevel::low, map_opts);
+        mem_node = cxl::dax_numa_node(cxl::DaxAllocator::default_path);
         std::cout << "Allocator: DAX (/dev/dax1.0 slice)\n";
     } else {
         print_usage(argv[0]);
         return 1;
     }
 
+    // ───── placement: client first, server on the nearest other core ─────
+    const cxl::Topology topo = cxl::Topology::discover();
+    unsigned server_cpu;
+    if (auto_pin) {
+        const cxl::Placement plan = topo.place(mem_node, 2);
+        topo.print(std::cout);
+        plan.print(std::cout, {"client", "server"});
+        client_cpu = plan[0];
+        server_cpu = plan[1];
+    } else {
+        server_cpu = topo.partner_of(client_cpu, mem_node);
+    }
+
     std::cout << "Client pinned to CPU " << client_cpu << '\n';
+    std::cout << "Server pinned to CPU " << server_cpu
+              << (topo.smt_siblings(client_cpu, server_cpu) ? " (SMT sibling)" : "")
+              << (server_cpu == client_cpu ? " (shared)" : "") << '\n';
     std::cout << "Iterations           : " << iters << '\n';
     std::cout << "Back-off (min,max)   : " << min_backoff << ", " << max_backoff << " cycles\n";
+    std::cout << "Mapping              : " << alloc->map_info() << '\n';
+    std::cout << "Request tail         : " << (piggyback ? "piggybacked on responses" : "CXL tail line") << '\n';
 
     const size_t cap = 1u << ORDER;
 
@@ -122,19 +249,28 @@ int main(int argc, char* argv[])
     std::memset(rsp_tail, 0, 64);
 
     // ───── construct queues ──────────────────────────────────────────────
-    CxlMpscQueue q_req(req_ring, ORDER, req_tail, min_backoff, max_backoff);  // client → server
-    CxlMpscQueue q_rsp(rsp_ring, ORDER, rsp_tail, min_backoff, max_backoff);  // server → client
+    CxlMpscQueue q_req(req_ring, ORDER, req_tail, true, min_backoff, max_backoff);  // client → server
+    CxlMpscQueue q_rsp(rsp_ring, ORDER, rsp_tail, true, min_backoff, max_backoff);  // server → client
+    if (piggyback) {
+        TailPolicy pol = q_req.tail_policy();
+        pol.mode = TailPolicy::Mode::piggyback;
+        q_req.set_tail_policy(pol);
+    }
 
     std::atomic<bool> server_ready{false};
+    const double      tsc_per_ns = latency ? measure_tsc_per_ns() : 0.0;
+    LatencyHistogram  h_req, h_rsp, h_rtt;     // one-way ×2 and round trip
+    const TscOffset   same_host{};             // both threads read one TSC
 
     // ───── server thread ────────────────────────────────────────────────
-    std::thread server([&, client_cpu]{
-        pin_to_cpu((client_cpu + 1) % std::thread::hardware_concurrency());
+    std::thread server([&, server_cpu]{
+        pin_to_cpu(server_cpu);
         server_ready.store(true, std::memory_order_release);
 
         Entry req{}, rsp{};
         for (size_t i = 0; i < iters; ++i) {
             while (!q_req.dequeue(req)) { /* spin */ }
+            if (latency) h_req.record(one_way_cycles(req, same_host));
 
             // // (optional) validate
             // if (req.meta.f.rpc_id != static_cast<uint16_t>(i & 0xFFFF) ||
@@ -146,6 +282,8 @@ int main(int argc, char* argv[])
             // }
 
             rsp = req;                                // echo back
+            if (piggyback) rsp.args[k_rpc_credit_arg] = q_req.consumed_tail();
+            if (latency) stamp_tx(rsp);
             while (!q_rsp.enqueue(rsp)) { /* spin */ }
         }
     });
@@ -157,6 +295,7 @@ int main(int argc, char* argv[])
     pin_to_cpu(client_cpu);        // client thread
 
     Entry req{}, rsp{};
+    const uint64_t faults0 = cxl::page_faults();
     const auto t0 = Steady::now();
 
     for (size_t i = 0; i < iters; ++i) {
@@ -164,8 +303,16 @@ int main(int argc, char* argv[])
         req.meta.f.rpc_id      = static_cast<uint16_t>(i & 0xFFFF);
         req.meta.f.rpc_method  = 0;
 
+        if (latency) stamp_tx(req);
+        const uint64_t sent = req.args[k_ts_arg];
         while (!q_req.enqueue(req)) { /* spin */ }
         while (!q_rsp.dequeue(rsp)) { /* spin */ }
+        if (piggyback) q_req.note_consumer_tail(static_cast<uint32_t>(rsp.args[k_rpc_credit_arg]));
+        if (latency) {
+            const uint64_t now = __rdtsc();
+            h_rsp.record(one_way_cycles(rsp, same_host, now));
+            h_rtt.record(now - sent);
+        }
 
         // client-side validation
         // if (rsp.meta.f.rpc_id != req.meta.f.rpc_id ||
@@ -179,29 +326,57 @@ int main(int argc, char* argv[])
 
     const auto t1 = Steady::now();
     server.join();
+    const uint64_t loop_faults = cxl::page_faults() - faults0;
 
     // ───── results ──────────────────────────────────────────────────────
     const double total_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0).count();
     const double rtt_ns   = total_ns / static_cast<double>(iters);
 
+    // 0 when built with CXL_QUEUE_METRICS=0 – the per-access time is then 0 too
     const long total_memory_access = q_req.get_metrics().enqueue_calls +
                                       q_req.get_metrics().dequeue_calls +
                                       q_rsp.get_metrics().enqueue_calls +
                                       q_rsp.get_metrics().dequeue_calls;
 
     std::cout << "Memory accesses      : " << total_memory_access << '\n';
+    std::cout << "Page faults (loop)   : " << loop_faults << '\n';
 
     std::cout << std::fixed << std::setprecision(2);
     std::cout << "\nTotal elapsed (ms)   : " << total_ns / 1e6  << '\n'
               << "Round-trip latency/ns: " << rtt_ns           << '\n'
               << "One-way latency/ns   : " << rtt_ns / 2.0     << '\n'
-              << "Memory time/ns     : "  << total_ns / total_memory_access << '\n';
+              << "Memory time/ns     : "
+              << (total_memory_access ? total_ns / total_memory_access : 0.0) << '\n';
+
+    if (latency) {
+        std::cout << "\n[latency]\n";
+        h_rtt.print("round trip          ", std::cout, tsc_per_ns);
+        h_req.print("client → server     ", std::cout, tsc_per_ns);
+        h_rsp.print("server → client     ", std::cout, tsc_per_ns);
+    }
 
     std::cout << "\n[queue stats]\n";
     q_req.print_metrics("request");
     std::cout << '\n';
     q_rsp.print_metrics("response");
 
+    // ───── RPC window sweep (same queues, drained between runs) ─────────
+    if (rpc_max_window != 0) {
+        rpc_max_window = std::min(rpc_max_window, std::min<uint32_t>(cap, k_rpc_max_window));
+        std::cout << "\n[rpc window sweep]\n"
+                  << " window    Mops/s    avg-ns     max-ns   errors\n"
+                  << " ------  --------  --------  ---------  -------\n";
+        for (uint32_t w = 1; ; w = std::min(w * 2, rpc_max_window)) {
+            const RpcRun r = run_rpc(q_req, q_rsp, client_cpu, server_cpu, w, iters, piggyback);
+            std::cout << std::setw(7)  << r.window << "  "
+                      << std::setw(8)  << r.mops   << "  "
+                      << std::setw(8)  << r.avg_ns << "  "
+                      << std::setw(9)  << r.max_ns << "  "
+                      << std::setw(7)  << r.errors << '\n';
+            if (w == rpc_max_window) break;
+        }
+    }
+
     // No explicit free — allocator releases memory in its destructor
     return 0;
 }
@@ -0,0 +1,367 @@
+// cxl_pool_allocator.hpp
+// ─────────────────────────────────────────────────────────────────────────────
+//  Size-class pool allocator with deallocate() over any CxlAllocator
+//
+//   • 64-B … 1-MiB power-of-two size classes, carved in slabs from the
+//     upstream bump region → freed memory stays on the same DAX device /
+//     NUMA node and is reused for the same class
+//   • per-thread caches (host-local pointer stacks, no CXL traffic for
+//     bookkeeping); they refill from / spill to a per-class central list
+//   • larger requests go straight to upstream and are recycled by exact
+//     (4-KiB rounded) size
+//   • every block is aligned to min(class size, 4 KiB); allocate_aligned()
+//     with a larger alignment bypasses the classes
+//
+//  Sized free: deallocate(p, bytes[, alignment]) must get the size (and
+//  alignment) the block was allocated with – no per-block header, so
+//  64-B blocks are exactly one cache line.
+//
+//  Example
+//   cxl::DaxAllocator  dax;
+//   cxl::PoolAllocator pool(dax);
+//   void* p = pool.allocate_aligned(200);      // 256-B class
+//   pool.deallocate(p, 200);
+// ─────────────────────────────────────────────────────────────────────────────
+#ifndef CXL_POOL_ALLOCATOR_HPP_
+#define CXL_POOL_ALLOCATOR_HPP_
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "cxl_allocator.hpp"
+
+namespace cxl {
+
+struct PoolStats {
+    std::size_t upstream_bytes {0};   // taken from the bump region
+    std::size_t free_bytes     {0};   // in central lists + thread caches
+    std::size_t live_bytes     {0};   // handed out (class-rounded)
+    std::size_t allocs         {0};
+    std::size_t frees          {0};
+    std::size_t cache_hits     {0};   // served by a thread cache
+    std::size_t refills        {0};   // thread cache ← central
+    std::size_t spills         {0};   // thread cache → central
+    std::size_t slabs          {0};
+
+    // share of the upstream bytes not currently in use
+    [[nodiscard]] double fragmentation() const noexcept
+    {
+        return upstream_bytes ? 1.0 - double(live_bytes) / double(upstream_bytes) : 0.0;
+    }
+};
+
+class PoolAllocator : public CxlAllocator {
+public:
+    static constexpr std::size_t k_min_class   = 64;
+    static constexpr std::size_t k_max_class   = 1u << 20;                   // 1 MiB
+    static constexpr std::size_t k_num_classes = 15;                         // 64 B … 1 MiB
+    static constexpr std::size_t k_slab_bytes  = 64 * 1024;                  // per refill
+    static constexpr std::size_t k_max_align   = 4096;
+    static constexpr std::size_t k_cache_max   = 64;                         // blocks / class / thread
+    static constexpr std::size_t k_large_round = 4096;
+    static_assert(k_min_class << (k_num_classes - 1) == k_max_class);
+
+    explicit PoolAllocator(CxlAllocator& upstream, DebugLevel dbg = DebugLevel::low)
+        : shared_{std::make_shared<Shared>(upstream)}, debug_level_{dbg}
+    {
+        log(debug_level_, DebugLevel::low,
+            "pool allocator ok: " + std::to_string(k_num_classes) + " classes, upstream remaining=" +
+            std::to_string(upstream.remaining()));
+    }
+
+    PoolAllocator(const PoolAllocator&)            = delete;
+    PoolAllocator& operator=(const PoolAllocator&) = delete;
+
+    // ─── allocator API ────────────────────────────────────────────────────
+    void* allocate(std::size_t bytes) override { return allocate_aligned(bytes, 64); }
+
+    void* allocate_aligned(std::size_t bytes, std::size_t alignment = 64) override
+    {
+        const int c = class_of(bytes, alignment);
+        void* p = c < 0 ? allocate_large(bytes, alignment) : cache().pop(c);
+        log(debug_level_, DebugLevel::high,
+            "pool allocate(" + std::to_string(bytes) + ", align=" + std::to_string(alignment) +
+            ") → " + std::to_string(reinterpret_cast<std::uintptr_t>(p)));
+        return p;
+    }
+
+    void deallocate(void* p, std::size_t bytes, std::size_t alignment = 64) override
+    {
+        if (!p) return;
+        const int c = class_of(bytes, alignment);
+        if (c < 0) deallocate_large(p, bytes, alignment);
+        else       cache().push(c, p);
+    }
+
+    // used()      : bytes currently handed out
+    // remaining() : upstream remaining + bytes waiting for reuse
+    [[nodiscard]] std::size_t used() const noexcept override { return stats().live_bytes; }
+    [[nodiscard]] std::size_t remaining() const noexcept override
+    {
+        return shared_->upstream.remaining() + stats().free_bytes;
+    }
+    [[nodiscard]] std::size_t capacity() const noexcept override { return shared_->upstream.capacity(); }
+
+    bool test_memory() override { return shared_->upstream.test_memory(); }
+    void set_debug(DebugLevel lvl) noexcept override { debug_level_ = lvl; }
+
+    // Return this thread's cached blocks to the central lists.
+    void flush_thread_cache() { cache().spill_all(); }
+
+    [[nodiscard]] PoolStats stats() const
+    {
+        Shared& s = *shared_;
+        std::lock_guard lk(s.registry_mtx);
+        PoolStats st = s.retired;
+        for (ThreadCache* tc : s.caches) tc->add_to(st);
+        {
+            std::lock_guard ul(s.upstream_mtx);
+            st.upstream_bytes = s.upstream_bytes;
+            st.slabs          = s.slabs;
+        }
+        for (std::size_t c = 0; c < k_num_classes; ++c) {
+            std::lock_guard cl(s.central[c].mtx);
+            st.free_bytes += s.central[c].blocks.size() * class_size(c);
+        }
+        {
+            std::lock_guard ll(s.large_mtx);
+            for (const auto& [sz, v] : s.large) st.free_bytes += sz * v.size();
+            st.allocs     += s.large_allocs;
+            st.frees      += s.large_frees;
+            st.live_bytes += s.large_live;
+        }
+        return st;
+    }
+
+    static void print_stats(const PoolStats& st, std::ostream& os)
+    {
+        os << "upstream=" << st.upstream_bytes << " live=" << st.live_bytes
+           << " free=" << st.free_bytes << " frag=" << st.fragmentation()
+           << " allocs=" << st.allocs << " frees=" << st.frees
+           << " cache_hits=" << st.cache_hits << " refills=" << st.refills
+           << " spills=" << st.spills << " slabs=" << st.slabs << '\n';
+    }
+
+    static constexpr std::size_t class_size(std::size_t c) noexcept { return k_min_class << c; }
+
+    // size class for (bytes, alignment), -1 → large path
+    static constexpr int class_of(std::size_t bytes, std::size_t alignment) noexcept
+    {
+        if (alignment > k_max_align) return -1;
+        const std::size_t need = std::max({bytes, alignment, k_min_class});
+        if (need > k_max_class) return -1;
+        return std::countr_zero(std::bit_ceil(need)) - std::countr_zero(k_min_class);
+    }
+
+private:
+    struct Central {
+        std::mutex          mtx;
+        std::vector<void*>  blocks;
+    };
+
+    struct ThreadCache;
+
+    struct Shared {
+        explicit Shared(CxlAllocator& up) : upstream(up) {}
+
+        CxlAllocator&                       upstream;
+        std::array<Central, k_num_classes>  central;
+
+        mutable std::mutex                  upstream_mtx;
+        std::size_t                         upstream_bytes {0};
+        std::size_t                         slabs          {0};
+
+        mutable std::mutex                  large_mtx;
+        std::map<std::size_t, std::vector<void*>> large;   // rounded size → blocks
+        std::size_t                         large_live   {0};
+        std::size_t                         large_allocs {0};
+        std::size_t                         large_frees  {0};
+
+        mutable std::mutex                  registry_mtx;
+        std::vector<ThreadCache*>           caches;
+        PoolStats                           retired;        // from exited threads
+
+        void* carve(std::size_t bytes, std::size_t align)
+        {
+            std::lock_guard lk(upstream_mtx);
+            void* p = upstream.allocate_aligned(bytes, align);   // throws bad_alloc
+            upstream_bytes += bytes;
+            ++slabs;
+            return p;
+        }
+    };
+
+    // Counters are written by the owning thread only and read by stats().
+    struct ThreadCache {
+        std::weak_ptr<Shared>                         owner;
+        Shared*                                       s;
+        std::array<std::vector<void*>, k_num_classes> blocks;
+        std::atomic<std::size_t> allocs {0}, frees {0}, hits {0}, refills {0}, spills {0};
+        std::atomic<std::size_t> live {0}, cached {0};
+
+        explicit ThreadCache(const std::shared_ptr<Shared>& sh) : owner(sh), s(sh.get())
+        {
+            std::lock_guard lk(s->registry_mtx);
+            s->caches.push_back(this);
+        }
+
+        ~ThreadCache()
+        {
+            auto sh = owner.lock();
+            if (!sh) return;                       // pool already gone
+            spill_all();
+            std::lock_guard lk(s->registry_mtx);
+            add_to(s->retired);                    // cached is 0 after the spill
+            std::erase(s->caches, this);
+        }
+
+        static void bump(std::atomic<std::size_t>& a, std::size_t d = 1) noexcept
+        {
+            a.store(a.load(std::memory_order_relaxed) + d, std::memory_order_relaxed);
+        }
+        static void drop(std::atomic<std::size_t>& a, std::size_t d) noexcept
+        {
+            a.store(a.load(std::memory_order_relaxed) - d, std::memory_order_relaxed);
+        }
+
+        void* pop(int c)
+        {
+            auto& v = blocks[c];
+            if (!v.empty()) bump(hits);
+            else            refill(c);
+            void* p = v.back();
+            v.pop_back();
+            bump(allocs);
+            bump(live, class_size(c));
+            drop(cached, class_size(c));
+            return p;
+        }
+
+        void push(int c, void* p)
+        {
+            auto& v = blocks[c];
+            v.push_back(p);
+            bump(frees);
+            drop(live, class_size(c));
+            bump(cached, class_size(c));
+            if (v.size() > k_cache_max) spill(c, v.size() / 2);
+        }
+
+        // half a cache from central, else a fresh slab
+        void refill(int c)
+        {
+            const std::size_t sz   = class_size(c);
+            const std::size_t want = std::max<std::size_t>(1, k_cache_max / 2);
+            auto& v = blocks[c];
+            {
+                Central& cen = s->central[c];
+                std::lock_guard lk(cen.mtx);
+                const std::size_t n = std::min(want, cen.blocks.size());
+                v.insert(v.end(), cen.blocks.end() - n, cen.blocks.end());
+                cen.blocks.resize(cen.blocks.size() - n);
+            }
+            if (v.empty()) {
+                const std::size_t slab = std::max(sz, k_slab_bytes);
+                auto* base = static_cast<std::uint8_t*>(s->carve(slab, std::min(sz, k_max_align)));
+                for (std::size_t off = slab; off >= sz; off -= sz)   // low addresses first out
+                    v.push_back(base + off - sz);
+            }
+            bump(refills);
+            bump(cached, v.size() * sz);
+        }
+
+        void spill(int c, std::size_t n)
+        {
+            auto& v = blocks[c];
+            Central& cen = s->central[c];
+            {
+                std::lock_guard lk(cen.mtx);
+                cen.blocks.insert(cen.blocks.end(), v.begin(), v.begin() + n);
+            }
+            v.erase(v.begin(), v.begin() + n);
+            bump(spills);
+            drop(cached, n * class_size(c));
+        }
+
+        void spill_all()
+        {
+            for (std::size_t c = 0; c < k_num_classes; ++c)
+                if (!blocks[c].empty()) spill(static_cast<int>(c), blocks[c].size());
+        }
+
+        void add_to(PoolStats& st) const noexcept
+        {
+            st.allocs     += allocs.load(std::memory_order_relaxed);
+            st.frees      += frees.load(std::memory_order_relaxed);
+            st.cache_hits += hits.load(std::memory_order_relaxed);
+            st.refills    += refills.load(std::memory_order_relaxed);
+            st.spills     += spills.load(std::memory_order_relaxed);
+            st.live_bytes += live.load(std::memory_order_relaxed);
+            st.free_bytes += cached.load(std::memory_order_relaxed);
+        }
+    };
+
+    // One cache per (thread, pool); pools are told apart by their Shared
+    // block, which a cache keeps alive only weakly.
+    ThreadCache& cache()
+    {
+        thread_local std::vector<std::unique_ptr<ThreadCache>> caches;
+        for (auto& tc : caches)
+            if (tc->s == shared_.get() && !tc->owner.expired()) return *tc;
+        std::erase_if(caches, [](const auto& tc) { return tc->owner.expired(); });
+        return *caches.emplace_back(std::make_unique<ThreadCache>(shared_));
+    }
+
+    void* allocate_large(std::size_t bytes, std::size_t alignment)
+    {
+        Shared& s = *shared_;
+        const std::size_t sz = (bytes + k_large_round - 1) / k_large_round * k_large_round;
+        {
+            std::lock_guard lk(s.large_mtx);
+            auto it = s.large.find(sz);
+            if (it != s.large.end()) {
+                auto& v = it->second;
+                for (std::size_t i = v.size(); i-- > 0; ) {
+                    if (reinterpret_cast<std::uintptr_t>(v[i]) % alignment) continue;
+                    void* p = v[i];
+                    v.erase(v.begin() + static_cast<std::ptrdiff_t>(i));
+                    s.large_live += sz;
+                    ++s.large_allocs;
+                    return p;
+                }
+            }
+        }
+        void* p = s.carve(sz, std::max(alignment, k_large_round));
+        std::lock_guard lk(s.large_mtx);
+        s.large_live += sz;
+        ++s.large_allocs;
+        return p;
+    }
+
+    void deallocate_large(void* p, std::size_t bytes, std::size_t /*alignment*/)
+    {
+        Shared& s = *shared_;
+        const std::size_t sz = (bytes + k_large_round - 1) / k_large_round * k_large_round;
+        std::lock_guard lk(s.large_mtx);
+        s.large[sz].push_back(p);
+        s.large_live -= sz;
+        ++s.large_frees;
+    }
+
+    std::shared_ptr<Shared> shared_;
+    DebugLevel              debug_level_;
+};
+
+} // namespace cxl
+#endif // CXL_POOL_ALLOCATOR_HPP_
@@ -0,0 +1,209 @@
+// cxl_queue_set.hpp
+// ─────────────────────────────────────────────────────────────────────────────
+//  QueueSet — fan-in poller over N CxlMpscQueue rings
+//
+//   • owns N rings (+ their tail lines) carved from one CxlAllocator
+//   • plus ⌈N/16⌉ 64-B doorbell summary lines: one 4-byte word per ring
+//   • producers stamp their ring's word after publishing (NT 32-bit store
+//     + sfence, the NT_STREAM_FLAG pattern from doorbell_benchmark.cpp)
+//   • the consumer reads only the summary lines and drains the rings whose
+//     word changed → an idle sweep costs ⌈N/16⌉ CXL reads instead of N
+//
+//  Why words, not bits: the lines are written by many hosts and CXL
+//  shared memory is not coherent, so a read-modify-write of a shared bit
+//  would lose updates.  A word per ring has a single writer (per host) and
+//  the value written is the last published slot + 1, so every ring is a
+//  change the poller can see without anyone clearing it.
+//
+//  Layout (same allocation order on every host → same addresses):
+//      [summary line 0 .. L-1] [tail 0][ring 0] [tail 1][ring 1] ...
+//
+//  Example
+//   cxl::DaxAllocator dax;
+//   QueueSet set(dax, 64, 10);                    // 64 rings × 1024 slots
+//   set.queue(7).enqueue(e);                      // producer side
+//   set.poll([](uint32_t ring, Entry& e) { ... }); // consumer side
+// ─────────────────────────────────────────────────────────────────────────────
+#ifndef CXL_QUEUE_SET_HPP_
+#define CXL_QUEUE_SET_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+#include "cxl_allocator.hpp"
+#include "cxl_mpsc_queue_exp.hpp"
+
+constexpr uint32_t k_doorbells_per_line = 64 / sizeof(uint32_t);
+
+// ─────────────────────────────────────────────────────────────────────────────
+//  Poller metrics (consumer side)
+// ─────────────────────────────────────────────────────────────────────────────
+struct QueueSetMetrics {
+    size_t polls            {0};
+    size_t idle_polls       {0};   // nothing delivered
+    size_t summary_reads    {0};   // CXL reads of doorbell lines
+    size_t rings_flagged    {0};   // doorbell word changed
+    size_t rings_drained    {0};   // drain attempts (flagged or pending)
+    size_t spurious_drains  {0};   // flagged, but already drained earlier
+    size_t items            {0};
+    size_t backoff_events   {0};
+    size_t backoff_cycles   {0};
+};
+
+class QueueSet {
+public:
+    // ────────────────────────────────────────────────────────────────
+    //  Construction — allocates everything from `alloc`.  The consumer
+    //  host passes do_initialize=true (zeroes rings and doorbells);
+    //  producer hosts attach with false, in the same allocation order.
+    // ────────────────────────────────────────────────────────────────
+    QueueSet(cxl::CxlAllocator& alloc,
+             uint32_t           n_rings,
+             uint32_t           order,
+             bool               do_initialize = true,
+             uint32_t           min_backoff   = 128,
+             uint32_t           max_backoff   = 16'384)
+        : n_rings_(n_rings),
+          n_lines_((n_rings + k_doorbells_per_line - 1) / k_doorbells_per_line),
+          seen_(n_rings, 0),
+          pending_(n_rings, 1),       // unknown history → drain once
+          backoff_idle_(min_backoff, max_backoff)
+    {
+        summary_ = static_cast<uint32_t*>(
+            alloc.allocate_aligned(std::size_t{n_lines_} * 64, 64));
+        if (do_initialize) {
+            alignas(64) const Entry zero{};
+            for (uint32_t l = 0; l < n_lines_; ++l)
+                store_nt_64B(summary_ + l * k_doorbells_per_line, &zero);
+        }
+
+        const std::size_t ring_bytes = (std::size_t{1} << order) * sizeof(Entry);
+        rings_.reserve(n_rings);
+        for (uint32_t i = 0; i < n_rings; ++i) {
+            auto* tail = static_cast<uint64_t*>(alloc.allocate_aligned(64, 64));
+            auto* ring = static_cast<Entry*>(alloc.allocate_aligned(ring_bytes, 64));
+            auto  q    = std::make_unique<CxlMpscQueue>(ring, order, tail, do_initialize,
+                                                        min_backoff, max_backoff);
+            q->set_doorbell(&summary_[i]);
+            q->set_wait_policy(WaitPolicy::none);   // the poller waits, not the ring
+            rings_.push_back(std::move(q));
+        }
+    }
+
+    [[nodiscard]] uint32_t size() const noexcept { return n_rings_; }
+
+    // Ring i: producers enqueue through it, the consumer may also use it
+    // directly (set_tail_policy, lookahead, metrics...).
+    [[nodiscard]] CxlMpscQueue& queue(uint32_t i) noexcept { return *rings_[i]; }
+
+    // How the consumer waits after an idle poll (umwait: first summary line)
+    void set_wait_policy(WaitPolicy p) noexcept { backoff_idle_.set_policy(p); }
+
+    // ────────────────────────────────────────────────────────────────
+    //  poll — read the summary lines, drain flagged rings
+    //  fn(uint32_t ring, Entry& e) is called for each item, in ring
+    //  order.  At most `max_per_ring` items are taken from one ring per
+    //  poll; a ring cut short stays pending for the next poll.
+    //  Returns the number of items delivered; backs off when 0.
+    // ────────────────────────────────────────────────────────────────
+    template <class Fn>
+    std::size_t poll(Fn&& fn,
+                     std::size_t max_per_ring = std::numeric_limits<std::size_t>::max())
+    {
+        ++metrics_.polls;
+        std::size_t delivered = 0;
+
+        alignas(64) uint32_t words[k_doorbells_per_line];
+        for (uint32_t l = 0; l < n_lines_; ++l) {
+            load_fresh_64B(words, summary_ + l * k_doorbells_per_line);
+            ++metrics_.summary_reads;
+
+            const uint32_t base = l * k_doorbells_per_line;
+            const uint32_t end  = std::min(base + k_doorbells_per_line, n_rings_);
+            for (uint32_t i = base; i < end; ++i) {
+                const uint32_t w = words[i - base];
+                const bool flagged = w != seen_[i];
+                if (flagged) {
+                    seen_[i] = w;
+                    ++metrics_.rings_flagged;
+                }
+                if (!flagged && !pending_[i]) continue;
+
+                const std::size_t got = drain(i, fn, max_per_ring);
+                if (got == 0 && flagged && !pending_[i]) ++metrics_.spurious_drains;
+                delivered += got;
+            }
+        }
+
+        metrics_.items += delivered;
+        if (delivered == 0) {
+            ++metrics_.idle_polls;
+            backoff_idle_.pause(metrics_.backoff_events, metrics_.backoff_cycles,
+                                summary_);
+        } else {
+            backoff_idle_.reset();
+        }
+        return delivered;
+    }
+
+    [[nodiscard]] const QueueSetMetrics& get_metrics() const noexcept { return metrics_; }
+
+    void print_metrics(std::string_view label = {}, std::ostream& os = std::cout) const
+    {
+        os << "\n════════ QueueSet " << label << " ════════\n"
+           << "Rings / summary lines   : " << n_rings_ << " / " << n_lines_ << '\n'
+           << "Polls (idle)            : " << metrics_.polls << " (" << metrics_.idle_polls << ")\n"
+           << "Summary line reads      : " << metrics_.summary_reads << '\n'
+           << "Rings flagged           : " << metrics_.rings_flagged << '\n'
+           << "Ring drains (spurious)  : " << metrics_.rings_drained
+           << " (" << metrics_.spurious_drains << ")\n"
+           << "Items                   : " << metrics_.items << '\n'
+           << "Back-off events/cycles  : " << metrics_.backoff_events << " / "
+                                           << metrics_.backoff_cycles << '\n';
+    }
+
+private:
+    static constexpr std::size_t k_drain_batch = 16;
+
+    // Drain ring i in batches; leaves it pending if cut short or torn.
+    template <class Fn>
+    std::size_t drain(uint32_t i, Fn& fn, std::size_t max_items)
+    {
+        ++metrics_.rings_drained;
+        CxlMpscQueue& q = *rings_[i];
+        alignas(64) Entry buf[k_drain_batch];
+
+        // the torn flag, not Metrics: those may be compiled out, and the
+        // doorbell that announced the torn entry is already consumed
+        std::size_t total = 0;
+        bool        torn  = false;
+        while (total < max_items) {
+            const std::size_t want = std::min(k_drain_batch, max_items - total);
+            const std::size_t n    = q.dequeue_batch(std::span<Entry>(buf, want));
+            for (std::size_t k = 0; k < n; ++k) fn(i, buf[k]);
+            total += n;
+            torn   = q.last_batch_torn();
+            if (n < want) break;
+        }
+        pending_[i] = total == max_items || torn;
+        return total;
+    }
+
+    const uint32_t n_rings_;
+    const uint32_t n_lines_;
+    uint32_t*      summary_ {nullptr};
+
+    std::vector<std::unique_ptr<CxlMpscQueue>> rings_;
+    std::vector<uint32_t> seen_;        // last doorbell value per ring
+    std::vector<uint8_t>  pending_;     // drain even without a new doorbell
+
+    QueueSetMetrics    metrics_;
+    ExponentialBackoff backoff_idle_;
+};
+
+#endif // CXL_QUEUE_SET_HPP_
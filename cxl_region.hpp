@@ -0,0 +1,363 @@
+// cxl_region.hpp
+// ─────────────────────────────────────────────────────────────────────────────
+//  Named-region directory and persistent queue headers in CXL memory
+//
+//   • RegionDirectory: a table at the start of a shared region mapping
+//     names to (offset, bytes); the rest of the region is bump-allocated
+//     through it.  Processes on any host find allocations by name instead
+//     of replaying the same allocate_aligned() sequence – only the region
+//     itself must sit at the same place (e.g. the first allocation of a
+//     DaxAllocator slice)
+//   • QueueHeader: one line in front of each queue – magic, version,
+//     generation, order, ring / tail offsets and the generation's base
+//     position.  init_queue() writes it; attach_queue() reads it
+//   • fast (re)initialization: the ring is zeroed once, when the queue is
+//     first created (NT stores, nothing pulled into the cache).  A new
+//     generation writes no ring line at all: it starts its positions a
+//     few laps past the published tail, so every stale slot carries an
+//     epoch the new generation does not expect
+//   • restart: a new handle on the current generation calls
+//     resume_consumer() / resume_producer() and carries on – no
+//     re-initialization, no drain
+//
+//  Single writer, as everywhere: the directory header and entries are
+//  written only by the process that formatted the region, a queue header
+//  only by the side that calls init_queue().  Lines are written with NT
+//  stores and carry a check word, so a reader rejects a torn line and
+//  reads it again.
+//
+//  Generations assume the tail line is at most one ring behind the
+//  consumer – always true except TailPolicy::piggyback after a crash;
+//  publish_tail() before a planned restart covers that case too.
+//
+//  Example
+//   void* base = alloc.allocate_aligned(bytes, 64);        // first allocation
+//   auto  dir  = RegionDirectory::open_or_format(base, bytes);
+//   auto  qa   = init_queue(dir, "requests", 14);           // owner side
+//   CxlMpscQueue prod(qa.ring, qa.order, qa.tail, /*do_initialize=*/false);
+//   prod.resume_producer();
+//   // elsewhere, or after a restart:
+//   auto  dir2 = RegionDirectory::open(base, bytes);
+//   auto  qb   = attach_queue(dir2, "requests");
+//   CxlMpscQueue cons(qb->ring, qb->order, qb->tail, /*do_initialize=*/false);
+//   cons.resume_consumer();
+// ─────────────────────────────────────────────────────────────────────────────
+#ifndef CXL_REGION_HPP_
+#define CXL_REGION_HPP_
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+#include "cxl_mpsc_queue_exp.hpp"
+
+// ─────────────────────────────────────────────────────────────────────────────
+//  On-media layout
+// ─────────────────────────────────────────────────────────────────────────────
+struct alignas(64) RegionDirHeader {
+    uint64_t magic;            // k_magic once formatted
+    uint32_t version;
+    uint32_t capacity;         // entry lines after this header
+    uint64_t bytes;            // region size
+    uint64_t count;            // entries published
+    uint64_t next;             // offset of the next allocation
+    uint64_t pad[2];
+    uint64_t check;            // region_line_check of words 0…6
+};
+static_assert(sizeof(RegionDirHeader) == 64);
+
+struct alignas(64) RegionDirEntry {
+    char     name[40];         // NUL-terminated
+    uint64_t offset;           // from the region base
+    uint64_t bytes;
+    uint64_t check;            // region_line_check of words 0…6
+};
+static_assert(sizeof(RegionDirEntry) == 64);
+
+struct alignas(64) QueueHeader {
+    uint64_t magic;            // k_queue_magic once initialized
+    uint32_t version;
+    uint32_t order;
+    uint64_t generation;       // 1 on creation, +1 per init_queue()
+    uint64_t ring_offset;      // from this header
+    uint64_t tail_offset;      // from this header
+    uint64_t base;             // first position of this generation
+    uint64_t pad;
+    uint64_t check;            // region_line_check of words 0…6
+};
+static_assert(sizeof(QueueHeader) == 64);
+
+// fold of the first seven words; never 0 for a written line
+inline uint64_t region_line_check(const void* line) noexcept
+{
+    const auto* w = static_cast<const uint64_t*>(line);
+    uint64_t h = 0x9e37'79b9'7f4a'7c15ull;
+    for (int i = 0; i < 7; ++i) h = (h ^ w[i]) * 0x1000'0000'01b3ull;
+    return h | 1;
+}
+
+// fresh copy of a line written by another host; false if torn or unwritten
+template <class Line>
+inline bool read_region_line(const Line* src, Line& out) noexcept
+{
+    load_fresh_64B(&out, const_cast<Line*>(src));
+    return out.check == region_line_check(&out);
+}
+
+template <class Line>
+inline void write_region_line(Line* dst, Line line) noexcept
+{
+    line.check = region_line_check(&line);
+    store_nt_64B(dst, &line);
+}
+
+// ─────────────────────────────────────────────────────────────────────────────
+//  RegionDirectory
+// ─────────────────────────────────────────────────────────────────────────────
+class RegionDirectory {
+public:
+    static constexpr uint64_t k_magic           = 0x5249'4452'5351'4c43ull;   // "CLQSRDIR"
+    static constexpr uint32_t k_version         = 1;
+    static constexpr uint32_t k_default_entries = 63;
+
+    static constexpr std::size_t table_bytes(uint32_t entries) noexcept
+    {
+        return 64 * (1 + std::size_t{entries});
+    }
+
+    // ────────────────────────────────────────────────────────────────
+    //  format — write an empty directory over `base` (creator only)
+    //  open   — attach to an existing one; throws if there is none
+    // ────────────────────────────────────────────────────────────────
+    static RegionDirectory format(void* base, std::size_t bytes,
+                                  uint32_t entries = k_default_entries)
+    {
+        if (bytes < table_bytes(entries))
+            throw std::invalid_argument("RegionDirectory: region smaller than its table");
+        RegionDirectory d(base, bytes);
+        d.hdr_ = RegionDirHeader{k_magic, k_version, entries, bytes, 0, table_bytes(entries), {}, 0};
+        write_region_line(d.header(), d.hdr_);
+        return d;
+    }
+
+    static RegionDirectory open(void* base, std::size_t bytes)
+    {
+        RegionDirectory d(base, bytes);
+        if (!d.refresh()) throw std::runtime_error("RegionDirectory: no directory header");
+        if (d.hdr_.bytes > bytes)
+            throw std::runtime_error("RegionDirectory: region smaller than formatted");
+        return d;
+    }
+
+    static bool present(void* base) noexcept
+    {
+        RegionDirHeader h;
+        return read_region_line(static_cast<const RegionDirHeader*>(base), h) &&
+               h.magic == k_magic && h.version == k_version;
+    }
+
+    static RegionDirectory open_or_format(void* base, std::size_t bytes,
+                                          uint32_t entries = k_default_entries)
+    {
+        return present(base) ? open(base, bytes) : format(base, bytes, entries);
+    }
+
+    // ────────────────────────────────────────────────────────────────
+    //  create — bump-allocate `bytes` under `name` (creator only).
+    //  The entry line is written before the header that counts it, so
+    //  a reader never sees a count without its entry.  Throws if the
+    //  name exists, is too long, or the table / region is full.
+    // ────────────────────────────────────────────────────────────────
+    void* create(std::string_view name, std::size_t bytes, std::size_t align = 64)
+    {
+        if (name.empty() || name.size() >= sizeof(RegionDirEntry::name))
+            throw std::invalid_argument("RegionDirectory: bad name '" + std::string(name) + "'");
+        refresh();
+        if (find(name)) throw std::invalid_argument("RegionDirectory: '" + std::string(name) + "' exists");
+        if (hdr_.count == hdr_.capacity) throw std::runtime_error("RegionDirectory: table full");
+
+        align = std::max<std::size_t>(align, 64);
+        const uint64_t off = (hdr_.next + align - 1) & ~uint64_t(align - 1);
+        if (off + bytes > hdr_.bytes) throw std::runtime_error("RegionDirectory: region full");
+
+        RegionDirEntry e{};
+        std::memcpy(e.name, name.data(), name.size());
+        e.offset = off;
+        e.bytes  = bytes;
+        write_region_line(entry(hdr_.count), e);
+
+        ++hdr_.count;
+        hdr_.next = (off + bytes + 63) & ~uint64_t{63};
+        write_region_line(header(), hdr_);
+        return base_ + off;
+    }
+
+    // ────────────────────────────────────────────────────────────────
+    //  find — address of `name` (and its size), nullptr if absent
+    // ────────────────────────────────────────────────────────────────
+    void* find(std::string_view name, std::size_t* bytes = nullptr)
+    {
+        refresh();
+        for (uint64_t i = 0; i < hdr_.count; ++i) {
+            RegionDirEntry e;
+            while (!read_region_line(entry(i), e)) _mm_pause();
+            if (std::string_view(e.name) != name) continue;
+            if (bytes) *bytes = e.bytes;
+            return base_ + e.offset;
+        }
+        return nullptr;
+    }
+
+    void* find_or_create(std::string_view name, std::size_t bytes, std::size_t align = 64)
+    {
+        std::size_t have = 0;
+        if (void* p = find(name, &have)) {
+            if (have < bytes) throw std::runtime_error("RegionDirectory: '" + std::string(name) + "' too small");
+            return p;
+        }
+        return create(name, bytes, align);
+    }
+
+    [[nodiscard]] uint64_t    entries() const noexcept { return hdr_.count; }
+    [[nodiscard]] void*       base()    const noexcept { return base_; }
+    [[nodiscard]] std::size_t bytes()   const noexcept { return bytes_; }
+
+private:
+    RegionDirectory(void* base, std::size_t bytes)
+        : base_{static_cast<std::byte*>(base)}, bytes_{bytes}
+    {
+        if (reinterpret_cast<std::uintptr_t>(base) & 63u)
+            throw std::invalid_argument("RegionDirectory: base not 64-byte aligned");
+    }
+
+    RegionDirHeader* header() const noexcept { return reinterpret_cast<RegionDirHeader*>(base_); }
+    RegionDirEntry*  entry(uint64_t i) const noexcept
+    {
+        return reinterpret_cast<RegionDirEntry*>(base_ + 64 * (1 + i));
+    }
+
+    // re-read the header; another host may have added entries
+    bool refresh() noexcept
+    {
+        RegionDirHeader h;
+        for (int tries = 0; tries < 64; ++tries) {
+            if (read_region_line(header(), h)) {
+                if (h.magic != k_magic || h.version != k_version) return false;
+                hdr_ = h;
+                return true;
+            }
+            _mm_pause();
+        }
+        return false;
+    }
+
+    std::byte*      base_;
+    std::size_t     bytes_;
+    RegionDirHeader hdr_ {};
+};
+
+// ─────────────────────────────────────────────────────────────────────────────
+//  Persistent queues
+// ─────────────────────────────────────────────────────────────────────────────
+struct QueueAttachment {
+    Entry*    ring;
+    uint64_t* tail;
+    uint32_t  order;
+    uint32_t  base;            // first position of this generation
+    uint64_t  generation;
+};
+
+inline constexpr uint64_t k_queue_magic   = 0x5545'5551'5351'4c43ull;     // "CLQSQUEU"
+inline constexpr uint32_t k_queue_version = 1;
+
+inline std::size_t queue_region_bytes(uint32_t order) noexcept
+{
+    return 2 * 64 + (sizeof(Entry) << order);    // header + tail line + ring
+}
+
+namespace detail {
+
+inline QueueAttachment queue_view(QueueHeader* h, const QueueHeader& v) noexcept
+{
+    auto* bytes = reinterpret_cast<std::byte*>(h);
+    return {reinterpret_cast<Entry*>(bytes + v.ring_offset),
+            reinterpret_cast<uint64_t*>(bytes + v.tail_offset),
+            v.order, static_cast<uint32_t>(v.base), v.generation};
+}
+
+inline bool read_queue_header(QueueHeader* h, QueueHeader& out) noexcept
+{
+    for (int tries = 0; tries < 64; ++tries) {
+        if (read_region_line(h, out)) return out.magic == k_queue_magic && out.version == k_queue_version;
+        _mm_pause();
+    }
+    return false;
+}
+
+// first lap of a new generation: past every lap a stale slot can carry
+// (tail − 1 … tail + 2 laps) and never epoch 0, the zeroed line
+inline uint32_t next_generation_base(uint32_t published_tail, uint32_t order) noexcept
+{
+    uint32_t lap = (published_tail >> order) + 3;
+    if (static_cast<uint8_t>(lap + 1) == 0) ++lap;
+    return lap << order;
+}
+
+} // namespace detail
+
+// ────────────────────────────────────────────────────────────────
+//  init_queue — create `name` (zeroing its ring once) or start a new
+//  generation of it in place.  Only the owner side calls this, with no
+//  handles of the previous generation still running; every handle is
+//  then built with do_initialize = false and resumes.
+// ────────────────────────────────────────────────────────────────
+inline QueueAttachment init_queue(RegionDirectory& dir, std::string_view name, uint32_t order)
+{
+    std::size_t have = queue_region_bytes(order);
+    void* p = dir.find(name, &have);
+    if (!p) p = dir.create(name, have);
+    auto* h = static_cast<QueueHeader*>(p);
+    QueueHeader v;
+    const bool live = detail::read_queue_header(h, v);
+    if ((live && v.order != order) || have < queue_region_bytes(order))
+        throw std::invalid_argument("init_queue: '" + std::string(name) + "' " +
+                                    (live ? "has order " + std::to_string(v.order)
+                                          : "is only " + std::to_string(have) + " bytes"));
+    if (live) {
+        const QueueAttachment old = detail::queue_view(h, v);
+        v.base = detail::next_generation_base(static_cast<uint32_t>(load_fresh_u64(old.tail)), order);
+        ++v.generation;
+    } else {
+        v = QueueHeader{k_queue_magic, k_queue_version, order, 1, 128, 64, 0, 0, 0};
+        const QueueAttachment a = detail::queue_view(h, v);
+        static const Entry zero{};
+        for (std::size_t i = 0; i < (std::size_t{1} << order); ++i) stream_64B(a.ring + i, &zero);
+        _mm_sfence();
+    }
+
+    QueueAttachment a = detail::queue_view(h, v);
+    store_nt_u64(a.tail + 1, 0);                 // stall-request word
+    store_nt_u64(a.tail, v.base);
+    write_region_line(h, v);                     // publishes the generation last
+    a.generation = v.generation;
+    return a;
+}
+
+// ────────────────────────────────────────────────────────────────
+//  attach_queue — current generation of `name`, nullopt until
+//  init_queue() has published it
+// ────────────────────────────────────────────────────────────────
+inline std::optional<QueueAttachment> attach_queue(RegionDirectory& dir, std::string_view name)
+{
+    auto* h = static_cast<QueueHeader*>(dir.find(name));
+    QueueHeader v;
+    if (!h || !detail::read_queue_header(h, v)) return std::nullopt;
+    return detail::queue_view(h, v);
+}
+
+#endif // CXL_REGION_HPP_
@@ -0,0 +1,316 @@
+// cxl_rpc.hpp
+// ─────────────────────────────────────────────────────────────────────────────
+//  Pipelined RPC endpoints over a CxlMpscQueue request/response pair
+//
+//   • RpcClient : up to `window` calls in flight; responses are matched by
+//                 rpc_id (a slot of the client's pending table) and checked
+//                 against the rpc_method that was sent
+//   • RpcServer : per-rpc_method handler table; drains requests in batches
+//                 and answers them with one enqueue_batch per batch
+//
+//  Wire format: one Entry per call and per response.  args[] is the
+//  payload, meta.f.rpc_method / rpc_id travel unchanged from request to
+//  response.  A request for a method without handler is answered with
+//  rpc_method = k_rpc_error_method and args[0] = the requested method.
+//
+//  Tail piggyback (set_tail_piggyback on both ends): the server stamps the
+//  request queue's consumed tail into args[k_rpc_credit_arg] of every
+//  response and stops publishing it to CXL (TailPolicy::Mode::piggyback);
+//  the client hands it to the request queue's producer side.  The RPC path
+//  then has no tail flushes and no CXL tail reads; handlers must leave
+//  args[k_rpc_credit_arg] of the response alone.
+//
+//  Example
+//   RpcServer srv(q_req, q_rsp);
+//   srv.register_handler(1, [](const Entry& in, Entry& out) { out.args[0] = in.args[0] + 1; });
+//   RpcClient cli(q_req, q_rsp, 32);
+//   cli.call(1, {{41}});
+//   cli.poll([](const RpcCompletion& c) { ... c.rsp.args[0] == 42 ... });
+// ─────────────────────────────────────────────────────────────────────────────
+#ifndef CXL_RPC_HPP_
+#define CXL_RPC_HPP_
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <span>
+#include <string_view>
+#include <vector>
+#include <x86intrin.h>   // __rdtsc
+
+#include "cxl_mpsc_queue_exp.hpp"
+
+constexpr uint8_t  k_rpc_error_method = 0xFF;   // reserved: "no such method"
+constexpr uint32_t k_rpc_max_window   = std::numeric_limits<uint16_t>::max();
+constexpr std::size_t k_rpc_credit_arg = 5;     // response: request-queue tail
+
+// ─────────────────────────────────────────────────────────────────────────────
+//  Client side
+// ─────────────────────────────────────────────────────────────────────────────
+
+struct RpcCompletion {
+    uint16_t     rpc_id;
+    uint8_t      method;           // method that was called
+    bool         error;            // server had no handler for it
+    uint64_t     latency_cycles;   // TSC, call() → poll()
+    uint64_t     cookie;           // as passed to call()
+    const Entry& rsp;
+};
+
+struct RpcClientMetrics {
+    size_t calls              {0};
+    size_t responses          {0};
+    size_t errors             {0};   // k_rpc_error_method responses
+    size_t window_full        {0};   // call() refused: window exhausted
+    size_t ring_full          {0};   // call() refused: request ring full
+    size_t unknown_responses  {0};   // rpc_id not in flight / method mismatch
+    size_t tail_credits       {0};   // piggybacked tails that freed request slots
+    size_t latency_cycles_sum {0};
+    size_t latency_cycles_min {std::numeric_limits<size_t>::max()};
+    size_t latency_cycles_max {0};
+};
+
+class RpcClient {
+public:
+    RpcClient(CxlMpscQueue& req, CxlMpscQueue& rsp, uint32_t window)
+        : req_(req), rsp_(rsp), window_(window), pending_(window)
+    {
+        assert(window >= 1 && window <= k_rpc_max_window && "window must fit rpc_id");
+        free_ids_.reserve(window);
+        for (uint32_t id = window; id-- > 0; )
+            free_ids_.push_back(static_cast<uint16_t>(id));
+    }
+
+    // Take request-queue tail credits from the responses (the server
+    // must stamp them, RpcServer::set_tail_piggyback).
+    void set_tail_piggyback(bool on) noexcept { piggyback_ = on; }
+    [[nodiscard]] bool tail_piggyback() const noexcept { return piggyback_; }
+
+    // ────────────────────────────────────────────────────────────────
+    //  call — send one request; false if the window or the ring is full
+    //  (nothing was sent, retry after poll())
+    // ────────────────────────────────────────────────────────────────
+    bool call(uint8_t method, std::span<const uint64_t> args, uint64_t cookie = 0)
+    {
+        assert(method != k_rpc_error_method && args.size() <= std::size(Entry{}.args));
+        if (free_ids_.empty()) { ++metrics_.window_full; return false; }
+
+        const uint16_t id = free_ids_.back();
+        Entry e{};
+        std::copy(args.begin(), args.end(), e.args);
+        e.meta.f.rpc_method = method;
+        e.meta.f.rpc_id     = id;
+        e.meta.f.seal_index = -1;                 // single-line entry
+
+        const uint64_t t = __rdtsc();
+        if (!req_.enqueue(e)) { ++metrics_.ring_full; return false; }
+
+        free_ids_.pop_back();
+        pending_[id] = Pending{t, cookie, method, true};
+        ++metrics_.calls;
+        return true;
+    }
+
+    // ────────────────────────────────────────────────────────────────
+    //  poll — collect up to `max` responses, fn(const RpcCompletion&)
+    //  for each.  Returns the number completed.
+    // ────────────────────────────────────────────────────────────────
+    template <class Fn>
+    std::size_t poll(Fn&& fn, std::size_t max = k_batch)
+    {
+        alignas(64) Entry buf[k_batch];
+        const std::size_t n = rsp_.dequeue_batch(std::span<Entry>(buf, std::min(max, k_batch)));
+        const uint64_t now = __rdtsc();
+
+        std::size_t done   = 0;
+        const Entry* credit = nullptr;      // newest matched response
+        for (std::size_t k = 0; k < n; ++k) {
+            const Entry&   r  = buf[k];
+            const uint16_t id = r.meta.f.rpc_id;
+            const bool     err = r.meta.f.rpc_method == k_rpc_error_method;
+            if (id >= window_ || !pending_[id].in_flight ||
+                (!err && r.meta.f.rpc_method != pending_[id].method)) {
+                ++metrics_.unknown_responses;
+                continue;
+            }
+            Pending& p = pending_[id];
+            p.in_flight = false;
+            free_ids_.push_back(id);
+            credit = &r;
+
+            const uint64_t lat = now - p.t_sent;
+            ++metrics_.responses;
+            metrics_.errors             += err;
+            metrics_.latency_cycles_sum += lat;
+            metrics_.latency_cycles_min  = std::min<size_t>(metrics_.latency_cycles_min, lat);
+            metrics_.latency_cycles_max  = std::max<size_t>(metrics_.latency_cycles_max, lat);
+
+            fn(RpcCompletion{id, p.method, err, lat, p.cookie, r});
+            ++done;
+        }
+        /* responses of one server come in order: the last tail is newest */
+        if (piggyback_ && credit &&
+            req_.note_consumer_tail(static_cast<uint32_t>(credit->args[k_rpc_credit_arg])))
+            ++metrics_.tail_credits;
+        return done;
+    }
+
+    // poll() until nothing is in flight
+    template <class Fn>
+    void drain(Fn&& fn) { while (in_flight() != 0) poll(fn); }
+
+    [[nodiscard]] uint32_t in_flight() const noexcept { return window_ - static_cast<uint32_t>(free_ids_.size()); }
+    [[nodiscard]] uint32_t window()    const noexcept { return window_; }
+    [[nodiscard]] const RpcClientMetrics& get_metrics() const noexcept { return metrics_; }
+
+    void print_metrics(std::string_view label = {}, std::ostream& os = std::cout) const
+    {
+        const auto& m = metrics_;
+        os << "\n════════ RpcClient " << label << " ════════\n"
+           << "Window                  : " << window_ << '\n'
+           << "Calls / responses       : " << m.calls << " / " << m.responses << '\n'
+           << "Errors                  : " << m.errors << '\n'
+           << "Refused (window / ring) : " << m.window_full << " / " << m.ring_full << '\n'
+           << "Unknown responses       : " << m.unknown_responses << '\n'
+           << "Tail credits (in-band)  : " << m.tail_credits
+           << (piggyback_ ? "\n" : " (piggyback off)\n")
+           << "Latency cycles avg      : "
+           << (m.responses ? m.latency_cycles_sum / m.responses : 0) << '\n'
+           << "Latency cycles min/max  : "
+           << (m.responses ? m.latency_cycles_min : 0) << " / " << m.latency_cycles_max << '\n';
+    }
+
+private:
+    static constexpr std::size_t k_batch = 16;
+
+    struct Pending {
+        uint64_t t_sent    {0};
+        uint64_t cookie    {0};
+        uint8_t  method    {0};
+        bool     in_flight {false};
+    };
+
+    CxlMpscQueue&          req_;
+    CxlMpscQueue&          rsp_;
+    const uint32_t         window_;
+    std::vector<Pending>   pending_;    // indexed by rpc_id
+    std::vector<uint16_t>  free_ids_;
+    bool                   piggyback_ {false};
+    RpcClientMetrics       metrics_;
+};
+
+// ─────────────────────────────────────────────────────────────────────────────
+//  Server side
+// ─────────────────────────────────────────────────────────────────────────────
+
+// Fill `rsp.args`; meta is set by the server.
+using RpcHandler = std::function<void(const Entry& req, Entry& rsp)>;
+
+struct RpcServerMetrics {
+    size_t requests       {0};
+    size_t unknown_method {0};
+    size_t polls_empty    {0};
+    size_t tail_credits   {0};   // responses stamped with the request tail
+    std::array<size_t, 256> per_method {};
+};
+
+class RpcServer {
+public:
+    RpcServer(CxlMpscQueue& req, CxlMpscQueue& rsp) : req_(req), rsp_(rsp) {}
+
+    void register_handler(uint8_t method, RpcHandler h)
+    {
+        assert(method != k_rpc_error_method && "method id is reserved");
+        handlers_[method] = std::move(h);
+    }
+
+    // ────────────────────────────────────────────────────────────────
+    //  set_tail_piggyback — stamp the request tail into every response
+    //  and switch the request queue to TailPolicy::Mode::piggyback; off
+    //  restores the policy it had before.  The client must take the
+    //  credits (RpcClient::set_tail_piggyback) or it will run dry and
+    //  fall back to stall requests.
+    // ────────────────────────────────────────────────────────────────
+    void set_tail_piggyback(bool on) noexcept
+    {
+        if (on == piggyback_) return;
+        piggyback_ = on;
+        TailPolicy p = req_.tail_policy();
+        if (on) { saved_mode_ = p.mode; p.mode = TailPolicy::Mode::piggyback; }
+        else    { p.mode = saved_mode_; }
+        req_.set_tail_policy(p);
+    }
+    [[nodiscard]] bool tail_piggyback() const noexcept { return piggyback_; }
+
+    // ────────────────────────────────────────────────────────────────
+    //  poll — serve up to `max` requests; responses of one batch go out
+    //  with one enqueue_batch (spins while the response ring is full)
+    // ────────────────────────────────────────────────────────────────
+    std::size_t poll(std::size_t max = k_batch)
+    {
+        alignas(64) Entry in[k_batch];
+        alignas(64) Entry out[k_batch];
+        const std::size_t n = req_.dequeue_batch(std::span<Entry>(in, std::min(max, k_batch)));
+        if (n == 0) { ++metrics_.polls_empty; return 0; }
+
+        for (std::size_t k = 0; k < n; ++k) {
+            const Entry& q = in[k];
+            Entry&       r = out[k];
+            r = Entry{};
+            r.meta.f.rpc_id     = q.meta.f.rpc_id;
+            r.meta.f.rpc_method = q.meta.f.rpc_method;
+            r.meta.f.seal_index = -1;
+
+            if (const RpcHandler& h = handlers_[q.meta.f.rpc_method]) {
+                h(q, r);
+                ++metrics_.per_method[q.meta.f.rpc_method];
+            } else {
+                r.meta.f.rpc_method = k_rpc_error_method;
+                r.args[0]           = q.meta.f.rpc_method;
+                ++metrics_.unknown_method;
+            }
+        }
+        if (piggyback_) {
+            const uint64_t tail = req_.consumed_tail();   // includes this batch
+            for (std::size_t k = 0; k < n; ++k) out[k].args[k_rpc_credit_arg] = tail;
+            metrics_.tail_credits += n;
+        }
+
+        for (std::size_t sent = 0; sent < n; )
+            sent += rsp_.enqueue_batch(std::span<Entry>(out + sent, n - sent));
+
+        metrics_.requests += n;
+        return n;
+    }
+
+    [[nodiscard]] const RpcServerMetrics& get_metrics() const noexcept { return metrics_; }
+
+    void print_metrics(std::string_view label = {}, std::ostream& os = std::cout) const
+    {
+        os << "\n════════ RpcServer " << label << " ════════\n"
+           << "Requests                : " << metrics_.requests << '\n'
+           << "Unknown method          : " << metrics_.unknown_method << '\n'
+           << "Empty polls             : " << metrics_.polls_empty << '\n'
+           << "Tail credits (in-band)  : " << metrics_.tail_credits << '\n';
+        for (std::size_t m = 0; m < metrics_.per_method.size(); ++m)
+            if (metrics_.per_method[m])
+                os << "  method " << m << "\t\t: " << metrics_.per_method[m] << '\n';
+    }
+
+private:
+    static constexpr std::size_t k_batch = 16;
+
+    CxlMpscQueue&                req_;
+    CxlMpscQueue&                rsp_;
+    std::array<RpcHandler, 256>  handlers_ {};
+    bool                         piggyback_  {false};
+    TailPolicy::Mode             saved_mode_ {TailPolicy::Mode::fixed};
+    RpcServerMetrics             metrics_;
+};
+
+#endif // CXL_RPC_HPP_
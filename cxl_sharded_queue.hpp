@@ -0,0 +1,317 @@
+// cxl_sharded_queue.hpp
+// ─────────────────────────────────────────────────────────────────────────────
+//  ShardedQueue — K CxlMpscQueue rings drained by a pool of workers
+//
+//   • K shards, each a ring + tail line from one CxlAllocator and a
+//     ProducerGroup; ShardProducer (one per producer thread) spreads
+//     entries round-robin (spilling to the next shard when one is full)
+//     or by key (one shard per key, no spill)
+//   • ShardWorker (one per worker thread) owns a home shard (id mod K) and
+//     steals from the others, in rotating order, when its home is idle
+//   • claim protocol: the consumer side of a ring is single-threaded, so a
+//     worker takes a batch under the shard's claim flag – one cache line in
+//     host DRAM, test-and-set with acquire / release – and processes it
+//     after dropping the flag.  Nothing about the claim is in CXL memory:
+//     flags need an atomic RMW, which non-coherent CXL cannot provide
+//     across hosts.  The ring itself needs no hand-over: every dequeue
+//     invalidates (clflushopt, host-wide) before it loads, so the next
+//     owner never reads a line the previous owner's core had cached, and
+//     the queue's consumer state (tail, epoch, tail policy) is published
+//     by the release of the flag.
+//   • work hint: producers claim slots in the shard's ProducerGroup (host
+//     memory) and workers mirror the consumed tail next to it, so
+//     head − consumed says "maybe work" without a CXL read; idle shards
+//     cost a stealer two host loads, not a CXL miss
+//
+//  All producers and workers live in the process that owns the
+//  ShardedQueue (the groups and flags are host memory).  Producers on
+//  other hosts need rings of their own (see ProducerGroup).
+//
+//  Order: a shard is dequeued in order, but two workers may process
+//  consecutive batches of one shard at the same time – keyed routing
+//  keeps a key on one ring, not on one worker.
+//
+//  Example
+//   ShardedQueue sq(alloc, 4, 12);
+//   ShardProducer p(sq);            p.enqueue(e);       // producer thread
+//   ShardWorker   w(sq, worker_id);                     // worker thread
+//   while (run) w.poll([](uint32_t shard, Entry& e) { handle(e); });
+// ─────────────────────────────────────────────────────────────────────────────
+#ifndef CXL_SHARDED_QUEUE_HPP_
+#define CXL_SHARDED_QUEUE_HPP_
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <span>
+#include <string_view>
+#include <vector>
+
+#include "cxl_allocator.hpp"
+#include "cxl_mpsc_queue_exp.hpp"
+
+class ShardedQueue {
+public:
+    // One ring: the consumer handle plus what producers and workers share.
+    struct Shard {
+        Entry*                            ring;
+        uint64_t*                         tail_line;
+        ProducerGroup                     group;
+        alignas(64) std::atomic<bool>     claimed  {false};
+        std::atomic<uint32_t>             consumed {0};      // mirror of the tail
+        std::unique_ptr<CxlMpscQueue>     consumer;
+
+        Shard(Entry* r, uint64_t* t) : ring(r), tail_line(t) {}
+
+        bool try_claim() noexcept
+        {
+            return !claimed.load(std::memory_order_relaxed) &&
+                   !claimed.exchange(true, std::memory_order_acquire);
+        }
+        void release() noexcept { claimed.store(false, std::memory_order_release); }
+
+        // Claimed or written, not consumed yet (host loads only).
+        [[nodiscard]] bool maybe_pending() const noexcept
+        {
+            return group.head.load(std::memory_order_relaxed) !=
+                   consumed.load(std::memory_order_relaxed);
+        }
+    };
+
+    // ────────────────────────────────────────────────────────────────
+    //  Construction — n_shards rings of 2^order slots from `alloc`
+    //  (tail line then ring, per shard).  Workers never wait inside the
+    //  queue: the shard consumers use WaitPolicy::none.
+    // ────────────────────────────────────────────────────────────────
+    ShardedQueue(cxl::CxlAllocator& alloc, uint32_t n_shards, uint32_t order,
+                 bool do_initialize = true)
+        : order_(order)
+    {
+        assert(n_shards >= 1);
+        for (uint32_t s = 0; s < n_shards; ++s) {
+            auto* tail = static_cast<uint64_t*>(alloc.allocate_aligned(64, 64));
+            auto* ring = static_cast<Entry*>(
+                alloc.allocate_aligned(sizeof(Entry) << order, 64));
+            auto sh = std::make_unique<Shard>(ring, tail);
+            sh->consumer = std::make_unique<CxlMpscQueue>(ring, order, tail, sh->group,
+                                                          do_initialize);
+            sh->consumer->set_wait_policy(WaitPolicy::none);
+            shards_.push_back(std::move(sh));
+        }
+    }
+
+    [[nodiscard]] uint32_t shards() const noexcept { return static_cast<uint32_t>(shards_.size()); }
+    [[nodiscard]] uint32_t order()  const noexcept { return order_; }
+    [[nodiscard]] Shard&   shard(uint32_t s) noexcept { return *shards_[s]; }
+
+    // Per-shard consumer metrics (read once the workers have stopped).
+    void print_metrics(std::string_view label = {}, std::ostream& os = std::cout) const
+    {
+        os << "\n════════ ShardedQueue " << label << " ════════\n"
+           << "Shards                  : " << shards_.size() << " × " << (1u << order_) << " slots\n";
+        for (std::size_t s = 0; s < shards_.size(); ++s) {
+            const Metrics& m = shards_[s]->consumer->get_metrics();
+            os << "  shard " << s << "\t\t: " << m.dequeue_batch_items << " items, "
+               << m.no_new_items << " empty, " << m.flush_tail << " tail flushes\n";
+        }
+    }
+
+private:
+    uint32_t                            order_;
+    std::vector<std::unique_ptr<Shard>> shards_;
+};
+
+// ─────────────────────────────────────────────────────────────────────────────
+//  Producer side
+// ─────────────────────────────────────────────────────────────────────────────
+struct ShardProducerMetrics {
+    size_t enqueued       {0};
+    size_t spills         {0};   // shard full, took the next one
+    size_t refused        {0};   // every shard (or the key's shard) full
+    size_t backoff_events {0};
+    size_t backoff_cycles {0};
+};
+
+class ShardProducer {
+public:
+    // first_shard staggers the round-robin start between producers.
+    explicit ShardProducer(ShardedQueue& sq, uint32_t first_shard = 0)
+        : next_(first_shard % sq.shards()), backoff_full_(128)
+    {
+        for (uint32_t s = 0; s < sq.shards(); ++s) {
+            ShardedQueue::Shard& sh = sq.shard(s);
+            auto q = std::make_unique<CxlMpscQueue>(sh.ring, sq.order(), sh.tail_line, sh.group,
+                                                    /*do_initialize=*/false);
+            q->producer_backoff().set_policy(WaitPolicy::none);   // spill, don't wait
+            handles_.push_back(std::move(q));
+        }
+    }
+
+    // ────────────────────────────────────────────────────────────────
+    //  enqueue — next shard in round-robin order; a full shard spills
+    //  to the one after it.  False only if all shards are full.
+    // ────────────────────────────────────────────────────────────────
+    bool enqueue(Entry& e) noexcept
+    {
+        const uint32_t k = static_cast<uint32_t>(handles_.size());
+        for (uint32_t i = 0; i < k; ++i) {
+            const uint32_t s = next_;
+            next_ = next_ + 1 == k ? 0 : next_ + 1;
+            if (handles_[s]->enqueue(e)) {
+                metrics_.spills += i;
+                return done();
+            }
+        }
+        return refuse();
+    }
+
+    // ────────────────────────────────────────────────────────────────
+    //  enqueue_to — the shard of `key` (entries of a key stay on one
+    //  ring, in order).  False if that shard is full.
+    // ────────────────────────────────────────────────────────────────
+    bool enqueue_to(uint64_t key, Entry& e) noexcept
+    {
+        return handles_[shard_of(key)]->enqueue(e) ? done() : refuse();
+    }
+
+    [[nodiscard]] uint32_t shard_of(uint64_t key) const noexcept
+    {
+        // Fibonacci hashing: the high bits of key × 2^64/φ, then a range
+        // reduction – sequential keys still spread over all shards
+        const uint64_t h = key * 0x9e37'79b9'7f4a'7c15ull;
+        return static_cast<uint32_t>(((h >> 32) * handles_.size()) >> 32);
+    }
+
+    [[nodiscard]] const ShardProducerMetrics& get_metrics() const noexcept { return metrics_; }
+
+    void print_metrics(std::string_view label = {}, std::ostream& os = std::cout) const
+    {
+        const auto& m = metrics_;
+        os << "── Shard producer [" << label << "] ──────────────\n"
+           << "Enqueued                : " << m.enqueued << '\n'
+           << "Spills / refused        : " << m.spills << " / " << m.refused << '\n'
+           << "Back-off events / cycles: " << m.backoff_events << " / " << m.backoff_cycles << '\n';
+    }
+
+private:
+    bool done() noexcept
+    {
+        ++metrics_.enqueued;
+        backoff_full_.reset();
+        return true;
+    }
+    bool refuse() noexcept
+    {
+        ++metrics_.refused;
+        backoff_full_.pause(metrics_.backoff_events, metrics_.backoff_cycles);
+        return false;
+    }
+
+    std::vector<std::unique_ptr<CxlMpscQueue>> handles_;
+    uint32_t                                   next_;
+    ExponentialBackoff                         backoff_full_;
+    ShardProducerMetrics                       metrics_;
+};
+
+// ─────────────────────────────────────────────────────────────────────────────
+//  Consumer side
+// ─────────────────────────────────────────────────────────────────────────────
+struct ShardWorkerMetrics {
+    size_t polls          {0};
+    size_t home_items     {0};
+    size_t stolen_items   {0};
+    size_t steals         {0};   // batches taken from another shard
+    size_t steal_attempts {0};   // other shards whose hint said "maybe work"
+    size_t claim_busy     {0};   // shard claimed by another worker
+    size_t idle_polls     {0};   // nothing anywhere
+    size_t backoff_events {0};
+    size_t backoff_cycles {0};
+};
+
+class ShardWorker {
+public:
+    ShardWorker(ShardedQueue& sq, uint32_t id, uint32_t min_backoff = 128,
+                uint32_t max_backoff = 16'384)
+        : sq_(sq), home_(id % sq.shards()), victim_(home_), backoff_idle_(min_backoff, max_backoff) {}
+
+    [[nodiscard]] uint32_t home() const noexcept { return home_; }
+
+    // ────────────────────────────────────────────────────────────────
+    //  poll — one batch from the home shard or, if it has none, from
+    //  the first other shard that has one; fn(shard, Entry&) for each,
+    //  outside the claim.  Returns the number of entries handled.
+    // ────────────────────────────────────────────────────────────────
+    template <class Fn>
+    std::size_t poll(Fn&& fn, std::size_t max = k_batch)
+    {
+        ++metrics_.polls;
+        alignas(64) Entry buf[k_batch];
+        const std::span<Entry> out(buf, std::min(max, k_batch));
+
+        uint32_t    from = home_;
+        std::size_t n    = take(home_, out);
+        if (n) {
+            metrics_.home_items += n;
+        } else {
+            const uint32_t k = sq_.shards();
+            for (uint32_t i = 1; i < k && n == 0; ++i) {
+                victim_ = victim_ + 1 == k ? 0 : victim_ + 1;
+                if (victim_ == home_) victim_ = victim_ + 1 == k ? 0 : victim_ + 1;
+                if (!sq_.shard(victim_).maybe_pending()) continue;
+                ++metrics_.steal_attempts;
+                n = take(victim_, out);
+                from = victim_;
+            }
+            if (n) { ++metrics_.steals; metrics_.stolen_items += n; }
+        }
+
+        if (n == 0) {
+            ++metrics_.idle_polls;
+            backoff_idle_.pause(metrics_.backoff_events, metrics_.backoff_cycles);
+            return 0;
+        }
+        backoff_idle_.reset();
+        for (std::size_t i = 0; i < n; ++i) fn(from, buf[i]);
+        return n;
+    }
+
+    [[nodiscard]] const ShardWorkerMetrics& get_metrics() const noexcept { return metrics_; }
+
+    void print_metrics(std::string_view label = {}, std::ostream& os = std::cout) const
+    {
+        const auto& m = metrics_;
+        os << "── Shard worker [" << label << "] home " << home_ << " ────────\n"
+           << "Polls / idle            : " << m.polls << " / " << m.idle_polls << '\n'
+           << "Items home / stolen     : " << m.home_items << " / " << m.stolen_items << '\n'
+           << "Steals / attempts       : " << m.steals << " / " << m.steal_attempts << '\n'
+           << "Claim busy              : " << m.claim_busy << '\n'
+           << "Back-off events / cycles: " << m.backoff_events << " / " << m.backoff_cycles << '\n';
+    }
+
+private:
+    static constexpr std::size_t k_batch = 16;
+
+    // Dequeue one batch from shard s under its claim.
+    std::size_t take(uint32_t s, std::span<Entry> out) noexcept
+    {
+        ShardedQueue::Shard& sh = sq_.shard(s);
+        if (!sh.maybe_pending()) return 0;
+        if (!sh.try_claim()) { ++metrics_.claim_busy; return 0; }
+        const std::size_t n = sh.consumer->dequeue_batch(out);
+        sh.consumed.store(sh.consumer->consumed_tail(), std::memory_order_relaxed);
+        sh.release();
+        return n;
+    }
+
+    ShardedQueue&      sq_;
+    const uint32_t     home_;
+    uint32_t           victim_;
+    ExponentialBackoff backoff_idle_;
+    ShardWorkerMetrics metrics_;
+};
+
+#endif // CXL_SHARDED_QUEUE_HPP_
@@ -0,0 +1,187 @@
+// cxl_stats.hpp
+// ─────────────────────────────────────────────────────────────────────────────
+//  Stats segment – where queue handles export live snapshots
+//
+//   • a run of 64-B lines in shared memory: POSIX shm for one host, or any
+//     CXL region (e.g. from a CxlAllocator) for a monitor on another host
+//   • line 0 = segment header, then per slot a descriptor line (queue
+//     name, side, capacity) followed by the QueueStatsLine the queue
+//     handle publishes into (BasicCxlMpscQueue::set_stats_export)
+//   • every line has a single writer: the header and descriptors are
+//     written by whoever attaches the slot, the snapshot by the queue;
+//     readers never write, so monitoring adds no traffic on queue lines
+//   • slots are assigned by the caller (same convention on every host) –
+//     there is no cross-host allocation of slots
+//
+//  Example
+//   auto seg = StatsSegment::open_shm("/cxlq", 2, /*create=*/true);
+//   q.set_stats_export(StatsRole::producer,
+//                      seg.attach(0, "req", StatsRole::producer, q.capacity()));
+//   q.set_stats_export(StatsRole::consumer,
+//                      seg.attach(1, "req", StatsRole::consumer, q.capacity()));
+//   // elsewhere: ./stats_monitor /cxlq
+// ─────────────────────────────────────────────────────────────────────────────
+#ifndef CXL_STATS_HPP_
+#define CXL_STATS_HPP_
+
+#include <algorithm>
+#include <cassert>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "cxl_mpsc_queue_exp.hpp"
+
+struct alignas(64) StatsSlotDesc {
+    uint64_t magic;            // k_desc_magic once the slot is attached
+    uint64_t capacity;         // ring slots
+    uint8_t  role;             // StatsRole
+    uint8_t  pad[7];
+    char     name[40];         // NUL-terminated queue name
+};
+static_assert(sizeof(StatsSlotDesc) == 64);
+
+struct StatsSlotInfo {
+    std::string name;
+    StatsRole   role;
+    std::size_t capacity;
+};
+
+class StatsSegment {
+public:
+    static constexpr uint64_t k_magic      = 0x5354'4154'5351'4c43ull;   // "CLQSTATS"
+    static constexpr uint64_t k_desc_magic = 0x4353'4544'5351'4c43ull;   // "CLQSDESC"
+    static constexpr uint32_t k_version    = 1;
+
+    static constexpr std::size_t bytes(uint32_t n_slots) noexcept
+    {
+        return 64 * (1 + 2 * std::size_t{n_slots});
+    }
+
+    // ────────────────────────────────────────────────────────────────
+    //  Over memory the caller owns (≥ bytes(n_slots), 64-B aligned).
+    //  do_initialize clears the slots and writes the header; an
+    //  attaching reader passes n_slots = 0 and takes it from the header.
+    // ────────────────────────────────────────────────────────────────
+    StatsSegment(void* base, uint32_t n_slots, bool do_initialize)
+        : base_(static_cast<uint8_t*>(base)), n_slots_(n_slots)
+    {
+        assert((reinterpret_cast<std::uintptr_t>(base) & 63u) == 0 &&
+               "stats segment is not 64-byte aligned");
+        if (do_initialize) {
+            alignas(64) uint8_t zero[64] = {};
+            for (std::size_t off = 64; off < bytes(n_slots_); off += 64)
+                stream_64B(base_ + off, zero);
+            alignas(64) Header h{k_magic, k_version, n_slots_, {}};
+            store_nt_64B(base_, &h);
+        } else {
+            alignas(64) Header h;
+            load_fresh_64B(&h, base_);
+            if (h.magic != k_magic || h.version != k_version)
+                throw std::runtime_error("StatsSegment: no stats header");
+            if (n_slots_ == 0) n_slots_ = h.n_slots;
+            n_slots_ = std::min(n_slots_, h.n_slots);
+        }
+    }
+
+    // POSIX shared memory object `name` ("/cxlq").  create = true sizes and
+    // initialises it; otherwise the slot count comes from its header.
+    static StatsSegment open_shm(const std::string& name, uint32_t n_slots, bool create)
+    {
+        const int fd = ::shm_open(name.c_str(), create ? O_CREAT | O_RDWR : O_RDWR, 0644);
+        if (fd < 0) throw std::runtime_error("shm_open " + name + ": " + std::strerror(errno));
+
+        std::size_t len = bytes(n_slots);
+        if (create) {
+            if (::ftruncate(fd, static_cast<off_t>(len)) != 0) {
+                ::close(fd);
+                throw std::runtime_error("ftruncate " + name + ": " + std::strerror(errno));
+            }
+        } else {
+            struct stat st{};
+            ::fstat(fd, &st);
+            len = static_cast<std::size_t>(st.st_size);
+        }
+        void* p = ::mmap(nullptr, len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (p == MAP_FAILED || len < 64)
+            throw std::runtime_error("mmap " + name + ": " + std::strerror(errno));
+
+        StatsSegment seg(p, create ? n_slots : 0, create);
+        seg.map_len_ = len;
+        seg.n_slots_ = std::min<uint32_t>(seg.n_slots_, static_cast<uint32_t>((len / 64 - 1) / 2));
+        return seg;
+    }
+
+    StatsSegment(const StatsSegment&)            = delete;
+    StatsSegment& operator=(const StatsSegment&) = delete;
+    StatsSegment(StatsSegment&& o) noexcept
+        : base_(o.base_), n_slots_(o.n_slots_), map_len_(std::exchange(o.map_len_, 0)) {}
+    ~StatsSegment() { if (map_len_) ::munmap(base_, map_len_); }
+
+    [[nodiscard]] uint32_t slots() const noexcept { return n_slots_; }
+
+    // Describe `slot` and hand back its snapshot line for set_stats_export().
+    QueueStatsLine* attach(uint32_t slot, std::string_view name,
+                           StatsRole role, std::size_t capacity) noexcept
+    {
+        assert(slot < n_slots_);
+        alignas(64) StatsSlotDesc d{};
+        d.magic    = k_desc_magic;
+        d.capacity = capacity;
+        d.role     = static_cast<uint8_t>(role);
+        std::memcpy(d.name, name.data(), std::min(name.size(), sizeof d.name - 1));
+        store_nt_64B(desc_line(slot), &d);
+        return line(slot);
+    }
+
+    // Fresh read of the descriptor; false for a slot nobody attached.
+    bool describe(uint32_t slot, StatsSlotInfo& out) const
+    {
+        alignas(64) StatsSlotDesc d;
+        load_fresh_64B(&d, desc_line(slot));
+        if (d.magic != k_desc_magic) return false;
+        d.name[sizeof d.name - 1] = '\0';
+        out = StatsSlotInfo{d.name, static_cast<StatsRole>(d.role), d.capacity};
+        return true;
+    }
+
+    // Fresh read of the latest snapshot (see read_stats_line).
+    bool read(uint32_t slot, QueueStatsLine& out) const noexcept
+    {
+        return read_stats_line(line(slot), out);
+    }
+
+    [[nodiscard]] QueueStatsLine* line(uint32_t slot) const noexcept
+    {
+        return reinterpret_cast<QueueStatsLine*>(base_ + 64 * (2 + 2 * std::size_t{slot}));
+    }
+
+private:
+    struct alignas(64) Header {
+        uint64_t magic;
+        uint32_t version;
+        uint32_t n_slots;
+        uint8_t  pad[48];
+    };
+
+    [[nodiscard]] void* desc_line(uint32_t slot) const noexcept
+    {
+        return base_ + 64 * (1 + 2 * std::size_t{slot});
+    }
+
+    uint8_t*    base_;
+    uint32_t    n_slots_;
+    std::size_t map_len_ {0};   // > 0 when open_shm() owns the mapping
+};
+
+#endif // CXL_STATS_HPP_
@@ -0,0 +1,436 @@
+// cxl_stream.hpp
+// ─────────────────────────────────────────────────────────────────────────────
+//  Bulk streaming channel – multi-MB transfers between hosts
+//
+//   • n_chunks buffers of chunk_bytes each, used strictly in ring order
+//     (chunk = seq % n_chunks); a control ring (CxlMpscQueue, P → C)
+//     carries one descriptor per filled chunk {seq, bytes, end-of-message}
+//   • producer: AVX-512 NT-store copy into the chunk, one sfence, then the
+//     descriptor – the chunk is in CXL memory before it is announced
+//   • consumer: keeps up to `window` announced chunks in flight – each is
+//     invalidated (clflushopt) and its head prefetched as soon as its
+//     descriptor is seen, while earlier chunks are still being read
+//   • credit-based flow control: the consumer owns one credit line holding
+//     the number of chunks it has released; the producer may run at most
+//     n_chunks ahead of it and reads the line fresh only when it runs out.
+//     Credits are published every credit_batch releases and when the
+//     consumer finds nothing new, so a stalled producer is not starved
+//   • every shared line keeps a single writer; nothing is read-modify-
+//     written across hosts
+//
+//  Layout (allocation order, same on every host): chunks (4 KiB aligned),
+//  credit line, control tail line, control ring.
+//
+//  Example
+//   StreamChannel ch(alloc, 8, 1 << 20, /*do_initialize=*/true);    // P
+//   ch.send(buf.data(), buf.size());          // blocks on credits only
+//   StreamChannel ch(alloc, 8, 1 << 20, /*do_initialize=*/false);   // C
+//   std::size_t n = ch.receive(out.data(), out.size());  // to end of message
+//   // or in place:
+//   while (auto c = ch.poll()) { use(c.data, c.bytes); ch.release(); }
+// ─────────────────────────────────────────────────────────────────────────────
+#ifndef CXL_STREAM_HPP_
+#define CXL_STREAM_HPP_
+
+#include <algorithm>
+#include <bit>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string_view>
+#include <vector>
+#include <immintrin.h>
+#include <x86intrin.h>
+
+#include "cxl_allocator.hpp"
+#include "cxl_mpsc_queue_exp.hpp"
+
+// ─────────────────────────────────────────────────────────────────────────────
+//  Copy kernels
+// ─────────────────────────────────────────────────────────────────────────────
+
+// src → 64-B aligned dst with NT stores, four lines per step; a partial
+// last line is staged and streamed whole.  No fence (caller fences once).
+static inline void nt_copy_to_cxl(void* dst, const void* src, std::size_t bytes) noexcept
+{
+    auto*             d    = static_cast<uint8_t*>(dst);
+    const auto*       s    = static_cast<const uint8_t*>(src);
+    const std::size_t full = bytes & ~std::size_t{63};
+    std::size_t       off  = 0;
+    for (; off + 256 <= full; off += 256) {
+        const __m512i a = _mm512_loadu_si512(s + off);
+        const __m512i b = _mm512_loadu_si512(s + off + 64);
+        const __m512i c = _mm512_loadu_si512(s + off + 128);
+        const __m512i e = _mm512_loadu_si512(s + off + 192);
+        _mm512_stream_si512(reinterpret_cast<__m512i*>(d + off),       a);
+        _mm512_stream_si512(reinterpret_cast<__m512i*>(d + off + 64),  b);
+        _mm512_stream_si512(reinterpret_cast<__m512i*>(d + off + 128), c);
+        _mm512_stream_si512(reinterpret_cast<__m512i*>(d + off + 192), e);
+    }
+    for (; off < full; off += 64)
+        _mm512_stream_si512(reinterpret_cast<__m512i*>(d + off), _mm512_loadu_si512(s + off));
+    if (const std::size_t rest = bytes - full) {
+        alignas(64) uint8_t line[64] = {};
+        std::memcpy(line, s + full, rest);
+        stream_64B(d + full, line);
+    }
+}
+
+// 64-B aligned (already invalidated) src → dst, four lines per step.
+static inline void copy_from_cxl(void* dst, const void* src, std::size_t bytes) noexcept
+{
+    auto*             d    = static_cast<uint8_t*>(dst);
+    const auto*       s    = static_cast<const uint8_t*>(src);
+    const std::size_t full = bytes & ~std::size_t{63};
+    std::size_t       off  = 0;
+    for (; off + 256 <= full; off += 256) {
+        const __m512i a = _mm512_load_si512(s + off);
+        const __m512i b = _mm512_load_si512(s + off + 64);
+        const __m512i c = _mm512_load_si512(s + off + 128);
+        const __m512i e = _mm512_load_si512(s + off + 192);
+        _mm512_storeu_si512(d + off,       a);
+        _mm512_storeu_si512(d + off + 64,  b);
+        _mm512_storeu_si512(d + off + 128, c);
+        _mm512_storeu_si512(d + off + 192, e);
+    }
+    for (; off < full; off += 64)
+        _mm512_storeu_si512(d + off, _mm512_load_si512(s + off));
+    if (const std::size_t rest = bytes - full) std::memcpy(d + full, s + full, rest);
+}
+
+// ─────────────────────────────────────────────────────────────────────────────
+//  StreamChannel
+// ─────────────────────────────────────────────────────────────────────────────
+struct StreamMetrics {
+    size_t   chunks_sent      {0};   // P
+    size_t   bytes_sent       {0};   // P
+    size_t   credit_waits     {0};   // P: no free chunk, even after a fresh read
+    size_t   credit_probes    {0};   // P: fresh reads of the credit line
+    uint64_t send_first_tsc   {0};   // P: first / last chunk committed
+    uint64_t send_last_tsc    {0};
+    size_t   chunks_received  {0};   // C
+    size_t   bytes_received   {0};   // C
+    size_t   empty_polls      {0};   // C: poll() found nothing announced
+    size_t   lines_flushed    {0};   // C: clflushopt'd chunk lines
+    size_t   credit_updates   {0};   // C: credit line stores
+    size_t   max_in_flight    {0};   // C: announced, not yet released
+    uint64_t recv_first_tsc   {0};   // C: first / last chunk released
+    uint64_t recv_last_tsc    {0};
+};
+
+// A chunk handed out by poll(): readable in place until release().
+struct StreamChunk {
+    const uint8_t* data           {nullptr};
+    std::size_t    bytes          {0};
+    uint64_t       seq            {0};
+    bool           end_of_message {false};
+
+    explicit operator bool() const noexcept { return data != nullptr; }
+};
+
+// The shared memory of one channel; allocate() fixes the layout.
+struct StreamRegion {
+    uint8_t*    chunks      {nullptr};
+    uint64_t*   credit      {nullptr};
+    uint64_t*   tail        {nullptr};
+    Entry*      ring        {nullptr};
+    uint32_t    order       {0};
+    uint32_t    n_chunks    {0};
+    std::size_t chunk_bytes {0};
+
+    static StreamRegion allocate(cxl::CxlAllocator& alloc, uint32_t n_chunks, std::size_t chunk_bytes)
+    {
+        assert(n_chunks >= 1 && chunk_bytes >= 64);
+        StreamRegion r;
+        r.n_chunks    = n_chunks;
+        r.chunk_bytes = (chunk_bytes + 63) & ~std::size_t{63};
+        r.chunks      = static_cast<uint8_t*>(
+            alloc.allocate_aligned(std::size_t{n_chunks} * r.chunk_bytes, 4096));
+        r.credit      = static_cast<uint64_t*>(alloc.allocate_aligned(64, 64));
+        // ring ≥ 2 × n_chunks: credits bound the descriptors outstanding to
+        // n_chunks, the slack covers a consumer tail not yet published
+        r.order = std::max(2u, static_cast<uint32_t>(std::bit_width(n_chunks - 1u)) + 1);
+        r.tail  = static_cast<uint64_t*>(alloc.allocate_aligned(64, 64));
+        r.ring  = static_cast<Entry*>(
+            alloc.allocate_aligned((std::size_t{1} << r.order) * sizeof(Entry), 64));
+        return r;
+    }
+};
+
+class StreamChannel {
+public:
+    // Control-ring descriptor layout (args of one Entry)
+    static constexpr std::size_t k_arg_seq   = 0;
+    static constexpr std::size_t k_arg_bytes = 1;
+    static constexpr std::size_t k_arg_flags = 2;
+    static constexpr uint64_t    k_flag_eom  = 1;      // last chunk of a message
+
+    // ────────────────────────────────────────────────────────────────
+    //  n_chunks × chunk_bytes from `alloc` (same arguments on both
+    //  hosts).  window = chunks the consumer keeps in flight (default
+    //  half the ring); credit_batch = releases per credit-line store.
+    // ────────────────────────────────────────────────────────────────
+    StreamChannel(cxl::CxlAllocator& alloc,
+                  uint32_t           n_chunks,
+                  std::size_t        chunk_bytes,
+                  bool               do_initialize,
+                  uint32_t           window       = 0,
+                  uint32_t           credit_batch = 0)
+        : StreamChannel(StreamRegion::allocate(alloc, n_chunks, chunk_bytes),
+                        do_initialize, window, credit_batch) {}
+
+    // Over a region allocated once, e.g. both ends in one process.
+    StreamChannel(const StreamRegion& r,
+                  bool                do_initialize,
+                  uint32_t            window       = 0,
+                  uint32_t            credit_batch = 0)
+        : n_chunks_(r.n_chunks),
+          chunk_bytes_(r.chunk_bytes),
+          window_(std::clamp<uint32_t>(window ? window : r.n_chunks / 2, 1, r.n_chunks)),
+          credit_batch_(std::clamp<uint32_t>(credit_batch ? credit_batch : r.n_chunks / 4, 1, r.n_chunks)),
+          base_(r.chunks),
+          credit_(r.credit),
+          announced_(r.n_chunks)
+    {
+        if (do_initialize) {
+            alignas(64) uint64_t zero[8] = {};
+            store_nt_64B(credit_, zero);
+        }
+        ctrl_ = std::make_unique<CxlMpscQueue>(r.ring, r.order, r.tail, do_initialize);
+        ctrl_->set_wait_policy(WaitPolicy::none);    // poll() returns, callers wait
+    }
+
+    [[nodiscard]] uint32_t    chunks()      const noexcept { return n_chunks_; }
+    [[nodiscard]] std::size_t chunk_bytes() const noexcept { return chunk_bytes_; }
+    [[nodiscard]] uint32_t    window()      const noexcept { return window_; }
+
+    // ── producer side ───────────────────────────────────────────────
+
+    // Stream `bytes` from src as one message (chunked, NT stores).
+    // Blocks only while all chunks are in flight.
+    void send(const void* src, std::size_t bytes)
+    {
+        const auto* s = static_cast<const uint8_t*>(src);
+        do {
+            const std::size_t n   = std::min(bytes, chunk_bytes_);
+            void*             dst = acquire();
+            nt_copy_to_cxl(dst, s, n);
+            _mm_sfence();
+            commit(n, n == bytes);
+            s     += n;
+            bytes -= n;
+        } while (bytes != 0);
+    }
+
+    // In-place production: the next chunk (chunk_bytes() writable), once
+    // a credit is available.  Fill it, then commit().
+    [[nodiscard]] void* acquire()
+    {
+        for (bool waited = false; sent_ - credits_seen_ >= n_chunks_; ) {
+            ++metrics_.credit_probes;
+            credits_seen_ = load_fresh_u64(credit_);
+            if (sent_ - credits_seen_ < n_chunks_) break;
+            if (!waited) { ++metrics_.credit_waits; waited = true; }
+            cpu_relax_for_cycles(128);
+        }
+        return chunk(sent_);
+    }
+
+    // Announce the acquired chunk: `bytes` valid, eom = last of a message.
+    // Data written with ordinary stores is written back first (clwb);
+    // after send()'s NT copy the lines are already out.
+    void commit(std::size_t bytes, bool end_of_message, bool write_back = false)
+    {
+        assert(bytes <= chunk_bytes_);
+        if (write_back) {
+            uint8_t* p = chunk(sent_);
+            for (std::size_t off = 0; off < bytes; off += 64) _mm_clwb(p + off);
+            _mm_sfence();
+        }
+        Entry d{};
+        d.args[k_arg_seq]   = sent_;
+        d.args[k_arg_bytes] = bytes;
+        d.args[k_arg_flags] = end_of_message ? k_flag_eom : 0;
+        while (!ctrl_->enqueue(d)) { /* cannot stay full: see constructor */ }
+
+        const uint64_t now = __rdtsc();
+        if (metrics_.chunks_sent++ == 0) metrics_.send_first_tsc = now;
+        metrics_.send_last_tsc = now;
+        metrics_.bytes_sent   += bytes;
+        ++sent_;
+    }
+
+    // ── consumer side ───────────────────────────────────────────────
+
+    // Next announced chunk, invalidated and readable in place, or an empty
+    // chunk if none has arrived.  Up to window() chunks may be polled
+    // before release(); release() returns the oldest one.
+    StreamChunk poll()
+    {
+        top_up();
+        if (next_ == seen_) {
+            ++metrics_.empty_polls;
+            if (released_ != published_) publish_credits();   // idle: hand them back
+            return {};
+        }
+        const Announced& a = announced_[next_ % n_chunks_];
+        ++next_;
+        return {chunk(a.seq), a.bytes, a.seq, a.eom};
+    }
+
+    // Give the oldest polled chunk back to the producer.
+    void release()
+    {
+        assert(released_ < next_ && "release() without a polled chunk");
+        const Announced& a = announced_[released_ % n_chunks_];
+        const uint64_t   now = __rdtsc();
+        if (metrics_.chunks_received++ == 0) metrics_.recv_first_tsc = now;
+        metrics_.recv_last_tsc   = now;
+        metrics_.bytes_received += a.bytes;
+        ++released_;
+        if (released_ - published_ >= credit_batch_) publish_credits();
+        top_up();                                  // keep the window full
+    }
+
+    // Copy the next message (or its first `cap` bytes) into dst; blocks
+    // until the message ends or dst is full.  Returns the bytes copied.
+    std::size_t receive(void* dst, std::size_t cap)
+    {
+        auto*       d   = static_cast<uint8_t*>(dst);
+        std::size_t got = 0;
+        while (got < cap) {
+            if (!cur_) {
+                cur_ = poll();
+                if (!cur_) { _mm_pause(); continue; }
+                cur_off_ = 0;
+            }
+            const std::size_t n = std::min(cur_.bytes - cur_off_, cap - got);
+            copy_from_cxl(d + got, cur_.data + cur_off_, n);
+            got      += n;
+            cur_off_ += n;
+            if (cur_off_ < cur_.bytes) break;          // dst full mid-chunk
+            const bool eom = cur_.end_of_message;
+            cur_ = {};
+            release();
+            if (eom) break;
+        }
+        return got;
+    }
+
+    // Push released credits now (e.g. before going idle).
+    void publish_credits() noexcept
+    {
+        store_nt_u64(credit_, released_);
+        published_ = released_;
+        ++metrics_.credit_updates;
+    }
+
+    // ── metrics ─────────────────────────────────────────────────────
+
+    [[nodiscard]] const StreamMetrics& get_metrics() const noexcept { return metrics_; }
+
+    // Throughput of each side: bytes over first → last chunk (TSC).
+    [[nodiscard]] double send_gbps(double tsc_per_ns) const noexcept
+    {
+        return gbps(metrics_.bytes_sent, metrics_.send_first_tsc, metrics_.send_last_tsc, tsc_per_ns);
+    }
+    [[nodiscard]] double receive_gbps(double tsc_per_ns) const noexcept
+    {
+        return gbps(metrics_.bytes_received, metrics_.recv_first_tsc, metrics_.recv_last_tsc, tsc_per_ns);
+    }
+
+    // tsc_per_ns > 0 adds the GB/s lines (measure_tsc_per_ns()).
+    void print_metrics(std::string_view label = {}, std::ostream& os = std::cout,
+                       double tsc_per_ns = 0.0) const
+    {
+        const auto& m = metrics_;
+        os << "\n════════ StreamChannel " << label << " ════════\n"
+           << "Chunks × bytes          : " << n_chunks_ << " × " << chunk_bytes_
+           << "  (window " << window_ << ", credit batch " << credit_batch_ << ")\n"
+           << "Chunks / bytes sent (P) : " << m.chunks_sent << " / " << m.bytes_sent << '\n'
+           << "Credit waits / probes   : " << m.credit_waits << " / " << m.credit_probes << '\n'
+           << "Chunks / bytes recv (C) : " << m.chunks_received << " / " << m.bytes_received << '\n'
+           << "Empty polls (C)         : " << m.empty_polls << '\n'
+           << "Lines flushed (C)       : " << m.lines_flushed << '\n'
+           << "Credit updates (C)      : " << m.credit_updates << '\n'
+           << "Max chunks in flight    : " << m.max_in_flight << '\n';
+        if (tsc_per_ns > 0) {
+            const auto flags = os.flags();
+            os << std::fixed << std::setprecision(2);
+            if (m.chunks_sent > 1)     os << "Send GB/s (P)           : " << send_gbps(tsc_per_ns) << '\n';
+            if (m.chunks_received > 1) os << "Receive GB/s (C)        : " << receive_gbps(tsc_per_ns) << '\n';
+            os.flags(flags);
+        }
+    }
+
+private:
+    struct Announced {
+        uint64_t    seq   {0};
+        std::size_t bytes {0};
+        bool        eom   {false};
+    };
+
+    [[nodiscard]] uint8_t* chunk(uint64_t seq) const noexcept
+    {
+        return base_ + (seq % n_chunks_) * chunk_bytes_;
+    }
+
+    // Take descriptors while the window has room; invalidate each chunk
+    // and prefetch its first lines so the loads overlap earlier chunks.
+    void top_up()
+    {
+        Entry d;
+        while (seen_ - released_ < window_ && ctrl_->dequeue(d)) {
+            Announced& a = announced_[seen_ % n_chunks_];
+            a.seq   = d.args[k_arg_seq];
+            a.bytes = d.args[k_arg_bytes];
+            a.eom   = (d.args[k_arg_flags] & k_flag_eom) != 0;
+            assert(a.seq == seen_ && "stream descriptors out of order");
+
+            uint8_t* p = chunk(a.seq);
+            for (std::size_t off = 0; off < a.bytes; off += 64) _mm_clflushopt(p + off);
+            _mm_sfence();
+            for (std::size_t off = 0; off < std::min<std::size_t>(a.bytes, k_prefetch_bytes); off += 64)
+                _mm_prefetch(reinterpret_cast<const char*>(p + off), _MM_HINT_T0);
+            metrics_.lines_flushed += (a.bytes + 63) / 64;
+            ++seen_;
+            metrics_.max_in_flight = std::max<size_t>(metrics_.max_in_flight, seen_ - released_);
+        }
+    }
+
+    static double gbps(std::size_t bytes, uint64_t t0, uint64_t t1, double tsc_per_ns) noexcept
+    {
+        return t1 > t0 && tsc_per_ns > 0 ? double(bytes) / (double(t1 - t0) / tsc_per_ns) : 0.0;
+    }
+
+    static constexpr std::size_t k_prefetch_bytes = 4096;
+
+    const uint32_t    n_chunks_;
+    const std::size_t chunk_bytes_;
+    const uint32_t    window_;
+    const uint32_t    credit_batch_;
+    uint8_t*          base_;
+    uint64_t*         credit_;             // C writes (released count), P reads
+    std::unique_ptr<CxlMpscQueue> ctrl_;   // P enqueues descriptors, C dequeues
+
+    /* producer side */
+    uint64_t sent_         {0};
+    uint64_t credits_seen_ {0};
+
+    /* consumer side */
+    std::vector<Announced> announced_;     // by seq % n_chunks
+    uint64_t    seen_      {0};            // descriptors taken
+    uint64_t    next_      {0};            // next to hand out from poll()
+    uint64_t    released_  {0};
+    uint64_t    published_ {0};            // last value on the credit line
+    StreamChunk cur_       {};             // receive(): chunk being copied
+    std::size_t cur_off_   {0};
+
+    StreamMetrics metrics_;
+};
+
+#endif // CXL_STREAM_HPP_
@@ -0,0 +1,260 @@
+// cxl_topology.hpp
+// ─────────────────────────────────────────────────────────────────────────────
+//  Topology-aware thread placement for queue benchmarks and services
+//
+//   • Topology::discover() reads the CPUs this process may run on
+//     (sched_getaffinity), their core / package / SMT siblings (sysfs) and
+//     the NUMA node distances (libnuma)
+//   • dax_numa_node(path) maps a /dev/dax device to the node that backs it,
+//     so DAX runs place threads like NUMA runs do
+//   • place(mem_node, n) orders CPUs for n hot pollers: one thread per
+//     physical core, nearest CPU node to the queue memory first (CXL
+//     nodes have no CPUs – the closest socket wins), farther nodes next,
+//     SMT siblings only once every core has a thread
+//   • Placement::print() logs the chosen layout; pin_thread() applies it
+//
+//  The ordering is deterministic (distance, node id, core, cpu id), so
+//  the same `auto` run lands on the same cores on every host that has the
+//  same shape.
+//
+//  Example
+//   const auto topo = cxl::Topology::discover();
+//   const auto plan = topo.place(/*mem_node=*/2, /*threads=*/2);
+//   plan.print(std::cout, {"client", "server"});
+//   std::thread server([&] { cxl::pin_thread(plan[1]); /* … */ });
+//   cxl::pin_thread(plan[0]);
+// ─────────────────────────────────────────────────────────────────────────────
+#ifndef CXL_TOPOLOGY_HPP_
+#define CXL_TOPOLOGY_HPP_
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <iomanip>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <utility>
+#include <vector>
+#include <numa.h>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+
+namespace cxl {
+
+// ─────────────────────────────────────────────────────────────────────────────
+//  sysfs helpers
+// ─────────────────────────────────────────────────────────────────────────────
+namespace detail {
+
+inline int read_sysfs_int(const std::string& path, int fallback) noexcept
+{
+    std::ifstream f(path);
+    int v;
+    return (f >> v) ? v : fallback;
+}
+
+} // namespace detail
+
+/// NUMA node backing a device-DAX path such as "/dev/dax1.0", or -1.
+/// A dax device onlined as system-ram reports target_node; the node the
+/// device hangs off is the fallback.
+inline int dax_numa_node(std::string_view dev_path)
+{
+    const auto slash = dev_path.rfind('/');
+    const std::string name(dev_path.substr(slash == std::string_view::npos ? 0 : slash + 1));
+    const std::string dir = "/sys/bus/dax/devices/" + name + '/';
+    const int target = detail::read_sysfs_int(dir + "target_node", -1);
+    return target >= 0 ? target : detail::read_sysfs_int(dir + "numa_node", -1);
+}
+
+/// pin the calling thread to one CPU; false (errno set) if refused
+inline bool pin_thread(unsigned cpu) noexcept
+{
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return ::pthread_setaffinity_np(::pthread_self(), sizeof(set), &set) == 0;
+}
+
+// ─────────────────────────────────────────────────────────────────────────────
+//  Topology
+// ─────────────────────────────────────────────────────────────────────────────
+struct CpuInfo {
+    unsigned cpu;       // logical CPU id
+    int      node;      // NUMA node of the CPU
+    int      package;   // physical_package_id
+    int      core;      // core_id (unique within the package)
+};
+
+struct PlacedCpu {
+    unsigned cpu;
+    int      node;
+    int      distance;  // NUMA distance node → memory node
+    bool     core_shared;  // another placed thread runs on this core
+};
+
+struct Placement {
+    int                    mem_node {-1};
+    std::vector<PlacedCpu> threads;
+    bool                   oversubscribed {false};  // more threads than CPUs
+
+    unsigned operator[](std::size_t i) const noexcept { return threads[i].cpu; }
+    std::size_t size() const noexcept { return threads.size(); }
+
+    void print(std::ostream& os, const std::vector<std::string>& roles = {}) const
+    {
+        os << "Placement for memory node " << mem_node
+           << (oversubscribed ? " (oversubscribed)" : "") << '\n';
+        for (std::size_t i = 0; i < threads.size(); ++i) {
+            const PlacedCpu& t = threads[i];
+            const std::string role = i < roles.size() ? roles[i] : "thread " + std::to_string(i);
+            os << "  " << std::left << std::setw(12) << role << std::right
+               << " cpu " << std::setw(3) << t.cpu << "  node " << t.node
+               << "  distance " << t.distance << (t.core_shared ? "  core shared" : "") << '\n';
+        }
+    }
+};
+
+class Topology {
+public:
+    /// `distance[a][b]` is the NUMA distance between nodes a and b
+    Topology(std::vector<CpuInfo> cpus, std::vector<std::vector<int>> distance)
+        : cpus_{std::move(cpus)}, distance_{std::move(distance)} {}
+
+    /// the CPUs in this process' affinity mask, as the kernel reports them
+    static Topology discover()
+    {
+        const bool numa = ::numa_available() != -1;
+        cpu_set_t allowed;
+        CPU_ZERO(&allowed);
+        if (::sched_getaffinity(0, sizeof(allowed), &allowed) != 0)
+            for (unsigned c = 0; c < CPU_SETSIZE; ++c) CPU_SET(c, &allowed);
+
+        std::vector<CpuInfo> cpus;
+        const unsigned n_conf = static_cast<unsigned>(std::max(1L, ::sysconf(_SC_NPROCESSORS_CONF)));
+        for (unsigned c = 0; c < n_conf && c < CPU_SETSIZE; ++c) {
+            if (!CPU_ISSET(c, &allowed)) continue;
+            const std::string t = "/sys/devices/system/cpu/cpu" + std::to_string(c) + "/topology/";
+            const int node = numa ? ::numa_node_of_cpu(static_cast<int>(c)) : 0;
+            cpus.push_back({c, std::max(node, 0),
+                            detail::read_sysfs_int(t + "physical_package_id", 0),
+                            detail::read_sysfs_int(t + "core_id", static_cast<int>(c))});
+        }
+
+        const int n_nodes = numa ? ::numa_max_node() + 1 : 1;
+        std::vector<std::vector<int>> dist(n_nodes, std::vector<int>(n_nodes, 10));
+        if (numa)
+            for (int a = 0; a < n_nodes; ++a)
+                for (int b = 0; b < n_nodes; ++b) {
+                    const int d = ::numa_distance(a, b);   // 0: node absent
+                    dist[a][b] = d > 0 ? d : (a == b ? 10 : 255);
+                }
+        return Topology(std::move(cpus), std::move(dist));
+    }
+
+    const std::vector<CpuInfo>& cpus() const noexcept { return cpus_; }
+    int nodes() const noexcept { return static_cast<int>(distance_.size()); }
+
+    int distance(int a, int b) const noexcept
+    {
+        if (a < 0 || b < 0 || a >= nodes() || b >= nodes()) return a == b ? 10 : 255;
+        return distance_[a][b];
+    }
+
+    /// node of `cpu`, or -1 if it is not in the topology
+    int node_of(unsigned cpu) const noexcept
+    {
+        for (const CpuInfo& c : cpus_) if (c.cpu == cpu) return c.node;
+        return -1;
+    }
+
+    bool smt_siblings(unsigned a, unsigned b) const noexcept
+    {
+        const CpuInfo* ca = find(a);
+        const CpuInfo* cb = find(b);
+        return ca && cb && a != b && ca->package == cb->package && ca->core == cb->core;
+    }
+
+    // ────────────────────────────────────────────────────────────────
+    //  place — `n` CPUs for hot pollers on memory at `mem_node`
+    //
+    //  Memory node -1 (unknown) is treated as the node of the first CPU.
+    //  Beyond one thread per CPU the order wraps and `oversubscribed`
+    //  is set, so callers on small machines still get a layout.
+    // ────────────────────────────────────────────────────────────────
+    Placement place(int mem_node, std::size_t n) const
+    {
+        Placement p;
+        p.mem_node = mem_node;
+        if (cpus_.empty() || n == 0) return p;
+        const int mem = mem_node >= 0 ? mem_node : cpus_.front().node;
+
+        // first CPU of each core gets rank 0, its siblings 1, 2, …
+        std::vector<std::pair<unsigned, const CpuInfo*>> ranked;
+        for (const CpuInfo& c : cpus_) {
+            unsigned rank = 0;
+            for (const CpuInfo& o : cpus_)
+                if (o.cpu < c.cpu && o.package == c.package && o.core == c.core) ++rank;
+            ranked.emplace_back(rank, &c);
+        }
+        const auto key = [&](const std::pair<unsigned, const CpuInfo*>& r) {
+            return std::tuple(r.first, distance(r.second->node, mem), r.second->node,
+                              r.second->package, r.second->core, r.second->cpu);
+        };
+        std::sort(ranked.begin(), ranked.end(),
+                  [&](const auto& a, const auto& b) { return key(a) < key(b); });
+
+        p.oversubscribed = n > ranked.size();
+        for (std::size_t i = 0; i < n; ++i) {
+            const CpuInfo& c = *ranked[i % ranked.size()].second;
+            p.threads.push_back({c.cpu, c.node, distance(c.node, mem), false});
+        }
+        for (PlacedCpu& t : p.threads)
+            for (const PlacedCpu& o : p.threads)
+                if (&t != &o && (o.cpu == t.cpu || smt_siblings(o.cpu, t.cpu))) t.core_shared = true;
+        return p;
+    }
+
+    /// CPU for a thread that polls against one already running on `cpu`:
+    /// nearest other core to `mem_node`, never an SMT sibling of `cpu`
+    /// unless nothing else is left
+    unsigned partner_of(unsigned cpu, int mem_node) const
+    {
+        const Placement all = place(mem_node, cpus_.size());
+        for (const PlacedCpu& t : all.threads)
+            if (t.cpu != cpu && !smt_siblings(t.cpu, cpu)) return t.cpu;
+        for (const PlacedCpu& t : all.threads)
+            if (t.cpu != cpu) return t.cpu;
+        return cpu;
+    }
+
+    void print(std::ostream& os) const
+    {
+        os << "Topology: " << cpus_.size() << " CPU(s) on " << nodes() << " node(s)\n";
+        for (int a = 0; a < nodes(); ++a) {
+            std::size_t n_cpus = 0;
+            for (const CpuInfo& c : cpus_) n_cpus += c.node == a;
+            os << "  node " << a << "  " << std::setw(3) << n_cpus << " CPU(s)  distance";
+            for (int b = 0; b < nodes(); ++b) os << ' ' << std::setw(3) << distance(a, b);
+            os << '\n';
+        }
+    }
+
+private:
+    const CpuInfo* find(unsigned cpu) const noexcept
+    {
+        for (const CpuInfo& c : cpus_) if (c.cpu == cpu) return &c;
+        return nullptr;
+    }
+
+    std::vector<CpuInfo>          cpus_;
+    std::vector<std::vector<int>> distance_;
+};
+
+} // namespace cxl
+
+#endif // CXL_TOPOLOGY_HPP_
@@ -1,8 +1,30 @@
 // doorbell_benchmark.cpp — 64-byte door-bell micro-benchmark
 //
 // CLI:
-//   ./doorbell_benchmark pin <cpu_id> dax
-//   ./doorbell_benchmark pin <cpu_id> numa <node_id>
+//   ./doorbell_benchmark pin <cpu_id> dax              [mode …]
+//   ./doorbell_benchmark pin <cpu_id> numa <node_id>   [mode …]
+//
+// Modes:
+//   issue                                   (default) issue cost per OpType:
+//                                           one core, tight loop
+//   visibility [reader_cpu [rounds [poll]]] store-to-observe latency: the
+//                                           writer on cpu_id stamps its TSC
+//                                           into the line(s) and stores them
+//                                           with each OpType; a reader on
+//                                           reader_cpu (default cpu_id+1)
+//                                           polls until it sees them and
+//                                           records now − stamp.  poll =
+//                                           flush (clflushopt + load, as the
+//                                           queue consumer does, default) or
+//                                           plain (coherent load).
+//   bandwidth [threads [MiB]]               stream a region (default 256 MiB)
+//                                           from 1, 2, 4 … threads (cpu_id,
+//                                           cpu_id+1, …), per write/read
+//                                           method, one sfence per 4 KiB
+//
+// Visibility covers the store methods (checksum / flag variants cost more
+// to issue but become visible like their base store).  Writer and reader
+// share one TSC, so this is cross-core / cross-socket on one host.
 //
 // Build (GCC ≥ 12 or Clang ≥ 15):
 //   g++ -O3 -std=c++20 -march=native -mavx512f -mavx512bw \
@@ -17,9 +39,12 @@
 #include <sched.h>
 #include <unistd.h>
 
+#include <algorithm>
+#include <atomic>
 #include <chrono>
 #include <cstdint>
 #include <cstdlib>
+#include <cstring>
 #include <iomanip>
 #include <iostream>
 #include <memory>
@@ -81,13 +106,24 @@ struct Config {
     int                cpu_id    = 0;
     enum class Mode { dax, numa } mode = Mode::dax;
     int                numa_node = 0;
+
+    enum class Bench { issue, visibility, bandwidth } bench = Bench::issue;
+    int                reader_cpu = -1;          // visibility: −1 → cpu_id + 1
+    std::size_t        rounds     = 200'000;     // visibility
+    bool               poll_flush = true;        // visibility
+    unsigned           threads    = 0;           // bandwidth: 0 → #CPUs
+    std::size_t        region_mib = 256;         // bandwidth
 };
 
 [[noreturn]] static void print_usage(const char* prog)
 {
     std::cerr << "Usage:\n"
-              << "  " << prog << " pin <cpu_id> dax\n"
-              << "  " << prog << " pin <cpu_id> numa <alloc_node>\n";
+              << "  " << prog << " pin <cpu_id> dax               [mode …]\n"
+              << "  " << prog << " pin <cpu_id> numa <alloc_node> [mode …]\n"
+              << "modes : issue (default)\n"
+              << "        visibility [reader_cpu [rounds [flush|plain]]]\n"
+              << "        bandwidth  [threads [MiB]]   (dax: MiB below the "
+              << (cxl::DaxAllocator::default_length >> 20) << " MiB mapping)\n";
     std::exit(EXIT_FAILURE);
 }
 
@@ -100,22 +136,63 @@ static Config parse_cli(int argc, char** argv)
     cfg.cpu_id = std::atoi(argv[2]);
 
     std::string mode = argv[3];
+    int next = 4;
     if (mode == "dax") {
         cfg.mode = Config::Mode::dax;
     } else if (mode == "numa") {
         if (argc < 5) print_usage(argv[0]);
         cfg.mode      = Config::Mode::numa;
         cfg.numa_node = std::atoi(argv[4]);
+        next          = 5;
     } else {
         print_usage(argv[0]);
     }
+
+    if (argc > next) {
+        const std::string bench = argv[next++];
+        if (bench == "issue") {
+            cfg.bench = Config::Bench::issue;
+        } else if (bench == "visibility") {
+            cfg.bench = Config::Bench::visibility;
+            if (argc > next) cfg.reader_cpu = std::atoi(argv[next++]);
+            if (argc > next) cfg.rounds     = std::stoull(argv[next++]);
+            if (argc > next) {
+                const std::string poll = argv[next++];
+                if (poll != "flush" && poll != "plain") print_usage(argv[0]);
+                cfg.poll_flush = poll == "flush";
+            }
+        } else if (bench == "bandwidth") {
+            cfg.bench = Config::Bench::bandwidth;
+            if (argc > next) cfg.threads    = std::stoul(argv[next++]);
+            if (argc > next) cfg.region_mib = std::stoull(argv[next++]);
+        } else {
+            print_usage(argv[0]);
+        }
+    }
+    if (cfg.bench == Config::Bench::bandwidth) {
+        // the DAX mapping has a fixed size; refuse a region it cannot hold
+        // here rather than fail in allocate_aligned() after the setup
+        const std::size_t max_mib = cfg.mode == Config::Mode::dax
+                                  ? (cxl::DaxAllocator::default_length - 4096) >> 20
+                                  : std::size_t{1} << 30;
+        if (cfg.region_mib == 0 || cfg.region_mib > max_mib) {
+            std::cerr << "bandwidth: region of " << cfg.region_mib << " MiB, must be 1…"
+                      << max_mib << " MiB\n";
+            print_usage(argv[0]);
+        }
+    }
+    if (cfg.reader_cpu < 0) cfg.reader_cpu = cfg.cpu_id + 1;
     return cfg;
 }
 
 static std::unique_ptr<cxl::CxlAllocator>
 make_allocator(const Config& cfg)
 {
-    constexpr std::size_t arena_size = 64 * 2;   // two cache lines
+    // two cache lines, or the bandwidth region (+ a page of slack;
+    // parse_cli() keeps it within the DAX mapping)
+    const std::size_t arena_size = cfg.bench == Config::Bench::bandwidth
+                                 ? (cfg.region_mib << 20) + 4096
+                                 : 64 * 2;
     if (cfg.mode == Config::Mode::dax)
         return std::make_unique<cxl::DaxAllocator>();
     return std::make_unique<cxl::NumaAllocator>(cfg.numa_node,
@@ -318,6 +395,242 @@ static void benchmark(cxl::CxlAllocator& alloc, std::vector<Result>& out)
     }
 }
 
+/* ─ visibility: store-to-observe latency ──────────────────────────────── */
+// Lines written per round by a visibility OpType; 0 = not measured here.
+static int visible_lines(OpType op)
+{
+    switch (op) {
+        case OpType::REG_CLFLUSH_SINGLE:
+        case OpType::REG_CLFLUSHOPT_SINGLE:
+        case OpType::REG_CLWB_SINGLE:
+        case OpType::SCALAR8_CLWB_SINGLE:
+        case OpType::NT_STREAM_SINGLE:
+        case OpType::MOVDIR_SINGLE:          return 1;
+        case OpType::REG_CLFLUSHOPT_DOUBLE:
+        case OpType::NT_STREAM_DOUBLE:
+        case OpType::MOVDIR_DOUBLE:          return 2;
+        default:                             return 0;
+    }
+}
+
+// The write side of one round, exactly as the issue benchmark does it.
+static inline void issue_visible(OpType op, uint8_t* dst, uint8_t* dst2, const uint8_t* src)
+{
+    const auto v = *reinterpret_cast<const __m512i*>(src);
+    switch (op) {
+        case OpType::REG_CLFLUSH_SINGLE:
+            _mm512_store_si512(reinterpret_cast<__m512i*>(dst), v); clflush(dst); sfence(); break;
+        case OpType::REG_CLFLUSHOPT_SINGLE:
+            _mm512_store_si512(reinterpret_cast<__m512i*>(dst), v); clflush_opt(dst); sfence(); break;
+        case OpType::REG_CLWB_SINGLE:
+            _mm512_store_si512(reinterpret_cast<__m512i*>(dst), v); clwb(dst); sfence(); break;
+        case OpType::SCALAR8_CLWB_SINGLE: {
+            const uint64_t* s64 = reinterpret_cast<const uint64_t*>(src);
+            volatile uint64_t* d64 = reinterpret_cast<uint64_t*>(dst);
+            for (int j = 7; j >= 0; --j) d64[j] = s64[j];     // seq word last
+            clwb(dst); sfence(); break;
+        }
+        case OpType::NT_STREAM_SINGLE:
+            _mm512_stream_si512(reinterpret_cast<__m512i*>(dst), v); sfence(); break;
+        case OpType::MOVDIR_SINGLE:
+            movdir64b(dst, src); sfence(); break;
+        case OpType::REG_CLFLUSHOPT_DOUBLE:
+            _mm512_store_si512(reinterpret_cast<__m512i*>(dst), v);
+            _mm512_store_si512(reinterpret_cast<__m512i*>(dst2), v);
+            clflush_opt(dst); clflush_opt(dst2); sfence(); break;
+        case OpType::NT_STREAM_DOUBLE:
+            _mm512_stream_si512(reinterpret_cast<__m512i*>(dst), v);
+            _mm512_stream_si512(reinterpret_cast<__m512i*>(dst2), v);
+            sfence(); break;
+        case OpType::MOVDIR_DOUBLE:
+            movdir64b(dst, src);  sfence();
+            movdir64b(dst2, src); sfence(); break;
+        default: break;
+    }
+}
+
+// Word 0 of an observed line: with `flush` the reader drops its copy
+// first (non-coherent CXL reader), otherwise a plain coherent load.
+static inline uint64_t observe_seq(uint8_t* line, bool flush)
+{
+    if (flush) { clflush_opt(line); sfence(); }
+    return *reinterpret_cast<volatile uint64_t*>(line);
+}
+
+static void visibility(cxl::CxlAllocator& alloc, const Config& cfg)
+{
+    uint8_t* dst  = static_cast<uint8_t*>(alloc.allocate_aligned(k_line));
+    uint8_t* dst2 = static_cast<uint8_t*>(alloc.allocate_aligned(k_line));
+    const double ghz = rdtsc_ghz();
+
+    std::cout << "Store-to-observe latency, writer cpu " << cfg.cpu_id << " → reader cpu "
+              << cfg.reader_cpu << ", " << cfg.rounds << " rounds, reader poll: "
+              << (cfg.poll_flush ? "clflushopt+load" : "plain load") << "\n\n"
+              << std::left << std::setw(36) << "Operation (ns)" << std::right
+              << std::setw(11) << "min" << std::setw(11) << "p50" << std::setw(11) << "p90"
+              << std::setw(11) << "p99" << std::setw(11) << "p99.9" << '\n';
+    if (cfg.rounds == 0) return;
+
+    for (OpType op : all_op_types()) {
+        const int lines = visible_lines(op);
+        if (lines == 0) continue;
+        if ((op == OpType::MOVDIR_SINGLE || op == OpType::MOVDIR_DOUBLE) && !has_movdir64b()) {
+            std::cerr << "[WARN] CPU lacks MOVDIR64B — skipping\n";
+            continue;
+        }
+        std::memset(dst, 0, k_line);  std::memset(dst2, 0, k_line);
+        clflush(dst); clflush(dst2); sfence();
+
+        // Seen-acks travel over a host-local word, so only the measured
+        // direction touches the target memory.
+        alignas(64) std::atomic<uint64_t> ack{0};
+        std::vector<uint64_t> lat;
+        lat.reserve(cfg.rounds);
+
+        std::thread reader([&] {
+            pin_to_cpu(cfg.reader_cpu);
+            for (uint64_t seq = 1; seq <= cfg.rounds; ++seq) {
+                while (observe_seq(dst, cfg.poll_flush) != seq) {}
+                if (lines == 2) while (observe_seq(dst2, cfg.poll_flush) != seq) {}
+                const uint64_t now = __rdtsc();
+                const uint64_t t0  = reinterpret_cast<volatile uint64_t*>(dst)[1];
+                lat.push_back(now - t0);
+                ack.store(seq, std::memory_order_release);
+            }
+        });
+
+        alignas(64) uint8_t src[k_line] = {0};
+        auto* w = reinterpret_cast<uint64_t*>(src);
+        for (uint64_t seq = 1; seq <= cfg.rounds; ++seq) {
+            w[0] = seq;
+            w[1] = __rdtsc();
+            issue_visible(op, dst, dst2, src);
+            while (ack.load(std::memory_order_acquire) != seq) _mm_pause();
+        }
+        reader.join();
+
+        std::sort(lat.begin(), lat.end());
+        const auto pct = [&](double p) {
+            return lat[std::min(lat.size() - 1, static_cast<std::size_t>(p * lat.size()))] / ghz;
+        };
+        std::cout << std::left << std::setw(36) << op_name(op) << std::right << std::fixed
+                  << std::setprecision(1) << std::setw(11) << pct(0.0) << std::setw(11) << pct(0.5)
+                  << std::setw(11) << pct(0.9) << std::setw(11) << pct(0.99)
+                  << std::setw(11) << pct(0.999) << '\n';
+    }
+}
+
+/* ─ bandwidth: many lines, many threads ───────────────────────────────── */
+enum class BwOp : uint8_t { store_clflushopt, store_clwb, nt_stream, movdir, flush_load, nt_load };
+
+static const char* bw_name(BwOp op)
+{
+    switch (op) {
+        case BwOp::store_clflushopt: return "write  store+clflushopt";
+        case BwOp::store_clwb:       return "write  store+clwb";
+        case BwOp::nt_stream:        return "write  non_temporal_stream";
+        case BwOp::movdir:           return "write  movdir64B";
+        case BwOp::flush_load:       return "read   clflushopt+load";
+        case BwOp::nt_load:          return "read   clflushopt+nt_load";
+    }
+    return "unknown";
+}
+
+// One pass over [p, p + bytes); returns a fold of what was read.
+static uint64_t bw_pass(BwOp op, uint8_t* p, std::size_t bytes)
+{
+    constexpr std::size_t k_chunk = 4096;            // one sfence per chunk
+    alignas(64) uint8_t src[k_line];
+    std::memset(src, 0xa5, sizeof src);
+    const auto v = *reinterpret_cast<const __m512i*>(src);
+    __m512i acc = _mm512_setzero_si512();
+
+    for (std::size_t off = 0; off < bytes; off += k_chunk) {
+        uint8_t* c = p + off;
+        switch (op) {
+            case BwOp::store_clflushopt:
+                for (std::size_t l = 0; l < k_chunk; l += k_line) {
+                    _mm512_store_si512(reinterpret_cast<__m512i*>(c + l), v); clflush_opt(c + l);
+                }
+                break;
+            case BwOp::store_clwb:
+                for (std::size_t l = 0; l < k_chunk; l += k_line) {
+                    _mm512_store_si512(reinterpret_cast<__m512i*>(c + l), v); clwb(c + l);
+                }
+                break;
+            case BwOp::nt_stream:
+                for (std::size_t l = 0; l < k_chunk; l += k_line)
+                    _mm512_stream_si512(reinterpret_cast<__m512i*>(c + l), v);
+                break;
+            case BwOp::movdir:
+                for (std::size_t l = 0; l < k_chunk; l += k_line) movdir64b(c + l, src);
+                break;
+            case BwOp::flush_load:
+            case BwOp::nt_load:
+                for (std::size_t l = 0; l < k_chunk; l += k_line) clflush_opt(c + l);
+                sfence();
+                for (std::size_t l = 0; l < k_chunk; l += k_line)
+                    acc = _mm512_xor_si512(acc, op == BwOp::nt_load
+                        ? _mm512_stream_load_si512(c + l)
+                        : _mm512_load_si512(c + l));
+                break;
+        }
+        sfence();
+    }
+    return static_cast<uint64_t>(_mm512_reduce_or_epi64(acc));
+}
+
+static void bandwidth(cxl::CxlAllocator& alloc, const Config& cfg)
+{
+    const std::size_t bytes = cfg.region_mib << 20;
+    auto* region = static_cast<uint8_t*>(alloc.allocate_aligned(bytes, 4096));
+    std::memset(region, 0, bytes);                     // fault it in up front
+
+    const unsigned n_cpus  = std::max(1u, std::thread::hardware_concurrency());
+    const unsigned max_thr = cfg.threads ? cfg.threads : n_cpus;
+    const bool     movdir  = has_movdir64b();
+
+    std::cout << "Bandwidth over " << cfg.region_mib << " MiB (GB/s, best of 3 passes)\n\n"
+              << std::left << std::setw(30) << "Method";
+    for (unsigned t = 1; t <= max_thr; t *= 2) std::cout << std::right << std::setw(8) << t << 'T';
+    std::cout << '\n' << std::fixed << std::setprecision(2);
+
+    for (BwOp op : {BwOp::store_clflushopt, BwOp::store_clwb, BwOp::nt_stream,
+                    BwOp::movdir, BwOp::flush_load, BwOp::nt_load}) {
+        if (op == BwOp::movdir && !movdir) continue;
+        std::cout << std::left << std::setw(30) << bw_name(op) << std::right;
+        for (unsigned t = 1; t <= max_thr; t *= 2) {
+            // slices 4 KiB aligned; the last thread takes the remainder
+            const std::size_t slice = bytes / t & ~std::size_t{4095};
+            double best = 0;
+            for (int pass = 0; pass < 3; ++pass) {
+                std::vector<std::thread> ts;
+                std::vector<uint64_t>    sums(t);
+                std::atomic<unsigned> ready{0};
+                std::atomic<bool>     go{false};
+                for (unsigned i = 0; i < t; ++i)
+                    ts.emplace_back([&, i] {
+                        pin_to_cpu(static_cast<int>((cfg.cpu_id + i) % n_cpus));
+                        const std::size_t len = i + 1 == t ? bytes - slice * i : slice;
+                        ready.fetch_add(1);
+                        while (!go.load(std::memory_order_acquire)) {}
+                        sums[i] = bw_pass(op, region + slice * i, len);
+                    });
+                while (ready.load() != t) std::this_thread::yield();
+                const auto t0 = std::chrono::steady_clock::now();
+                go.store(true, std::memory_order_release);
+                for (auto& th : ts) th.join();
+                for (uint64_t x : sums) nt_load_checksum += x;
+                const double s = std::chrono::duration<double>(
+                    std::chrono::steady_clock::now() - t0).count();
+                best = std::max(best, double(bytes) / s / 1e9);
+            }
+            std::cout << std::setw(9) << best;
+        }
+        std::cout << '\n';
+    }
+}
+
 /* ─ main ──────────────────────────────────────────────────────────────── */
 int main(int argc, char** argv)
 {
@@ -335,6 +648,13 @@ int main(int argc, char** argv)
         return EXIT_FAILURE;
     }
 
+    if (cfg.bench == Config::Bench::visibility) { visibility(*allocator, cfg); return 0; }
+    if (cfg.bench == Config::Bench::bandwidth)  {
+        bandwidth(*allocator, cfg);
+        std::cout << "\n  checksum (ignore): " << nt_load_checksum << '\n';
+        return 0;
+    }
+
     /* run benchmark */
     std::vector<Result> results;
     benchmark(*allocator, results);
@@ -1,16 +1,85 @@
-// flush_page_bench.cpp
-#include <x86intrin.h>   // _mm_clwb, _mm_clflushopt, _mm_clflush, _mm_mfence
-#include <numa.h>        // numa_alloc_onnode, numa_free, numa_available
-#include <ctime>         // clock_gettime
+// flush_wb.cpp — CXL vs DRAM memory characterization
+//
+// CLI:
+//   ./flush_wb <target> [<target> …] [sections=…] [mib=256] [threads=N] [cpu=0]
+//     target   : numa:<node> | <node> (same) | dax   (through CxlAllocator)
+//     sections : comma list of
+//                flush  – dirty + flush a 4 / 8 KiB page per method (the
+//                         original benchmark)
+//                chase  – dependent-load (pointer-chasing) latency over a
+//                         `mib` working set, plain and with clflushopt +
+//                         sfence before every load (the consumer's pattern)
+//                bw     – read / write / NT-write bandwidth, 1, 2, 4 …
+//                         `threads` threads
+//                loaded – chase latency while threads−1 injectors stream
+//                         reads at decreasing inter-burst delays
+//                tune   – queue defaults derived from chase + bw
+//                (default: all)
+//     mib      : working set / bandwidth region per target (default 256)
+//     threads  : max threads for bw / loaded (default #CPUs)
+//     cpu      : first CPU; thread i runs on cpu + i
+//
+// The tune section turns the measurements into starting points for
+// CxlMpscQueue (see tune_queue() for the rules); feed them to
+// sweep_bench to confirm on the host.
+//
+// Example:
+//   ./flush_wb numa:0 numa:2 sections=chase,bw,tune mib=512 threads=16
+//
+// Build:
+//   make flush_wb
+// ---------------------------------------------------------------------------
+
+#include "cxl_allocator.hpp"
+
+#include <immintrin.h>
+#include <x86intrin.h>   // _mm_clwb, _mm_clflushopt, _mm_clflush, __rdtsc
+#include <numa.h>
+#include <pthread.h>
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cctype>
+#include <cmath>
 #include <cstdint>
+#include <cstdlib>
 #include <cstring>
+#include <ctime>         // clock_gettime
 #include <iomanip>
 #include <iostream>
+#include <memory>
+#include <numeric>
+#include <random>
+#include <set>
+#include <sstream>
+#include <string>
+#include <thread>
 #include <vector>
 
 constexpr std::size_t k_line_bytes = 64;
 constexpr std::size_t k_iters      = 100000;
 
+using Steady = std::chrono::steady_clock;
+
+static void pin_to_cpu(unsigned cpu)
+{
+    cpu_set_t set; CPU_ZERO(&set); CPU_SET(cpu, &set);
+    if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0)
+        perror("pthread_setaffinity_np");
+}
+
+static double tsc_per_ns()
+{
+    const auto     t0 = Steady::now();
+    const uint64_t c0 = __rdtsc();
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    const uint64_t c1 = __rdtsc();
+    return double(c1 - c0) / std::chrono::duration<double, std::nano>(Steady::now() - t0).count();
+}
+
+// ─── Section: flush (dirty a page, flush it, wait for write-back) ────────────
+
 // All three flush methods
 enum class flush_method { clwb, clflushopt, clflush };
 
@@ -90,51 +159,305 @@ void bench_one(unsigned char *page,
               << std::setw(8) << avg_n << " ns\n";
 }
 
+static void section_flush(cxl::CxlAllocator& alloc)
+{
+    std::cout << "\n[flush]  (" << k_iters << " iters)\n"
+              << "method     | size KiB → cycles,    ns\n"
+              << "--------------------------------------\n";
+    for (std::size_t sz : {4096ul, 8192ul}) {
+        auto* page = static_cast<unsigned char*>(alloc.allocate_aligned(sz, 4096));
+        std::memset(page, 0, sz);
+        bench_one<flush_method::clwb>      (page, sz, "CLWB");
+        bench_one<flush_method::clflushopt>(page, sz, "CLFLUSHOPT");
+        bench_one<flush_method::clflush>   (page, sz, "CLFLUSH");
+        std::cout << "--------------------------------------\n";
+    }
+}
+
+// ─── Section: chase (dependent-load latency) ─────────────────────────────────
+
+// One random cycle through every line of [base, base + bytes): each line's
+// first word points at the next, so every load depends on the previous.
+static void build_chain(uint8_t* base, std::size_t bytes, uint64_t seed)
+{
+    const std::size_t lines = bytes / k_line_bytes;
+    std::vector<std::size_t> order(lines);
+    std::iota(order.begin(), order.end(), 0);
+    std::shuffle(order.begin() + 1, order.end(), std::mt19937_64(seed));
+    for (std::size_t i = 0; i < lines; ++i)
+        *reinterpret_cast<void**>(base + order[i] * k_line_bytes) =
+            base + order[(i + 1) % lines] * k_line_bytes;
+}
+
+// Average ns per dependent load over `steps` hops.
+static double chase_ns(uint8_t* start, std::size_t steps, bool flush, double tpn)
+{
+    void* p = start;
+    const uint64_t c0 = __rdtsc();
+    if (flush) {
+        for (std::size_t i = 0; i < steps; ++i) {
+            _mm_clflushopt(p);
+            _mm_sfence();
+            p = *static_cast<void* volatile*>(p);
+        }
+    } else {
+        for (std::size_t i = 0; i < steps; ++i) p = *static_cast<void* volatile*>(p);
+    }
+    const uint64_t c1 = __rdtsc();
+    asm volatile("" :: "r"(p));
+    return double(c1 - c0) / tpn / double(steps);
+}
+
+struct ChaseResult { double plain_ns; double flush_ns; };
+
+static ChaseResult section_chase(uint8_t* region, std::size_t bytes, double tpn)
+{
+    build_chain(region, bytes, 42);
+    const std::size_t steps = std::min<std::size_t>(bytes / k_line_bytes * 2, 4'000'000);
+    chase_ns(region, steps / 4, false, tpn);                 // warm the TLB
+    const ChaseResult r{chase_ns(region, steps, false, tpn), chase_ns(region, steps, true, tpn)};
+    std::cout << "\n[chase]  " << (bytes >> 20) << " MiB working set, " << steps << " hops\n"
+              << std::right << std::fixed << std::setprecision(1)
+              << "  dependent load                  : " << std::setw(8) << r.plain_ns << " ns\n"
+              << "  clflushopt + sfence + load      : " << std::setw(8) << r.flush_ns << " ns\n";
+    return r;
+}
+
+// ─── Section: bw (read / write / NT write across threads) ────────────────────
+enum class BwKind { read, write, nt_write };
+
+static uint64_t bw_pass(BwKind k, uint8_t* p, std::size_t bytes)
+{
+    __m512i acc = _mm512_setzero_si512();
+    const __m512i v = _mm512_set1_epi64(0x5a5a5a5a5a5a5a5all);
+    for (std::size_t off = 0; off < bytes; off += k_line_bytes) {
+        auto* l = reinterpret_cast<__m512i*>(p + off);
+        switch (k) {
+        case BwKind::read:     acc = _mm512_xor_si512(acc, _mm512_load_si512(l)); break;
+        case BwKind::write:    _mm512_store_si512(l, v);  break;
+        case BwKind::nt_write: _mm512_stream_si512(l, v); break;
+        }
+    }
+    _mm_sfence();
+    return static_cast<uint64_t>(_mm512_reduce_or_epi64(acc));
+}
+
+// GB/s of `t` threads covering the region once, best of 2 passes.
+static double bw_run(BwKind k, uint8_t* region, std::size_t bytes, unsigned t, unsigned cpu)
+{
+    const unsigned    n_cpus = std::max(1u, std::thread::hardware_concurrency());
+    const std::size_t slice  = bytes / t & ~std::size_t{4095};
+    double best = 0;
+    for (int pass = 0; pass < 2; ++pass) {
+        std::atomic<unsigned> ready{0};
+        std::atomic<bool>     go{false};
+        std::vector<uint64_t> sink(t);
+        std::vector<std::thread> ts;
+        for (unsigned i = 0; i < t; ++i)
+            ts.emplace_back([&, i] {
+                pin_to_cpu((cpu + i) % n_cpus);
+                const std::size_t len = i + 1 == t ? bytes - slice * i : slice;
+                ready.fetch_add(1);
+                while (!go.load(std::memory_order_acquire)) {}
+                sink[i] = bw_pass(k, region + slice * i, len);
+            });
+        while (ready.load() != t) std::this_thread::yield();
+        const auto t0 = Steady::now();
+        go.store(true, std::memory_order_release);
+        for (auto& th : ts) th.join();
+        const double s = std::chrono::duration<double>(Steady::now() - t0).count();
+        asm volatile("" :: "r"(sink.data()) : "memory");
+        best = std::max(best, double(bytes) / s / 1e9);
+    }
+    return best;
+}
+
+struct BwResult { double read_1t; double nt_write_1t; double nt_write_peak; };
+
+static BwResult section_bw(uint8_t* region, std::size_t bytes, unsigned max_thr, unsigned cpu)
+{
+    BwResult r{};
+    std::cout << "\n[bw]  GB/s over " << (bytes >> 20) << " MiB\n"
+              << "threads      read     write  nt_write\n"
+              << "-------  --------  --------  --------\n"
+              << std::right << std::fixed << std::setprecision(2);
+    for (unsigned t = 1; t <= max_thr; t *= 2) {
+        const double rd = bw_run(BwKind::read,     region, bytes, t, cpu);
+        const double wr = bw_run(BwKind::write,    region, bytes, t, cpu);
+        const double nt = bw_run(BwKind::nt_write, region, bytes, t, cpu);
+        if (t == 1) { r.read_1t = rd; r.nt_write_1t = nt; }
+        r.nt_write_peak = std::max(r.nt_write_peak, nt);
+        std::cout << std::setw(7) << t << "  " << std::setw(8) << rd << "  "
+                  << std::setw(8) << wr << "  " << std::setw(8) << nt << '\n';
+    }
+    return r;
+}
+
+// ─── Section: loaded (latency under injected read traffic) ───────────────────
+// The chaser walks the first half of the region, injectors read the second
+// half in 4 KiB bursts separated by `delay` TSC cycles of pause.
+static void section_loaded(uint8_t* region, std::size_t bytes, unsigned max_thr,
+                           unsigned cpu, double tpn)
+{
+    const unsigned    n_cpus = std::max(1u, std::thread::hardware_concurrency());
+    const unsigned    n_inj  = std::max(1u, max_thr) - (max_thr > 1 ? 1 : 0);
+    const std::size_t half   = bytes / 2 & ~std::size_t{4095};
+    uint8_t*          inj    = region + half;
+    const std::size_t slice  = (bytes - half) / n_inj & ~std::size_t{4095};
+    build_chain(region, half, 7);
+    const std::size_t steps = std::min<std::size_t>(half / k_line_bytes, 1'000'000);
+
+    std::cout << "\n[loaded]  chase " << (half >> 20) << " MiB, " << n_inj
+              << " read injector(s)" << (max_thr > 1 ? "" : " sharing the CPU") << '\n'
+              << "  delay cyc   inject GB/s   latency ns\n"
+              << "  ---------   -----------   ----------\n" << std::right << std::fixed;
+
+    std::cout << "       idle   " << std::setw(11) << std::setprecision(2) << 0.0 << "   "
+              << std::setw(10) << std::setprecision(1) << chase_ns(region, steps, false, tpn) << '\n';
+    for (uint64_t delay : {20'000ull, 5'000ull, 1'000ull, 200ull, 0ull}) {
+        std::atomic<bool>     stop{false};
+        std::atomic<uint64_t> moved{0};
+        std::vector<std::thread> ts;
+        for (unsigned i = 0; i < n_inj; ++i)
+            ts.emplace_back([&, i] {
+                pin_to_cpu((cpu + 1 + i) % n_cpus);
+                uint8_t* base = inj + slice * i;
+                uint64_t bytes_done = 0, sink = 0;
+                for (std::size_t off = 0; !stop.load(std::memory_order_relaxed);
+                     off = (off + 4096) % slice) {
+                    sink ^= bw_pass(BwKind::read, base + off, 4096);
+                    bytes_done += 4096;
+                    if (delay) {
+                        const uint64_t until = __rdtsc() + delay;
+                        while (__rdtsc() < until) _mm_pause();
+                    }
+                }
+                asm volatile("" :: "r"(sink));
+                moved.fetch_add(bytes_done);
+            });
+        const auto   t0  = Steady::now();
+        const double lat = chase_ns(region, steps, false, tpn);
+        stop.store(true);
+        for (auto& th : ts) th.join();
+        const double s = std::chrono::duration<double>(Steady::now() - t0).count();
+        std::cout << std::setw(11) << delay << "   " << std::setprecision(2) << std::setw(11)
+                  << double(moved.load()) / s / 1e9 << "   " << std::setprecision(1)
+                  << std::setw(10) << lat << '\n';
+    }
+}
+
+// ─── Section: tune (queue defaults from the measurements) ────────────────────
+// Rules (starting points, not optima – confirm with sweep_bench):
+//   • per-line enqueue cost e  = 64 B / single-thread NT write bandwidth
+//   • tail round trip       rt = 2 × flushed-load latency (consumer NT-stores
+//                                the tail, the producer reads it fresh)
+//   • tail flush interval      ≥ rt / e items, so a published tail is back
+//                                at the producer before it has used up one
+//                                interval of slots; rounded up to 2^k
+//   • ring order               = log2(4 × interval) (interval = cap / 4,
+//                                the TailPolicy default), clamped to 6 … 16
+//   • consumer back-off min    ≈ one flushed-load latency in TSC cycles –
+//                                waiting less than one probe only adds polls;
+//                                2^k, clamped to 32 … 4096
+static void tune_queue(const ChaseResult& c, const BwResult& b, double tpn)
+{
+    if (c.flush_ns <= 0 || b.nt_write_1t <= 0) {
+        std::cout << "\n[tune]  needs the chase and bw sections\n";
+        return;
+    }
+    const double      e_ns     = double(k_line_bytes) / b.nt_write_1t;       // GB/s = B/ns
+    const double      rt_ns    = 2.0 * c.flush_ns;
+    const std::size_t interval = std::bit_ceil(static_cast<std::size_t>(std::ceil(rt_ns / e_ns)));
+    const uint32_t    order    = std::clamp<uint32_t>(std::bit_width(4 * interval) - 1, 6, 16);
+    const uint32_t    backoff  = std::clamp<uint32_t>(
+        std::bit_ceil(static_cast<uint32_t>(c.flush_ns * tpn)), 32, 4096);
+
+    std::cout << "\n[tune]  per-line enqueue " << std::fixed << std::setprecision(1) << e_ns
+              << " ns, tail round trip " << rt_ns << " ns\n"
+              << "  ring order          : " << order << "  (" << (1u << order) << " slots)\n"
+              << "  tail flush interval : " << std::min<std::size_t>(interval, (1u << order) / 4)
+              << "  (TailPolicy::interval)\n"
+              << "  consumer min back-off: " << backoff << " cycles\n"
+              << "  → ./sweep_bench order=" << order - 1 << ',' << order << ',' << order + 1
+              << " backoff=" << backoff / 2 << ":16384," << backoff << ":16384,"
+              << backoff * 2 << ":16384\n";
+}
+
+// ─── Driver ──────────────────────────────────────────────────────────────────
+[[noreturn]] static void print_usage(const char* prog)
+{
+    std::cerr << "Usage: " << prog << " <numa:N | N | dax> [...] [sections=flush,chase,bw,loaded,tune]"
+                 " [mib=256] [threads=N] [cpu=0]\n";
+    std::exit(EXIT_FAILURE);
+}
+
 int main(int argc, char **argv) {
     if (numa_available() < 0) {
         std::cerr << "Error: NUMA is not available on this system\n";
         return 1;
     }
-    if (argc < 2) {
-        std::cerr << "Usage: " << argv[0] << " <node0> [node1] ...\n";
-        return 1;
+    if (argc < 2) print_usage(argv[0]);
+
+    std::vector<std::string> targets;
+    std::set<std::string>    sections{"flush", "chase", "bw", "loaded", "tune"};
+    std::size_t mib     = 256;
+    unsigned    threads = std::max(1u, std::thread::hardware_concurrency());
+    unsigned    cpu     = 0;
+    for (int i = 1; i < argc; ++i) {
+        const std::string a = argv[i];
+        const auto eq = a.find('=');
+        if (eq == std::string::npos) {
+            if (a == "dax" || a.rfind("numa:", 0) == 0) targets.push_back(a);
+            else if (std::isdigit(static_cast<unsigned char>(a[0]))) targets.push_back("numa:" + a);
+            else print_usage(argv[0]);
+            continue;
+        }
+        const std::string k = a.substr(0, eq), v = a.substr(eq + 1);
+        if (k == "sections") {
+            sections.clear();
+            std::stringstream ss(v);
+            for (std::string s; std::getline(ss, s, ','); ) sections.insert(s);
+        } else if (k == "mib")     mib     = std::max<std::size_t>(1, std::stoull(v));
+        else if (k == "threads")   threads = std::max(1u, static_cast<unsigned>(std::stoul(v)));
+        else if (k == "cpu")       cpu     = std::stoul(v);
+        else print_usage(argv[0]);
     }
+    if (targets.empty()) print_usage(argv[0]);
 
-    // Parse nodes
-    std::vector<int> nodes;
-    for (int i = 1; i < argc; ++i)
-        nodes.push_back(std::stoi(argv[i]));
+    pin_to_cpu(cpu);
+    const double      tpn   = tsc_per_ns();
+    const std::size_t bytes = mib << 20;
 
-    // We want to test both 4 KiB and 8 KiB
-    const std::vector<std::size_t> page_sizes = { 4096, 8192 };
+    for (const std::string& t : targets) {
+        std::cout << "\n════════ " << t << " ════════\n";
+        std::unique_ptr<cxl::CxlAllocator> alloc;
+        try {
+            cxl::MapOptions opts;
+            opts.prefault = true;
+            if (t == "dax")
+                alloc = std::make_unique<cxl::DaxAllocator>(cxl::DaxAllocator::default_path,
+                                                           cxl::DaxAllocator::default_offset,
+                                                           cxl::DaxAllocator::default_length,
+                                                           cxl::DebugLevel::off, opts);
+            else
+                alloc = std::make_unique<cxl::NumaAllocator>(std::stoi(t.substr(5)),
+                                                            bytes + (1u << 20),
+                                                            cxl::DebugLevel::off, opts);
+        } catch (const std::exception& ex) {
+            std::cerr << t << ": " << ex.what() << " – skipped\n";
+            continue;
+        }
 
-    std::cout << "NUMA‐aware flush benchmark (" << k_iters << " iters)\n"
-              << "method     | size KiB → cycles,    ns\n"
-              << "--------------------------------------\n";
+        if (sections.count("flush")) section_flush(*alloc);
+        auto* region = static_cast<uint8_t*>(alloc->allocate_aligned(bytes, 4096));
+        std::memset(region, 0, bytes);
 
-    for (int node : nodes) {
-        std::cout << "=== NUMA node " << node << " ===\n";
-
-        for (auto sz : page_sizes) {
-            // Allocate on that node
-            auto page = (unsigned char*)numa_alloc_onnode(sz, node);
-            if (!page) {
-                std::cerr << "  [node " << node << "] allocation of "
-                          << sz << " bytes failed\n";
-                continue;
-            }
-            std::memset(page, 0, sz);
-
-            // Run all three methods
-            bench_one<flush_method::clwb>      (page, sz, "CLWB");
-            bench_one<flush_method::clflushopt>(page, sz, "CLFLUSHOPT");
-            bench_one<flush_method::clflush>   (page, sz, "CLFLUSH");
-
-            numa_free(page, sz);
-            std::cout << "--------------------------------------\n";
-        }
+        ChaseResult c{};
+        BwResult    b{};
+        if (sections.count("chase") || sections.count("tune")) c = section_chase(region, bytes, tpn);
+        if (sections.count("bw")    || sections.count("tune")) b = section_bw(region, bytes, threads, cpu);
+        if (sections.count("loaded")) section_loaded(region, bytes, threads, cpu, tpn);
+        if (sections.count("tune"))   tune_queue(c, b, tpn);
     }
-
     return 0;
 }
-
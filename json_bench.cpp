@@ -7,17 +7,23 @@
  *
  * Tree structures are generated with a balanced shape for each node count.
  *
- * Library‑agnostic via `JsonLibrary`; default implementation uses
- * **nlohmann::json**. Swap codecs by subclassing and re‑compiling.
+ * Library‑agnostic via `JsonLibrary`; both tables run for
+ * **nlohmann::json** and for the flat binary codec (cxl_flat.hpp): offset
+ * tables, strings and blobs read in place, no parsing.  A last section
+ * times the flat codec the way the queue uses it: encoding straight into
+ * an out-of-line CXL buffer (BufferPool), reading fields in place, and
+ * decoding trees into a FlatArena (no per-node heap allocation).
  *
- * Build (example):
- * g++ -O3 -std=c++20 -march=native -I/path/to/nlohmann \
- * serialization_benchmark_final.cpp -o ser_bench
+ * Build:
+ *   make json_bench
  * Run:
- * ./ser_bench
+ *   ./json_bench
  */
 
 #include "nlohmann_json.hpp"
+#include "cxl_allocator.hpp"
+#include "cxl_buffer_pool.hpp"
+#include "cxl_flat.hpp"
 #include <chrono>
 #include <cmath>
 #include <cstdint>
@@ -225,12 +231,151 @@ std::size_t count_nodes(const TreeNode& n) {
 }
 
 
+// ────────────────────────────────────────────────────────────────
+//  Flat binary schemas (see cxl_flat.hpp)
+//  A tree is laid out parent first; each node's children are one
+//  contiguous FlatNode array, so a child is found by index, not search.
+// ────────────────────────────────────────────────────────────────
+constexpr uint16_t k_schema_complex = 1;
+constexpr uint16_t k_schema_tree    = 2;
+
+struct FlatComplex {
+    int32_t id;
+    uint8_t active;
+    uint8_t pad[3];
+    double  score;
+    FlatRef name;
+    FlatRef values;            // int64_t[]
+    FlatRef data;              // bytes
+};
+static_assert(sizeof(FlatComplex) == 40);
+
+struct FlatNode {
+    int32_t  id;
+    uint32_t pad;
+    FlatRef  label;
+    FlatRef  blob;
+    FlatRef  children;         // FlatNode[]
+};
+static_assert(sizeof(FlatNode) == 32);
+
+std::size_t flat_size(const ComplexPayload& p) {
+    return sizeof(FlatHeader) + flat_bytes<FlatComplex>(1) + flat_bytes<char>(p.name.size()) +
+           flat_bytes<int64_t>(p.values.size()) + flat_bytes<uint8_t>(p.data.size());
+}
+
+static std::size_t flat_node_bytes(const TreeNode& n) {
+    std::size_t b = sizeof(FlatNode) + flat_bytes<char>(n.label.size()) + flat_bytes<uint8_t>(n.blob.size());
+    for (const auto& c : n.children) b += flat_node_bytes(c);
+    return b;
+}
+std::size_t flat_size(const TreeNode& n) { return sizeof(FlatHeader) + flat_node_bytes(n); }
+
+// Encode into `buf` (≥ flat_size(p)); returns the message length, 0 if short.
+std::size_t flat_encode(const ComplexPayload& p, void* buf, std::size_t cap) {
+    FlatWriter w(buf, cap);
+    const uint32_t root = w.reserve<FlatComplex>();
+    FlatComplex* t = w.table<FlatComplex>(root);
+    t->id     = p.id;
+    t->active = p.active;
+    t->score  = p.score;
+    t->name   = w.string(p.name);
+    t->values = w.array(std::span<const int64_t>(p.values));
+    t->data   = w.array(std::span<const uint8_t>(p.data));
+    return w.finish(k_schema_complex, root);
+}
+
+static void flat_encode_node(FlatWriter& w, uint32_t at, const TreeNode& n) {
+    const FlatRef kids = w.reserve_array<FlatNode>(n.children.size());
+    FlatNode* t = w.table<FlatNode>(at);
+    t->id       = n.id;
+    t->label    = w.string(n.label);
+    t->blob     = w.array(std::span<const uint8_t>(n.blob));
+    t->children = kids;
+    for (std::size_t i = 0; i < n.children.size(); ++i)
+        flat_encode_node(w, kids.offset + static_cast<uint32_t>(i * sizeof(FlatNode)), n.children[i]);
+}
+
+std::size_t flat_encode(const TreeNode& n, void* buf, std::size_t cap) {
+    FlatWriter w(buf, cap);
+    const uint32_t root = w.reserve<FlatNode>();
+    flat_encode_node(w, root, n);
+    return w.finish(k_schema_tree, root);
+}
+
+// In-place view of a ComplexPayload message; false for a foreign one.
+struct ComplexView {
+    int32_t                  id;
+    bool                     active;
+    double                   score;
+    std::string_view         name;
+    std::span<const int64_t> values;
+    std::span<const uint8_t> data;
+};
+
+bool flat_view(const FlatReader& r, ComplexView& v) {
+    const FlatComplex* t = r.root<FlatComplex>(k_schema_complex);
+    if (!t) return false;
+    v = ComplexView{t->id, t->active != 0, t->score, r.string(t->name),
+                    r.array<int64_t>(t->values), r.blob(t->data)};
+    return !r.failed();
+}
+
+// Decoded tree node living in a FlatArena; label / blob point into the
+// arena (copy = true) or into the message itself (copy = false).
+struct ArenaTreeNode {
+    int32_t                        id;
+    std::string_view               label;
+    std::span<const uint8_t>       blob;
+    std::span<const ArenaTreeNode> children;
+};
+
+static void flat_decode_node(const FlatReader& r, const FlatNode& f, ArenaTreeNode& out,
+                             FlatArena& arena, bool copy) {
+    out.id    = f.id;
+    out.label = copy ? arena.copy(r.string(f.label)) : r.string(f.label);
+    out.blob  = copy ? arena.copy(r.blob(f.blob))    : r.blob(f.blob);
+    const auto kids = r.array<FlatNode>(f.children);
+    ArenaTreeNode* c = arena.make_array<ArenaTreeNode>(kids.size());
+    for (std::size_t i = 0; i < kids.size(); ++i) flat_decode_node(r, kids[i], c[i], arena, copy);
+    out.children = {c, kids.size()};
+}
+
+const ArenaTreeNode* flat_decode_tree(const FlatReader& r, FlatArena& arena, bool copy = true) {
+    const FlatNode* root = r.root<FlatNode>(k_schema_tree);
+    if (!root) return nullptr;
+    ArenaTreeNode* out = arena.make_array<ArenaTreeNode>(1);
+    flat_decode_node(r, *root, *out, arena, copy);
+    return r.failed() ? nullptr : out;
+}
+
+// Touch every node in place: id, label and blob lengths, first blob byte.
+static uint64_t flat_walk(const FlatReader& r, const FlatNode& n) {
+    const auto blob = r.blob(n.blob);
+    uint64_t sum = static_cast<uint32_t>(n.id) + r.string(n.label).size() + blob.size() +
+                   (blob.empty() ? 0 : blob[0]);
+    for (const FlatNode& c : r.array<FlatNode>(n.children)) sum += flat_walk(r, c);
+    return sum;
+}
+
+// Owning decode (heap-allocated children, as nlohmann produces).
+static void flat_decode_owned(const FlatReader& r, const FlatNode& f, TreeNode& out) {
+    out.id = f.id;
+    out.label.assign(r.string(f.label));
+    const auto blob = r.blob(f.blob);
+    out.blob.assign(blob.begin(), blob.end());
+    const auto kids = r.array<FlatNode>(f.children);
+    out.children.resize(kids.size());
+    for (std::size_t i = 0; i < kids.size(); ++i) flat_decode_owned(r, kids[i], out.children[i]);
+}
+
 // ────────────────────────────────────────────────────────────────
 //  Library‑agnostic interface
 // ────────────────────────────────────────────────────────────────
 class JsonLibrary {
 public:
     virtual ~JsonLibrary() = default;
+    virtual const char*    name() const = 0;
     virtual std::string    serialize(const ComplexPayload&) = 0;
     virtual std::string    serialize(const TreeNode&)       = 0;
     virtual ComplexPayload deserialize_complex(const std::string&) = 0;
@@ -239,6 +384,7 @@ public:
 
 class NlohmannJsonLib final : public JsonLibrary {
 public:
+    const char* name() const override { return "nlohmann::json"; }
     std::string serialize(const ComplexPayload& p) override {
         return nlohmann::json(p).dump();
     }
@@ -253,6 +399,41 @@ public:
     }
 };
 
+// Flat codec behind the same interface: std::string as the byte buffer,
+// owning decode.  The in-place paths are timed separately in main().
+class FlatCodecLib final : public JsonLibrary {
+public:
+    const char* name() const override { return "flat binary"; }
+    std::string serialize(const ComplexPayload& p) override { return encode(p); }
+    std::string serialize(const TreeNode& n) override { return encode(n); }
+    ComplexPayload deserialize_complex(const std::string& s) override {
+        ComplexPayload p{};
+        ComplexView    v;
+        if (!flat_view(FlatReader(s.data(), s.size()), v)) return p;
+        p.id     = v.id;
+        p.name.assign(v.name);
+        p.score  = v.score;
+        p.active = v.active;
+        p.values.assign(v.values.begin(), v.values.end());
+        p.data.assign(v.data.begin(), v.data.end());
+        return p;
+    }
+    TreeNode deserialize_tree(const std::string& s) override {
+        TreeNode n;
+        const FlatReader r(s.data(), s.size());
+        if (const FlatNode* root = r.root<FlatNode>(k_schema_tree)) flat_decode_owned(r, *root, n);
+        return n;
+    }
+
+private:
+    template <class T>
+    static std::string encode(const T& v) {
+        std::string s(flat_size(v), '\0');
+        s.resize(flat_encode(v, s.data(), s.size()));
+        return s;
+    }
+};
+
 // ────────────────────────────────────────────────────────────────
 //  Timing helper
 // ────────────────────────────────────────────────────────────────
@@ -270,7 +451,9 @@ static double average_ns(F&& fn, std::size_t iterations) {
 //  Main benchmark
 // ────────────────────────────────────────────────────────────────
 int main() {
-    std::unique_ptr<JsonLibrary> lib = std::make_unique<NlohmannJsonLib>();
+    std::vector<std::unique_ptr<JsonLibrary>> libs;
+    libs.push_back(std::make_unique<NlohmannJsonLib>());
+    libs.push_back(std::make_unique<FlatCodecLib>());
 
     std::cout << std::fixed << std::setprecision(2);
     
@@ -285,12 +468,8 @@ int main() {
         {"64B",   64}, {"256B",  256}, {"512B",  512}, {"1KiB",  1024},
         {"4KiB",  4 * 1024}, {"16KiB", 16 * 1024}, {"64KiB", 64 * 1024}
     };
-    std::cout << "\n--- Flat Object Benchmark (nlohmann::json) ---\n";
-    std::cout << "Target Size\tActual Size\tIterations\tSerialize (μs)\tDeserialize (μs)\n";
-    std::cout << "-----------\t-----------\t----------\t--------------\t----------------\n";
+    std::vector<ComplexPayload> flats;
     for (const auto& [label, bytes] : flat_cases) {
-        const std::size_t iters = bytes >= 16 * 1024 ? 10'000 : 100'000;
-
         ComplexPayload flat;
         flat.id = 42;
         flat.name = random_ascii(16);
@@ -299,13 +478,27 @@ int main() {
         flat.values = {1,2,3,4,5,6,7};
         const size_t flat_overhead = calculate_flat_size(flat);
         flat.data = random_blob(bytes > flat_overhead ? bytes - flat_overhead : 0);
+        flats.push_back(std::move(flat));
+    }
+    const auto flat_iters = [&](std::size_t i) -> std::size_t {
+        return flat_cases[i].bytes >= 16 * 1024 ? 10'000 : 100'000;
+    };
 
-        const double ser_flat_ns = average_ns([&]{ lib->serialize(flat); }, iters);
-        const std::string flat_str = lib->serialize(flat);
-        const double des_flat_ns = average_ns([&]{ lib->deserialize_complex(flat_str); }, iters);
-        
-        std::cout << label << "\t\t" << calculate_flat_size(flat) << "B\t\t" << iters << "\t\t" 
-                  << ser_flat_ns / 1000.0 << "\t\t" << des_flat_ns / 1000.0 << "\n";
+    for (const auto& lib : libs) {
+        std::cout << "\n--- Flat Object Benchmark (" << lib->name() << ") ---\n";
+        std::cout << "Target Size\tActual Size\tIterations\tSerialize (μs)\tDeserialize (μs)\n";
+        std::cout << "-----------\t-----------\t----------\t--------------\t----------------\n";
+        for (std::size_t i = 0; i < flat_cases.size(); ++i) {
+            const ComplexPayload& flat  = flats[i];
+            const std::size_t     iters = flat_iters(i);
+
+            const double ser_flat_ns = average_ns([&]{ lib->serialize(flat); }, iters);
+            const std::string flat_str = lib->serialize(flat);
+            const double des_flat_ns = average_ns([&]{ lib->deserialize_complex(flat_str); }, iters);
+
+            std::cout << flat_cases[i].label << "\t\t" << calculate_flat_size(flat) << "B\t\t" << iters << "\t\t"
+                      << ser_flat_ns / 1000.0 << "\t\t" << des_flat_ns / 1000.0 << "\n";
+        }
     }
 
     // --- Tree Benchmark ---
@@ -327,22 +520,93 @@ int main() {
         {"512 Nodes",  512,   9, 6, 128},
         {"1000 Nodes", 1000, 10, 7, 128},
     };
+    std::vector<TreeNode> trees;
+    for (const auto& tc : tree_cases)
+        trees.push_back(make_tree_by_structure(tc.total_nodes, tc.max_depth, tc.max_children, tc.node_data_size));
+    const auto tree_iters = [&](std::size_t i) -> std::size_t {
+        const int n = tree_cases[i].total_nodes;
+        return n >= 512 ? 1000 : (n >= 64 ? 10'000 : 50'000);
+    };
+
+    for (const auto& lib : libs) {
+        std::cout << "\n--- Tree Benchmark (" << lib->name() << ") ---\n";
+        std::cout << "Structure \tNodes\tTotal Tree Size (KiB)\tIterations\tSerialize (μs)\tDeserialize (μs)\n";
+        std::cout << "----------\t-----\t---------------------\t----------\t--------------\t----------------\n";
+        for (std::size_t i = 0; i < tree_cases.size(); ++i) {
+            const TreeNode&   tree  = trees[i];
+            const std::size_t iters = tree_iters(i);
+
+            const double ser_tree_ns = average_ns([&]{ lib->serialize(tree); }, iters);
+            const std::string tree_str = lib->serialize(tree);
+            const double des_tree_ns = average_ns([&]{ lib->deserialize_tree(tree_str); }, iters);
+
+            std::cout << tree_cases[i].label << "\t" << count_nodes(tree) << "\t"
+                      << static_cast<double>(calculate_tree_size(tree)) / 1024.0 << "\t\t\t"
+                      << iters << "\t\t" << ser_tree_ns / 1000.0 << "\t\t" << des_tree_ns / 1000.0 << "\n";
+        }
+    }
 
-    std::cout << "\n--- Tree Benchmark (nlohmann::json) ---\n";
-    std::cout << "Structure \tNodes\tTotal Tree Size (KiB)\tIterations\tSerialize (μs)\tDeserialize (μs)\n";
-    std::cout << "----------\t-----\t---------------------\t----------\t--------------\t----------------\n";
-    for (const auto& tc : tree_cases) {
-        const std::size_t iters = tc.total_nodes >= 512 ? 1000 : (tc.total_nodes >= 64 ? 10'000 : 50'000);
+    // --- Flat codec in place: CXL buffer → reads in place / arena ---
+    //  encode : straight into a BufferPool buffer + write-back (publish)
+    //  view   : FlatReader over the buffer, every field touched, no copy
+    //  arena  : tree decoded into a reused FlatArena (labels / blobs copied)
+    std::size_t max_msg = 0;
+    for (const auto& f : flats) max_msg = std::max(max_msg, flat_size(f));
+    for (const auto& t : trees) max_msg = std::max(max_msg, flat_size(t));
+    cxl::NumaAllocator alloc(0, 2 * max_msg + (1u << 20), cxl::DebugLevel::off);
+    BufferPool         pool(alloc, 1, max_msg, 1);
+    volatile uint64_t  sink = 0;
+
+    std::cout << "\n--- Flat codec in place (BufferPool buffer on node 0) ---\n";
+    std::cout << "Target Size\tWire Size\tIterations\tEncode→buf (μs)\tView (μs)\n";
+    std::cout << "-----------\t---------\t----------\t---------------\t---------\n";
+    for (std::size_t i = 0; i < flat_cases.size(); ++i) {
+        const std::size_t iters = flat_iters(i);
+        BufferHandle h = pool.acquire(flat_size(flats[i]));
+        const double enc_ns = average_ns([&]{
+            flat_encode(flats[i], pool.data(h), h.length);
+            pool.publish(h);
+        }, iters);
+        const double view_ns = average_ns([&]{
+            ComplexView v;
+            if (flat_view(FlatReader(pool.data(h), h.length), v))
+                sink = sink + v.id + v.name.size() + v.values.back() + v.data.size() +
+                       (v.data.empty() ? 0 : v.data[0]);
+        }, iters);
+        std::cout << flat_cases[i].label << "\t\t" << h.length << "B\t\t" << iters << "\t\t"
+                  << enc_ns / 1000.0 << "\t\t" << view_ns / 1000.0 << "\n";
+        pool.release(h);
+        pool.flush_releases();
+        pool.reclaim();
+    }
 
-        TreeNode tree = make_tree_by_structure(tc.total_nodes, tc.max_depth, tc.max_children, tc.node_data_size);
-        const double ser_tree_ns = average_ns([&]{ lib->serialize(tree); }, iters);
-        const std::string tree_str = lib->serialize(tree);
-        const double des_tree_ns = average_ns([&]{ lib->deserialize_tree(tree_str); }, iters);
-        
-        std::cout << tc.label << "\t" << count_nodes(tree) << "\t"
-                  << static_cast<double>(calculate_tree_size(tree)) / 1024.0 << "\t\t\t"
-                  << iters << "\t\t" << ser_tree_ns / 1000.0 << "\t\t" << des_tree_ns / 1000.0 << "\n";
+    FlatArena arena;
+    std::cout << "\nStructure \tNodes\tWire Size (KiB)\tIterations\tEncode→buf (μs)\tView (μs)\tArena decode (μs)\n";
+    std::cout << "----------\t-----\t---------------\t----------\t---------------\t---------\t-----------------\n";
+    for (std::size_t i = 0; i < tree_cases.size(); ++i) {
+        const std::size_t iters = tree_iters(i);
+        BufferHandle h = pool.acquire(flat_size(trees[i]));
+        const double enc_ns = average_ns([&]{
+            flat_encode(trees[i], pool.data(h), h.length);
+            pool.publish(h);
+        }, iters);
+        const double view_ns = average_ns([&]{
+            const FlatReader r(pool.data(h), h.length);
+            if (const FlatNode* root = r.root<FlatNode>(k_schema_tree)) sink = sink + flat_walk(r, *root);
+        }, iters);
+        const double arena_ns = average_ns([&]{
+            arena.reset();
+            if (const ArenaTreeNode* t = flat_decode_tree(FlatReader(pool.data(h), h.length), arena))
+                sink = sink + t->children.size();
+        }, iters);
+        std::cout << tree_cases[i].label << "\t" << count_nodes(trees[i]) << "\t"
+                  << h.length / 1024.0 << "\t\t" << iters << "\t\t"
+                  << enc_ns / 1000.0 << "\t\t" << view_ns / 1000.0 << "\t\t" << arena_ns / 1000.0 << "\n";
+        pool.release(h);
+        pool.flush_releases();
+        pool.reclaim();
     }
+    std::cout << "Arena heap blocks, all tree decodes: " << arena.blocks_allocated() << "\n";
 
     return 0;
 }
@@ -0,0 +1,201 @@
+// pool_bench.cpp — PoolAllocator vs. the bump allocator
+//
+// CLI:
+//   ./pool_bench numa <node_id> [ops_per_thread [max_threads]]
+//   ./pool_bench dax            [ops_per_thread [max_threads]]
+//
+// Part 1 – throughput: every thread keeps a window of 64 live blocks and
+//          replaces a random one per op (sizes 64 B … 64 KiB, log-uniform).
+//          Pool: allocate + deallocate.  Bump: allocate only, behind one
+//          mutex (BumpPtr is not thread-safe) – it just runs out instead.
+// Part 2 – fragmentation over time: one thread churns a working set of
+//          4096 blocks; prints what the pool took from upstream vs. what
+//          is live, and what a bump allocator would have consumed.
+//
+// Build:
+//   make pool_bench
+// ---------------------------------------------------------------------------
+
+#include "cxl_allocator.hpp"
+#include "cxl_pool_allocator.hpp"
+
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+using Steady = std::chrono::steady_clock;
+
+/* ─ CLI ──────────────────────────────────────────────────────────────────── */
+static void print_usage(const char* prog)
+{
+    std::cerr << "Usage:\n"
+              << "  " << prog << " numa <node_id> [ops_per_thread [max_threads]]\n"
+              << "  " << prog << " dax            [ops_per_thread [max_threads]]\n";
+}
+
+using AllocFactory = std::function<std::unique_ptr<cxl::CxlAllocator>()>;
+
+/* ─ workload ─────────────────────────────────────────────────────────────── */
+// log-uniform 64 B … 64 KiB, not rounded to a class
+struct SizeGen {
+    std::mt19937_64                        rng;
+    std::uniform_real_distribution<double> exp2{6.0, 16.0};
+    explicit SizeGen(uint64_t seed) : rng(seed) {}
+    std::size_t operator()() { return static_cast<std::size_t>(std::exp2(exp2(rng))); }
+};
+
+struct Block { void* p; std::size_t bytes; };
+
+// Mutex-guarded bump baseline: same interface, no reuse
+class LockedBump {
+public:
+    explicit LockedBump(cxl::CxlAllocator& a) : a_(a) {}
+    void* allocate(std::size_t n) { std::lock_guard lk(m_); return a_.allocate_aligned(n, 64); }
+    void  deallocate(void*, std::size_t) {}
+private:
+    cxl::CxlAllocator& a_;
+    std::mutex         m_;
+};
+
+template <class A>
+static double run_threads(A& alloc, unsigned threads, std::size_t ops, std::size_t& done)
+{
+    std::vector<std::size_t> per(threads, 0);
+    std::vector<std::thread> ts;
+    const auto t0 = Steady::now();
+    for (unsigned t = 0; t < threads; ++t)
+        ts.emplace_back([&, t] {
+            SizeGen gen(0x9e3779b97f4a7c15ull * (t + 1));
+            std::vector<Block> window;
+            window.reserve(64);
+            try {
+                for (std::size_t i = 0; i < ops; ++i) {
+                    const std::size_t n = gen();
+                    if (window.size() == 64) {
+                        const std::size_t k = gen.rng() % 64;
+                        alloc.deallocate(window[k].p, window[k].bytes);
+                        window[k] = {alloc.allocate(n), n};
+                    } else {
+                        window.push_back({alloc.allocate(n), n});
+                    }
+                    ++per[t];
+                }
+            } catch (const std::bad_alloc&) { /* bump exhausted */ }
+            for (auto& b : window) alloc.deallocate(b.p, b.bytes);
+        });
+    for (auto& th : ts) th.join();
+    const double ns = std::chrono::duration<double, std::nano>(Steady::now() - t0).count();
+    done = 0;
+    for (auto n : per) done += n;
+    return ns;
+}
+
+// Adapter: PoolAllocator through the same two calls
+struct PoolRef {
+    cxl::PoolAllocator& p;
+    void* allocate(std::size_t n)            { return p.allocate_aligned(n, 64); }
+    void  deallocate(void* q, std::size_t n) { p.deallocate(q, n); }
+};
+
+static void throughput(const AllocFactory& make, std::size_t ops, unsigned max_threads)
+{
+    std::cout << "\n[throughput]  ops/thread=" << ops << "\n"
+              << "threads   pool Mops/s   bump Mops/s   bump ops done   pool upstream MiB\n"
+              << "-------   -----------   -----------   -------------   -----------------\n";
+    for (unsigned t = 1; t <= max_threads; t *= 2) {
+        auto up_pool = make();
+        cxl::PoolAllocator pool(*up_pool, cxl::DebugLevel::off);
+        PoolRef pr{pool};
+        std::size_t pool_done = 0;
+        const double pool_ns = run_threads(pr, t, ops, pool_done);
+
+        auto up_bump = make();
+        LockedBump bump(*up_bump);
+        std::size_t bump_done = 0;
+        const double bump_ns = run_threads(bump, t, ops, bump_done);
+
+        std::cout << std::setw(7) << t << "   "
+                  << std::setw(11) << pool_done / pool_ns * 1e3 << "   "
+                  << std::setw(11) << bump_done / bump_ns * 1e3 << "   "
+                  << std::setw(13) << bump_done << "   "
+                  << std::setw(17) << pool.stats().upstream_bytes / double(1 << 20) << '\n';
+    }
+}
+
+static void fragmentation(const AllocFactory& make, std::size_t steps)
+{
+    constexpr std::size_t k_live = 4096;
+    auto up = make();
+    cxl::PoolAllocator pool(*up, cxl::DebugLevel::off);
+    SizeGen gen(42);
+    std::vector<Block> live;
+    std::size_t bump_bytes = 0;           // what a bump allocator would hold
+
+    std::cout << "\n[fragmentation]  working set=" << k_live << " blocks\n"
+              << "      step    live MiB   upstream MiB    frag   bump MiB\n"
+              << "----------  ----------   ------------  ------  ---------\n";
+    const std::size_t report = std::max<std::size_t>(1, steps / 10);
+    for (std::size_t i = 1; i <= steps; ++i) {
+        const std::size_t n = gen();
+        if (live.size() == k_live) {
+            const std::size_t k = gen.rng() % k_live;
+            pool.deallocate(live[k].p, live[k].bytes);
+            live[k] = {pool.allocate_aligned(n), n};
+        } else {
+            live.push_back({pool.allocate_aligned(n), n});
+        }
+        bump_bytes += (n + 63) & ~std::size_t{63};
+
+        if (i % report == 0) {
+            const cxl::PoolStats st = pool.stats();
+            std::cout << std::setw(10) << i << "  "
+                      << std::setw(10) << st.live_bytes / double(1 << 20) << "   "
+                      << std::setw(12) << st.upstream_bytes / double(1 << 20) << "  "
+                      << std::setw(6)  << st.fragmentation() << "  "
+                      << std::setw(9)  << bump_bytes / double(1 << 20) << '\n';
+        }
+    }
+    for (auto& b : live) pool.deallocate(b.p, b.bytes);
+    std::cout << "final: ";
+    cxl::PoolAllocator::print_stats(pool.stats(), std::cout);
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 2) { print_usage(argv[0]); return EXIT_FAILURE; }
+    const std::string_view kind = argv[1];
+
+    AllocFactory make;
+    int next = 2;
+    if (kind == "numa" && argc >= 3) {
+        const int node = std::stoi(argv[2]);
+        next = 3;
+        make = [node] { return std::make_unique<cxl::NumaAllocator>(node, cxl::DaxAllocator::default_length,
+                                                                   cxl::DebugLevel::off); };
+    } else if (kind == "dax") {
+        make = [] { return std::make_unique<cxl::DaxAllocator>(cxl::DaxAllocator::default_path,
+                                                              cxl::DaxAllocator::default_offset,
+                                                              cxl::DaxAllocator::default_length,
+                                                              cxl::DebugLevel::off); };
+    } else {
+        print_usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+    const std::size_t ops     = argc > next     ? std::stoull(argv[next])     : 200'000;
+    const unsigned    threads = argc > next + 1 ? std::stoul(argv[next + 1])  : std::thread::hardware_concurrency();
+
+    std::cout << std::fixed << std::setprecision(2);
+    throughput(make, ops, std::max(1u, threads));
+    fragmentation(make, 10 * ops);
+    return 0;
+}
@@ -0,0 +1,318 @@
+// scaling_bench.cpp — N producers × M consumers, placed by NUMA distance
+//
+// CLI:
+//   ./scaling_bench numa <node_id> [key=value …]
+//   ./scaling_bench dax            [key=value …]
+//     producers=1,2,4,8   producer counts to sweep      (default 1,2,4 … #CPUs-1)
+//     consumers=1,2       consumer counts to sweep      (default 1)
+//     policy=compact      compact | spread | split      (default compact)
+//     secs=2              timed phase per point
+//     order=12            ring order of each consumer's ring
+//
+// M consumers each own one ring (the queue stays MPSC); producer i feeds
+// ring i mod M through that ring's ProducerGroup.  Threads are placed by
+// the distance of their CPU's node to the memory node (the CXL node for
+// numa, node 0 for dax):
+//   compact : fill the nearest node first, then the next nearest …
+//   spread  : round-robin over nodes, nearest first (one thread per node
+//             before the second on any node)
+//   split   : consumers on the nearest node, producers on the farthest –
+//             the cross-socket / cross-host shape
+// CPUs are used once while they last, then reused round-robin (reported).
+//
+// Output per point: aggregate Mmsg/s, per-producer min / max, Jain's
+// fairness index over producers (1 = perfectly fair, 1/N = one thread
+// did everything) and the consumer share spread.
+//
+// Build:
+//   make scaling_bench
+// ---------------------------------------------------------------------------
+
+#include "cxl_allocator.hpp"
+#include "cxl_mpsc_queue_exp.hpp"
+
+#include <numa.h>
+#include <pthread.h>
+#include <sched.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using Steady = std::chrono::steady_clock;
+
+static void pin_to_cpu(unsigned cpu)
+{
+    cpu_set_t set; CPU_ZERO(&set); CPU_SET(cpu, &set);
+    if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0)
+        perror("pthread_setaffinity_np");
+}
+
+[[noreturn]] static void print_usage(const char* prog)
+{
+    std::cerr << "Usage:\n"
+              << "  " << prog << " numa <node_id> [producers=1,2,4] [consumers=1,2] "
+                 "[policy=compact|spread|split] [secs=2] [order=12]\n"
+              << "  " << prog << " dax            [producers=…] [consumers=…] [policy=…] [secs=…] [order=…]\n";
+    std::exit(EXIT_FAILURE);
+}
+
+static std::vector<std::size_t> parse_list(const std::string& s)
+{
+    std::vector<std::size_t> out;
+    std::stringstream ss(s);
+    for (std::string tok; std::getline(ss, tok, ','); )
+        if (!tok.empty()) out.push_back(std::max<std::size_t>(1, std::stoull(tok)));
+    return out;
+}
+
+// ─── Placement ───────────────────────────────────────────────────────────────
+enum class Policy { compact, spread, split };
+
+struct Placement {
+    std::vector<unsigned> producers;   // CPU per producer
+    std::vector<unsigned> consumers;   // CPU per consumer
+    bool                  oversubscribed {false};
+};
+
+// Allowed CPUs grouped by node, nodes ordered by distance to `mem_node`.
+static std::vector<std::vector<unsigned>> cpus_by_distance(int mem_node)
+{
+    cpu_set_t allowed; CPU_ZERO(&allowed);
+    sched_getaffinity(0, sizeof(allowed), &allowed);
+
+    std::map<int, std::vector<unsigned>> by_node;
+    for (unsigned c = 0; c < CPU_SETSIZE; ++c)
+        if (CPU_ISSET(c, &allowed)) by_node[std::max(0, numa_node_of_cpu(c))].push_back(c);
+
+    std::vector<std::pair<int, int>> order;   // (distance, node)
+    for (auto& [node, _] : by_node) order.emplace_back(numa_distance(mem_node, node), node);
+    std::sort(order.begin(), order.end());
+
+    std::vector<std::vector<unsigned>> out;
+    for (auto [d, node] : order) out.push_back(by_node[node]);
+    return out;
+}
+
+static Placement place(Policy pol, int mem_node, std::size_t n_prod, std::size_t n_cons)
+{
+    const auto nodes = cpus_by_distance(mem_node);
+    std::vector<unsigned> flat;                       // compact order
+    for (const auto& n : nodes) flat.insert(flat.end(), n.begin(), n.end());
+
+    std::vector<unsigned> rr;                         // spread order
+    for (std::size_t i = 0; rr.size() < flat.size(); ++i)
+        for (const auto& n : nodes)
+            if (i < n.size()) rr.push_back(n[i]);
+
+    Placement p;
+    const std::size_t total = n_prod + n_cons;
+    p.oversubscribed = total > flat.size();
+    const auto take = [](const std::vector<unsigned>& v, std::size_t i) { return v[i % v.size()]; };
+
+    switch (pol) {
+    case Policy::compact:
+    case Policy::spread: {
+        const auto& v = pol == Policy::compact ? flat : rr;
+        for (std::size_t i = 0; i < n_cons; ++i) p.consumers.push_back(take(v, i));
+        for (std::size_t i = 0; i < n_prod; ++i) p.producers.push_back(take(v, n_cons + i));
+        break;
+    }
+    case Policy::split: {
+        // consumers from the near end, producers from the far end
+        for (std::size_t i = 0; i < n_cons; ++i) p.consumers.push_back(take(flat, i));
+        for (std::size_t i = 0; i < n_prod; ++i)
+            p.producers.push_back(flat[(flat.size() - 1 - i % flat.size())]);
+        break;
+    }
+    }
+    return p;
+}
+
+// ─── One point ───────────────────────────────────────────────────────────────
+struct alignas(64) Counter { uint64_t n {0}; };
+
+struct PointResult {
+    double                secs;
+    std::vector<uint64_t> produced;    // per producer
+    std::vector<uint64_t> consumed;    // per consumer
+};
+
+static PointResult run_point(std::vector<Entry*>& rings, std::vector<uint64_t*>& tails,
+                             uint32_t order, const Placement& pl, double secs)
+{
+    const std::size_t n_prod = pl.producers.size();
+    const std::size_t n_cons = pl.consumers.size();
+
+    std::vector<std::unique_ptr<ProducerGroup>> groups;
+    std::vector<std::unique_ptr<CxlMpscQueue>>  cons_q, prod_q;
+    for (std::size_t c = 0; c < n_cons; ++c) {
+        groups.push_back(std::make_unique<ProducerGroup>());
+        cons_q.push_back(std::make_unique<CxlMpscQueue>(rings[c], order, tails[c], true));
+    }
+    for (std::size_t p = 0; p < n_prod; ++p)
+        prod_q.push_back(std::make_unique<CxlMpscQueue>(rings[p % n_cons], order, tails[p % n_cons],
+                                                        *groups[p % n_cons], false));
+
+    std::vector<Counter> produced(n_prod), consumed(n_cons);
+    std::atomic<bool>   stop{false}, go{false};
+    std::atomic<size_t> producers_done{0};
+
+    std::vector<std::thread> ts;
+    for (std::size_t c = 0; c < n_cons; ++c)
+        ts.emplace_back([&, c] {
+            pin_to_cpu(pl.consumers[c]);
+            CxlMpscQueue& q = *cons_q[c];
+            Entry e{};
+            while (!go.load(std::memory_order_acquire)) {}
+            // drain until every producer has stopped and the ring is empty
+            for (;;) {
+                if (q.dequeue(e)) { ++consumed[c].n; continue; }
+                if (producers_done.load(std::memory_order_acquire) == n_prod) {
+                    uint64_t sent = 0;
+                    for (std::size_t p = c; p < n_prod; p += n_cons) sent += produced[p].n;
+                    if (consumed[c].n >= sent) break;
+                }
+            }
+        });
+    for (std::size_t p = 0; p < n_prod; ++p)
+        ts.emplace_back([&, p] {
+            pin_to_cpu(pl.producers[p]);
+            CxlMpscQueue& q = *prod_q[p];
+            Entry e{};
+            e.meta.f.rpc_method = 1;
+            e.meta.f.seal_index = -1;
+            e.meta.f.rpc_id     = static_cast<uint16_t>(p);
+            uint64_t n = 0;
+            while (!go.load(std::memory_order_acquire)) {}
+            while (!stop.load(std::memory_order_relaxed)) {
+                e.args[0] = n;
+                if (q.enqueue(e)) ++n;
+            }
+            produced[p].n = n;
+            producers_done.fetch_add(1, std::memory_order_release);
+        });
+
+    const auto t0 = Steady::now();
+    go.store(true, std::memory_order_release);
+    std::this_thread::sleep_for(std::chrono::duration<double>(secs));
+    stop.store(true, std::memory_order_relaxed);
+    for (auto& t : ts) t.join();
+
+    PointResult r;
+    r.secs = std::chrono::duration<double>(Steady::now() - t0).count();
+    for (auto& c : produced) r.produced.push_back(c.n);
+    for (auto& c : consumed) r.consumed.push_back(c.n);
+    return r;
+}
+
+// Jain's index: (Σx)² / (n·Σx²)
+static double jain(const std::vector<uint64_t>& v)
+{
+    double s = 0, s2 = 0;
+    for (uint64_t x : v) { s += double(x); s2 += double(x) * double(x); }
+    return s2 > 0 ? s * s / (double(v.size()) * s2) : 1.0;
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc < 2) print_usage(argv[0]);
+    const std::string mode = argv[1];
+    int mem_node = 0, next = 2;
+    std::unique_ptr<cxl::CxlAllocator> alloc;
+    try {
+        if (mode == "numa" && argc >= 3) {
+            mem_node = std::stoi(argv[2]);
+            next     = 3;
+            alloc    = std::make_unique<cxl::NumaAllocator>(mem_node, cxl::DaxAllocator::default_length,
+                                                           cxl::DebugLevel::off);
+        } else if (mode == "dax") {
+            alloc = std::make_unique<cxl::DaxAllocator>(cxl::DaxAllocator::default_path,
+                                                       cxl::DaxAllocator::default_offset,
+                                                       cxl::DaxAllocator::default_length,
+                                                       cxl::DebugLevel::off);
+        } else {
+            print_usage(argv[0]);
+        }
+    } catch (const std::exception& ex) {
+        std::cerr << "Allocator init failed: " << ex.what() << '\n';
+        return EXIT_FAILURE;
+    }
+
+    const unsigned n_cpus = std::max(1u, std::thread::hardware_concurrency());
+    std::vector<std::size_t> prods, conss{1};
+    Policy   policy = Policy::compact;
+    double   secs   = 2.0;
+    uint32_t order  = 12;
+    for (int i = next; i < argc; ++i) {
+        const std::string a = argv[i];
+        const auto eq = a.find('=');
+        if (eq == std::string::npos) print_usage(argv[0]);
+        const std::string k = a.substr(0, eq), v = a.substr(eq + 1);
+        if      (k == "producers") prods = parse_list(v);
+        else if (k == "consumers") conss = parse_list(v);
+        else if (k == "secs")      secs  = std::stod(v);
+        else if (k == "order")     order = std::stoul(v);
+        else if (k == "policy") {
+            if      (v == "compact") policy = Policy::compact;
+            else if (v == "spread")  policy = Policy::spread;
+            else if (v == "split")   policy = Policy::split;
+            else print_usage(argv[0]);
+        } else print_usage(argv[0]);
+    }
+    if (prods.empty())
+        for (std::size_t p = 1; p < std::max(2u, n_cpus); p *= 2) prods.push_back(p);
+
+    // one ring + tail line per consumer, for the largest M
+    const std::size_t max_cons = *std::max_element(conss.begin(), conss.end());
+    std::vector<Entry*>    rings;
+    std::vector<uint64_t*> tails;
+    for (std::size_t c = 0; c < max_cons; ++c) {
+        rings.push_back(static_cast<Entry*>(alloc->allocate_aligned(sizeof(Entry) << order, 64)));
+        tails.push_back(static_cast<uint64_t*>(alloc->allocate_aligned(64, 64)));
+    }
+
+    const char* pol_name[] = {"compact", "spread", "split"};
+    std::cout << "Memory node " << mem_node << (mode == "dax" ? " (dax)" : "")
+              << "  policy " << pol_name[int(policy)] << "  ring 2^" << order
+              << "  " << secs << " s/point  " << n_cpus << " CPUs\n";
+    for (const auto& n : cpus_by_distance(mem_node))
+        std::cout << "  node " << numa_node_of_cpu(n.front()) << "  distance "
+                  << numa_distance(mem_node, numa_node_of_cpu(n.front()))
+                  << "  cpus " << n.size() << '\n';
+
+    std::cout << "\n  N   M   Mmsg/s   per-P min    per-P max   Jain(P)  C share min/max  ns/msg\n"
+              <<   "---  --  --------  ----------  ----------  -------  ---------------  ------\n"
+              << std::fixed;
+    for (std::size_t m : conss)
+    for (std::size_t n : prods) {
+        const Placement   pl = place(policy, mem_node, n, m);
+        const PointResult r  = run_point(rings, tails, order, pl, secs);
+
+        uint64_t total = 0;
+        for (uint64_t x : r.consumed) total += x;
+        const auto [pmin, pmax] = std::minmax_element(r.produced.begin(), r.produced.end());
+        const auto [cmin, cmax] = std::minmax_element(r.consumed.begin(), r.consumed.end());
+        const double share = total ? 1.0 / double(total) : 0.0;
+
+        std::cout << std::setw(3) << n << "  " << std::setw(2) << m << "  "
+                  << std::setprecision(3) << std::setw(8) << total / r.secs / 1e6 << "  "
+                  << std::setw(10) << *pmin / r.secs / 1e6 << "  "
+                  << std::setw(10) << *pmax / r.secs / 1e6 << "  "
+                  << std::setw(7)  << jain(r.produced) << "  "
+                  << std::setprecision(2) << std::setw(7) << *cmin * share << " / "
+                  << std::setw(5) << *cmax * share << "  "
+                  << std::setprecision(1) << std::setw(6) << (total ? r.secs * 1e9 / total : 0.0)
+                  << (pl.oversubscribed ? "  (CPUs shared)" : "") << '\n';
+    }
+    return 0;
+}
@@ -0,0 +1,210 @@
+// sharded_bench.cpp — consumer-side scaling of ShardedQueue with workers
+//
+// CLI:
+//   ./sharded_bench numa <node_id> [key=value …]
+//   ./sharded_bench dax            [key=value …]
+//     workers=1,2,4,8   worker counts to sweep         (default 1,2,4 … #CPUs-1)
+//     shards=0          rings (0 = the largest worker count)
+//     producers=2       producer threads, round-robin over the shards
+//     work=200          TSC cycles of work per entry (spun after dequeue)
+//     skew=0            1: every entry keyed to one shard – only stealing
+//                       spreads the load
+//     secs=2            timed phase per point
+//     order=12          ring order of each shard
+//
+// The workers' handler spins `work` cycles per entry, standing in for
+// request processing; with one ring that work is the ceiling a single
+// consumer thread hits.  Output per worker count: consumed Mentries/s,
+// speed-up over the first point, the share of entries that were stolen,
+// and min / max entries per worker.
+//
+// Build:
+//   make sharded_bench
+// ---------------------------------------------------------------------------
+
+#include "cxl_allocator.hpp"
+#include "cxl_mpsc_queue_exp.hpp"
+#include "cxl_sharded_queue.hpp"
+
+#include <pthread.h>
+#include <sched.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <x86intrin.h>
+
+using Steady = std::chrono::steady_clock;
+
+static void pin_to_cpu(unsigned cpu)
+{
+    cpu_set_t set; CPU_ZERO(&set); CPU_SET(cpu, &set);
+    if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0)
+        perror("pthread_setaffinity_np");
+}
+
+[[noreturn]] static void print_usage(const char* prog)
+{
+    std::cerr << "Usage:\n"
+              << "  " << prog << " numa <node_id> [workers=1,2,4] [shards=0] [producers=2] "
+                 "[work=200] [skew=0|1] [secs=2] [order=12]\n"
+              << "  " << prog << " dax            [workers=…] [shards=…] [producers=…] [work=…] "
+                 "[skew=…] [secs=…] [order=…]\n";
+    std::exit(EXIT_FAILURE);
+}
+
+static std::vector<std::size_t> parse_list(const std::string& s)
+{
+    std::vector<std::size_t> out;
+    std::stringstream ss(s);
+    for (std::string tok; std::getline(ss, tok, ','); )
+        if (!tok.empty()) out.push_back(std::max<std::size_t>(1, std::stoull(tok)));
+    return out;
+}
+
+struct Config {
+    std::size_t shards    {0};
+    std::size_t producers {2};
+    uint64_t    work      {200};
+    bool        skew      {false};
+    double      secs      {2.0};
+    uint32_t    order     {12};
+};
+
+struct Point {
+    double mops;
+    double stolen_pct;
+    size_t min_items;
+    size_t max_items;
+};
+
+static Point run_point(cxl::CxlAllocator& alloc, const Config& cfg, std::size_t workers, unsigned n_cpus)
+{
+    ShardedQueue sq(alloc, static_cast<uint32_t>(cfg.shards), cfg.order);
+    std::atomic<bool> start{false}, stop{false};
+    std::vector<ShardWorkerMetrics> wm(workers);
+
+    std::vector<std::thread> th;
+    for (std::size_t p = 0; p < cfg.producers; ++p)
+        th.emplace_back([&, p] {
+            pin_to_cpu(static_cast<unsigned>((workers + p) % n_cpus));
+            ShardProducer me(sq, static_cast<uint32_t>(p));
+            while (!start.load(std::memory_order_acquire)) std::this_thread::yield();
+            Entry e{};
+            for (uint64_t i = 0; !stop.load(std::memory_order_relaxed); ++i) {
+                e.args[0] = i;
+                if (cfg.skew) me.enqueue_to(0, e);
+                else          me.enqueue(e);
+            }
+        });
+
+    std::atomic<std::size_t> total{0};
+    for (std::size_t w = 0; w < workers; ++w)
+        th.emplace_back([&, w] {
+            pin_to_cpu(static_cast<unsigned>(w % n_cpus));
+            ShardWorker me(sq, static_cast<uint32_t>(w));
+            auto handle = [&](uint32_t, Entry& e) {
+                const uint64_t until = __rdtsc() + cfg.work;
+                while (__rdtsc() < until) _mm_pause();
+                asm volatile("" :: "r"(e.args[0]));
+            };
+            while (!start.load(std::memory_order_acquire)) std::this_thread::yield();
+            while (!stop.load(std::memory_order_relaxed)) me.poll(handle);
+            wm[w] = me.get_metrics();
+            total += wm[w].home_items + wm[w].stolen_items;
+        });
+
+    const auto t0 = Steady::now();
+    start.store(true, std::memory_order_release);
+    std::this_thread::sleep_for(std::chrono::duration<double>(cfg.secs));
+    stop.store(true, std::memory_order_relaxed);
+    for (auto& t : th) t.join();
+    const double us = std::chrono::duration<double, std::micro>(Steady::now() - t0).count();
+
+    Point pt{double(total.load()) / us, 0.0, SIZE_MAX, 0};
+    std::size_t stolen = 0;
+    for (const auto& m : wm) {
+        const std::size_t items = m.home_items + m.stolen_items;
+        stolen      += m.stolen_items;
+        pt.min_items = std::min(pt.min_items, items);
+        pt.max_items = std::max(pt.max_items, items);
+    }
+    pt.stolen_pct = total ? 100.0 * double(stolen) / double(total.load()) : 0.0;
+    return pt;
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc < 2) print_usage(argv[0]);
+    const std::string mode = argv[1];
+    int mem_node = 0, next = 2;
+    std::unique_ptr<cxl::CxlAllocator> alloc;
+    try {
+        if (mode == "numa" && argc >= 3) {
+            mem_node = std::stoi(argv[2]);
+            next     = 3;
+            alloc    = std::make_unique<cxl::NumaAllocator>(mem_node, cxl::DaxAllocator::default_length,
+                                                           cxl::DebugLevel::off);
+        } else if (mode == "dax") {
+            alloc = std::make_unique<cxl::DaxAllocator>(cxl::DaxAllocator::default_path,
+                                                       cxl::DaxAllocator::default_offset,
+                                                       cxl::DaxAllocator::default_length,
+                                                       cxl::DebugLevel::off);
+        } else {
+            print_usage(argv[0]);
+        }
+    } catch (const std::exception& ex) {
+        std::cerr << "Allocator init failed: " << ex.what() << '\n';
+        return EXIT_FAILURE;
+    }
+
+    const unsigned n_cpus = std::max(1u, std::thread::hardware_concurrency());
+    std::vector<std::size_t> workers;
+    Config cfg;
+    for (int i = next; i < argc; ++i) {
+        const std::string a = argv[i];
+        const auto eq = a.find('=');
+        if (eq == std::string::npos) print_usage(argv[0]);
+        const std::string k = a.substr(0, eq), v = a.substr(eq + 1);
+        if      (k == "workers")   workers       = parse_list(v);
+        else if (k == "shards")    cfg.shards    = std::stoull(v);
+        else if (k == "producers") cfg.producers = std::max<std::size_t>(1, std::stoull(v));
+        else if (k == "work")      cfg.work      = std::stoull(v);
+        else if (k == "skew")      cfg.skew      = std::stoi(v) != 0;
+        else if (k == "secs")      cfg.secs      = std::stod(v);
+        else if (k == "order")     cfg.order     = std::stoul(v);
+        else print_usage(argv[0]);
+    }
+    if (workers.empty())
+        for (std::size_t w = 1; w < std::max(2u, n_cpus); w *= 2) workers.push_back(w);
+    if (cfg.shards == 0) cfg.shards = *std::max_element(workers.begin(), workers.end());
+
+    std::cout << "Memory node " << mem_node << (mode == "dax" ? " (dax)" : "")
+              << "  shards " << cfg.shards << " × 2^" << cfg.order
+              << "  producers " << cfg.producers << "  work " << cfg.work << " cyc"
+              << (cfg.skew ? "  skew: one hot shard" : "") << "  CPUs " << n_cpus << "\n\n"
+              << " workers   Mops/s  speed-up  stolen%   min/worker   max/worker  note\n"
+              << " -------  -------  --------  -------  -----------  -----------  ----\n"
+              << std::fixed;
+
+    // each point allocates fresh rings; the bump allocator never frees
+    double base = 0.0;
+    for (std::size_t w : workers) {
+        const Point p = run_point(*alloc, cfg, w, n_cpus);
+        if (base == 0.0) base = p.mops;
+        std::cout << std::setw(8) << w << "  " << std::setprecision(3) << std::setw(7) << p.mops
+                  << "  " << std::setprecision(2) << std::setw(8) << (base > 0 ? p.mops / base : 0.0)
+                  << "  " << std::setprecision(1) << std::setw(7) << p.stolen_pct
+                  << "  " << std::setw(11) << p.min_items << "  " << std::setw(11) << p.max_items
+                  << (w + cfg.producers > n_cpus ? "  oversubscribed" : "") << '\n';
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,132 @@
+// stats_monitor.cpp — live view of queues exporting into a StatsSegment
+//
+// CLI:
+//   ./stats_monitor <shm-name> [interval_ms [reports]]
+//
+// Every interval, reads each attached slot fresh (read-only: no stores to
+// the segment, none to the queues) and prints per side
+//   calls/s   : enqueue* / dequeue* calls per second since the last report
+//   depth     : max producer position − consumer position of the same queue
+//   stalls/s  : queue_full (P) or empty polls (C) per second
+//   backoff % : back-off cycles waited / TSC cycles elapsed
+//   probes    : CXL tail reads (P) or tail flushes (C), total
+// A slot whose snapshot has not advanced is marked "idle".  Rates use the
+// publisher's TSC, so monitor and queue host need the same TSC rate.
+// reports = 0 (default) runs until interrupted.
+//
+// Example:
+//   ./cxl_mpsc_queue pin 0 numa 0 100000000 2 stats /cxlq &
+//   ./stats_monitor /cxlq 500
+//
+// Build:
+//   make stats_monitor
+// ---------------------------------------------------------------------------
+
+#include "cxl_latency.hpp"
+#include "cxl_stats.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+static void print_usage(const char* prog)
+{
+    std::cerr << "Usage:\n"
+              << "  " << prog << " <shm-name> [interval_ms [reports]]\n";
+    std::exit(EXIT_FAILURE);
+}
+
+struct SlotView {
+    StatsSlotInfo  info;
+    bool           attached {false};
+    bool           valid    {false};
+    QueueStatsLine now  {};
+    QueueStatsLine prev {};
+};
+
+int main(int argc, char* argv[])
+{
+    if (argc < 2) print_usage(argv[0]);
+    const std::string name        = argv[1];
+    const unsigned    interval_ms = argc > 2 ? std::stoul(argv[2]) : 1'000;
+    const unsigned    reports     = argc > 3 ? std::stoul(argv[3]) : 0;
+
+    StatsSegment seg = [&] {
+        try {
+            return StatsSegment::open_shm(name, 0, /*create=*/false);
+        } catch (const std::exception& ex) {
+            std::cerr << ex.what() << '\n';
+            std::exit(EXIT_FAILURE);
+        }
+    }();
+    const double tsc_per_s = measure_tsc_per_ns() * 1e9;
+    std::vector<SlotView> v(seg.slots());
+
+    std::cout << "Monitoring " << name << " (" << seg.slots() << " slots, every "
+              << interval_ms << " ms)\n";
+    for (unsigned r = 0; reports == 0 || r < reports; ++r) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(interval_ms));
+
+        for (uint32_t i = 0; i < v.size(); ++i) {
+            SlotView& s = v[i];
+            if (!s.attached) s.attached = seg.describe(i, s.info);
+            if (!s.attached) continue;
+            QueueStatsLine cur;
+            if (!seg.read(i, cur)) continue;   // never published or torn
+            s.prev  = s.now.seq ? s.now : cur;
+            s.now   = cur;
+            s.valid = true;
+        }
+
+        std::cout << "\n slot  queue             side   calls/s        depth     stalls/s   backoff %      probes\n"
+                  <<   " ----  ----------------  ----  ------------  --------  ------------  ---------  ----------\n"
+                  << std::fixed;
+        for (uint32_t i = 0; i < v.size(); ++i) {
+            const SlotView& s = v[i];
+            if (!s.valid) continue;
+            const bool   prod = s.info.role == StatsRole::producer;
+            const double dt   = double(s.now.tsc - s.prev.tsc);
+            const auto   rate = [&](uint64_t a, uint64_t b) {
+                return dt > 0 ? double(a - b) * tsc_per_s / dt : 0.0;
+            };
+
+            // depth: the furthest producer position of this queue vs. its consumer
+            uint64_t p_pos = 0, c_pos = 0;
+            bool     have_p = false, have_c = false;
+            for (const SlotView& o : v) {
+                if (!o.valid || o.info.name != s.info.name) continue;
+                if (o.info.role == StatsRole::producer) {
+                    p_pos  = have_p ? std::max(p_pos, o.now.position) : o.now.position;
+                    have_p = true;
+                } else {
+                    c_pos  = o.now.position;
+                    have_c = true;
+                }
+            }
+            // positions are 32-bit free-running slot counters; the two
+            // snapshots are taken at different times, so clamp to [0, cap]
+            const int32_t  d     = static_cast<int32_t>(static_cast<uint32_t>(p_pos - c_pos));
+            const uint64_t depth = std::clamp<int64_t>(d, 0, static_cast<int64_t>(s.info.capacity));
+
+            std::cout << std::setw(5) << i << "  " << std::left << std::setw(16)
+                      << s.info.name.substr(0, 16) << std::right << "  "
+                      << (prod ? "   P" : "   C") << "  "
+                      << std::setprecision(0) << std::setw(12)
+                      << rate(s.now.calls, s.prev.calls) << "  ";
+            if (have_p && have_c) std::cout << std::setw(8) << depth;
+            else                  std::cout << std::setw(8) << "-";
+            std::cout << "  " << std::setw(12) << rate(s.now.stalls, s.prev.stalls) << "  "
+                      << std::setprecision(2) << std::setw(9)
+                      << (dt > 0 ? 100.0 * double(s.now.backoff_cycles - s.prev.backoff_cycles) / dt : 0.0)
+                      << "  " << std::setw(10) << s.now.probes
+                      << (s.now.seq == s.prev.seq ? "  idle" : "") << '\n';
+        }
+    }
+    return 0;
+}
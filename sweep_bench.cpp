@@ -0,0 +1,339 @@
+// sweep_bench.cpp — one driver for parameter sweeps, results as JSON
+//
+// CLI (every axis takes a comma-separated list; the sweep is the product):
+//   ./sweep_bench [mem=numa:0,dax] [order=10,14] [backoff=128:16384,64:1024]
+//                 [payload=56,448] [producers=1,2,4] [reps=5] [iters=1000000]
+//                 [pin=<cpu>] [variant=<s>+<l>[+<c>]] [out=<file.json>]
+//
+//   mem       : numa:<node> (DRAM / CXL-as-NUMA) or dax (/dev/dax slice)
+//   order     : ring order (2^order slots)
+//   backoff   : consumer back-off min:max cycles (queue constructor)
+//   payload   : bytes per message; > 56 B goes through enqueue_message()
+//   producers : producer threads sharing one ProducerGroup
+//   reps      : repetitions per point; the JSON has median / p10 / p90
+//   iters     : messages per repetition
+//   variant   : line store / load / check policy (default: CPUID)
+//
+// Each repetition: producers on pin+1 … stream `iters` messages, the
+// consumer on `pin` drains them.  Every message carries its send TSC, so
+// the consumer also records enqueue → dequeue latency (same host, no
+// offset).  JSON goes to stdout or `out`, progress to stderr.
+//
+// Example:
+//   ./sweep_bench mem=numa:0 order=8,12,14 producers=1,2 reps=7 out=base.json
+//
+// Build:
+//   make sweep_bench
+// ---------------------------------------------------------------------------
+
+#include "cxl_allocator.hpp"
+#include "cxl_latency.hpp"
+#include "cxl_mpsc_queue_exp.hpp"
+#include "nlohmann_json.hpp"
+
+#include <pthread.h>
+#include <sys/utsname.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using Steady = std::chrono::steady_clock;
+using json   = nlohmann::json;
+
+static void pin_to_cpu(unsigned cpu)
+{
+    cpu_set_t set; CPU_ZERO(&set); CPU_SET(cpu, &set);
+    if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0)
+        perror("pthread_setaffinity_np");
+}
+
+[[noreturn]] static void print_usage(const char* prog)
+{
+    std::cerr << "Usage:\n"
+              << "  " << prog << " [mem=numa:0,dax] [order=10,14] [backoff=128:16384,...]\n"
+              << "      [payload=56,448] [producers=1,2] [reps=5] [iters=1000000]\n"
+              << "      [pin=<cpu>] [variant=<s>+<l>[+<c>]] [out=<file.json>]\n";
+    std::exit(EXIT_FAILURE);
+}
+
+static std::vector<std::string> split(const std::string& s, char sep)
+{
+    std::vector<std::string> out;
+    std::stringstream ss(s);
+    for (std::string tok; std::getline(ss, tok, sep); )
+        if (!tok.empty()) out.push_back(tok);
+    return out;
+}
+
+// ─── Sweep axes ──────────────────────────────────────────────────────────────
+struct Point {
+    std::string mem;
+    uint32_t    order;
+    uint32_t    backoff_min;
+    uint32_t    backoff_max;
+    std::size_t payload;
+    std::size_t producers;
+};
+
+struct Options {
+    std::vector<std::string>                    mem       {"numa:0"};
+    std::vector<uint32_t>                       order     {14};
+    std::vector<std::pair<uint32_t, uint32_t>>  backoff   {{128, 16'384}};
+    std::vector<std::size_t>                    payload   {k_payload_bytes};
+    std::vector<std::size_t>                    producers {1};
+    unsigned     reps  {5};
+    std::size_t  iters {1'000'000};
+    unsigned     pin   {0};
+    QueueVariant variant = detect_queue_variant();
+    std::string  out;
+};
+
+static Options parse(int argc, char* argv[])
+{
+    Options o;
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        const auto eq = arg.find('=');
+        if (eq == std::string::npos) print_usage(argv[0]);
+        const std::string key = arg.substr(0, eq);
+        const auto        vals = split(arg.substr(eq + 1), ',');
+        if (vals.empty()) print_usage(argv[0]);
+
+        if (key == "mem") {
+            o.mem = vals;
+        } else if (key == "order") {
+            o.order.clear();
+            for (auto& v : vals) o.order.push_back(std::stoul(v));
+        } else if (key == "backoff") {
+            o.backoff.clear();
+            for (auto& v : vals) {
+                const auto mm = split(v, ':');
+                if (mm.size() != 2) print_usage(argv[0]);
+                o.backoff.emplace_back(std::stoul(mm[0]), std::stoul(mm[1]));
+            }
+        } else if (key == "payload") {
+            o.payload.clear();
+            for (auto& v : vals) o.payload.push_back(std::stoull(v));
+        } else if (key == "producers") {
+            o.producers.clear();
+            for (auto& v : vals) o.producers.push_back(std::max<std::size_t>(1, std::stoull(v)));
+        } else if (key == "reps") {
+            o.reps = std::max(1ul, std::stoul(vals[0]));
+        } else if (key == "iters") {
+            o.iters = std::stoull(vals[0]);
+        } else if (key == "pin") {
+            o.pin = std::stoul(vals[0]);
+        } else if (key == "variant") {
+            const auto v = parse_queue_variant(vals[0]);
+            if (!v) print_usage(argv[0]);
+            o.variant = *v;
+        } else if (key == "out") {
+            o.out = vals[0];
+        } else {
+            print_usage(argv[0]);
+        }
+    }
+    return o;
+}
+
+static std::unique_ptr<cxl::CxlAllocator> make_allocator(const std::string& mem)
+{
+    if (mem == "dax")
+        return std::make_unique<cxl::DaxAllocator>(cxl::DaxAllocator::default_path,
+                                                  cxl::DaxAllocator::default_offset,
+                                                  cxl::DaxAllocator::default_length,
+                                                  cxl::DebugLevel::off);
+    if (mem.rfind("numa:", 0) == 0)
+        return std::make_unique<cxl::NumaAllocator>(std::stoi(mem.substr(5)),
+                                                   cxl::DaxAllocator::default_length,
+                                                   cxl::DebugLevel::off);
+    throw std::invalid_argument("unknown mem kind " + mem);
+}
+
+// ─── Statistics over repetitions ─────────────────────────────────────────────
+// Linear interpolation between closest ranks (0 ≤ p ≤ 1).
+static double percentile(std::vector<double> v, double p)
+{
+    if (v.empty()) return 0.0;
+    std::sort(v.begin(), v.end());
+    const double pos = p * double(v.size() - 1);
+    const std::size_t lo = static_cast<std::size_t>(pos);
+    const std::size_t hi = std::min(lo + 1, v.size() - 1);
+    return v[lo] + (v[hi] - v[lo]) * (pos - double(lo));
+}
+
+static json summarize(const std::vector<double>& v)
+{
+    return json{{"median", percentile(v, 0.5)}, {"p10", percentile(v, 0.1)},
+                {"p90", percentile(v, 0.9)},    {"min", percentile(v, 0.0)},
+                {"max", percentile(v, 1.0)},    {"samples", v}};
+}
+
+// ─── One repetition ──────────────────────────────────────────────────────────
+struct Rep {
+    double           seconds;
+    std::size_t      enqueue_calls;
+    std::size_t      dequeue_calls;
+    std::size_t      queue_full;
+    LatencyHistogram latency;   // TSC cycles
+};
+
+template <class Queue>
+static Rep run_rep(Entry* ring, uint64_t* tail, const Point& pt,
+                   std::size_t iters, unsigned pin)
+{
+    ProducerGroup group;
+    std::vector<std::unique_ptr<Queue>> prods;
+    for (std::size_t p = 0; p < pt.producers; ++p)
+        prods.push_back(std::make_unique<Queue>(ring, pt.order, tail, group, p == 0,
+                                                pt.backoff_min, pt.backoff_max));
+    Queue cons(ring, pt.order, tail, false, pt.backoff_min, pt.backoff_max);
+
+    const std::size_t m = message_lines(pt.payload);
+    const unsigned    n_cpus = std::max(1u, std::thread::hardware_concurrency());
+    std::vector<uint8_t> src(pt.payload, 0x5a);
+
+    Rep r{};
+    const auto t0 = Steady::now();
+    std::vector<std::thread> ts;
+    for (std::size_t p = 0; p < pt.producers; ++p)
+        ts.emplace_back([&, p] {
+            pin_to_cpu(static_cast<unsigned>((pin + 1 + p) % n_cpus));
+            Queue& q = *prods[p];
+            std::vector<Entry> lines(m);
+            pack_message(src.data(), pt.payload, lines);
+            for (auto& l : lines) l.meta.f.rpc_method = 1;
+            const std::size_t n = iters * (p + 1) / pt.producers - iters * p / pt.producers;
+            for (std::size_t i = 0; i < n; ++i) {
+                stamp_tx(lines[0]);
+                if (m == 1) { lines[0].meta.f.seal_index = -1; while (!q.enqueue(lines[0])) {} }
+                else        { while (!q.enqueue_message(lines)) {} }
+            }
+        });
+
+    std::vector<Entry> lines(m);
+    const TscOffset same_host{};
+    for (std::size_t got = 0; got < iters; ) {
+        const bool ok = m == 1 ? cons.dequeue(lines[0]) : cons.dequeue_message(lines) != 0;
+        if (!ok) continue;
+        r.latency.record(one_way_cycles(lines[0], same_host));
+        ++got;
+    }
+    r.seconds = std::chrono::duration<double>(Steady::now() - t0).count();
+    for (auto& t : ts) t.join();
+
+    for (const auto& q : prods) {
+        r.enqueue_calls += q->get_metrics().enqueue_calls;
+        r.queue_full    += q->get_metrics().queue_full;
+    }
+    r.dequeue_calls = cons.get_metrics().dequeue_calls;
+    return r;
+}
+
+// ─── Environment, so runs can be compared across upgrades ────────────────────
+static json environment(const Options& o, double tsc_per_ns)
+{
+    utsname u{};
+    ::uname(&u);
+    std::string cpu;
+    std::ifstream ci("/proc/cpuinfo");
+    for (std::string line; std::getline(ci, line); )
+        if (line.rfind("model name", 0) == 0) { cpu = line.substr(line.find(':') + 2); break; }
+
+    std::ostringstream v;
+    v << o.variant;
+    return json{{"host", u.nodename}, {"kernel", u.release}, {"cpu", cpu},
+                {"timestamp", static_cast<int64_t>(std::time(nullptr))},
+                {"tsc_per_ns", tsc_per_ns}, {"variant", v.str()},
+                {"metrics", CXL_QUEUE_METRICS != 0},
+                {"iters", o.iters}, {"reps", o.reps}};
+}
+
+int main(int argc, char* argv[])
+{
+    const Options o = parse(argc, argv);
+    pin_to_cpu(o.pin);
+    const double tsc_per_ns = measure_tsc_per_ns();
+
+    json doc;
+    doc["environment"] = environment(o, tsc_per_ns);
+    doc["results"]     = json::array();
+
+    const uint32_t max_order = *std::max_element(o.order.begin(), o.order.end());
+    for (const std::string& mem : o.mem) {
+        std::unique_ptr<cxl::CxlAllocator> alloc;
+        try {
+            alloc = make_allocator(mem);
+        } catch (const std::exception& ex) {
+            std::cerr << mem << ": " << ex.what() << " – skipped\n";
+            continue;
+        }
+        // one ring for the largest order, re-initialised by every repetition
+        auto* ring = static_cast<Entry*>(alloc->allocate_aligned(sizeof(Entry) << max_order, 64));
+        auto* tail = static_cast<uint64_t*>(alloc->allocate_aligned(64, 64));
+
+        for (uint32_t order : o.order)
+        for (auto [bmin, bmax] : o.backoff)
+        for (std::size_t payload : o.payload)
+        for (std::size_t producers : o.producers) {
+            const Point pt{mem, order, bmin, bmax, payload, producers};
+            if (message_lines(payload) > (std::size_t{1} << order)) {
+                std::cerr << "payload " << payload << " B does not fit order " << order << " – skipped\n";
+                continue;
+            }
+            std::cerr << mem << " order=" << order << " backoff=" << bmin << ':' << bmax
+                      << " payload=" << payload << " producers=" << producers << " …";
+
+            std::vector<double> mops, gbps, enq_per_msg, deq_per_msg;
+            std::size_t queue_full = 0;
+            LatencyHistogram lat;
+            with_queue_variant(o.variant, [&](auto tag) {
+                using Queue = typename decltype(tag)::type;
+                for (unsigned rep = 0; rep < o.reps; ++rep) {
+                    const Rep r = run_rep<Queue>(ring, tail, pt, o.iters, o.pin);
+                    mops.push_back(double(o.iters) / r.seconds / 1e6);
+                    gbps.push_back(double(o.iters) * payload / r.seconds / 1e9);
+                    enq_per_msg.push_back(double(r.enqueue_calls) / o.iters);
+                    deq_per_msg.push_back(double(r.dequeue_calls) / o.iters);
+                    queue_full += r.queue_full;
+                    lat.merge(r.latency);
+                }
+            });
+
+            const auto ns = [&](uint64_t c) { return double(c) / tsc_per_ns; };
+            doc["results"].push_back(json{
+                {"config", {{"mem", mem}, {"order", order}, {"backoff_min", bmin},
+                            {"backoff_max", bmax}, {"payload", payload},
+                            {"lines", message_lines(payload)}, {"producers", producers}}},
+                {"throughput_mops", summarize(mops)},
+                {"throughput_gbps", summarize(gbps)},
+                {"enqueue_calls_per_msg", summarize(enq_per_msg)},
+                {"dequeue_calls_per_msg", summarize(deq_per_msg)},
+                {"queue_full", queue_full},
+                {"latency_ns", {{"samples", lat.count()}, {"min", ns(lat.min())},
+                                {"p50", ns(lat.percentile(0.50))}, {"p90", ns(lat.percentile(0.90))},
+                                {"p99", ns(lat.percentile(0.99))}, {"p999", ns(lat.percentile(0.999))},
+                                {"max", ns(lat.max())}, {"mean", lat.mean() / tsc_per_ns}}}});
+            std::cerr << " " << percentile(mops, 0.5) << " Mmsg/s\n";
+        }
+    }
+
+    if (o.out.empty()) {
+        std::cout << doc.dump(2) << '\n';
+    } else {
+        std::ofstream f(o.out);
+        f << doc.dump(2) << '\n';
+        if (!f) { std::cerr << "cannot write " << o.out << '\n'; return EXIT_FAILURE; }
+    }
+    return 0;
+}
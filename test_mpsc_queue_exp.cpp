@@ -0,0 +1,1559 @@
+// ─────────────────────────────────────────────────────────────────────────────
+//  Test Suite for cxl_mpsc_queue_exp.hpp (the queue used by the benchmarks)
+//  Compile on an AVX-512 capable machine, e.g.:
+//      g++ -std=c++20 -O3 -march=native -pthread test_mpsc_queue_exp.cpp -lnuma -o test_mpsc_queue_exp
+//  Exit status is non-zero if any test failed.
+// ─────────────────────────────────────────────────────────────────────────────
+#include <iostream>
+#include <thread>
+#include <vector>
+#include <atomic>
+#include <cassert>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <sstream>
+
+#include "cxl_mpsc_queue_exp.hpp"
+#include "cxl_queue_set.hpp"
+#include "cxl_rpc.hpp"
+#include "cxl_coro.hpp"
+#include "cxl_pool_allocator.hpp"
+#include "cxl_buffer_pool.hpp"
+#include "cxl_latency.hpp"
+#include "cxl_stats.hpp"
+#include "cxl_stream.hpp"
+#include "cxl_broadcast.hpp"
+#include "cxl_sharded_queue.hpp"
+#include "cxl_topology.hpp"
+#include "cxl_region.hpp"
+
+using namespace std::chrono_literals;
+
+constexpr uint32_t ORDER = 4;                 // 16-slot ring for easy wrap tests
+constexpr uint32_t CAP   = 1u << ORDER;       // queue capacity
+
+// ---------------------------------------------------------------------------
+//  Simple RAII harness for allocating ring + tail cache-line
+//  `q` is the consumer-side handle (and the producer in single-thread tests).
+// ---------------------------------------------------------------------------
+#include <numa.h>
+
+struct TestEnv {
+    Entry*         ring;
+    uint64_t*      tail_cxl;
+    CxlMpscQueue*  q;
+
+    explicit TestEnv(int numa_node = 0) {
+        const size_t ring_bytes = sizeof(Entry) * CAP;
+
+        ring     = static_cast<Entry*>(numa_alloc_onnode(ring_bytes, numa_node));
+        tail_cxl = static_cast<uint64_t*>(numa_alloc_onnode(64,        numa_node));
+
+        // Ensure both regions are 64-byte aligned
+        assert(reinterpret_cast<uintptr_t>(ring)     % 64 == 0 && "ring not 64-byte aligned");
+        assert(reinterpret_cast<uintptr_t>(tail_cxl) % 64 == 0 && "tail_cxl not 64-byte aligned");
+
+        std::memset(tail_cxl, 0, 64);
+
+        q = new CxlMpscQueue(ring, ORDER, tail_cxl, /*do_initialize=*/true);
+    }
+
+    ~TestEnv() {
+        delete q;
+        numa_free(ring,     sizeof(Entry) * CAP);
+        numa_free(tail_cxl, 64);
+    }
+};
+
+// ---------------------------------------------------------------------------
+//  Helpers
+// ---------------------------------------------------------------------------
+constexpr const char* GREEN = "\033[32m";
+constexpr const char* RED   = "\033[31m";
+constexpr const char* RESET = "\033[0m";
+
+static std::atomic<int> failures{0};
+
+inline void pass(const char* n)  { std::cout << GREEN << '[' << n << "] PASSED"        << RESET << '\n'; }
+inline void fail(const char* n, const char* m)
+{ ++failures; std::cout << RED   << '[' << n << "] FAILED: " << m << RESET << '\n'; }
+
+// ---------------------------------------------------------------------------
+//  1. Single enqueue / dequeue
+// ---------------------------------------------------------------------------
+void test_enqueue_dequeue_single() {
+    constexpr const char* N = "test_enqueue_dequeue_single";
+    TestEnv env;
+
+    Entry in{};  in.meta.f.rpc_id = 42;
+    if (!env.q->enqueue(in))                          return fail(N, "enqueue failed");
+
+    Entry out{};
+    if (!env.q->dequeue(out))                         return fail(N, "dequeue failed");
+    if (out.meta.f.rpc_id != 42)                      return fail(N, "value mismatch");
+    pass(N);
+}
+
+// ---------------------------------------------------------------------------
+//  2. Wrap-around correctness (several laps → epoch changes)
+// ---------------------------------------------------------------------------
+void test_wraparound_behavior() {
+    constexpr const char* N = "test_wraparound_behavior";
+    TestEnv env;
+
+    uint32_t next_in = 0, next_out = 0;
+    for (int lap = 0; lap < 6; ++lap) {
+        while (next_in < next_out + CAP) {
+            Entry e{}; e.meta.f.rpc_id = static_cast<uint16_t>(next_in);
+            if (!env.q->enqueue(e))                   return fail(N, "fill failed");
+            ++next_in;
+        }
+        for (uint32_t i = 0; i < CAP / 2; ++i, ++next_out) {
+            Entry e{};
+            if (!env.q->dequeue(e))                   return fail(N, "dequeue failed");
+            if (e.meta.f.rpc_id != static_cast<uint16_t>(next_out))
+                                                      return fail(N, "order mismatch");
+        }
+    }
+    pass(N);
+}
+
+// ---------------------------------------------------------------------------
+//  3. Dequeue on empty queue / enqueue on full queue
+// ---------------------------------------------------------------------------
+void test_empty_and_full() {
+    constexpr const char* N = "test_empty_and_full";
+    TestEnv env;
+
+    Entry e{};
+    if (env.q->dequeue(e))                            return fail(N, "dequeue succeeded on empty");
+    for (uint32_t i = 0; i < CAP; ++i)
+        if (!env.q->enqueue(e))                       return fail(N, "prematurely full");
+    if (env.q->enqueue(e))                            return fail(N, "enqueue succeeded when full");
+#if CXL_QUEUE_METRICS
+    if (env.q->get_metrics().queue_full != 1)         return fail(N, "queue_full not counted");
+#endif
+    pass(N);
+}
+
+// ---------------------------------------------------------------------------
+//  4. Checksum: a corrupted slot must not be consumed
+// ---------------------------------------------------------------------------
+void test_checksum_logic() {
+    constexpr const char* N = "test_checksum_logic";
+    TestEnv env;
+
+    Entry good{};
+    for (int i = 0; i < 7; ++i) good.args[i] = 0xAA55AA55AA55AA55ULL + i;
+    good.meta.f.rpc_id = 0xEE;
+    env.q->enqueue(good);
+    env.q->enqueue(good);
+
+    env.ring[1].args[0] ^= 0x1;                  // corrupt payload of slot 1
+
+    Entry out{};
+    if (!env.q->dequeue(out))                         return fail(N, "queue rejected good entry");
+    if (env.q->dequeue(out))                          return fail(N, "queue accepted corrupted entry");
+#if CXL_QUEUE_METRICS
+    if (env.q->get_metrics().checksum_failed != 1)    return fail(N, "checksum failure not counted");
+#endif
+    pass(N);
+}
+
+// ---------------------------------------------------------------------------
+//  5. Producers sharing a group share the capacity of one ring
+// ---------------------------------------------------------------------------
+void test_group_shared_capacity() {
+    constexpr const char* N = "test_group_shared_capacity";
+    TestEnv env;
+
+    ProducerGroup group;
+    CxlMpscQueue p0(env.ring, ORDER, env.tail_cxl, group, /*do_initialize=*/true);
+    CxlMpscQueue p1(env.ring, ORDER, env.tail_cxl, group, /*do_initialize=*/false);
+
+    // alternate handles; slots must come out in claim order
+    for (uint32_t i = 0; i < CAP; ++i) {
+        Entry e{}; e.meta.f.rpc_id = static_cast<uint16_t>(i);
+        if (!(i & 1 ? p1 : p0).enqueue(e))            return fail(N, "prematurely full");
+    }
+    Entry e{};
+    if (p0.enqueue(e) || p1.enqueue(e))               return fail(N, "group exceeded capacity");
+
+    for (uint32_t i = 0; i < CAP; ++i) {
+        if (!env.q->dequeue(e))                       return fail(N, "dequeue failed");
+        if (e.meta.f.rpc_id != i)                     return fail(N, "order mismatch");
+    }
+    pass(N);
+}
+
+// ---------------------------------------------------------------------------
+//  6. Threaded multi-producer: no loss, per-producer FIFO
+// ---------------------------------------------------------------------------
+void test_threaded_mpsc() {
+    constexpr const char* N = "test_threaded_mpsc";
+    constexpr uint32_t   PRODUCERS = 4;
+    constexpr uint32_t   ITERS     = 20'000;   // per producer
+
+    TestEnv env;
+    ProducerGroup group;
+    std::vector<std::unique_ptr<CxlMpscQueue>> qs;
+    for (uint32_t p = 0; p < PRODUCERS; ++p)
+        qs.push_back(std::make_unique<CxlMpscQueue>(
+            env.ring, ORDER, env.tail_cxl, group, /*do_initialize=*/false));
+
+    std::vector<std::thread> prods;
+    for (uint32_t p = 0; p < PRODUCERS; ++p)
+        prods.emplace_back([&, p]{
+            Entry e{};
+            e.args[0] = p;
+            for (uint32_t i = 0; i < ITERS; ++i) {
+                e.args[1] = i;
+                while (!qs[p]->enqueue(e)) {}
+            }
+        });
+
+    std::vector<uint64_t> next(PRODUCERS, 0);
+    bool ok = true;
+    Entry e{};
+    for (uint32_t seen = 0; seen < PRODUCERS * ITERS; ) {
+        if (!env.q->dequeue(e)) continue;
+        ++seen;
+        if (e.args[0] >= PRODUCERS || e.args[1] != next[e.args[0]]) ok = false;
+        else ++next[e.args[0]];
+    }
+
+    for (auto& t : prods) t.join();
+    if (!ok)                                          return fail(N, "order mismatch or bad producer id");
+    pass(N);
+}
+
+// ---------------------------------------------------------------------------
+//  7. Batches: partial enqueue when nearly full, dequeue stops at a gap
+// ---------------------------------------------------------------------------
+void test_batch_enqueue_dequeue() {
+    constexpr const char* N = "test_batch_enqueue_dequeue";
+    TestEnv env;
+
+    std::vector<Entry> in(CAP + 4), out(CAP);
+    for (uint32_t i = 0; i < in.size(); ++i) in[i].meta.f.rpc_id = static_cast<uint16_t>(i);
+
+    if (env.q->enqueue_batch(std::span(in).first(3)) != 3)   return fail(N, "short first batch");
+    if (env.q->enqueue_batch(std::span(in).subspan(3)) != CAP - 3)
+                                                             return fail(N, "batch not clipped to free space");
+    if (env.q->enqueue_batch(std::span(in).subspan(CAP)) != 0) return fail(N, "enqueue_batch succeeded when full");
+
+    if (env.q->dequeue_batch(out, 5) != 5)                   return fail(N, "max not honoured");
+    std::size_t got = 5;
+    for (std::size_t n; (n = env.q->dequeue_batch(std::span(out).subspan(got))) != 0; got += n) {}
+    if (got != CAP)                                          return fail(N, "lost entries");
+    for (uint32_t i = 0; i < CAP; ++i)
+        if (out[i].meta.f.rpc_id != i)                       return fail(N, "order mismatch");
+
+    // corrupt the 3rd of 4 new entries → batch must stop right before it
+    env.q->enqueue_batch(std::span(in).first(4));
+    env.ring[(CAP + 2) & (CAP - 1)].args[0] ^= 0x1;
+    if (env.q->dequeue_batch(out) != 2)                      return fail(N, "did not stop at torn slot");
+    if (env.q->dequeue_batch(out) != 0)                      return fail(N, "torn slot consumed");
+#if CXL_QUEUE_METRICS
+    if (env.q->get_metrics().checksum_failed != 1)           return fail(N, "checksum failure not counted");
+#endif
+    pass(N);
+}
+
+// ---------------------------------------------------------------------------
+//  8. Zero-copy reserve/commit + peek/release, interleaved with copies
+// ---------------------------------------------------------------------------
+void test_reserve_commit_peek_release() {
+    constexpr const char* N = "test_reserve_commit_peek_release";
+    TestEnv env;
+
+    if (env.q->peek() != nullptr)                            return fail(N, "peek succeeded on empty");
+
+    // three laps, so reservations land on slots with stale content
+    for (uint32_t i = 0; i < 3 * CAP; ++i) {
+        if (i % 3 == 0) {
+            Entry e{}; e.args[0] = i;
+            if (!env.q->enqueue(e))                          return fail(N, "enqueue failed");
+        } else {
+            SlotReservation r = env.q->reserve();
+            if (!r)                                          return fail(N, "reserve failed");
+            r.entry->args[0]          = i;
+            r.entry->meta.f.rpc_id    = static_cast<uint16_t>(i);
+            r.entry->meta.f.rpc_method = 9;
+            env.q->commit(r);
+        }
+
+        if (i % 2 == 0) {
+            const Entry* e = env.q->peek();
+            if (e == nullptr)                                return fail(N, "peek failed");
+            if (e->args[0] != i)                             return fail(N, "peek value mismatch");
+            if (!verify_checksum(e))                         return fail(N, "bad checksum in place");
+            env.q->release();
+        } else {
+            Entry out{};
+            if (!env.q->dequeue(out))                        return fail(N, "dequeue failed");
+            if (out.args[0] != i)                            return fail(N, "dequeue value mismatch");
+            if (i % 3 != 0 && out.meta.f.rpc_method != 9)    return fail(N, "rpc fields lost");
+        }
+    }
+
+    // full ring → empty reservation
+    for (uint32_t i = 0; i < CAP; ++i) env.q->commit(env.q->reserve());
+    if (env.q->reserve())                                    return fail(N, "reserve succeeded when full");
+    pass(N);
+}
+
+// ---------------------------------------------------------------------------
+//  9. Multi-line messages: byte round-trip, wrap, all-or-nothing
+// ---------------------------------------------------------------------------
+void test_multi_line_messages() {
+    constexpr const char* N = "test_multi_line_messages";
+    TestEnv env;
+
+    uint8_t msg[256], back[256];
+    for (std::size_t i = 0; i < sizeof(msg); ++i) msg[i] = static_cast<uint8_t>(i * 7 + 1);
+
+    std::vector<Entry> lines(CAP), out(CAP);
+    const std::size_t m = pack_message(msg, sizeof(msg), lines);
+    if (m != message_lines(sizeof(msg)) || m != 5)           return fail(N, "wrong line count");
+
+    // start at slot CAP-2 so the message wraps around the ring end
+    Entry e{}; e.meta.f.seal_index = -1;
+    for (uint32_t i = 0; i < CAP - 2; ++i) { env.q->enqueue(e); env.q->dequeue(e); }
+
+    lines[0].meta.f.rpc_id = 77;
+    if (!env.q->enqueue_message(std::span(lines).first(m)))  return fail(N, "enqueue_message failed");
+    if (env.q->enqueue_message(std::span(lines).first(CAP - m + 1)))
+                                                             return fail(N, "oversized message accepted");
+
+    // tear the last line → nothing may be consumed
+    const uint32_t last = (CAP - 2 + m - 1) & (CAP - 1);
+    env.ring[last].args[0] ^= 0x1;
+    if (env.q->dequeue_message(out) != 0)                    return fail(N, "partial message returned");
+#if CXL_QUEUE_METRICS
+    if (env.q->get_metrics().message_incomplete != 1)        return fail(N, "incomplete not counted");
+#endif
+    env.ring[last].args[0] ^= 0x1;
+
+    if (env.q->dequeue_message(out) != m)                    return fail(N, "dequeue_message failed");
+    if (out[0].meta.f.rpc_id != 77)                          return fail(N, "header fields lost");
+    unpack_message(std::span(out).first(m), back, sizeof(back));
+    if (std::memcmp(msg, back, sizeof(msg)) != 0)            return fail(N, "payload mismatch");
+
+    // plain entries still come out as one-line messages
+    env.q->enqueue(e);
+    if (env.q->dequeue_message(out) != 1)                    return fail(N, "single line not returned");
+    pass(N);
+}
+
+// ---------------------------------------------------------------------------
+// 10. Lookahead: hits for backlog, misses for slots written after prefetch
+// ---------------------------------------------------------------------------
+void test_lookahead_hits_and_misses() {
+    constexpr const char* N = "test_lookahead_hits_and_misses";
+    TestEnv env;
+
+    Entry e{};
+    for (uint32_t i = 0; i < CAP / 2; ++i) { e.args[0] = i; env.q->enqueue(e); }
+    env.q->set_lookahead(4);                  // window covers written slots
+
+    uint32_t next = 0;
+    for (; next < CAP / 2; ++next) {
+        if (!env.q->dequeue(e) || e.args[0] != next)         return fail(N, "backlog dequeue failed");
+    }
+#if CXL_QUEUE_METRICS
+    const auto hits = env.q->get_metrics().lookahead_hits;
+    if (hits != CAP / 2)                                     return fail(N, "backlog not served from prefetch");
+#endif
+
+    // window now holds lines prefetched before they were written (on
+    // coherent DRAM they may be refreshed → hit, on CXL they miss): every
+    // new item must still be seen, and each success counts exactly once
+    for (uint32_t lap = 0; lap < 3 * CAP; ++lap, ++next) {
+        e.args[0] = next; env.q->enqueue(e);
+        Entry out{};
+        if (!env.q->dequeue(out) || out.args[0] != next)     return fail(N, "stale prefetch returned");
+    }
+#if CXL_QUEUE_METRICS
+    const Metrics& m = env.q->get_metrics();
+    if (m.lookahead_hits + m.lookahead_misses != next)       return fail(N, "hit/miss accounting");
+#endif
+    if (env.q->dequeue(e))                                   return fail(N, "dequeue succeeded on empty");
+    pass(N);
+}
+
+// ---------------------------------------------------------------------------
+// 11. Adaptive tail publication: stall request → demand flush, idle flush
+// ---------------------------------------------------------------------------
+void test_adaptive_tail_policy() {
+    constexpr const char* N = "test_adaptive_tail_policy";
+    TestEnv env;
+    // second handle = the remote producer: it only sees the CXL tail
+    ProducerGroup remote;
+    CxlMpscQueue prod(env.ring, ORDER, env.tail_cxl, remote, false);
+
+    TailPolicy pol;
+    pol.mode        = TailPolicy::Mode::adaptive;
+    pol.idle_cycles = 0;                      // flush on the first empty poll
+    env.q->set_tail_policy(pol);
+    if (env.q->tail_flush_interval() != CAP / 4)            return fail(N, "default interval");
+
+    Entry e{};
+    for (uint32_t i = 0; i < CAP; ++i) { e.args[0] = i; if (!prod.enqueue(e)) return fail(N, "fill"); }
+    if (prod.enqueue(e))                                     return fail(N, "enqueue on full");
+    if (prod.enqueue(e))                                     return fail(N, "enqueue on full (2)");
+#if CXL_QUEUE_METRICS
+    if (prod.get_metrics().tail_requests != 1)               return fail(N, "one request per stall");
+#endif
+
+    // first probe (after interval/4 items) sees the request and publishes
+    for (uint32_t i = 0; i < CAP / 16; ++i)
+        if (!env.q->dequeue(e) || e.args[0] != i)            return fail(N, "dequeue");
+#if CXL_QUEUE_METRICS
+    const Metrics& m = env.q->get_metrics();
+    if (m.flush_tail_demand != 1)                            return fail(N, "demand flush missing");
+#endif
+    if (env.q->tail_flush_interval() != CAP / 8)             return fail(N, "interval not halved");
+    if (!prod.enqueue(e))                                    return fail(N, "producer still blocked");
+
+    uint32_t got = 0;
+    while (env.q->dequeue(e)) ++got;
+    if (got != CAP - CAP / 16 + 1)                           return fail(N, "drain count");
+    if (env.q->tail_flush_interval() <= CAP / 8)             return fail(N, "interval not relaxed");
+
+    // one item below the interval: the next empty poll publishes it
+    if (!prod.enqueue(e) || !env.q->dequeue(e))              return fail(N, "single item");
+    if (*env.tail_cxl == CAP + 2)                            return fail(N, "published too early");
+    if (env.q->dequeue(e))                                   return fail(N, "dequeue on empty");
+#if CXL_QUEUE_METRICS
+    if (m.flush_tail_idle != 1)                              return fail(N, "idle flush missing");
+#endif
+    if (*env.tail_cxl != CAP + 2)                            return fail(N, "tail not published");
+    pass(N);
+}
+
+// ---------------------------------------------------------------------------
+// 12. Wait policies: ladder escalates spin → tpause → yield → sleep
+// ---------------------------------------------------------------------------
+void test_wait_policy_ladder() {
+    constexpr const char* N = "test_wait_policy_ladder";
+    TestEnv env;
+    ExponentialBackoff& b = env.q->consumer_backoff();
+    using EB = ExponentialBackoff;
+
+    env.q->set_wait_policy(WaitPolicy::umwait);
+    Entry e{};
+    if (env.q->dequeue(e))                                   return fail(N, "dequeue on empty");
+    if (b.rung_steps[EB::rung_umwait] != 1)                  return fail(N, "umwait step not taken");
+
+    b.tpause_rounds = 2;
+    b.yield_rounds  = 2;
+    b.max_sleep_us  = 4;
+    env.q->set_wait_policy(WaitPolicy::ladder);
+    uint32_t spin_steps = 0;                  // 128 → 16384 default range
+    for (uint32_t w = 128; w < 16'384; w *= 2) ++spin_steps;
+    const size_t spin0 = b.rung_steps[EB::rung_spin];
+    for (uint32_t i = 0; i < spin_steps + 2 + 2 + 3; ++i)
+        if (env.q->dequeue(e))                               return fail(N, "dequeue on empty");
+    if (b.rung_steps[EB::rung_spin] - spin0 != spin_steps)   return fail(N, "spin rung");
+    if (b.rung_steps[EB::rung_tpause] != 2)                  return fail(N, "tpause rung");
+    if (b.rung_steps[EB::rung_yield]  != 2)                  return fail(N, "yield rung");
+    if (b.rung_steps[EB::rung_sleep]  != 3)                  return fail(N, "sleep rung");
+
+    // an item resets the ladder: the next empty poll spins again
+    env.q->enqueue(e);
+    if (!env.q->dequeue(e))                                  return fail(N, "dequeue");
+    const size_t spin1 = b.rung_steps[EB::rung_spin];
+    env.q->dequeue(e);
+    if (b.rung_steps[EB::rung_spin] != spin1 + 1)            return fail(N, "ladder not reset");
+    pass(N);
+}
+
+// ---------------------------------------------------------------------------
+// 13. QueueSet: only rung rings are drained, idle poll reads summary only
+// ---------------------------------------------------------------------------
+void test_queue_set_doorbells() {
+    constexpr const char* N = "test_queue_set_doorbells";
+    constexpr uint32_t   RINGS = 20;          // two summary lines
+    cxl::NumaAllocator alloc(0, 4u << 20, cxl::DebugLevel::off);
+    QueueSet set(alloc, RINGS, ORDER);
+
+    std::vector<uint64_t> got(RINGS, 0);
+    auto sink = [&](uint32_t r, Entry& e) {
+        if (e.args[0] != r || e.args[1] != got[r]) got[r] = ~0ull;
+        else ++got[r];
+    };
+    set.poll(sink);                           // first poll drains everything once
+    const QueueSetMetrics& m = set.get_metrics();
+    const size_t drains0 = m.rings_drained;
+
+    if (set.poll(sink) != 0)                                 return fail(N, "items on idle set");
+    if (m.rings_drained != drains0)                          return fail(N, "idle poll drained a ring");
+    if (m.summary_reads != 4)                                return fail(N, "idle poll read more than the summary");
+
+    Entry e{};
+    for (uint32_t r : {3u, 17u}) {
+        e.args[0] = r;
+        for (uint32_t i = 0; i < 5; ++i) { e.args[1] = i; if (!set.queue(r).enqueue(e)) return fail(N, "enqueue"); }
+    }
+    Entry batch[3]{};
+    for (uint32_t i = 0; i < 3; ++i) { batch[i].args[0] = 9; batch[i].args[1] = i; }
+    if (set.queue(9).enqueue_batch(batch) != 3)              return fail(N, "enqueue_batch");
+
+    if (set.poll(sink, 4) != 4 + 4 + 3)                      return fail(N, "first drain");
+    if (m.rings_drained != drains0 + 3)                      return fail(N, "drained unflagged rings");
+    if (set.poll(sink, 4) != 2)                              return fail(N, "capped rings not pending");
+    if (got[3] != 5 || got[17] != 5 || got[9] != 3)          return fail(N, "lost / reordered items");
+    if (set.poll(sink) != 0)                                 return fail(N, "items after drain");
+    pass(N);
+}
+
+// ---------------------------------------------------------------------------
+// 14. RPC: window limit, correlation by rpc_id, per-method dispatch
+// ---------------------------------------------------------------------------
+void test_rpc_window_and_dispatch() {
+    constexpr const char* N = "test_rpc_window_and_dispatch";
+    constexpr uint32_t   WINDOW = 4;
+    TestEnv req, rsp;
+
+    RpcServer srv(*req.q, *rsp.q);
+    srv.register_handler(1, [](const Entry& in, Entry& out) { out.args[0] = in.args[0] + 1; });
+    srv.register_handler(2, [](const Entry& in, Entry& out) { out.args[0] = in.args[0] * 2; });
+    RpcClient cli(*req.q, *rsp.q, WINDOW);
+
+    for (uint64_t i = 0; i < WINDOW; ++i)
+        if (!cli.call(static_cast<uint8_t>(1 + i % 2), {&i, 1}, i)) return fail(N, "call within window");
+    const uint64_t x = 99;
+    if (cli.call(1, {&x, 1}))                                return fail(N, "call beyond window");
+    if (cli.in_flight() != WINDOW)                           return fail(N, "in_flight");
+
+    if (srv.poll() != WINDOW)                                return fail(N, "server batch");
+    bool ok = true;
+    size_t done = 0;
+    cli.drain([&](const RpcCompletion& c) {
+        const uint64_t want = c.method == 1 ? c.cookie + 1 : c.cookie * 2;
+        ok &= !c.error && c.method == 1 + c.cookie % 2 && c.rsp.args[0] == want;
+        ++done;
+    });
+    if (!ok || done != WINDOW)                               return fail(N, "wrong responses");
+
+    // unknown method → error completion, id recycled
+    if (!cli.call(7, {&x, 1}))                               return fail(N, "call after drain");
+    srv.poll();
+    bool err = false;
+    cli.drain([&](const RpcCompletion& c) { err = c.error && c.method == 7 && c.rsp.args[0] == 7; });
+    if (!err)                                                return fail(N, "no error completion");
+    if (cli.get_metrics().unknown_responses != 0)            return fail(N, "mis-correlated response");
+    pass(N);
+}
+
+// ---------------------------------------------------------------------------
+// 15. Coroutines: many producers, a relay and a collector on one thread
+// ---------------------------------------------------------------------------
+void test_coroutine_scheduler() {
+    constexpr const char* N = "test_coroutine_scheduler";
+    constexpr uint32_t   PRODUCERS = 64;
+    constexpr uint32_t   ITEMS     = 8;       // per producer; rings hold 16
+    TestEnv a, b;
+    CoroScheduler sched;
+
+    auto producer = [](CoroScheduler& s, CxlMpscQueue& q, uint64_t id) -> CoTask {
+        Entry e{};
+        e.args[0] = id;
+        for (uint64_t i = 0; i < ITEMS; ++i) {
+            e.args[1] = i;
+            co_await s.async_enqueue(q, e);
+        }
+    };
+    auto relay = [](CoroScheduler& s, CxlMpscQueue& in, CxlMpscQueue& out) -> CoTask {
+        for (uint32_t i = 0; i < PRODUCERS * ITEMS; ++i) {
+            Entry e = co_await s.async_dequeue(in);
+            co_await s.async_enqueue(out, e);
+        }
+    };
+    bool ok = true;
+    uint32_t seen = 0;
+    auto collector = [&](CoroScheduler& s, CxlMpscQueue& in) -> CoTask {
+        std::vector<uint64_t> next(PRODUCERS, 0);
+        for (uint32_t i = 0; i < PRODUCERS * ITEMS; ++i) {
+            Entry e = co_await s.async_dequeue(in);
+            if (e.args[0] >= PRODUCERS || e.args[1] != next[e.args[0]]++) ok = false;
+            ++seen;
+        }
+    };
+
+    sched.spawn(collector(sched, *b.q));
+    sched.spawn(relay(sched, *a.q, *b.q));
+    for (uint64_t p = 0; p < PRODUCERS; ++p) sched.spawn(producer(sched, *a.q, p));
+    sched.run();
+
+    const CoroMetrics& m = sched.get_metrics();
+    if (!ok || seen != PRODUCERS * ITEMS)                    return fail(N, "lost or reordered items");
+    if (sched.live() != 0)                                   return fail(N, "tasks left");
+    if (m.items_enqueued != 2 * PRODUCERS * ITEMS)           return fail(N, "enqueue count");
+
+    // CAP waiters parked in one round are served by a single batch probe
+    TestEnv c;
+    CoroScheduler one;
+    auto once = [](CoroScheduler& s, CxlMpscQueue& q, uint64_t id) -> CoTask {
+        Entry e{};
+        e.args[0] = id;
+        co_await s.async_enqueue(q, e);
+    };
+    for (uint64_t p = 0; p < CAP; ++p) one.spawn(once(one, *c.q, p));
+    one.run();
+    if (one.get_metrics().enqueue_probes != 1)               return fail(N, "enqueues not batched");
+    Entry e{};
+    for (uint64_t p = 0; p < CAP; ++p)
+        if (!c.q->dequeue(e) || e.args[0] != p)              return fail(N, "batched enqueue order");
+    pass(N);
+}
+
+// ---------------------------------------------------------------------------
+// 16. Pool allocator: class alignment, reuse after free, cross-thread free
+// ---------------------------------------------------------------------------
+void test_pool_allocator_reuse() {
+    constexpr const char* N = "test_pool_allocator_reuse";
+    cxl::NumaAllocator up(0, 16u << 20, cxl::DebugLevel::off);
+    cxl::PoolAllocator pool(up, cxl::DebugLevel::off);
+
+    void* a = pool.allocate_aligned(200);                    // 256-B class
+    void* b = pool.allocate_aligned(64, 4096);               // 4-KiB class
+    if (reinterpret_cast<uintptr_t>(a) % 256)                return fail(N, "class alignment");
+    if (reinterpret_cast<uintptr_t>(b) % 4096)               return fail(N, "requested alignment");
+    pool.deallocate(a, 200);
+    if (pool.allocate_aligned(256) != a)                     return fail(N, "freed block not reused");
+
+    // large path: recycled by rounded size
+    void* big = pool.allocate_aligned(3u << 20);
+    pool.deallocate(big, 3u << 20);
+    if (pool.allocate_aligned((3u << 20) - 100) != big)      return fail(N, "large block not reused");
+
+    // blocks freed on another thread come back through the central list
+    std::vector<void*> blocks;
+    for (int i = 0; i < 1000; ++i) blocks.push_back(pool.allocate_aligned(64));
+    const size_t upstream = pool.stats().upstream_bytes;
+    std::thread([&] {
+        for (void* p : blocks) pool.deallocate(p, 64);
+    }).join();                                               // thread exit spills its cache
+    for (int i = 0; i < 1000; ++i) pool.allocate_aligned(64);
+    const cxl::PoolStats st = pool.stats();
+    if (st.upstream_bytes != upstream)                       return fail(N, "cross-thread frees not reused");
+    if (st.allocs != st.frees + 1000 + 3)                    return fail(N, "alloc/free accounting");
+    pass(N);
+}
+
+// ---------------------------------------------------------------------------
+// 17. Buffer pool: handle in the ring, payload in place, ids returned
+// ---------------------------------------------------------------------------
+void test_buffer_pool_handles() {
+    constexpr const char* N = "test_buffer_pool_handles";
+    constexpr uint32_t   BUFS = 8;
+    cxl::NumaAllocator alloc(0, 4u << 20, cxl::DebugLevel::off);
+    BufferPool pool(alloc, BUFS, 1000, 3);    // 1000 → 1024-B buffers
+    TestEnv env;
+
+    if (pool.buffer_bytes() != 1024)                         return fail(N, "buffer rounding");
+    std::vector<uint8_t> src(1000);
+    for (uint32_t round = 0; round < 3; ++round) {
+        for (uint32_t i = 0; i < BUFS; ++i) {
+            const BufferHandle h = pool.acquire(100 + i * 100);
+            if (!h)                                          return fail(N, "acquire");
+            std::memset(src.data(), int(round * BUFS + i), h.length);
+            pool.write(h, src.data());
+            Entry e{};
+            put_handle(e, h);
+            e.args[2] = i;
+            if (!env.q->enqueue(e))                          return fail(N, "enqueue handle");
+        }
+        if (pool.acquire(10))                                return fail(N, "acquire beyond pool");
+
+        Entry e{};
+        for (uint32_t i = 0; i < BUFS; ++i) {
+            if (!env.q->dequeue(e))                          return fail(N, "dequeue handle");
+            const BufferHandle h = get_handle(e);
+            const auto* p = static_cast<const uint8_t*>(pool.open(h));
+            if (h.length != 100 + e.args[2] * 100 ||
+                p[0] != round * BUFS + i || p[h.length - 1] != p[0])
+                                                             return fail(N, "payload mismatch");
+            pool.release(h);
+        }
+        pool.flush_releases();
+    }
+    if (pool.reclaim() != BUFS || pool.free_buffers() != BUFS)
+                                                             return fail(N, "final reclaim");
+    const BufferPoolMetrics& m = pool.get_metrics();
+    if (m.reclaimed != 3 * BUFS)                      return fail(N, "ids not reclaimed");
+    if (m.return_entries != 3 * 2)                           return fail(N, "ids not batched per Entry");
+
+    // one id per return Entry (flush on every idle poll) past the ring size:
+    // the producer reclaims only when its free list runs dry
+    BufferPool idle(alloc, 64, 1024, 6);
+    for (uint32_t round = 0; round < 3 * 64; ++round) {
+        const BufferHandle h = idle.acquire(64);
+        if (!h)                                              return fail(N, "idle acquire");
+        idle.release(h);
+        if (!idle.flush_releases())                          return fail(N, "return ring full");
+    }
+    if (idle.pending_releases() != 0 || idle.get_metrics().return_full != 0)
+                                                             return fail(N, "releases deferred");
+    idle.reclaim();
+    if (idle.free_buffers() != 64)                           return fail(N, "idle reclaim");
+    pass(N);
+}
+
+// ---------------------------------------------------------------------------
+// 18. Allocator prefault: no page faults left for the first pass
+// ---------------------------------------------------------------------------
+void test_allocator_prefault() {
+    constexpr const char* N = "test_allocator_prefault";
+    constexpr std::size_t LEN = 8u << 20;
+    auto first_pass_faults = [](cxl::CxlAllocator& a) {
+        auto* p = static_cast<uint8_t*>(a.allocate_aligned(LEN, 4096));
+        const uint64_t f0 = cxl::page_faults();
+        for (std::size_t off = 0; off < LEN; off += 4096) p[off] = 1;
+        return cxl::page_faults() - f0;
+    };
+
+    cxl::NumaAllocator cold(0, LEN, cxl::DebugLevel::off);
+    if (first_pass_faults(cold) == 0)                        return fail(N, "cold mapping took no faults");
+
+    cxl::MapOptions opt;
+    opt.prefault = true;
+    cxl::NumaAllocator warm(0, LEN, cxl::DebugLevel::off, opt);
+    const cxl::MapInfo info = warm.map_info();
+    if (info.page_size != 4096 || info.prefault_faults == 0) return fail(N, "prefault report");
+    if (first_pass_faults(warm) != 0)                        return fail(N, "faults after prefault");
+
+    opt.page       = cxl::PageSize::huge_2m;               // falls back without a reservation
+    opt.interleave = {0};
+    cxl::NumaAllocator huge(0, LEN - 1, cxl::DebugLevel::off, opt);
+    const cxl::MapInfo hi = huge.map_info();
+    if (hi.huge_fallback == (hi.page_size == (2u << 20)))    return fail(N, "page size vs. fallback");
+    if (huge.capacity() != LEN - 1)                          return fail(N, "capacity");
+    pass(N);
+}
+
+// ---------------------------------------------------------------------------
+// 19. Store / load policies: every variant passes the same round trip
+// ---------------------------------------------------------------------------
+template <class Queue>
+bool policy_round_trip(Entry* ring, uint64_t* tail_cxl)
+{
+    Queue q(ring, ORDER, tail_cxl, /*do_initialize=*/true);
+    Entry e{}, out{};
+    for (uint32_t lap = 0; lap < 3; ++lap) {             // cross epochs
+        for (uint32_t i = 0; i < CAP; ++i) {
+            e.args[0] = lap * CAP + i;
+            if (!q.enqueue(e)) return false;
+        }
+        for (uint32_t i = 0; i < CAP; ++i)
+            if (!q.dequeue(out) || out.args[0] != lap * CAP + i) return false;
+    }
+    alignas(64) Entry batch[8]{}, got[8];
+    for (uint32_t i = 0; i < 8; ++i) batch[i].args[1] = i;
+    if (q.enqueue_batch(batch) != 8 || q.dequeue_batch(got) != 8 || got[7].args[1] != 7)
+        return false;
+    std::vector<Entry> lines(3), back(3);
+    if (!q.enqueue_message(lines) || q.dequeue_message(back) != 3) return false;
+    if (!q.enqueue(e) || !q.peek()) return false;
+    q.release();
+    return !q.dequeue(out);
+}
+
+void test_store_load_policies() {
+    constexpr const char* N = "test_store_load_policies";
+    TestEnv env;
+    for (StoreKind s : {StoreKind::nt, StoreKind::movdir64b, StoreKind::clwb, StoreKind::clflushopt})
+        for (LoadKind l : {LoadKind::clflushopt, LoadKind::clflush})
+            for (CheckKind c : {CheckKind::xor16, CheckKind::crc32c, CheckKind::none}) {
+                if (c == CheckKind::none && s != StoreKind::movdir64b) continue;
+                const QueueVariant v{s, l, c};
+                const bool ok = with_queue_variant(v, [&](auto tag) {
+                    return policy_round_trip<typename decltype(tag)::type>(env.ring, env.tail_cxl);
+                });
+                if (!ok) {
+                    std::cerr << "  variant " << v << '\n';
+                    return fail(N, "round trip");
+                }
+                const auto parsed = parse_queue_variant((std::ostringstream{} << v).str());
+                if (!parsed || parsed->store != s || parsed->load != l || parsed->check != c)
+                    return fail(N, "parse_queue_variant");
+            }
+    if (parse_queue_variant("nt") || parse_queue_variant("foo+clflush") ||
+        parse_queue_variant("nt+clflushopt+none"))
+        return fail(N, "bad variant accepted");
+    if (parse_queue_variant("nt+clflush")->check != CheckKind::xor16)
+        return fail(N, "default check");
+    pass(N);
+}
+
+// ---------------------------------------------------------------------------
+// 20. Check policies: CRC32C sees what XOR misses, NoCheck frees the field
+// ---------------------------------------------------------------------------
+void test_check_policies() {
+    constexpr const char* N = "test_check_policies";
+
+    Entry e{};
+    for (int i = 0; i < 7; ++i) e.args[i] = 0x0123'4567'89ab'cdefull * (i + 1);
+    e.meta.f.epoch = 3;
+    Entry x = e, c = e;
+    XorCheck::stamp(x);
+    Crc32cCheck::stamp(c);
+    if (!XorCheck::verify(x) || !Crc32cCheck::verify(c))      return fail(N, "pristine line rejected");
+
+    /* the same bit flipped in two words: the XOR fold cancels it */
+    x.args[1] ^= 0x10; x.args[4] ^= 0x10;
+    c.args[1] ^= 0x10; c.args[4] ^= 0x10;
+    if (!XorCheck::verify(x))                                  return fail(N, "xor premise");
+    if (Crc32cCheck::verify(c))                                return fail(N, "crc32c missed a double flip");
+
+    /* commit() must produce what stamp() produces */
+    TestEnv env;
+    BasicCxlMpscQueue<NtStore, FlushLoad, Crc32cCheck> q(env.ring, ORDER, env.tail_cxl);
+    SlotReservation r = q.reserve();
+    r.entry->args[0] = 42;
+    r.entry->meta.f.seal_index = -1;
+    q.commit(r);
+    if (!Crc32cCheck::verify(*r.entry))                        return fail(N, "commit crc32c");
+    Entry out{};
+    if (!q.dequeue(out) || out.args[0] != 42)                  return fail(N, "crc32c dequeue");
+
+#ifdef __MOVDIR64B__
+    /* no check: the checksum field is payload and comes back untouched */
+    BasicCxlMpscQueue<MovDir64BStore, FlushLoad, NoCheck> nq(env.ring, ORDER, env.tail_cxl);
+    for (uint32_t i = 0; i < 2 * CAP; ++i) {
+        Entry in{};
+        in.args[0]           = i;
+        in.meta.f.checksum   = static_cast<uint16_t>(0xBEEF ^ i);
+        if (!nq.enqueue(in))                                   return fail(N, "nocheck enqueue");
+        if (!nq.dequeue(out) || out.args[0] != i ||
+            out.meta.f.checksum != static_cast<uint16_t>(0xBEEF ^ i))
+                                                               return fail(N, "checksum field not payload");
+    }
+    if (nq.get_metrics().checksum_failed != 0)                 return fail(N, "nocheck counted a failure");
+
+    /* commit() goes through the Store policy too (one movdir64b here) */
+    SlotReservation nr = nq.reserve();
+    nr.entry->args[0]         = 7;
+    nr.entry->meta.f.checksum = 0xBEEF;
+    nq.commit(nr);
+    if (!nq.dequeue(out) || out.args[0] != 7 || out.meta.f.checksum != 0xBEEF)
+                                                               return fail(N, "nocheck commit");
+#endif
+    pass(N);
+}
+
+// ---------------------------------------------------------------------------
+// 21. Latency histogram percentiles + TSC offset calibration
+// ---------------------------------------------------------------------------
+void test_latency_histogram_and_calibration() {
+    constexpr const char* N = "test_latency_histogram_and_calibration";
+
+    /* bucket edges: index() is monotone and every value ≤ its upper edge */
+    for (uint64_t v : {0ull, 15ull, 16ull, 31ull, 32ull, 1000ull, 123456789ull, ~0ull}) {
+        const std::size_t i = LatencyHistogram::index(v);
+        if (i >= LatencyHistogram::k_buckets || LatencyHistogram::upper_edge(i) < v ||
+            (i > 0 && LatencyHistogram::upper_edge(i - 1) >= v))
+            return fail(N, "bucket edges");
+    }
+
+    /* 1…10000: percentiles within one bucket (≤ 1/16) of the exact rank */
+    LatencyHistogram h;
+    for (uint64_t v = 1; v <= 10'000; ++v) h.record(v);
+    for (double p : {0.5, 0.9, 0.99, 0.999}) {
+        const double exact = p * 10'000;
+        const double got   = static_cast<double>(h.percentile(p));
+        if (got < exact || got > exact * (1.0 + 1.0 / 16) + 1) return fail(N, "percentile error");
+    }
+    if (h.min() != 1 || h.max() != 10'000 || h.count() != 10'000) return fail(N, "min/max/count");
+    LatencyHistogram spike;
+    spike.record(1'000'000);
+    h.merge(spike);
+    if (h.max() != 1'000'000 || h.percentile(1.0) != 1'000'000)   return fail(N, "merge");
+
+    /* calibration against a responder whose clock runs 5 M cycles ahead */
+    constexpr int64_t  SKEW   = 5'000'000;
+    constexpr uint32_t ROUNDS = 32;
+    TestEnv a, b;                          // a: initiator → responder, b: back
+    std::thread responder([&] {
+        serve_tsc_calibration(*a.q, *b.q, ROUNDS,
+                              [] { return __rdtsc() + static_cast<uint64_t>(SKEW); });
+    });
+    const TscOffset off = calibrate_tsc_offset(*a.q, *b.q, ROUNDS);
+    responder.join();
+    if (off.rounds != ROUNDS || off.rtt_min == 0)               return fail(N, "calibration rounds");
+    if (std::llabs(off.offset - SKEW) > static_cast<int64_t>(off.rtt_min / 2 + 1))
+        return fail(N, "offset outside ±rtt/2");
+
+    /* one-way: a stamp taken on the skewed clock maps back onto ours */
+    Entry e{};
+    e.args[k_ts_arg] = __rdtsc() + SKEW;
+    const uint64_t lat = one_way_cycles(e, TscOffset{SKEW, 0, 0}, __rdtsc() + 1000);
+    if (lat < 1000 || lat > 1'000'000)                          return fail(N, "one_way_cycles");
+    pass(N);
+}
+
+// ---------------------------------------------------------------------------
+//  22. Live stats export: periodic snapshots, fresh reads, torn-line check,
+//      NullCounter (what Metrics fields become with CXL_QUEUE_METRICS=0)
+// ---------------------------------------------------------------------------
+void test_stats_export() {
+    constexpr const char* N = "test_stats_export";
+    TestEnv env;
+
+    const std::size_t bytes = StatsSegment::bytes(2);
+    void* mem = numa_alloc_onnode(bytes, 0);
+    StatsSegment seg(mem, 2, /*do_initialize=*/true);
+    StatsSegment view(mem, 0, /*do_initialize=*/false);   // monitor's handle
+    if (view.slots() != 2)                                      return fail(N, "slot count from header");
+
+    QueueStatsLine s{};
+    StatsSlotInfo info;
+    if (view.describe(0, info) || view.read(0, s))              return fail(N, "unattached slot readable");
+
+    env.q->set_stats_export(StatsRole::producer,
+                            seg.attach(0, "req", StatsRole::producer, env.q->capacity()), 2);
+    env.q->set_stats_export(StatsRole::consumer,
+                            seg.attach(1, "req", StatsRole::consumer, env.q->capacity()), 2);
+    if (!view.describe(1, info) || info.name != "req" ||
+        info.role != StatsRole::consumer || info.capacity != CAP) return fail(N, "descriptor");
+
+    // every 4 calls: the 8th enqueue publishes before claiming its slot
+    Entry e{};
+    for (int i = 0; i < 10; ++i)
+        if (!env.q->enqueue(e))                                 return fail(N, "enqueue");
+    if (!view.read(0, s) || s.seq != 3 || s.calls != 8 || s.position != 7)
+        return fail(N, "periodic producer snapshot");
+    env.q->publish_stats(StatsRole::producer);
+    if (!view.read(0, s) || s.seq != 4 || s.calls != 10 || s.position != 10)
+        return fail(N, "explicit producer snapshot");
+
+    for (int i = 0; i < 6; ++i)
+        if (!env.q->dequeue(e))                                 return fail(N, "dequeue");
+    if (!view.read(1, s) || s.seq != 2 || s.calls != 4 || s.position != 3)
+        return fail(N, "consumer snapshot");
+    env.q->publish_stats(StatsRole::consumer);
+    const uint64_t depth = (view.read(0, s), s.position);
+    if (!view.read(1, s) || depth - s.position != 4)            return fail(N, "depth");
+#if CXL_QUEUE_METRICS
+    if (s.stalls != env.q->get_metrics().no_new_items)          return fail(N, "stalls from Metrics");
+#endif
+
+    // a line whose two sequence words disagree is a torn read
+    alignas(64) QueueStatsLine torn = s;
+    torn.seq_check = s.seq + 1;
+    store_nt_64B(seg.line(1), &torn);
+    if (view.read(1, s))                                        return fail(N, "torn line accepted");
+
+    env.q->set_stats_export(StatsRole::producer, nullptr);
+    const uint64_t seq = (view.read(0, s), s.seq);
+    for (int i = 0; i < 8; ++i) env.q->enqueue(e);
+    if (!view.read(0, s) || s.seq != seq)                       return fail(N, "export not stopped");
+
+    NullCounter c;
+    ++c; c += 5;
+    if (static_cast<std::size_t>(c) != 0)                       return fail(N, "NullCounter counts");
+    numa_free(mem, bytes);
+    pass(N);
+}
+
+// ---------------------------------------------------------------------------
+// 23. Back-off: per-queue state; adaptive mode retunes from observed gaps
+// ---------------------------------------------------------------------------
+void test_adaptive_backoff() {
+    constexpr const char* N = "test_adaptive_backoff";
+    TestEnv a, b;
+    Entry e{};
+    for (uint32_t i = 0; i < CAP; ++i)
+        if (!a.q->enqueue(e))                                return fail(N, "fill");
+    if (a.q->enqueue(e))                                     return fail(N, "enqueue on full");
+    if (a.q->producer_backoff().current_wait_ == 128)        return fail(N, "full wait not grown");
+    if (b.q->producer_backoff().current_wait_ != 128)        return fail(N, "back-off shared between queues");
+    while (a.q->dequeue(e)) {}                               // drain; the empty poll publishes the tail
+    if (!a.q->enqueue(e))                                    return fail(N, "enqueue after drain");
+    if (a.q->producer_backoff().current_wait_ != 128)        return fail(N, "not reset on success");
+
+    // 32 successes after 16+32+64+128 each: gap = 240 − 128/2 = 176, no spread
+    using EB = ExponentialBackoff;
+    EB bo{16, 4'096};
+    bo.set_adaptive(true);
+    size_t ev = 0, cyc = 0;
+    for (uint32_t i = 0; i < EB::k_retune_every; ++i) {
+        for (int k = 0; k < 4; ++k) bo.pause(ev, cyc);
+        bo.reset();
+    }
+    if (bo.retunes() != 1 || bo.gap_estimate() != 176)      return fail(N, "gap estimate");
+    if (bo.poll_success_pct() != 20)                         return fail(N, "poll success rate");
+    if (bo.min_wait() != 212)                                return fail(N, "min ≠ √(2·128·176)");
+    if (bo.growth() != 1.0625)                               return fail(N, "steady gaps should not escalate");
+    if (bo.max_wait() != 4 * 212)                            return fail(N, "max ≠ 4 × min");
+    if (bo.current_wait_ != 212)                             return fail(N, "schedule not applied");
+
+    // a success without waiting is not a gap sample
+    bo.reset();
+    if (bo.gap_estimate() != 176)                            return fail(N, "idle reset observed");
+
+    // handle-level switch; fixed mode keeps the constructed schedule
+    a.q->set_backoff_adaptive(true);
+    if (!a.q->producer_backoff().adaptive() ||
+        !a.q->consumer_backoff().adaptive())                 return fail(N, "set_backoff_adaptive");
+    if (b.q->producer_backoff().adaptive())                  return fail(N, "adaptive leaked to another queue");
+    a.q->set_backoff_adaptive(false);
+    if (a.q->producer_backoff().min_wait() != 128)           return fail(N, "fixed min changed");
+    pass(N);
+}
+
+// ---------------------------------------------------------------------------
+// 24. StreamChannel: chunked messages, in-place polls, credit flow control
+// ---------------------------------------------------------------------------
+void test_stream_channel() {
+    constexpr const char* N = "test_stream_channel";
+    constexpr uint32_t   CHUNKS = 4;
+    constexpr size_t     CHUNK  = 4096;
+    cxl::NumaAllocator alloc(0, 4u << 20, cxl::DebugLevel::off);
+    const StreamRegion r = StreamRegion::allocate(alloc, CHUNKS, CHUNK);
+    StreamChannel tx(r, /*do_initialize=*/true);
+    StreamChannel rx(r, /*do_initialize=*/false, /*window=*/2, /*credit_batch=*/1);
+
+    // a message spanning 3 chunks, last one partial (and not line-sized)
+    std::vector<uint8_t> src(2 * CHUNK + 100), dst(src.size() + 64, 0);
+    for (size_t i = 0; i < src.size(); ++i) src[i] = static_cast<uint8_t>(i * 7 + 1);
+    tx.send(src.data(), src.size());
+    if (tx.get_metrics().chunks_sent != 3)                   return fail(N, "chunking");
+    if (rx.receive(dst.data(), dst.size()) != src.size())    return fail(N, "receive length");
+    if (std::memcmp(dst.data(), src.data(), src.size()) != 0) return fail(N, "payload");
+    if (rx.get_metrics().max_in_flight != 2)                 return fail(N, "window not used");
+
+    // in place: one message per chunk, polled up to the window
+    for (uint8_t k = 0; k < 3; ++k) {
+        std::vector<uint8_t> m(64, k);
+        tx.send(m.data(), m.size());
+    }
+    StreamChunk a = rx.poll(), b = rx.poll();
+    if (!a || !b || rx.poll())                               return fail(N, "window bound");
+    if (a.data[0] != 0 || b.data[0] != 1 || !a.end_of_message) return fail(N, "in-place data");
+    rx.release();
+    rx.release();
+    StreamChunk c = rx.poll();
+    if (!c || c.data[0] != 2 || c.bytes != 64)               return fail(N, "third chunk");
+    rx.release();
+    if (rx.poll())                                           return fail(N, "poll on empty");
+
+    // 6 chunks released and published: refilling all 4 takes one fresh
+    // credit read, never a wait
+    const size_t waits0 = tx.get_metrics().credit_waits;
+    std::vector<uint8_t> big(CHUNKS * CHUNK, 0x5a);
+    tx.send(big.data(), big.size());
+    if (tx.get_metrics().credit_waits != waits0)             return fail(N, "credits not returned");
+    std::vector<uint8_t> back(big.size());
+    if (rx.receive(back.data(), back.size()) != big.size() ||
+        back != big)                                         return fail(N, "full ring round trip");
+    pass(N);
+}
+
+// ---------------------------------------------------------------------------
+// 25. RPC tail piggyback: credits ride on responses, no CXL tail traffic
+// ---------------------------------------------------------------------------
+void test_rpc_tail_piggyback() {
+    constexpr const char* N = "test_rpc_tail_piggyback";
+    TestEnv req, rsp;
+
+    RpcServer srv(*req.q, *rsp.q);
+    srv.register_handler(1, [](const Entry& in, Entry& out) { out.args[0] = in.args[0] + 1; });
+    srv.set_tail_piggyback(true);
+    RpcClient cli(*req.q, *rsp.q, CAP);
+    cli.set_tail_piggyback(true);
+    if (req.q->tail_policy().mode != TailPolicy::Mode::piggyback) return fail(N, "server did not switch policy");
+
+    // five laps of the request ring, a full window each round
+    bool ok = true;
+    for (uint64_t round = 0; round < 5; ++round) {
+        for (uint64_t i = 0; i < CAP; ++i) {
+            const uint64_t x = round * CAP + i;
+            if (!cli.call(1, {&x, 1}, x))                    return fail(N, "call refused");
+        }
+        while (srv.poll() != 0) {}
+        cli.drain([&](const RpcCompletion& c) { ok &= !c.error && c.rsp.args[0] == c.cookie + 1; });
+    }
+    if (!ok)                                                 return fail(N, "wrong responses");
+    if (cli.get_metrics().tail_credits == 0)                 return fail(N, "no credits applied");
+#if CXL_QUEUE_METRICS
+    const Metrics& m = req.q->get_metrics();
+    if (m.read_cxl_tail != 0)                                return fail(N, "client read the CXL tail");
+    if (m.flush_tail != 0)                                   return fail(N, "server flushed the tail");
+    if (m.tail_credits != cli.get_metrics().tail_credits)    return fail(N, "credits not applied");
+#endif
+    if (req.q->note_consumer_tail(0))                        return fail(N, "stale credit accepted");
+
+    // a producer without in-band credits fills the ring, finds the CXL
+    // tail stale, posts a stall request; the idle consumer answers it
+    TailPolicy pol = req.q->tail_policy();
+    pol.idle_cycles = 0;
+    req.q->set_tail_policy(pol);
+    Entry e{};
+    size_t sent = 0;
+    while (req.q->enqueue(e)) ++sent;
+    if (sent != CAP)                                         return fail(N, "ring not filled");
+#if CXL_QUEUE_METRICS
+    if (req.q->get_metrics().tail_requests == 0)             return fail(N, "no stall request");
+#endif
+    Entry out{};
+    while (req.q->dequeue(out)) {}
+#if CXL_QUEUE_METRICS
+    if (req.q->get_metrics().flush_tail_demand != 1)         return fail(N, "no demand flush");
+#endif
+    if (!req.q->enqueue(e))                                  return fail(N, "producer still stalled");
+
+    srv.set_tail_piggyback(false);
+    if (req.q->tail_policy().mode != TailPolicy::Mode::fixed) return fail(N, "policy not restored");
+    pass(N);
+}
+
+// ---------------------------------------------------------------------------
+// 26. Broadcast ring: one write per entry, slowest cursor blocks, lapping
+// ---------------------------------------------------------------------------
+void test_broadcast_ring() {
+    constexpr const char* N = "test_broadcast_ring";
+    constexpr uint32_t   SUBS = 3;
+    cxl::NumaAllocator alloc(0, 1u << 20, cxl::DebugLevel::off);
+
+    // block: every subscriber sees every entry, the slowest holds the producer
+    {
+        const BroadcastRegion r = BroadcastRegion::allocate(alloc, ORDER, SUBS);
+        BroadcastProducer pub(r, /*do_initialize=*/true);
+        std::vector<std::unique_ptr<BroadcastSubscriber>> subs;
+        for (uint32_t i = 0; i < SUBS; ++i) subs.push_back(std::make_unique<BroadcastSubscriber>(r, i));
+
+        Entry e{};
+        for (uint64_t i = 0; i < CAP; ++i) {
+            e.args[0] = i;
+            if (!pub.publish(e))                             return fail(N, "publish within capacity");
+        }
+        if (pub.publish(e))                                  return fail(N, "publish past the slowest cursor");
+
+        uint64_t next[SUBS] = {};
+        auto drain = [&](uint32_t s) {
+            Entry out[CAP];
+            bool ok = true;
+            while (const std::size_t n = subs[s]->poll_batch(out))
+                for (std::size_t k = 0; k < n; ++k) ok &= out[k].args[0] == next[s]++;
+            return ok;
+        };
+        if (!drain(0) || !drain(1))                          return fail(N, "fan-out order");
+        if (pub.publish(e))                                  return fail(N, "subscriber 2 not waited for");
+        subs[2]->detach();                                   // leaves the minimum
+        e.args[0] = CAP;
+        if (!pub.publish(e))                                 return fail(N, "detached subscriber still blocks");
+        if (!drain(0) || next[0] != CAP + 1)                 return fail(N, "entry after refill");
+        if (pub.get_metrics().published != CAP + 1)          return fail(N, "one write per entry");
+        if (pub.get_metrics().cursor_reads > 4 * SUBS)       return fail(N, "cursor lines read on the fast path");
+    }
+
+    // lap: the producer never waits, a stalled subscriber skips ahead
+    {
+        const BroadcastRegion r = BroadcastRegion::allocate(alloc, ORDER, 1);
+        BroadcastProducer   pub(r, /*do_initialize=*/true, BroadcastProducer::Overflow::lap);
+        BroadcastSubscriber sub(r, 0);
+        Entry e{};
+        for (uint64_t i = 0; i < 3 * CAP + 5; ++i) {
+            e.args[0] = i;
+            if (!pub.publish(e))                             return fail(N, "lap mode refused");
+        }
+        if (pub.get_metrics().subscribers_lapped != 1)       return fail(N, "lap not counted");
+        Entry out{};
+        uint64_t got = 0, first = 0;
+        while (sub.poll(out)) { if (got++ == 0) first = out.args[0]; }
+        if (first != 3 * CAP || got != 5)                    return fail(N, "did not resync to the live lap");
+        if (sub.get_metrics().laps != 1 || sub.get_metrics().skipped != 3 * CAP)
+                                                             return fail(N, "skip accounting");
+        e.args[0] = 42;
+        pub.publish(e);
+        if (!sub.poll(out) || out.args[0] != 42)             return fail(N, "entry after resync");
+    }
+
+    // 200 laps (epoch lag ≥ 0x80): a late subscriber starts from the head
+    // line, a stalled one resyncs to it instead of waiting for a wrap
+    {
+        constexpr uint64_t LIVE = 200 * CAP;                 // head line published here
+        const BroadcastRegion r = BroadcastRegion::allocate(alloc, ORDER, 2);
+        BroadcastProducer   pub(r, /*do_initialize=*/true, BroadcastProducer::Overflow::lap);
+        BroadcastSubscriber stalled(r, 0);
+        Entry e{};
+        for (uint64_t i = 0; i < LIVE + 3; ++i) {
+            e.args[0] = i;
+            pub.publish(e);
+        }
+        BroadcastSubscriber late(r, 1);
+        if (late.cursor() != LIVE)                           return fail(N, "late subscriber not at the head line");
+        for (BroadcastSubscriber* s : {&late, &stalled}) {
+            Entry out[CAP];
+            const std::size_t n = s->poll_batch(out);
+            if (n != 3 || out[0].args[0] != LIVE || out[2].args[0] != LIVE + 2)
+                                                             return fail(N, "nothing found past 128 laps");
+        }
+        if (stalled.get_metrics().head_resyncs != 1 || stalled.get_metrics().skipped != LIVE)
+                                                             return fail(N, "head resync accounting");
+        e.args[0] = LIVE + 3;
+        pub.publish(e);
+        Entry out{};
+        if (!late.poll(out) || out.args[0] != LIVE + 3 ||
+            !stalled.poll(out) || out.args[0] != LIVE + 3)   return fail(N, "entry after head resync");
+    }
+    pass(N);
+}
+
+// ---------------------------------------------------------------------------
+// 27. Sharded queue: home shard first, stealing, claims, spill, threads
+// ---------------------------------------------------------------------------
+void test_sharded_work_stealing() {
+    constexpr const char* N = "test_sharded_work_stealing";
+    constexpr uint32_t   SHARDS = 4;
+    cxl::NumaAllocator alloc(0, 1u << 20, cxl::DebugLevel::off);
+    ShardedQueue  sq(alloc, SHARDS, ORDER);
+    ShardProducer prod(sq);
+
+    Entry e{};
+    for (uint64_t i = 0; i < 4 * SHARDS; ++i) {            // 4 per shard
+        e.args[0] = i;
+        if (!prod.enqueue(e))                                return fail(N, "round-robin enqueue");
+    }
+    ShardWorker w0(sq, 0), w1(sq, 1);
+    std::vector<int> seen(4 * SHARDS, 0);
+    auto note = [&](uint32_t shard, Entry& x) {
+        if (x.args[0] % SHARDS == shard) ++seen[x.args[0]];
+    };
+    if (w0.poll(note) != 4 || w0.get_metrics().home_items != 4) return fail(N, "home shard first");
+    if (w0.poll(note) != 4 || w0.get_metrics().steals != 1)   return fail(N, "idle home → steal");
+
+    // a claimed shard is skipped, not waited for
+    if (!sq.shard(2).try_claim())                            return fail(N, "claim free shard");
+    if (w1.poll(note) != 4 || w1.get_metrics().claim_busy != 1) return fail(N, "claimed shard not skipped");
+    sq.shard(2).release();
+    while (w1.poll(note) != 0) {}
+    if (std::count(seen.begin(), seen.end(), 1) != int(seen.size())) return fail(N, "entries lost or repeated");
+    if (w1.poll(note) != 0 || w1.get_metrics().idle_polls == 0) return fail(N, "idle poll");
+
+    // keyed: one shard per key, in order; a full shard spills round-robin
+    const uint32_t ks = prod.shard_of(7);
+    for (uint64_t i = 0; i < CAP; ++i) {
+        e.args[0] = i;
+        if (!prod.enqueue_to(7, e))                          return fail(N, "keyed enqueue");
+    }
+    if (prod.enqueue_to(7, e))                               return fail(N, "keyed enqueue past full");
+    if (sq.shard(ks).group.head.load() != sq.shard(ks).consumed.load() + CAP)
+                                                             return fail(N, "key left its shard");
+    const size_t spills0 = prod.get_metrics().spills;
+    for (uint32_t i = 0; i < SHARDS; ++i) prod.enqueue(e);
+    if (prod.get_metrics().spills != spills0 + 1)            return fail(N, "full shard not spilled");
+    ShardWorker wk(sq, ks);
+    uint64_t next = 0;
+    bool ordered = true;
+    while (wk.get_metrics().home_items < CAP)
+        wk.poll([&](uint32_t s, Entry& x) { if (s == ks) ordered &= x.args[0] == next++; });
+    if (!ordered)                                            return fail(N, "keyed order");
+    while (wk.poll([](uint32_t, Entry&) {}) != 0) {}
+
+    // threads: 2 producers, 3 workers, every entry handled once
+    constexpr uint64_t PER = 3000;
+    std::atomic<uint64_t> count{0}, sum{0};
+    std::atomic<bool>     stop{false};
+    std::vector<std::thread> workers;
+    for (uint32_t w = 0; w < 3; ++w)
+        workers.emplace_back([&, w] {
+            ShardWorker me(sq, w);
+            auto fn = [&](uint32_t, Entry& x) { ++count; sum += x.args[0]; };
+            while (!stop.load(std::memory_order_relaxed)) me.poll(fn);
+            while (me.poll(fn) != 0) {}
+        });
+    std::vector<std::thread> producers;
+    for (uint32_t p = 0; p < 2; ++p)
+        producers.emplace_back([&, p] {
+            ShardProducer me(sq, p);
+            Entry x{};
+            for (uint64_t i = 0; i < PER; ++i) {
+                x.args[0] = p * PER + i;
+                while (!me.enqueue(x)) std::this_thread::yield();
+            }
+        });
+    for (auto& t : producers) t.join();
+    while (count.load() < 2 * PER) std::this_thread::yield();
+    stop = true;
+    for (auto& t : workers) t.join();
+    if (count.load() != 2 * PER || sum.load() != (2 * PER) * (2 * PER - 1) / 2)
+                                                             return fail(N, "threaded delivery");
+    pass(N);
+}
+
+// ---------------------------------------------------------------------------
+// 28. Packed small messages: fill, deadline, flush, mixing, ring full
+// ---------------------------------------------------------------------------
+void test_packed_small_messages() {
+    constexpr const char* N = "test_packed_small_messages";
+    TestEnv env;
+    CxlMpscQueue& q = *env.q;
+    q.set_pack_deadline(~0ull);                          // flush by size / hand only
+
+    std::vector<std::vector<uint64_t>> got;
+    auto sink = [&](std::span<const uint64_t> m) { got.emplace_back(m.begin(), m.end()); };
+
+    // 1 + 2 + 1 + 3 words fill one line exactly → sent on the spot
+    const uint64_t a[] = {1}, b[] = {2, 3}, c[] = {4}, d[] = {5, 6, 7};
+    for (auto m : {std::span<const uint64_t>(a), std::span<const uint64_t>(b),
+                   std::span<const uint64_t>(c), std::span<const uint64_t>(d)})
+        if (!q.enqueue_small(m))                             return fail(N, "enqueue_small");
+    if (q.small_staged() != 0)                               return fail(N, "full line not sent");
+#if CXL_QUEUE_METRICS
+    if (q.get_metrics().small_lines != 1)                    return fail(N, "full line not counted");
+#endif
+    if (q.dequeue_small(sink) != 4 || got.size() != 4)       return fail(N, "unpack count");
+    if (got[1] != std::vector<uint64_t>{2, 3} || got[3] != std::vector<uint64_t>{5, 6, 7})
+                                                             return fail(N, "unpack content");
+
+    // 16 one-word messages → 2 full lines + 2 staged until flush_small()
+    got.clear();
+    for (uint64_t i = 0; i < 16; ++i) q.enqueue_small({&i, 1});
+    if (q.small_staged() != 2 || q.dequeue_small(sink) != 14) return fail(N, "partial line sent early");
+    if (!q.flush_small() || q.dequeue_small(sink) != 2)      return fail(N, "flush_small");
+    for (uint64_t i = 0; i < 16; ++i)
+        if (got[i].size() != 1 || got[i][0] != i)            return fail(N, "order across lines");
+#if CXL_QUEUE_METRICS
+    if (q.get_metrics().small_lines != 4)                    return fail(N, "lines per message");
+#endif
+
+    // deadline 0: the first message goes out at once; a plain entry
+    // reads as one 7-word message
+    q.set_pack_deadline(0);
+    got.clear();
+    const uint64_t x = 42;
+    q.enqueue_small({&x, 1});
+    if (q.small_staged() != 0)                               return fail(N, "deadline ignored");
+    Entry e{};
+    e.args[6] = 9;
+    e.meta.f.seal_index = -1;
+    q.enqueue(e);
+    if (q.dequeue_small(sink) != 2 || got[0] != std::vector<uint64_t>{42} ||
+        got[1].size() != 7 || got[1][6] != 9)                return fail(N, "deadline / plain line");
+
+    // ring full: a full pack stays staged, the next message is refused
+    q.set_pack_deadline(~0ull);
+    while (q.enqueue(e)) {}
+    const uint64_t seven[7] = {1, 2, 3, 4, 5, 6, 7};
+    if (!q.enqueue_small(seven) || q.small_staged() != 1)    return fail(N, "full pack not kept");
+    if (q.enqueue_small({&x, 1}))                            return fail(N, "message accepted without room");
+    Entry out{};
+    while (q.dequeue(out)) {}
+    if (!q.flush_small())                                    return fail(N, "flush after drain");
+    got.clear();
+    if (q.dequeue_small(sink) != 1 || got[0].size() != 7)    return fail(N, "staged pack lost");
+    pass(N);
+}
+
+// ---------------------------------------------------------------------------
+// 29. Topology placement: cores before SMT siblings, nearest node first
+// ---------------------------------------------------------------------------
+void test_topology_placement() {
+    constexpr const char* N = "test_topology_placement";
+    using cxl::CpuInfo;
+
+    // 2 sockets × 2 cores × 2 threads (Linux numbering: siblings at +4),
+    // plus a CPU-less CXL node 2 that is closer to socket 1
+    std::vector<CpuInfo> cpus;
+    for (unsigned c = 0; c < 8; ++c) {
+        const int sock = (c % 4) / 2;
+        cpus.push_back({c, sock, sock, static_cast<int>(c % 2)});
+    }
+    const cxl::Topology topo(cpus, {{10, 21, 25}, {21, 10, 20}, {25, 20, 10}});
+
+    if (!topo.smt_siblings(0, 4) || topo.smt_siblings(0, 1)) return fail(N, "siblings");
+
+    const cxl::Placement p3 = topo.place(2, 3);
+    if (p3.size() != 3 || p3[0] != 2 || p3[1] != 3 || p3[2] != 0) return fail(N, "nearest cores first");
+    for (const auto& t : p3.threads)
+        if (t.core_shared)                                      return fail(N, "core shared early");
+    if (p3.threads[0].distance != 20 || p3.threads[2].distance != 25) return fail(N, "distance");
+
+    const cxl::Placement p5 = topo.place(2, 5);
+    if (p5[4] != 6 || !p5.threads[4].core_shared || !p5.threads[0].core_shared ||
+        p5.threads[1].core_shared)                              return fail(N, "siblings after all cores");
+
+    const cxl::Placement p9 = topo.place(0, 9);
+    if (!p9.oversubscribed || p9[0] != 0 || p9[8] != p9[0])     return fail(N, "oversubscribed wrap");
+
+    if (topo.partner_of(2, 1) != 3 || topo.partner_of(0, 0) != 1) return fail(N, "partner_of");
+    if (topo.place(-1, 1)[0] != 0)                              return fail(N, "unknown memory node");
+
+    // the real machine: at least this thread's CPU, layout printable
+    const cxl::Topology here = cxl::Topology::discover();
+    if (here.cpus().empty() || here.node_of(here.cpus().front().cpu) < 0)
+                                                                return fail(N, "discover");
+    std::ostringstream os;
+    here.place(0, 2).print(os, {"client", "server"});
+    if (os.str().find("server") == std::string::npos)           return fail(N, "print");
+    pass(N);
+}
+
+// ---------------------------------------------------------------------------
+// 30. Region directory + persistent queue: restart, new generation
+// ---------------------------------------------------------------------------
+void test_region_restart() {
+    constexpr const char* N = "test_region_restart";
+    cxl::NumaAllocator alloc(0, 4u << 20, cxl::DebugLevel::off);
+    constexpr std::size_t BYTES = 256u << 10;
+    void* base = alloc.allocate_aligned(BYTES, 64);
+    std::memset(base, 0xa5, BYTES);                      // never-formatted media
+
+    if (RegionDirectory::present(base))                  return fail(N, "garbage taken for a directory");
+    bool threw = false;
+    try { RegionDirectory::open(base, BYTES); } catch (const std::runtime_error&) { threw = true; }
+    if (!threw)                                          return fail(N, "open without directory");
+
+    RegionDirectory dir = RegionDirectory::open_or_format(base, BYTES);
+    const QueueAttachment qa = init_queue(dir, "req", ORDER);
+    if (qa.generation != 1 || qa.base != 0 || qa.order != ORDER) return fail(N, "first generation");
+    for (std::size_t i = 0; i < CAP; ++i)
+        if (qa.ring[i].meta.f.epoch != 0)                return fail(N, "ring not zeroed on create");
+
+    Entry e{}, out{};
+    e.meta.f.seal_index = -1;
+    {
+        CxlMpscQueue p(qa.ring, ORDER, qa.tail, /*do_initialize=*/false);
+        CxlMpscQueue c(qa.ring, ORDER, qa.tail, /*do_initialize=*/false);
+        p.resume_producer();
+        c.resume_consumer();
+        for (uint64_t i = 0; i < 5; ++i) { e.args[0] = i; p.enqueue(e); }
+        for (int i = 0; i < 2; ++i) c.dequeue(out);
+        c.publish_tail();                                // planned stop
+    }
+
+    // restart both sides: attach by name, continue where they stopped
+    RegionDirectory dir2 = RegionDirectory::open(base, BYTES);
+    if (dir2.find("missing") != nullptr)                 return fail(N, "missing name found");
+    const auto qb = attach_queue(dir2, "req");
+    if (!qb || qb->ring != qa.ring || qb->generation != 1) return fail(N, "attach");
+    {
+        CxlMpscQueue p(qb->ring, ORDER, qb->tail, /*do_initialize=*/false);
+        CxlMpscQueue c(qb->ring, ORDER, qb->tail, /*do_initialize=*/false);
+        if (p.resume_producer() != 5)                    return fail(N, "producer head");
+        c.set_lookahead(4);
+        c.resume_consumer();
+        if (c.lookahead() != 4)                          return fail(N, "lookahead dropped on resume");
+        e.args[0] = 5;
+        p.enqueue(e);
+        for (uint64_t i = 2; i < 6; ++i)
+            if (!c.dequeue(out) || out.args[0] != i)     return fail(N, "continue after restart");
+        if (c.dequeue(out))                              return fail(N, "extra entry");
+        for (uint64_t i = 0; i < 3 * CAP; ++i) {         // wrap a few laps
+            e.args[0] = i;
+            if (!p.enqueue(e) || !c.dequeue(out) || out.args[0] != i) return fail(N, "laps");
+        }
+        for (uint64_t i = 0; i < 3; ++i) p.enqueue(e);   // left unconsumed
+    }
+
+    // new generation: nothing rewritten, stale entries stay invisible
+    const uint64_t stale = qa.ring[1].args[0];
+    const QueueAttachment qc = init_queue(dir, "req", ORDER);
+    if (qc.generation != 2 || qc.ring != qa.ring)        return fail(N, "second generation");
+    if (qa.ring[1].args[0] != stale)                     return fail(N, "ring rewritten");
+    if (dir.entries() != 1)                              return fail(N, "entry duplicated");
+    {
+        CxlMpscQueue p(qc.ring, ORDER, qc.tail, /*do_initialize=*/false);
+        CxlMpscQueue c(qc.ring, ORDER, qc.tail, /*do_initialize=*/false);
+        if (p.resume_producer() != qc.base)              return fail(N, "stale slot taken for the head");
+        c.resume_consumer();
+        if (c.dequeue(out))                              return fail(N, "stale entry delivered");
+        for (uint64_t i = 0; i < 2 * CAP; ++i) {
+            e.args[0] = 100 + i;
+            if (!p.enqueue(e) || !c.dequeue(out) || out.args[0] != 100 + i) return fail(N, "new generation");
+        }
+    }
+
+    threw = false;
+    try { dir.create("req", 64); } catch (const std::invalid_argument&) { threw = true; }
+    if (!threw)                                          return fail(N, "duplicate name");
+    threw = false;
+    try { init_queue(dir, "req", ORDER + 1); } catch (const std::invalid_argument&) { threw = true; }
+    if (!threw)                                          return fail(N, "order change");
+    pass(N);
+}
+
+// ---------------------------------------------------------------------------
+// 31. QueueSet: a ring stopped by a torn line stays pending (any METRICS)
+// ---------------------------------------------------------------------------
+void test_queue_set_torn_pending() {
+    constexpr const char* N = "test_queue_set_torn_pending";
+    cxl::NumaAllocator alloc(0, 4u << 20, cxl::DebugLevel::off);
+    QueueSet set(alloc, 4, ORDER);
+
+    std::vector<uint64_t> got;
+    auto sink = [&](uint32_t, Entry& e) { got.push_back(e.args[0]); };
+    set.poll(sink);                                       // initial drain
+
+    // three entries on ring 2; the middle one reads torn until repaired
+    CxlMpscQueue& q = set.queue(2);
+    Entry* torn = nullptr;
+    for (uint64_t i = 0; i < 3; ++i) {
+        SlotReservation r = q.reserve();
+        if (!r)                                           return fail(N, "reserve");
+        r.entry->args[0] = i;
+        r.entry->meta.f.seal_index = -1;
+        q.commit(r);
+        if (i == 1) torn = r.entry;
+    }
+    torn->args[0] ^= 0x100;
+    _mm_clflushopt(torn);
+    _mm_sfence();
+
+    if (set.poll(sink) != 1 || got != std::vector<uint64_t>{0}) return fail(N, "did not stop at torn line");
+    if (!q.last_batch_torn())                             return fail(N, "torn stop not reported");
+
+    // the doorbell is consumed; only the pending flag brings the ring back
+    torn->args[0] ^= 0x100;
+    _mm_clflushopt(torn);
+    _mm_sfence();
+    if (set.poll(sink) != 2 || got != std::vector<uint64_t>{0, 1, 2}) return fail(N, "torn ring not pending");
+    if (set.poll(sink) != 0)                              return fail(N, "items after repair");
+    pass(N);
+}
+
+// ---------------------------------------------------------------------------
+//  Main: invoke all tests
+// ---------------------------------------------------------------------------
+int main() {
+    test_enqueue_dequeue_single();   std::cout << '\n';
+    test_wraparound_behavior();      std::cout << '\n';
+    test_empty_and_full();           std::cout << '\n';
+    test_checksum_logic();           std::cout << '\n';
+    test_group_shared_capacity();    std::cout << '\n';
+    test_threaded_mpsc();            std::cout << '\n';
+    test_batch_enqueue_dequeue();    std::cout << '\n';
+    test_reserve_commit_peek_release(); std::cout << '\n';
+    test_multi_line_messages();      std::cout << '\n';
+    test_lookahead_hits_and_misses(); std::cout << '\n';
+    test_adaptive_tail_policy();      std::cout << '\n';
+    test_wait_policy_ladder();        std::cout << '\n';
+    test_queue_set_doorbells();       std::cout << '\n';
+    test_rpc_window_and_dispatch();   std::cout << '\n';
+    test_coroutine_scheduler();       std::cout << '\n';
+    test_pool_allocator_reuse();      std::cout << '\n';
+    test_buffer_pool_handles();       std::cout << '\n';
+    test_allocator_prefault();        std::cout << '\n';
+    test_store_load_policies();       std::cout << '\n';
+    test_check_policies();            std::cout << '\n';
+    test_latency_histogram_and_calibration(); std::cout << '\n';
+    test_stats_export();              std::cout << '\n';
+    test_adaptive_backoff();          std::cout << '\n';
+    test_stream_channel();            std::cout << '\n';
+    test_rpc_tail_piggyback();        std::cout << '\n';
+    test_broadcast_ring();            std::cout << '\n';
+    test_sharded_work_stealing();     std::cout << '\n';
+    test_packed_small_messages();     std::cout << '\n';
+    test_topology_placement();        std::cout << '\n';
+    test_region_restart();            std::cout << '\n';
+    test_queue_set_torn_pending();
+    return failures.load() == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
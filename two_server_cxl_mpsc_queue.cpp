@@ -3,11 +3,20 @@
 //  Sanity / micro-benchmark using CXL-backed allocators for two processes.
 //
 //  CLI (choose **one** form) ––––––––––––––––––––––––––––––––––––––––––––––
-//    <producer|consumer> pin <cpu_id> dax [iter_count]
+//    <producer|consumer> pin <cpu_id> dax [iter_count [batch [lookahead]]] [latency]
 //
 //    • producer|consumer : Role of this process
 //    • cpu_id            : logical CPU to pin the main thread to
 //    • iter_count        : #iterations (default = 10’000’000 = 10 M)
+//    • batch             : entries per enqueue_batch()/dequeue_batch()
+//                          (default = 1 → plain enqueue()/dequeue())
+//    • lookahead         : consumer slots kept flushed + prefetched
+//                          ahead of dequeue() (default = 0 → off)
+//    • latency           : (both sides) calibrate the TSC offset between
+//                          the hosts over two small side rings, stamp every
+//                          entry with the producer TSC, and report
+//                          p50/p99/p99.9 one-way latency (consumer) and
+//                          enqueue-call latency (producer)
 //
 //  Examples
 //    # On machine 1 (Producer)
@@ -16,6 +25,14 @@
 //    # On machine 2 (Consumer)
 //    sudo ./cxl_mpsc_queue consumer pin 3 dax 20000000
 //
+//    # Batched: 32 lines per fence on both sides
+//    sudo ./cxl_mpsc_queue producer pin 15 dax 20000000 32
+//    sudo ./cxl_mpsc_queue consumer pin 3  dax 20000000 32
+//
+//    # One-way latency percentiles
+//    sudo ./cxl_mpsc_queue producer pin 15 dax 20000000 1 0 latency
+//    sudo ./cxl_mpsc_queue consumer pin 3  dax 20000000 1 0 latency
+//
 //  Build (GCC ≥ 12 or Clang ≥ 15)
 //    g++ -O3 -std=c++20 -march=native -mavx512f -mavx512bw \
 //        -mclflushopt -mclwb -mmovdir64b  \
@@ -25,7 +42,9 @@
 
 #include "cxl_mpsc_queue_exp.hpp"
 #include "cxl_allocator.hpp" // Assuming this file exists and is correct
+#include "cxl_latency.hpp"
 
+#include <algorithm>
 #include <atomic>
 #include <cassert>
 #include <chrono>
@@ -37,6 +56,7 @@
 #include <sched.h>
 #include <sstream>
 #include <string>
+#include <span>
 #include <thread>
 #include <vector>
 
@@ -53,8 +73,8 @@ static void pin_to_cpu(int cpu_id) {
 
 [[noreturn]] static void print_usage(const char* prog) {
     std::cerr <<
-        "usage  : " << prog << " <producer|consumer> pin <cpu_id> dax [iter_count]\n"
-        "notes  : iter_count defaults to 10M when omitted\n"
+        "usage  : " << prog << " <producer|consumer> pin <cpu_id> dax [iter_count [batch [lookahead]]] [latency]\n"
+        "notes  : iter_count defaults to 10M, batch to 1, lookahead to 0 when omitted\n"
         "       : 'dax' mode is required for multi-process test\n";
     std::exit(EXIT_FAILURE);
 }
@@ -64,10 +84,15 @@ static void pin_to_cpu(int cpu_id) {
 //-------------------------------------------------------------------
 int main(int argc, char* argv[]) {
     constexpr std::size_t DEFAULT_ITERS = 10'000'000ULL;
+    constexpr uint32_t    CAL_ROUNDS    = 2'000;
 
     //-----------------------------------------------------------------------
     //  Parse CLI
     //-----------------------------------------------------------------------
+    // Optional trailing “latency” – strip it before the rest.
+    const bool LATENCY = argc >= 6 && std::string{argv[argc - 1]} == "latency";
+    if (LATENCY) --argc;
+
     if (argc < 5) print_usage(argv[0]);
 
     const std::string role = argv[1];
@@ -82,7 +107,10 @@ int main(int argc, char* argv[]) {
         print_usage(argv[0]);
     }
 
-    std::size_t ITER = (argc >= 6) ? std::stoull(argv[5]) : DEFAULT_ITERS;
+    std::size_t ITER  = (argc >= 6) ? std::stoull(argv[5]) : DEFAULT_ITERS;
+    std::size_t BATCH = (argc >= 7) ? std::stoull(argv[6]) : 1;
+    if (BATCH == 0) print_usage(argv[0]);
+    const uint32_t LOOKAHEAD = (argc >= 8) ? static_cast<uint32_t>(std::stoul(argv[7])) : 0;
 
     //-----------------------------------------------------------------------
     //  Pin main thread and create allocator
@@ -99,7 +127,10 @@ int main(int argc, char* argv[]) {
     }
 
     std::cout << "[" << role << "] Pinned to CPU " << cpu_id << '\n'
-              << "[" << role << "] Iterations      : " << ITER << "\n\n";
+              << "[" << role << "] Iterations      : " << ITER << '\n'
+              << "[" << role << "] Batch size      : " << BATCH << '\n'
+              << "[" << role << "] Lookahead       : " << LOOKAHEAD << '\n'
+              << "[" << role << "] Latency mode    : " << (LATENCY ? "on" : "off") << "\n\n";
 
     //-----------------------------------------------------------------------
     //  Queue setup – allocate from CXL allocator
@@ -109,11 +140,20 @@ int main(int argc, char* argv[]) {
 
     // Allocate all shared memory regions
     Entry* ring             = static_cast<Entry*>   (alloc->allocate_aligned(RING_BYTES, 64));
-    uint64_t* tail_cxl         = static_cast<uint64_t*>(alloc->allocate_aligned(sizeof(uint64_t), 64));
+    uint64_t* tail_cxl         = static_cast<uint64_t*>(alloc->allocate_aligned(64, 64));   // whole tail line
     uint64_t* producer_ready   = static_cast<uint64_t*>(alloc->allocate_aligned(sizeof(uint64_t), 64));
     uint64_t* consumer_ready   = static_cast<uint64_t*>(alloc->allocate_aligned(sizeof(uint64_t), 64));
     uint64_t* start_signal     = static_cast<uint64_t*>(alloc->allocate_aligned(sizeof(uint64_t), 64));
 
+    // TSC calibration side rings (allocated in every mode so the layout
+    // does not depend on the flags)
+    constexpr uint32_t CAL_ORDER = 4;
+    Entry*    cal_req_ring = static_cast<Entry*>   (alloc->allocate_aligned(sizeof(Entry) << CAL_ORDER, 64));
+    uint64_t* cal_req_tail = static_cast<uint64_t*>(alloc->allocate_aligned(64, 64));
+    Entry*    cal_rsp_ring = static_cast<Entry*>   (alloc->allocate_aligned(sizeof(Entry) << CAL_ORDER, 64));
+    uint64_t* cal_rsp_tail = static_cast<uint64_t*>(alloc->allocate_aligned(64, 64));
+    const double tsc_per_ns = LATENCY ? measure_tsc_per_ns() : 0.0;
+
     //-----------------------------------------------------------------------
     //  Run process-specific logic
     //-----------------------------------------------------------------------
@@ -124,6 +164,8 @@ int main(int argc, char* argv[]) {
         store_nt_u64(start_signal, 0);
 
         CxlMpscQueue q_producer(ring, ORDER, tail_cxl, /*do_initialize=*/true);
+        CxlMpscQueue q_cal_req(cal_req_ring, CAL_ORDER, cal_req_tail, /*do_initialize=*/true);
+        CxlMpscQueue q_cal_rsp(cal_rsp_ring, CAL_ORDER, cal_rsp_tail, /*do_initialize=*/true);
 
         // --- Warm-up phase ---
         std::cout << "[producer] Warming up...\n";
@@ -144,20 +186,51 @@ int main(int argc, char* argv[]) {
         std::cout << "[producer] Waiting for consumer...\n";
         while (load_fresh_u64(consumer_ready) == 0) { cpu_relax_for_cycles(100); }
 
+        if (LATENCY) {
+            std::cout << "[producer] Answering " << CAL_ROUNDS << " TSC calibration rounds...\n";
+            serve_tsc_calibration(q_cal_req, q_cal_rsp, CAL_ROUNDS);
+        }
+
         std::cout << "[producer] Consumer ready. Starting benchmark.\n";
         store_nt_u64(start_signal, 1);
         
         // --- Timed phase ---
+        LatencyHistogram h_enq;                 // cycles per successful call
+        std::vector<Entry> batch(BATCH, e);
         const auto t0 = std::chrono::steady_clock::now();
-        for (std::size_t i = WARMUP; i < ITER; ++i) {
-            e.meta.f.rpc_id = static_cast<uint16_t>(i);
-            
-            // Loop until enqueue succeeds, with debug logging enabled.
-            // The internal backoff in enqueue will prevent busy-spinning.
-            while (!q_producer.enqueue(e, false)) {}
+        if (BATCH == 1) {
+            for (std::size_t i = WARMUP; i < ITER; ++i) {
+                e.meta.f.rpc_id = static_cast<uint16_t>(i);
+
+                // Loop until enqueue succeeds, with debug logging enabled.
+                // The internal backoff in enqueue will prevent busy-spinning.
+                if (LATENCY) {
+                    stamp_tx(e);
+                    while (!q_producer.enqueue(e, false)) {}
+                    h_enq.record(__rdtsc() - e.args[k_ts_arg]);
+                    continue;
+                }
+                while (!q_producer.enqueue(e, false)) {}
+
+                // Log every successful enqueue operation.
+                // std::osyncstream(std::cout) << "[producer] Successfully enqueued item " << i << ".\n";
+            }
+        } else {
+            for (std::size_t i = WARMUP; i < ITER; ) {
+                const std::size_t n = std::min(BATCH, ITER - i);
+                for (std::size_t j = 0; j < n; ++j)
+                    batch[j].meta.f.rpc_id = static_cast<uint16_t>(i + j);
 
-            // Log every successful enqueue operation.
-            // std::osyncstream(std::cout) << "[producer] Successfully enqueued item " << i << ".\n";
+                // A short batch (ring almost full) enqueues a prefix only.
+                const uint64_t c0 = __rdtsc();
+                if (LATENCY)
+                    for (std::size_t j = 0; j < n; ++j) batch[j].args[k_ts_arg] = c0;
+                std::span<Entry> pending(batch.data(), n);
+                while (!pending.empty())
+                    pending = pending.subspan(q_producer.enqueue_batch(pending));
+                if (LATENCY) h_enq.record(__rdtsc() - c0);
+                i += n;
+            }
         }
         const auto t_prod = std::chrono::steady_clock::now() - t0;
 
@@ -169,6 +242,10 @@ int main(int argc, char* argv[]) {
         const std::size_t produced_items = ITER - WARMUP;
         std::cout << "\n[producer] Producer time: " << std::fixed << std::setprecision(2)
                   << ns_per(produced_items, t_prod) << " ns/op\n";
+        if (LATENCY)
+            h_enq.print(BATCH == 1 ? "[producer] enqueue() latency"
+                                   : "[producer] enqueue_batch() latency",
+                        std::cout, tsc_per_ns);
         q_producer.print_metrics("Producer");
 
     } else { // Consumer role
@@ -177,10 +254,28 @@ int main(int argc, char* argv[]) {
         while (load_fresh_u64(producer_ready) == 0) { cpu_relax_for_cycles(100); }
 
         CxlMpscQueue q_consumer(ring, ORDER, tail_cxl, /*do_initialize=*/false);
+        CxlMpscQueue q_cal_req(cal_req_ring, CAL_ORDER, cal_req_tail, /*do_initialize=*/false);
+        CxlMpscQueue q_cal_rsp(cal_rsp_ring, CAL_ORDER, cal_rsp_tail, /*do_initialize=*/false);
+        q_consumer.set_lookahead(LOOKAHEAD);
 
         std::cout << "[consumer] Producer is ready. Signaling own readiness.\n";
         store_nt_u64(consumer_ready, 1);
 
+        // producer TSC − consumer TSC
+        TscOffset tsc_off{};
+        if (LATENCY) {
+            tsc_off = calibrate_tsc_offset(q_cal_req, q_cal_rsp, CAL_ROUNDS);
+            std::cout << "[consumer] TSC offset (producer − consumer): " << tsc_off.offset
+                      << " cycles  ± " << std::fixed << std::setprecision(1)
+                      << tsc_off.rtt_min / 2 / tsc_per_ns << " ns (best RTT "
+                      << tsc_off.rtt_min / tsc_per_ns << " ns of " << tsc_off.rounds << ")\n";
+        }
+        LatencyHistogram h_one_way;
+        // warm-up entries carry no timestamp
+        const auto record = [&](const Entry& x, uint64_t now) {
+            if (LATENCY && x.args[k_ts_arg] != 0) h_one_way.record(one_way_cycles(x, tsc_off, now));
+        };
+
         std::cout << "[consumer] Waiting for start signal...\n";
         while (load_fresh_u64(start_signal) == 0) { cpu_relax_for_cycles(100); }
 
@@ -188,12 +283,27 @@ int main(int argc, char* argv[]) {
 
         // --- Timed phase ---
         Entry e{};
+        std::vector<Entry> batch(BATCH);
         std::size_t consumed = 0;
         const auto t0 = std::chrono::steady_clock::now();
+        while (BATCH > 1 && consumed < ITER) {
+            const std::size_t n = q_consumer.dequeue_batch(batch, ITER - consumed);
+            const uint64_t now = n && LATENCY ? __rdtsc() : 0;
+            for (std::size_t j = 0; j < n; ++j, ++consumed) {
+                record(batch[j], now);
+                if (batch[j].meta.f.rpc_id != static_cast<uint16_t>(consumed)) {
+                    std::osyncstream(std::cerr) << "[consumer] VERIFICATION FAILED! "
+                                                << "Expected rpc_id: " << consumed
+                                                << ", but got: " << batch[j].meta.f.rpc_id << ".\n";
+                    exit(EXIT_FAILURE); // Exit immediately on data corruption.
+                }
+            }
+        }
         while (consumed < ITER) {
             // Attempt to dequeue with debug logging enabled.
             // The internal backoff in dequeue will prevent busy-spinning.
             if (q_consumer.dequeue(e)) {
+                if (LATENCY) record(e, __rdtsc());
                 if (e.meta.f.rpc_id != static_cast<uint16_t>(consumed)) {
                     std::osyncstream(std::cerr) << "[consumer] VERIFICATION FAILED! "
                                                 << "Expected rpc_id: " << consumed
@@ -212,6 +322,9 @@ int main(int argc, char* argv[]) {
         };
         std::cout << "\n[consumer] Consumer time: " << std::fixed << std::setprecision(2)
                   << ns_per(ITER, t_cons) << " ns/op\n";
+        if (LATENCY)
+            h_one_way.print("[consumer] one-way latency (producer stamp → dequeue)",
+                            std::cout, tsc_per_ns);
         q_consumer.print_metrics("Consumer");
     }
 
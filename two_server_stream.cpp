@@ -0,0 +1,235 @@
+// two_server_stream.cpp
+// ─────────────────────────────────────────────────────────────────────────────
+//  Bulk transfer benchmark for StreamChannel (cxl_stream.hpp) across two
+//  hosts sharing a DAX region, or two threads on one host.
+//
+//  CLI (choose **one** form) ––––––––––––––––––––––––––––––––––––––––––––––
+//    <producer|consumer> pin <cpu_id> dax [msg_MiB [reps [chunk_KiB [chunks [window]]]]]
+//    local <numa_node> [msg_MiB [reps [chunk_KiB [chunks [window]]]]]
+//
+//    • producer|consumer : role of this process (start both, any order)
+//    • local             : both roles as threads over DRAM of numa_node
+//    • msg_MiB           : size of one message, e.g. a model shard (default 64)
+//    • reps              : messages streamed back to back (default 16)
+//    • chunk_KiB         : chunk buffer size (default 1024)
+//    • chunks            : chunk buffers = credits (default 8)
+//    • window            : chunks the consumer keeps in flight (default chunks/2)
+//
+//  The producer fills each message with a known pattern before the timed
+//  phase; the consumer receives into a local buffer and checks a sample of
+//  words per message.  Both sides report wall-clock GB/s and the channel's
+//  own TSC-based GB/s and credit counters.
+//
+//  Examples
+//    # On machine 1 (Producer)
+//    sudo ./two_stream producer pin 15 dax 256 8 2048 8
+//    # On machine 2 (Consumer)
+//    sudo ./two_stream consumer pin 3  dax 256 8 2048 8
+//
+//    # Single host, node 1 as the "CXL" memory
+//    ./two_stream local 1 64 16
+//
+//  Build
+//    make two_stream
+// ─────────────────────────────────────────────────────────────────────────────
+
+#include "cxl_allocator.hpp"
+#include "cxl_latency.hpp"
+#include "cxl_mpsc_queue_exp.hpp"
+#include "cxl_stream.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <sched.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+//-------------------------------------------------------------------
+//  Helpers
+//-------------------------------------------------------------------
+static void pin_to_cpu(int cpu_id) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu_id, &set);
+    if (::sched_setaffinity(0, sizeof(set), &set) != 0)
+        std::perror("sched_setaffinity");
+}
+
+[[noreturn]] static void print_usage(const char* prog) {
+    std::cerr <<
+        "usage  : " << prog << " <producer|consumer> pin <cpu_id> dax [msg_MiB [reps [chunk_KiB [chunks [window]]]]]\n"
+        "       : " << prog << " local <numa_node> [msg_MiB [reps [chunk_KiB [chunks [window]]]]]\n"
+        "notes  : defaults 64 MiB × 16 messages, 1024 KiB chunks, 8 chunks, window = chunks/2\n";
+    std::exit(EXIT_FAILURE);
+}
+
+struct Config {
+    std::size_t msg_bytes   = 64ull << 20;
+    std::size_t reps        = 16;
+    std::size_t chunk_bytes = 1ull << 20;
+    uint32_t    chunks      = 8;
+    uint32_t    window      = 0;
+};
+
+// Word i of message r; consumer recomputes it for the sampled words.
+static inline uint64_t pattern(std::size_t r, std::size_t i) noexcept
+{
+    return (uint64_t{r} << 40) ^ (i * 0x9e37'79b9'7f4a'7c15ull);
+}
+
+// Shared lines for the start handshake (first in the region).
+struct Handshake {
+    uint64_t* producer_ready;
+    uint64_t* consumer_ready;
+};
+
+static Handshake alloc_handshake(cxl::CxlAllocator& alloc)
+{
+    return {static_cast<uint64_t*>(alloc.allocate_aligned(64, 64)),
+            static_cast<uint64_t*>(alloc.allocate_aligned(64, 64))};
+}
+
+static double gb_per_s(std::size_t bytes, std::chrono::nanoseconds ns)
+{
+    return ns.count() > 0 ? double(bytes) / double(ns.count()) : 0.0;
+}
+
+//-------------------------------------------------------------------
+//  Roles (the channel is constructed by the caller)
+//-------------------------------------------------------------------
+static void run_producer(StreamChannel& ch, const Config& cfg, double tsc_per_ns)
+{
+    std::vector<std::vector<uint64_t>> msgs(std::min<std::size_t>(cfg.reps, 2));
+    for (std::size_t r = 0; r < msgs.size(); ++r) {
+        msgs[r].resize(cfg.msg_bytes / 8);
+        for (std::size_t i = 0; i < msgs[r].size(); ++i) msgs[r][i] = pattern(r, i);
+    }
+
+    const auto t0 = std::chrono::steady_clock::now();
+    for (std::size_t r = 0; r < cfg.reps; ++r) {
+        // two source buffers, patterns alternate (message r uses r % 2)
+        ch.send(msgs[r % msgs.size()].data(), cfg.msg_bytes);
+    }
+    const auto dt = std::chrono::steady_clock::now() - t0;
+
+    std::cout << "\n[producer] " << cfg.reps << " × " << (cfg.msg_bytes >> 20) << " MiB in "
+              << std::fixed << std::setprecision(2)
+              << std::chrono::duration<double, std::milli>(dt).count() << " ms → "
+              << gb_per_s(cfg.reps * cfg.msg_bytes, dt) << " GB/s\n";
+    ch.print_metrics("Producer", std::cout, tsc_per_ns);
+}
+
+static bool run_consumer(StreamChannel& ch, const Config& cfg, double tsc_per_ns)
+{
+    std::vector<uint64_t> buf(cfg.msg_bytes / 8);
+    bool ok = true;
+
+    const auto t0 = std::chrono::steady_clock::now();
+    for (std::size_t r = 0; r < cfg.reps; ++r) {
+        const std::size_t got = ch.receive(buf.data(), cfg.msg_bytes);
+        // sample 64 words spread over the message, plus the last one
+        const std::size_t words = got / 8;
+        const std::size_t pat   = r % std::min<std::size_t>(cfg.reps, 2);
+        bool good = got == cfg.msg_bytes && words > 0;
+        for (std::size_t k = 0; good && k <= 64; ++k) {
+            const std::size_t i = k == 64 ? words - 1 : k * (words / 64);
+            good = buf[i] == pattern(pat, i);
+        }
+        if (!good) {
+            std::cerr << "[consumer] VERIFICATION FAILED in message " << r
+                      << " (" << got << " of " << cfg.msg_bytes << " bytes)\n";
+            ok = false;
+            break;
+        }
+    }
+    ch.publish_credits();
+    const auto dt = std::chrono::steady_clock::now() - t0;
+
+    std::cout << "\n[consumer] " << cfg.reps << " × " << (cfg.msg_bytes >> 20) << " MiB in "
+              << std::fixed << std::setprecision(2)
+              << std::chrono::duration<double, std::milli>(dt).count() << " ms → "
+              << gb_per_s(cfg.reps * cfg.msg_bytes, dt) << " GB/s"
+              << (ok ? "  (verified)" : "") << '\n';
+    ch.print_metrics("Consumer", std::cout, tsc_per_ns);
+    return ok;
+}
+
+//-------------------------------------------------------------------
+//  Main
+//-------------------------------------------------------------------
+int main(int argc, char* argv[]) {
+    if (argc < 3) print_usage(argv[0]);
+    const std::string role  = argv[1];
+    const bool        local = role == "local";
+    if (!local && role != "producer" && role != "consumer") print_usage(argv[0]);
+    if (!local && (argc < 5 || std::string{argv[2]} != "pin" || std::string{argv[4]} != "dax"))
+        print_usage(argv[0]);
+
+    int arg = local ? 3 : 5;
+    Config cfg;
+    if (argc > arg) cfg.msg_bytes   = std::stoull(argv[arg++]) << 20;
+    if (argc > arg) cfg.reps        = std::stoull(argv[arg++]);
+    if (argc > arg) cfg.chunk_bytes = std::stoull(argv[arg++]) << 10;
+    if (argc > arg) cfg.chunks      = static_cast<uint32_t>(std::stoul(argv[arg++]));
+    if (argc > arg) cfg.window      = static_cast<uint32_t>(std::stoul(argv[arg++]));
+    if (cfg.msg_bytes == 0 || cfg.reps == 0 || cfg.chunk_bytes < 64 || cfg.chunks == 0)
+        print_usage(argv[0]);
+
+    const std::size_t region = std::size_t{cfg.chunks} * cfg.chunk_bytes + (4u << 20);
+    std::unique_ptr<cxl::CxlAllocator> alloc;
+    try {
+        if (local) alloc = std::make_unique<cxl::NumaAllocator>(std::stoi(argv[2]), region,
+                                                                cxl::DebugLevel::off);
+        else       alloc = std::make_unique<cxl::DaxAllocator>();
+    } catch (const std::exception& ex) {
+        std::cerr << "Allocator init failed: " << ex.what() << '\n';
+        return EXIT_FAILURE;
+    }
+    const double tsc_per_ns = measure_tsc_per_ns();
+
+    std::cout << "[" << role << "] Message         : " << (cfg.msg_bytes >> 20) << " MiB × " << cfg.reps << '\n'
+              << "[" << role << "] Chunks          : " << cfg.chunks << " × " << (cfg.chunk_bytes >> 10) << " KiB\n";
+
+    if (local) {
+        const StreamRegion r = StreamRegion::allocate(*alloc, cfg.chunks, cfg.chunk_bytes);
+        StreamChannel tx(r, /*do_initialize=*/true,  cfg.window);
+        StreamChannel rx(r, /*do_initialize=*/false, cfg.window);
+        std::cout << "[local] Window          : " << rx.window() << '\n';
+        bool ok = true;
+        std::thread consumer([&] { ok = run_consumer(rx, cfg, tsc_per_ns); });
+        run_producer(tx, cfg, tsc_per_ns);
+        consumer.join();
+        return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    const int cpu_id = std::stoi(argv[3]);
+    pin_to_cpu(cpu_id);
+    std::cout << "[" << role << "] Pinned to CPU " << cpu_id << "\n";
+
+    // handshake lines first, so the consumer can find them before it
+    // attaches to a channel the producer has not initialised yet
+    const Handshake hs = alloc_handshake(*alloc);
+    if (role == "producer") {
+        store_nt_u64(hs.consumer_ready, 0);
+        StreamChannel ch(*alloc, cfg.chunks, cfg.chunk_bytes, /*do_initialize=*/true, cfg.window);
+        store_nt_u64(hs.producer_ready, 1);
+        std::cout << "[producer] Waiting for consumer...\n";
+        while (load_fresh_u64(hs.consumer_ready) == 0) { cpu_relax_for_cycles(100); }
+        run_producer(ch, cfg, tsc_per_ns);
+        store_nt_u64(hs.producer_ready, 0);          // next run starts clean
+        return EXIT_SUCCESS;
+    }
+
+    std::cout << "[consumer] Waiting for producer to be ready...\n";
+    while (load_fresh_u64(hs.producer_ready) == 0) { cpu_relax_for_cycles(100); }
+    StreamChannel ch(*alloc, cfg.chunks, cfg.chunk_bytes, /*do_initialize=*/false, cfg.window);
+    std::cout << "[consumer] Window          : " << ch.window() << '\n';
+    store_nt_u64(hs.consumer_ready, 1);
+    return run_consumer(ch, cfg, tsc_per_ns) ? EXIT_SUCCESS : EXIT_FAILURE;
+}